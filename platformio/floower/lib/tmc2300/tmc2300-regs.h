@@ -144,6 +144,7 @@ struct REG_CHOPCONF {
 const uint8_t REG_TCOOLTHRS_ADDRESS = 0x14;
 const uint8_t REG_SGTHRS_ADDRESS = 0x40;
 const uint8_t REG_SG_VALUE_ADDRESS = 0x41;
+const uint16_t REG_SG_VALUE_MASK = 0x3FF; // 10 bit StallGuard result
 const uint8_t REG_COOLCONF_ADDRESS = 0x42;
 
 #pragma pack(pop)
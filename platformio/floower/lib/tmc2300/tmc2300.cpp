@@ -1,8 +1,33 @@
 #include "tmc2300.h"
 
+// CRC8 with polynomial x^8+x^2+x+1 over bytes sent LSB first, the table is of the reflected polynomial so the CRC is
+// computed reflected and turned around once at the end
+constexpr uint8_t crcReflected(uint8_t crc, uint8_t bits) {
+    return bits == 0 ? crc : crcReflected((crc & 1) ? (crc >> 1) ^ 0xE0 : crc >> 1, bits - 1);
+}
+
+#define CRC_4(i) crcReflected(i, 8), crcReflected(i + 1, 8), crcReflected(i + 2, 8), crcReflected(i + 3, 8)
+#define CRC_16(i) CRC_4(i), CRC_4(i + 4), CRC_4(i + 8), CRC_4(i + 12)
+#define CRC_64(i) CRC_16(i), CRC_16(i + 16), CRC_16(i + 32), CRC_16(i + 48)
+
+static constexpr uint8_t crcTable[256] = {CRC_64(0), CRC_64(64), CRC_64(128), CRC_64(192)};
+
+static uint8_t reflect(uint8_t value) {
+    value = (value & 0xF0) >> 4 | (value & 0x0F) << 4;
+    value = (value & 0xCC) >> 2 | (value & 0x33) << 2;
+    value = (value & 0xAA) >> 1 | (value & 0x55) << 1;
+    return value;
+}
+
+// configuration registers the driver changes only when written, status registers are always read
+static const uint8_t shadowAddresses[TMC2300_SHADOW_SIZE] = {
+    REG_GCONF::address, REG_IHOLD_IRUN::address, REG_TCOOLTHRS_ADDRESS, REG_SGTHRS_ADDRESS, REG_COOLCONF_ADDRESS, REG_CHOPCONF::address
+};
+
 TMC2300::TMC2300(Stream *serialPort, float RSense, uint8_t uartAddress) :
     serialPort(serialPort), RSense(RSense), uartAddress(uartAddress) {
     //defaults();
+    resetShadow();
 }
 
 uint8_t TMC2300::testConnection() {
@@ -16,7 +41,7 @@ uint8_t TMC2300::testConnection() {
 
 REG_GCONF TMC2300::readGConfReg() {
     REG_GCONF gconf;
-    gconf.sr = read(REG_GCONF::address);
+    gconf.sr = readRegister(REG_GCONF::address);
     return gconf;
 }
 
@@ -26,6 +51,10 @@ REG_GSTAT TMC2300::readGStat() {
     return gstat;
 }
 
+void TMC2300::writeGStat(REG_GSTAT gstat) {
+    write(REG_GSTAT::address, gstat.sr);
+}
+
 REG_IOIN TMC2300::readIontReg() {
     REG_IOIN iont;
     iont.sr = read(REG_IOIN::address);
@@ -37,7 +66,7 @@ void TMC2300::writeIontReg(REG_IOIN ioin) {
 }
 
 void TMC2300::writeIholdIrunReg(REG_IHOLD_IRUN iholdIrun) {
-    write(REG_IHOLD_IRUN::address, iholdIrun.sr);
+    writeRegister(REG_IHOLD_IRUN::address, iholdIrun.sr);
 }
 
 REG_DRV_STATUS TMC2300::readDrvStatusReg() {
@@ -52,27 +81,300 @@ void TMC2300::writeDrvStatusReg(REG_DRV_STATUS drvStatus) {
 
 REG_CHOPCONF TMC2300::readChopconf() {
     REG_CHOPCONF chopconf;
-    chopconf.sr = read(REG_CHOPCONF::address);
+    chopconf.sr = readRegister(REG_CHOPCONF::address);
     return chopconf;
 }
 
 void TMC2300::writeChopconfReg(REG_CHOPCONF chopconf) {
-    write(REG_CHOPCONF::address, chopconf.sr);
+    writeRegister(REG_CHOPCONF::address, chopconf.sr);
 }
 
 void TMC2300::writeTCoolThrs(uint32_t tCoolThrs) {
-    write(REG_TCOOLTHRS_ADDRESS, tCoolThrs);
+    writeRegister(REG_TCOOLTHRS_ADDRESS, tCoolThrs);
 }
 
-uint8_t TMC2300::readSGValue() {
-    return read(REG_SG_VALUE_ADDRESS);
+uint16_t TMC2300::readSGValue() {
+    return read(REG_SG_VALUE_ADDRESS) & REG_SG_VALUE_MASK;
 }
 
 void TMC2300::writeSGThrs(uint32_t sgThrs) {
-    write(REG_SGTHRS_ADDRESS, sgThrs);
+    writeRegister(REG_SGTHRS_ADDRESS, sgThrs);
+}
+
+void TMC2300::setRegister(uint8_t regAddr, uint32_t regVal) {
+    int8_t index = shadowIndex(regAddr);
+    if (index < 0) {
+        write(regAddr, regVal); // not in the shadow, write right away
+        return;
+    }
+    uint8_t mask = 1 << index;
+    if ((shadowValid & mask) && shadow[index] == regVal) {
+        return;
+    }
+    shadow[index] = regVal;
+    shadowValid |= mask;
+    shadowDirty |= mask;
+}
+
+uint8_t TMC2300::flush() {
+    uint8_t written = 0;
+    for (uint8_t i = 0; i < TMC2300_SHADOW_SIZE; i++) {
+        if (shadowDirty & (1 << i)) {
+            write(shadowAddresses[i], shadow[i]);
+            written++;
+        }
+    }
+    return written;
+}
+
+uint8_t TMC2300::flushAsync() {
+    uint8_t queued = 0;
+    for (uint8_t i = 0; i < TMC2300_SHADOW_SIZE; i++) {
+        if ((shadowDirty & (1 << i)) && writeAsync(shadowAddresses[i], shadow[i])) {
+            queued++; // stays dirty until written
+        }
+    }
+    return queued;
+}
+
+void TMC2300::resetShadow() {
+    for (uint8_t i = 0; i < TMC2300_SHADOW_SIZE; i++) {
+        shadow[i] = 0;
+    }
+    shadowValid = 0;
+    shadowDirty = 0;
+    storeShadow(REG_CHOPCONF::address, TMC2300_CHOPCONF_DEFAULT); // the only one read-modify-written
+}
+
+uint32_t TMC2300::readRegister(uint8_t regAddr) {
+    int8_t index = shadowIndex(regAddr);
+    if (index >= 0 && (shadowValid & (1 << index))) {
+        return shadow[index];
+    }
+    uint32_t regVal = read(regAddr);
+    if (index >= 0 && !CRCerror) {
+        storeShadow(regAddr, regVal);
+    }
+    return regVal;
+}
+
+void TMC2300::writeRegister(uint8_t regAddr, uint32_t regVal) {
+    int8_t index = shadowIndex(regAddr);
+    if (index >= 0) {
+        uint8_t mask = 1 << index;
+        if ((shadowValid & mask) && !(shadowDirty & mask) && shadow[index] == regVal) {
+            return; // driver has it already
+        }
+    }
+    write(regAddr, regVal);
+}
+
+int8_t TMC2300::shadowIndex(uint8_t regAddr) {
+    for (uint8_t i = 0; i < TMC2300_SHADOW_SIZE; i++) {
+        if (shadowAddresses[i] == regAddr) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void TMC2300::storeShadow(uint8_t regAddr, uint32_t regVal) {
+    int8_t index = shadowIndex(regAddr);
+    if (index >= 0) {
+        shadow[index] = regVal;
+        shadowValid |= 1 << index;
+        shadowDirty &= ~(1 << index);
+    }
+}
+
+bool TMC2300::readAsync(const uint8_t *addresses, uint8_t count, TMC2300ReadCallback callback) {
+    if (count == 0 || count > TMC2300_BATCH_SIZE) {
+        return false;
+    }
+    Request request;
+    request.write = false;
+    request.count = count;
+    for (uint8_t i = 0; i < count; i++) {
+        request.addresses[i] = addresses[i];
+        request.values[i] = 0;
+    }
+    request.readCallback = callback;
+    return enqueue(request);
+}
+
+bool TMC2300::writeAsync(uint8_t regAddr, uint32_t regVal, TMC2300WriteCallback callback) {
+    Request request;
+    request.write = true;
+    request.count = 1;
+    request.addresses[0] = regAddr;
+    request.values[0] = regVal;
+    request.writeCallback = callback;
+    return enqueue(request);
+}
+
+bool TMC2300::readStatusAsync(TMC2300StatusCallback callback) {
+    const uint8_t addresses[] = {REG_DRV_STATUS::address, REG_SG_VALUE_ADDRESS, REG_GSTAT::address};
+    return readAsync(addresses, 3, [callback](bool ok, const uint32_t *values, uint8_t count) {
+        TMC2300Status status;
+        status.drvStatus.sr = values[0];
+        status.sgValue = values[1] & REG_SG_VALUE_MASK;
+        status.gstat.sr = values[2];
+        callback(ok, status);
+    });
+}
+
+void TMC2300::poll() {
+    // move on as far as the UART allows, return once waiting for the driver
+    while (queueLength > 0) {
+        if (asyncState == ASYNC_SEND) {
+            sendAsync();
+        } else if (asyncState == ASYNC_REPLY) {
+            if (!receiveAsync()) {
+                if (millis() - sentTime < replyDelay + abortWindow) {
+                    return;
+                }
+                if (!retryAsync()) {
+                    completeAsync(false);
+                }
+                continue;
+            }
+            Request &request = queue[queueHead];
+            if (!checkReply(reply)) {
+                if (!retryAsync()) {
+                    completeAsync(false);
+                }
+                continue;
+            }
+            request.values[batchIndex++] = reply >> 8;
+            attempts = 0;
+            asyncState = ASYNC_SEND;
+            if (batchIndex == request.count) {
+                completeAsync(true);
+            }
+        } else {
+            while (serialPort->available() > 0) {
+                serialPort->read(); // echo of the single wire UART
+            }
+            if (millis() - sentTime < replyDelay) {
+                return;
+            }
+            completeAsync(true);
+        }
+    }
+}
+
+bool TMC2300::isBusy() {
+    return queueLength > 0;
+}
+
+bool TMC2300::enqueue(Request &request) {
+    if (queueLength >= TMC2300_QUEUE_SIZE) {
+        return false;
+    }
+    queue[(queueHead + queueLength) % TMC2300_QUEUE_SIZE] = request;
+    queueLength++;
+    return true;
+}
+
+void TMC2300::sendAsync() {
+    Request &request = queue[queueHead];
+    uint8_t regAddr = request.addresses[batchIndex];
+    while (serialPort->available() > 0) { // flush
+        serialPort->read();
+    }
+    if (request.write) {
+        uint32_t regVal = request.values[0];
+        uint8_t datagram[] = {TMC2300_SYNC, uartAddress, (uint8_t)(regAddr | TMC_WRITE), (uint8_t)(regVal>>24), (uint8_t)(regVal>>16), (uint8_t)(regVal>>8), (uint8_t)(regVal>>0), 0x00};
+        datagram[7] = calcCRC(datagram, 7);
+        for (uint8_t i = 0; i < 8; i++) {
+            bytesWritten += serialPort->write(datagram[i]);
+        }
+        asyncState = ASYNC_WRITTEN;
+    } else {
+        uint8_t datagram[] = {TMC2300_SYNC, uartAddress, (uint8_t)(regAddr | TMC_READ), 0x00};
+        datagram[3] = calcCRC(datagram, 3);
+        for (uint8_t i = 0; i < 4; i++) {
+            serialPort->write(datagram[i]);
+        }
+        sync = 0;
+        reply = 0;
+        replyLength = 0;
+        asyncState = ASYNC_REPLY;
+    }
+    sentTime = millis();
+}
+
+bool TMC2300::receiveAsync() {
+    // scan for the rx frame as sendDatagram does, only with the bytes already received
+    uint8_t regAddr = queue[queueHead].addresses[batchIndex];
+    uint32_t syncTarget = (static_cast<uint32_t>(TMC2300_SYNC)<<16) | 0xFF00 | regAddr;
+    while (serialPort->available() > 0) {
+        int16_t res = serialPort->read();
+        if (res < 0) {
+            break;
+        }
+        if (replyLength == 0) {
+            sync = ((sync << 8) | (res & 0xFF)) & 0xFFFFFF;
+            if (sync == syncTarget) {
+                reply = sync;
+                replyLength = 3;
+            }
+            continue;
+        }
+        reply = (reply << 8) | (res & 0xFF);
+        if (++replyLength == 8) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TMC2300::retryAsync() {
+    if (++attempts >= maxRetries) {
+        return false;
+    }
+    asyncState = ASYNC_SEND;
+    return true;
+}
+
+void TMC2300::completeAsync(bool ok) {
+    // take the request out first, the callback may queue another one
+    Request request = queue[queueHead];
+    queue[queueHead].readCallback = nullptr;
+    queue[queueHead].writeCallback = nullptr;
+    queueHead = (queueHead + 1) % TMC2300_QUEUE_SIZE;
+    queueLength--;
+    asyncState = ASYNC_SEND;
+    batchIndex = 0;
+    attempts = 0;
+
+    if (request.write) {
+        if (ok) {
+            storeShadow(request.addresses[0], request.values[0]);
+        }
+        if (request.writeCallback) {
+            request.writeCallback(ok);
+        }
+    } else if (request.readCallback) {
+        if (!ok) {
+            for (uint8_t i = 0; i < request.count; i++) {
+                request.values[i] = 0;
+            }
+        }
+        request.readCallback(ok, request.values, request.count);
+    }
+}
+
+void TMC2300::finishAsync() {
+    poll();
+    while (queueLength > 0) {
+        delay(1);
+        poll();
+    }
 }
 
 uint32_t TMC2300::read(uint8_t regAddr) {
+    finishAsync();
     constexpr uint8_t len = 3;
     regAddr |= TMC_READ;
 
@@ -84,20 +386,8 @@ uint32_t TMC2300::read(uint8_t regAddr) {
         out = sendDatagram(datagram, len, abortWindow);
         delay(replyDelay);
 
-        CRCerror = false;
-        uint8_t outDatagram[] = {
-            static_cast<uint8_t>(out>>56),
-            static_cast<uint8_t>(out>>48),
-            static_cast<uint8_t>(out>>40),
-            static_cast<uint8_t>(out>>32),
-            static_cast<uint8_t>(out>>24),
-            static_cast<uint8_t>(out>>16),
-            static_cast<uint8_t>(out>> 8),
-            static_cast<uint8_t>(out>> 0)
-        };
-        uint8_t crc = calcCRC(outDatagram, 7);
-        if ((crc != static_cast<uint8_t>(out)) || crc == 0 ) {
-            CRCerror = true;
+        CRCerror = !checkReply(out);
+        if (CRCerror) {
             out = 0;
         } else {
             break;
@@ -107,7 +397,23 @@ uint32_t TMC2300::read(uint8_t regAddr) {
     return out>>8;
 }
 
+bool TMC2300::checkReply(uint64_t reply) {
+    uint8_t replyDatagram[] = {
+        static_cast<uint8_t>(reply>>56),
+        static_cast<uint8_t>(reply>>48),
+        static_cast<uint8_t>(reply>>40),
+        static_cast<uint8_t>(reply>>32),
+        static_cast<uint8_t>(reply>>24),
+        static_cast<uint8_t>(reply>>16),
+        static_cast<uint8_t>(reply>> 8),
+        static_cast<uint8_t>(reply>> 0)
+    };
+    uint8_t crc = calcCRC(replyDatagram, 7);
+    return crc == static_cast<uint8_t>(reply) && crc != 0;
+}
+
 void TMC2300::write(uint8_t regAddr, uint32_t regVal) {
+    finishAsync();
     uint8_t len = 7;
     regAddr |= TMC_WRITE;
 
@@ -117,25 +423,17 @@ void TMC2300::write(uint8_t regAddr, uint32_t regVal) {
     for (uint8_t i = 0; i <= len; i++) {
         bytesWritten += serialPort->write(datagram[i]);
     }
+    storeShadow(regAddr & ~TMC_WRITE, regVal);
 
     delay(replyDelay);
 }
 
-uint8_t TMC2300::calcCRC(uint8_t datagram[], uint8_t len) {
-    uint8_t crc = 0;
+uint8_t TMC2300::calcCRC(const uint8_t datagram[], uint8_t len) {
+    uint8_t crc = 0; // reflected
     for (uint8_t i = 0; i < len; i++) {
-        uint8_t currentByte = datagram[i];
-        for (uint8_t j = 0; j < 8; j++) {
-            if ((crc >> 7) ^ (currentByte & 0x01)) {
-                crc = (crc << 1) ^ 0x07;
-            } else {
-                crc = (crc << 1);
-            }
-            crc &= 0xff;
-            currentByte = currentByte >> 1;
-        }
+        crc = crcTable[crc ^ datagram[i]];
     }
-    return crc;
+    return reflect(crc);
 }
 
 uint64_t TMC2300::sendDatagram(uint8_t datagram[], const uint8_t len, uint16_t timeout) {
@@ -2,8 +2,24 @@
 
 #include <Arduino.h>
 #include <Stream.h>
+#include <functional>
 #include "tmc2300-regs.h"
 
+#define TMC2300_QUEUE_SIZE 8 // pending asynchronous requests
+#define TMC2300_BATCH_SIZE 4 // registers read by one request
+#define TMC2300_SHADOW_SIZE 6 // configuration registers kept in the shadow
+#define TMC2300_CHOPCONF_DEFAULT 0x13008001 // power-on value
+
+struct TMC2300Status {
+  REG_DRV_STATUS drvStatus;
+  uint16_t sgValue; // 10 bit
+  REG_GSTAT gstat;
+};
+
+typedef std::function<void(bool ok, const uint32_t *values, uint8_t count)> TMC2300ReadCallback;
+typedef std::function<void(bool ok)> TMC2300WriteCallback;
+typedef std::function<void(bool ok, TMC2300Status status)> TMC2300StatusCallback;
+
 class TMC2300 {
   public:
     TMC2300(Stream *serialPort, float RSense, uint8_t addr);
@@ -11,6 +27,7 @@ class TMC2300 {
 
     REG_GCONF readGConfReg();
     REG_GSTAT readGStat();
+    void writeGStat(REG_GSTAT gstat); // flags are cleared by writing them back
 
     REG_IOIN readIontReg();
     void writeIontReg(REG_IOIN ioin);
@@ -24,15 +41,59 @@ class TMC2300 {
     void writeChopconfReg(REG_CHOPCONF chopconf);
 
     void writeTCoolThrs(uint32_t tCoolThrs);
-    uint8_t readSGValue();
+    uint16_t readSGValue();
     void writeSGThrs(uint32_t sgThrs);
     //void writeCoolConf(REG_COOL_CONF coolConf);
+
+    // Shadow of the configuration registers, reads are served from it once the value is known and writes of the
+    // value the driver already has are skipped. setRegister() only marks the register dirty, flush() writes the
+    // changed ones. Call resetShadow() when the driver was reset.
+    void setRegister(uint8_t regAddr, uint32_t regVal);
+    uint8_t flush(); // returns registers written
+    uint8_t flushAsync(); // queues the writes, returns registers queued
+    void resetShadow();
+
+    static uint8_t calcCRC(const uint8_t datagram[], uint8_t len);
+
+    // Asynchronous access, requests are queued and carried out by poll() which never waits for the driver. Callbacks
+    // are called from poll(). Meant for a single task, the blocking methods finish the queued requests first.
+    bool readAsync(const uint8_t *addresses, uint8_t count, TMC2300ReadCallback callback);
+    bool writeAsync(uint8_t regAddr, uint32_t regVal, TMC2300WriteCallback callback = nullptr);
+    bool readStatusAsync(TMC2300StatusCallback callback); // DRV_STATUS, SG_VALUE and GSTAT in one pass
+    void poll();
+    bool isBusy();
     
   private:
     uint32_t read(uint8_t addr);
     void write(uint8_t regAddr, uint32_t regVal);
-    uint8_t calcCRC(uint8_t datagram[], uint8_t len);
+    uint32_t readRegister(uint8_t regAddr);
+    void writeRegister(uint8_t regAddr, uint32_t regVal);
+    int8_t shadowIndex(uint8_t regAddr);
+    void storeShadow(uint8_t regAddr, uint32_t regVal);
     uint64_t sendDatagram(uint8_t datagram[], const uint8_t len, uint16_t timeout);
+    bool checkReply(uint64_t reply);
+
+    struct Request {
+      bool write;
+      uint8_t addresses[TMC2300_BATCH_SIZE];
+      uint32_t values[TMC2300_BATCH_SIZE];
+      uint8_t count;
+      TMC2300ReadCallback readCallback;
+      TMC2300WriteCallback writeCallback;
+    };
+
+    enum AsyncState {
+      ASYNC_SEND, // send datagram of the current register of the first request
+      ASYNC_REPLY, // wait for the read reply
+      ASYNC_WRITTEN // let the write datagram go out
+    };
+
+    bool enqueue(Request &request);
+    void sendAsync();
+    bool receiveAsync();
+    bool retryAsync();
+    void completeAsync(bool ok);
+    void finishAsync();
 
     Stream *serialPort = nullptr;
     const float RSense;
@@ -40,6 +101,21 @@ class TMC2300 {
     uint16_t bytesWritten = 0;
     bool CRCerror = false;
 
+    uint32_t shadow[TMC2300_SHADOW_SIZE];
+    uint8_t shadowValid = 0; // bit mask of shadow registers with known value
+    uint8_t shadowDirty = 0; // bit mask of shadow registers to be written
+
+    Request queue[TMC2300_QUEUE_SIZE];
+    uint8_t queueHead = 0;
+    uint8_t queueLength = 0;
+    AsyncState asyncState = ASYNC_SEND;
+    uint8_t batchIndex = 0; // register of the first request being transferred
+    uint8_t attempts = 0;
+    uint32_t sentTime = 0; // ms
+    uint32_t sync = 0;
+    uint64_t reply = 0;
+    uint8_t replyLength = 0;
+
     static constexpr uint8_t TMC_READ = 0x00;
     static constexpr uint8_t TMC_WRITE = 0x80;
     static constexpr uint8_t TMC2300_SYNC = 0x05;
@@ -9,105 +9,48 @@
 static const char* LOG_TAG = "Config";
 #endif
 
-// max 512B of EEPROM
-
-#define EEPROM_SIZE 512
-#define CONFIG_VERSION 5
-
-#define FLAG_BIT_CALIBRATED 0
-#define FLAG_BIT_BLUETOOTH_ALWAYS_ON 1
-#define FLAG_BIT_TOUCH_CALIBRATED 2
-
-// DO NOT CHANGE MEMORY ADDRESSES!
-// Hardware constants (reserved 0-19)
-#define EEPROM_ADDRESS_CONFIG_VERSION 0 // byte - version of configuration
-#define EEPROM_ADDRESS_LEDS_MODEL 1 // 0 - WS2812b, 1 - SK6812 (1 byte) NOT USED ANYMORE (since version 1)
-#define EEPROM_ADDRESS_SERVO_CLOSED 2 // integer (2 bytes) calibrated position of servo blossom closed (since version 1)
-#define EEPROM_ADDRESS_SERVO_OPEN 4 // integer (2 bytes) calibrated position of servo blossom open (since version 1)
-#define EEPROM_ADDRESS_REVISION 6 // byte - revision number of the logic board to enable features (since version 2)
-#define EEPROM_ADDRESS_SERIALNUMBER 7 // integer (2 bytes) (since version 2)
-#define EEPROM_ADDRESS_FLAGS 9 // byte (8 bites) - config flags [calibrated,bluetoothAlwaysOn,touchCalibrated,,,,,] (since version 3)
-
-// Customizable values (20+)
-#define EEPROM_ADDRESS_TOUCH_THRESHOLD 20 // byte (since version 2) - calibrated touch threshold value
-#define EEPROM_ADDRESS_BEHAVIOR 21 // byte - enumeration of predefined behaviors (since version 2)
-#define EEPROM_ADDRESS_COLOR_SCHEME_LENGTH 22 // 1 byte - number of colors set in EEPROM_ADDRESS_COLOR_SCHEME (since version 2)
-#define EEPROM_ADDRESS_NAME_LENGTH 23 // byte - length of data stored in EEPROM_ADDRESS_NAME (since version 2)
-#define EEPROM_ADDRESS_SPEED 24 // byte - speed of opening/closing in 0.1s (since version 4)
-#define EEPROM_ADDRESS_MAX_OPEN_LEVEL 25 // byte - maximum open level in percents (0-100) (since version 4)
-#define EEPROM_ADDRESS_COLOR_BRIGHTNESS 26 // byte - intensity of LEDs in percents (0-100), informative - should be already applied to color scheme (since version 4)
-// TODO: touch threshold adjustment not used at the moment
-//#define EEPROM_ADDRESS_TOUCH_THRESHOLD_ADJUSTMENT 27 // byte (since version 5) - adjusted touch threshold if needed by user
-// 28 available
-// 29 available
-#define EEPROM_ADDRESS_COLOR_SCHEME 30 // (30-59) 30 bytes (15x HS set) - array of 2 bytes per stored HSB color, B is missing [(H/9 + S/7), (H/9 + S/7), ..] (since version 4)
-#define EEPROM_ADDRESS_NAME 60 // (60-99) max 25 (40 reserved) chars (since version 2)
-
-// wifi
-#define EEPROM_ADDRESS_WIFI_SSID_LENGTH 100 // byte - length of data stored in EEPROM_ADDRESS_WIFI_SSID (since version 5)
-#define EEPROM_ADDRESS_WIFI_SSID 101 // (101-132) max 32 characters (since version 5)
-#define EEPROM_ADDRESS_WIFI_PWD_LENGTH 133 // byte - length of data stored in EEPROM_ADDRESS_WIFI_PWD (since version 5)
-#define EEPROM_ADDRESS_WIFI_PWD 134 // (134-197) max 64 characters (since version 5)
-#define EEPROM_ADDRESS_FLOUD_TOKEN_LENGTH 198 // byte - length of data stored in EEPROM_ADDRESS_FLOUD_TOKEN (since version 5)
-#define EEPROM_ADDRESS_FLOUD_TOKEN 199 // (199-238) max 40 characters (since version 5)
-#define EEPROM_ADDRESS_FLOUD_DEVICE_ID_LENGTH 239 // byte - length of data stored in EEPROM_ADDRESS_FLOUD_TOKEN (since version 5)
-#define EEPROM_ADDRESS_FLOUD_DEVICE_ID 240 // (240-279) max 40 characters (since version 5)
-// next available is 239
-
 void Config::begin() {
-    EEPROM.begin(EEPROM_SIZE);
+    store.begin();
 }
 
 void Config::load() {
-    uint8_t configVersion = EEPROM.read(EEPROM_ADDRESS_CONFIG_VERSION);
-
-    if (configVersion > 0 && configVersion < 255) {
-        servoClosed = readInt(EEPROM_ADDRESS_SERVO_CLOSED);
-        servoOpen = readInt(EEPROM_ADDRESS_SERVO_OPEN);
-
-        // backward compatibility => reset to factory settings
-        if (configVersion < 2) {
-            hardwareCalibration(servoClosed, servoOpen, 0, 0);
-            factorySettings();
+    if (store.has(CONFIG_KEY_VERSION) || !isClean(CONFIG_KEY_VERSION)) {
+        // values changed and not committed yet are kept
+        if (isClean(CONFIG_KEY_SERVO_CLOSED)) {
+            servoClosed = store.readUint16(CONFIG_KEY_SERVO_CLOSED, servoClosed);
         }
-
-        // backward compatibility => set calibrated ON
-        if (configVersion < 3) {
-            setCalibrated();
+        if (isClean(CONFIG_KEY_SERVO_OPEN)) {
+            servoOpen = store.readUint16(CONFIG_KEY_SERVO_OPEN, servoOpen);
         }
-
-        // backward compatibility => settings values
-        if (configVersion < 4) {
-            resetColorScheme();
-            hardwareRevision = EEPROM.read(EEPROM_ADDRESS_REVISION);
-            EEPROM.write(EEPROM_ADDRESS_TOUCH_THRESHOLD, DEFAULT_TOUCH_THRESHOLD);
-            EEPROM.write(EEPROM_ADDRESS_SPEED, DEFAULT_SPEED);
-            EEPROM.write(EEPROM_ADDRESS_MAX_OPEN_LEVEL, DEFAULT_MAX_OPEN_LEVEL);
-            EEPROM.write(EEPROM_ADDRESS_COLOR_BRIGHTNESS, DEFAULT_COLOR_BRIGHTNESS);
+        if (isClean(CONFIG_KEY_REVISION)) {
+            hardwareRevision = store.readByte(CONFIG_KEY_REVISION, 0);
         }
-
-        // backward compatibility => wifi settings
-        if (configVersion < 5) {
-            setWifi("", "");
-            setFloud("", "");
+        if (isClean(CONFIG_KEY_SERIALNUMBER)) {
+            serialNumber = store.readUint16(CONFIG_KEY_SERIALNUMBER, 0);
         }
-
-        if (configVersion < CONFIG_VERSION) {
-            ESP_LOGW(LOG_TAG, "Config outdated %d -> %d", configVersion, CONFIG_VERSION);
-            EEPROM.write(EEPROM_ADDRESS_CONFIG_VERSION, CONFIG_VERSION);
-            commit(); // this will commit also changes above
+        if (isClean(CONFIG_KEY_TOUCH_THRESHOLD)) {
+            touchThreshold = store.readByte(CONFIG_KEY_TOUCH_THRESHOLD, DEFAULT_TOUCH_THRESHOLD);
         }
-
-        hardwareRevision = EEPROM.read(EEPROM_ADDRESS_REVISION);
-        serialNumber = readInt(EEPROM_ADDRESS_SERIALNUMBER);
-        touchThreshold = EEPROM.read(EEPROM_ADDRESS_TOUCH_THRESHOLD);
         readFlags();
         readColorScheme();
-        readName();
+        if (isClean(CONFIG_KEY_NAME)) {
+            name = store.readString(CONFIG_KEY_NAME, NAME_MAX_LENGTH);
+        }
         readSpeed();
         readMaxOpenLevel();
         readColorBrightness();
-        readWifiAndFloud();
+        if (isClean(CONFIG_KEY_WIFI_SSID)) {
+            wifiSsid = store.readString(CONFIG_KEY_WIFI_SSID, WIFI_SSID_MAX_LENGTH);
+        }
+        if (isClean(CONFIG_KEY_WIFI_PWD)) {
+            wifiPassword = store.readString(CONFIG_KEY_WIFI_PWD, WIFI_PWD_MAX_LENGTH);
+        }
+        if (isClean(CONFIG_KEY_FLOUD_DEVICE_ID)) {
+            floudDeviceId = store.readString(CONFIG_KEY_FLOUD_DEVICE_ID, FLOUD_DEVICE_ID_MAX_LENGTH);
+        }
+        if (isClean(CONFIG_KEY_FLOUD_TOKEN)) {
+            floudToken = store.readString(CONFIG_KEY_FLOUD_TOKEN, FLOUD_TOKEN_MAX_LENGTH);
+        }
       
         ESP_LOGI(LOG_TAG, "Config ready");
         ESP_LOGI(LOG_TAG, "HW: %d -> %d, R%d, SN%d, f%d, tt%d", servoClosed, servoOpen, hardwareRevision, serialNumber, flags, touchThreshold);
@@ -126,18 +69,17 @@ void Config::load() {
 
 void Config::hardwareCalibration(unsigned int servoClosed, unsigned int servoOpen, uint8_t hardwareRevision, unsigned int serialNumber) {
     ESP_LOGW(LOG_TAG, "New HW config: %d -> %d, R%d, SN%d", servoClosed, servoOpen, hardwareRevision, serialNumber);
-    EEPROM.write(EEPROM_ADDRESS_CONFIG_VERSION, CONFIG_VERSION);
-    EEPROM.write(EEPROM_ADDRESS_LEDS_MODEL, 0); // 0 - WS2812b, 1 - SK6812 not used any longer
-    writeInt(EEPROM_ADDRESS_SERVO_CLOSED, servoClosed);
-    writeInt(EEPROM_ADDRESS_SERVO_OPEN, servoOpen);
-    EEPROM.write(EEPROM_ADDRESS_REVISION, hardwareRevision);
-    writeInt(EEPROM_ADDRESS_SERIALNUMBER, serialNumber);
-    EEPROM.write(EEPROM_ADDRESS_FLAGS, 0);
-
     this->servoClosed = servoClosed;
     this->servoOpen = servoOpen;
     this->hardwareRevision = hardwareRevision;
     this->serialNumber = serialNumber;
+    this->flags = 0;
+    markDirty(CONFIG_KEY_VERSION);
+    markDirty(CONFIG_KEY_SERVO_CLOSED);
+    markDirty(CONFIG_KEY_SERVO_OPEN);
+    markDirty(CONFIG_KEY_REVISION);
+    markDirty(CONFIG_KEY_SERIALNUMBER);
+    markDirty(CONFIG_KEY_FLAGS);
 }
 
 void Config::factorySettings() {
@@ -147,26 +89,22 @@ void Config::factorySettings() {
     setSpeed(DEFAULT_SPEED);
     setMaxOpenLevel(DEFAULT_MAX_OPEN_LEVEL);
     setColorBrightness(DEFAULT_COLOR_BRIGHTNESS);
-    EEPROM.write(EEPROM_ADDRESS_TOUCH_THRESHOLD, DEFAULT_TOUCH_THRESHOLD); // not used, for forward compabitility only
-    EEPROM.write(EEPROM_ADDRESS_BEHAVIOR, DEFAULT_BEHAVIOR); // not used, for forward compabitility only
+    setTouchThreshold(DEFAULT_TOUCH_THRESHOLD);
     resetColorScheme();
 }
 
 void Config::resetColorScheme() {
-    colorScheme[0] = colorWhite;
-    colorScheme[1] = colorYellow;
-    colorScheme[2] = colorOrange;
-    colorScheme[3] = colorRed;
-    colorScheme[4] = colorPink;
-    colorScheme[5] = colorPurple;
-    colorScheme[6] = colorBlue;
-    colorScheme[7] = colorGreen;
-    colorSchemeSize = 8;
-    writeColorScheme();
+    for (uint8_t i = 0; i < DEFAULT_COLOR_SCHEME_SIZE; i++) {
+        colorScheme[i] = defaultColorScheme[i];
+    }
+    colorSchemeSize = DEFAULT_COLOR_SCHEME_SIZE;
+    markDirty(CONFIG_KEY_COLOR_SCHEME);
 }
 
 void Config::readFlags() {
-    flags = EEPROM.read(EEPROM_ADDRESS_FLAGS);
+    if (isClean(CONFIG_KEY_FLAGS)) {
+        flags = store.readByte(CONFIG_KEY_FLAGS, 0);
+    }
     calibrated = CHECK_BIT(flags, FLAG_BIT_CALIBRATED);
     bluetoothAlwaysOn = CHECK_BIT(flags, FLAG_BIT_BLUETOOTH_ALWAYS_ON);
     touchCalibrated = CHECK_BIT(flags, FLAG_BIT_TOUCH_CALIBRATED);
@@ -174,19 +112,19 @@ void Config::readFlags() {
 
 void Config::setCalibrated() {
     flags = SET_BIT(flags, FLAG_BIT_CALIBRATED);
-    EEPROM.write(EEPROM_ADDRESS_FLAGS, flags);
+    markDirty(CONFIG_KEY_FLAGS);
     this->calibrated = true;
 }
 
 void Config::setBluetoothAlwaysOn(bool bluetoothAlwaysOn) {
     flags = bluetoothAlwaysOn ? SET_BIT(flags, FLAG_BIT_BLUETOOTH_ALWAYS_ON) : CLEAR_BIT(flags, FLAG_BIT_BLUETOOTH_ALWAYS_ON);
-    EEPROM.write(EEPROM_ADDRESS_FLAGS, flags);
+    markDirty(CONFIG_KEY_FLAGS);
     this->bluetoothAlwaysOn = bluetoothAlwaysOn;
 }
 
 void Config::setTouchCalibrated(bool touchCalibrated) {
     flags = touchCalibrated ? SET_BIT(flags, FLAG_BIT_TOUCH_CALIBRATED) : CLEAR_BIT(flags, FLAG_BIT_TOUCH_CALIBRATED);
-    EEPROM.write(EEPROM_ADDRESS_FLAGS, flags);
+    markDirty(CONFIG_KEY_FLAGS);
     this->touchCalibrated = touchCalibrated;
 }
 
@@ -195,65 +133,67 @@ void Config::setColorScheme(HsbColor* colors, uint8_t size) {
     for (uint8_t i = 0; i < size; i++) {
         this->colorScheme[i] = colors[i];
     }
-    writeColorScheme();
+    markDirty(CONFIG_KEY_COLOR_SCHEME);
 }
 
 void Config::setTouchThreshold(uint8_t touchThreshold) {
-    EEPROM.write(EEPROM_ADDRESS_TOUCH_THRESHOLD, touchThreshold);
     this->touchThreshold = touchThreshold;
+    markDirty(CONFIG_KEY_TOUCH_THRESHOLD);
 }
 
 void Config::setSpeed(uint8_t speed) {
     this->speed = speed;
     this->speedMillis = speed * 100;
-    EEPROM.write(EEPROM_ADDRESS_SPEED, speed);
+    markDirty(CONFIG_KEY_SPEED);
 }
 
 void Config::setMaxOpenLevel(uint8_t maxOpenLevel) {
     this->maxOpenLevel = maxOpenLevel;
-    EEPROM.write(EEPROM_ADDRESS_MAX_OPEN_LEVEL, maxOpenLevel);
+    markDirty(CONFIG_KEY_MAX_OPEN_LEVEL);
 }
 
 void Config::setColorBrightness(uint8_t colorBrightness) {
     this->colorBrightness = colorBrightness;
     this->colorBrightnessDecimal = (double) colorBrightness / 100.0;
-    EEPROM.write(EEPROM_ADDRESS_COLOR_BRIGHTNESS, colorBrightness);
+    markDirty(CONFIG_KEY_COLOR_BRIGHTNESS);
 }
 
 void Config::readSpeed() {
-    speed = EEPROM.read(EEPROM_ADDRESS_SPEED);
-    if (speed < 5) {
-        speed = 5;
+    if (isClean(CONFIG_KEY_SPEED)) {
+        speed = store.readByte(CONFIG_KEY_SPEED, DEFAULT_SPEED);
+        if (speed < 5) {
+            speed = 5;
+        }
+        speedMillis = speed * 100;
     }
-    speedMillis = speed * 100;
 }
 
 void Config::readMaxOpenLevel() {
-    maxOpenLevel = EEPROM.read(EEPROM_ADDRESS_MAX_OPEN_LEVEL);
-    if (maxOpenLevel > 100) {
-        maxOpenLevel = 100;
+    if (isClean(CONFIG_KEY_MAX_OPEN_LEVEL)) {
+        maxOpenLevel = store.readByte(CONFIG_KEY_MAX_OPEN_LEVEL, DEFAULT_MAX_OPEN_LEVEL);
+        if (maxOpenLevel > 100) {
+            maxOpenLevel = 100;
+        }
     }
 }
 
 void Config::readColorBrightness() {
-    colorBrightness = EEPROM.read(EEPROM_ADDRESS_COLOR_BRIGHTNESS);
-    if (colorBrightness > 100) {
-        colorBrightness = 100;
-    }
-    colorBrightnessDecimal = (double) colorBrightness / 100.0;
-}
-
-void Config::writeColorScheme() {
-    for (uint8_t i = 0; i < colorSchemeSize && i < COLOR_SCHEME_MAX_LENGTH; i++) {
-        writeInt(EEPROM_ADDRESS_COLOR_SCHEME + i * 2, encodeHSColor(colorScheme[i].H, colorScheme[i].S));
+    if (isClean(CONFIG_KEY_COLOR_BRIGHTNESS)) {
+        colorBrightness = store.readByte(CONFIG_KEY_COLOR_BRIGHTNESS, DEFAULT_COLOR_BRIGHTNESS);
+        if (colorBrightness > 100) {
+            colorBrightness = 100;
+        }
+        colorBrightnessDecimal = (double) colorBrightness / 100.0;
     }
-    EEPROM.write(EEPROM_ADDRESS_COLOR_SCHEME_LENGTH, colorSchemeSize);
 }
 
 void Config::readColorScheme() {
-    colorSchemeSize = min(EEPROM.read(EEPROM_ADDRESS_COLOR_SCHEME_LENGTH), (uint8_t) COLOR_SCHEME_MAX_LENGTH);
-    for(uint8_t i = 0; i < colorSchemeSize; i++) {
-        colorScheme[i] = decodeHSColor(readInt(EEPROM_ADDRESS_COLOR_SCHEME + i * 2));
+    if (isClean(CONFIG_KEY_COLOR_SCHEME)) {
+        uint8_t value[COLOR_SCHEME_MAX_LENGTH * 2];
+        colorSchemeSize = store.read(CONFIG_KEY_COLOR_SCHEME, value, sizeof(value)) / 2;
+        for(uint8_t i = 0; i < colorSchemeSize; i++) {
+            colorScheme[i] = decodeHSColor(value[i * 2] | (value[i * 2 + 1] << 8));
+        }
     }
 }
 
@@ -273,82 +213,149 @@ HsbColor Config::decodeHSColor(uint16_t valueHS) {
 
 void Config::setName(String name) {
     this->name = name;
-    writeString(EEPROM_ADDRESS_NAME, name, EEPROM_ADDRESS_NAME_LENGTH, NAME_MAX_LENGTH);
-}
-
-void Config::readName() {
-    name = readString(EEPROM_ADDRESS_NAME, EEPROM_ADDRESS_NAME_LENGTH, NAME_MAX_LENGTH);
+    markDirty(CONFIG_KEY_NAME);
 }
 
 void Config::setWifi(String ssid, String password) {
     this->wifiSsid = ssid;
     this->wifiPassword = password;
-    writeString(EEPROM_ADDRESS_WIFI_SSID, ssid, EEPROM_ADDRESS_WIFI_SSID_LENGTH, WIFI_SSID_MAX_LENGTH);
-    writeString(EEPROM_ADDRESS_WIFI_PWD, password, EEPROM_ADDRESS_WIFI_PWD_LENGTH, WIFI_PWD_MAX_LENGTH);
+    markDirty(CONFIG_KEY_WIFI_SSID);
+    markDirty(CONFIG_KEY_WIFI_PWD);
     wifiChanged = true;
 }
 
 void Config::setFloud(String deviceId, String token) {
     this->floudDeviceId = deviceId;
     this->floudToken = token;
-    writeString(EEPROM_ADDRESS_FLOUD_DEVICE_ID, deviceId, EEPROM_ADDRESS_FLOUD_DEVICE_ID_LENGTH, FLOUD_DEVICE_ID_MAX_LENGTH);
-    writeString(EEPROM_ADDRESS_FLOUD_TOKEN, token, EEPROM_ADDRESS_FLOUD_TOKEN_LENGTH, FLOUD_TOKEN_MAX_LENGTH);
+    markDirty(CONFIG_KEY_FLOUD_DEVICE_ID);
+    markDirty(CONFIG_KEY_FLOUD_TOKEN);
     wifiChanged = true;
 }
 
-void Config::readWifiAndFloud() {
-    wifiSsid = readString(EEPROM_ADDRESS_WIFI_SSID, EEPROM_ADDRESS_WIFI_SSID_LENGTH, WIFI_SSID_MAX_LENGTH);
-    wifiPassword = readString(EEPROM_ADDRESS_WIFI_PWD, EEPROM_ADDRESS_WIFI_PWD_LENGTH, WIFI_PWD_MAX_LENGTH);
-    floudDeviceId = readString(EEPROM_ADDRESS_FLOUD_DEVICE_ID, EEPROM_ADDRESS_FLOUD_DEVICE_ID_LENGTH, FLOUD_DEVICE_ID_MAX_LENGTH);
-    floudToken = readString(EEPROM_ADDRESS_FLOUD_TOKEN, EEPROM_ADDRESS_FLOUD_TOKEN_LENGTH, FLOUD_TOKEN_MAX_LENGTH);
-}
-
-void Config::writeInt(uint16_t address, uint16_t value) {
-    uint8_t two = (value & 0xFF);
-    uint8_t one = ((value >> 8) & 0xFF);
-    
-    EEPROM.write(address, two);
-    EEPROM.write(address + 1, one);
+void Config::markDirty(uint8_t key) {
+    dirtyKeys = SET_BIT(dirtyKeys, key);
 }
 
-uint16_t Config::readInt(uint16_t address) {
-    uint8_t two = EEPROM.read(address);
-    uint16_t one = EEPROM.read(address + 1);
-  
-    return (two & 0xFFFFFF) + ((one << 8) & 0xFFFFFFFF);
+bool Config::isClean(uint8_t key) {
+    return !CHECK_BIT(dirtyKeys, key);
 }
 
-void Config::writeString(uint16_t address, String value, uint16_t sizeAddress, uint8_t maxLength) {
-    uint8_t length = min((uint8_t) value.length(), (uint8_t) maxLength);
-    if (length > 0) {
-        for (uint8_t i = 0; i < length; i++) {
-            EEPROM.write(address + i, value[i]);
+bool Config::writeKey(uint8_t key) {
+    switch (key) {
+        case CONFIG_KEY_VERSION:
+            return store.writeByte(key, CONFIG_VERSION);
+        case CONFIG_KEY_SERVO_CLOSED:
+            return store.writeUint16(key, servoClosed);
+        case CONFIG_KEY_SERVO_OPEN:
+            return store.writeUint16(key, servoOpen);
+        case CONFIG_KEY_REVISION:
+            return store.writeByte(key, hardwareRevision);
+        case CONFIG_KEY_SERIALNUMBER:
+            return store.writeUint16(key, serialNumber);
+        case CONFIG_KEY_FLAGS:
+            return store.writeByte(key, flags);
+        case CONFIG_KEY_TOUCH_THRESHOLD:
+            return store.writeByte(key, touchThreshold);
+        case CONFIG_KEY_COLOR_SCHEME: {
+            uint8_t value[COLOR_SCHEME_MAX_LENGTH * 2];
+            uint8_t size = min(colorSchemeSize, (uint8_t) COLOR_SCHEME_MAX_LENGTH);
+            for (uint8_t i = 0; i < size; i++) {
+                uint16_t valueHS = encodeHSColor(colorScheme[i].H, colorScheme[i].S);
+                value[i * 2] = valueHS & 0xFF;
+                value[i * 2 + 1] = valueHS >> 8;
+            }
+            return store.write(key, value, size * 2);
         }
+        case CONFIG_KEY_NAME:
+            return store.writeString(key, name, NAME_MAX_LENGTH);
+        case CONFIG_KEY_SPEED:
+            return store.writeByte(key, speed);
+        case CONFIG_KEY_MAX_OPEN_LEVEL:
+            return store.writeByte(key, maxOpenLevel);
+        case CONFIG_KEY_COLOR_BRIGHTNESS:
+            return store.writeByte(key, colorBrightness);
+        case CONFIG_KEY_WIFI_SSID:
+            return store.writeString(key, wifiSsid, WIFI_SSID_MAX_LENGTH);
+        case CONFIG_KEY_WIFI_PWD:
+            return store.writeString(key, wifiPassword, WIFI_PWD_MAX_LENGTH);
+        case CONFIG_KEY_FLOUD_TOKEN:
+            return store.writeString(key, floudToken, FLOUD_TOKEN_MAX_LENGTH);
+        case CONFIG_KEY_FLOUD_DEVICE_ID:
+            return store.writeString(key, floudDeviceId, FLOUD_DEVICE_ID_MAX_LENGTH);
     }
-    EEPROM.write(sizeAddress, length);
+    return false;
 }
 
-String Config::readString(uint16_t address, uint16_t sizeAddress, uint8_t maxLength) {
-    uint8_t length = min(EEPROM.read(sizeAddress), (uint8_t) maxLength);
-    if (length == 0) {
-        return String();
-    }
-    char data[length + 1];
-    for(uint8_t i = 0; i < length; i++) {
-        data[i] = EEPROM.read(address + i);
+void Config::commit() {
+    flush();
+    if (configChangedCallback != nullptr) {
+        configChangedCallback(wifiChanged);
+        wifiChanged = false;
     }
-    data[length] = '\0';
-    return String(data);
 }
 
-void Config::commit() {
-    EEPROM.commit();
+void Config::commitLater() {
+    if (dirtyKeys != 0) {
+        commitPending = true;
+        commitDueTime = millis() + CONFIG_COMMIT_QUIET_TIME; // changes coming in a row are written together
+    }
     if (configChangedCallback != nullptr) {
         configChangedCallback(wifiChanged);
         wifiChanged = false;
     }
 }
 
+void Config::update(bool petalsMoving) {
+    // writing the flash stalls both cores, the motion would stutter
+    if (commitPending && !petalsMoving && (long) (millis() - commitDueTime) >= 0) {
+        flush();
+    }
+}
+
+void Config::planIdle(IdleScheduler &scheduler) {
+    if (commitPending) {
+        scheduler.wakeAt(commitDueTime);
+    }
+}
+
+void Config::flush() {
+    commitPending = false;
+    if (dirtyKeys == 0) {
+        return;
+    }
+    unsigned long startTime = micros();
+    uint16_t keys = dirtyKeys;
+    dirtyKeys = 0; // a key changed while writing stays dirty
+    uint16_t failedKeys = 0;
+    for (uint8_t key = 0; key < CONFIG_KEYS; key++) {
+        if (CHECK_BIT(keys, key) && !writeKey(key)) {
+            ESP_LOGE(LOG_TAG, "Failed to store %d", key);
+            failedKeys = SET_BIT(failedKeys, key);
+        }
+    }
+    if (failedKeys != 0) {
+        // retried after the quiet time
+        dirtyKeys |= failedKeys;
+        commitPending = true;
+        commitDueTime = millis() + CONFIG_COMMIT_QUIET_TIME;
+    }
+    uint32_t commitTime = micros() - startTime;
+    longestCommitTime = _max(longestCommitTime, commitTime);
+    commits++;
+}
+
+bool Config::isCommitPending() {
+    return commitPending;
+}
+
+uint32_t Config::getCommits() {
+    return commits;
+}
+
+uint32_t Config::getLongestCommitTime() {
+    return longestCommitTime;
+}
+
 void Config::onConfigChanged(ConfigChangedCallback callback) {
     configChangedCallback = callback;
 }
\ No newline at end of file
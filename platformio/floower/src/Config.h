@@ -1,13 +1,18 @@
 #pragma once
 
 #include "Arduino.h"
-#include <EEPROM.h>
 #include "NeoPixelBus.h"
+#include "ConfigStore.h"
+#include "IdleScheduler.h"
 
 #define CHECK_BIT(var, pos) ((var) & (1<<(pos)))
 #define SET_BIT(var, pos) ((var) | (1<<(pos)))
 #define CLEAR_BIT(var, pos) ((var) & ~(1<<(pos)))
 
+#define FLAG_BIT_CALIBRATED 0
+#define FLAG_BIT_BLUETOOTH_ALWAYS_ON 1
+#define FLAG_BIT_TOUCH_CALIBRATED 2
+
 #define COLOR_SCHEME_MAX_LENGTH 10
 #define NAME_MAX_LENGTH 25 // BLE name limit
 #define WIFI_SSID_MAX_LENGTH 32
@@ -15,9 +20,10 @@
 #define FLOUD_TOKEN_MAX_LENGTH 40
 #define FLOUD_DEVICE_ID_MAX_LENGTH 40
 
+#define CONFIG_COMMIT_QUIET_TIME 3000 // ms without a change before deferred changes are written
+
 // default values
 #define DEFAULT_TOUCH_THRESHOLD 45 // lower means lower sensitivity (45 is normal)
-#define DEFAULT_BEHAVIOR 0
 #define DEFAULT_SPEED 50 // x0.1s = 5 seconds to open/close
 #define DEFAULT_MAX_OPEN_LEVEL 100 // default open level is 100%
 #define DEFAULT_COLOR_BRIGHTNESS 70 // default intensity is 70%
@@ -32,8 +38,12 @@ const HsbColor colorPurple(0.81, 1.0, 1.0);
 const HsbColor colorPink(0.93, 1.0, 1.0);
 const HsbColor colorBlack(0.0, 1.0, 0.0);
 
+#define DEFAULT_COLOR_SCHEME_SIZE 8
+const HsbColor defaultColorScheme[DEFAULT_COLOR_SCHEME_SIZE] = {colorWhite, colorYellow, colorOrange, colorRed, colorPink, colorPurple, colorBlue, colorGreen};
+
 typedef std::function<void(bool wifiChanged)> ConfigChangedCallback;
 
+// Values are changed and committed by the loop task only, the transports hand their commands over to it.
 class Config {
     public:
         Config(uint8_t firmwareVersion) : firmwareVersion(firmwareVersion) {}
@@ -53,7 +63,14 @@ class Config {
         void setColorBrightness(uint8_t colorBrightness);
         void setWifi(String ssid, String password);
         void setFloud(String deviceId, String token);
-        void commit();
+        void commit(); // writes the changed values to the store
+        void commitLater(); // changes take effect now, the flash is written once they stop coming
+        void update(bool petalsMoving); // writes the deferred changes when due, not while the petals move
+        void planIdle(IdleScheduler &scheduler);
+        void flush(); // writes the deferred changes now, before deep sleep or restart
+        bool isCommitPending();
+        uint32_t getCommits(); // flash writes of the changes
+        uint32_t getLongestCommitTime(); // us
         void onConfigChanged(ConfigChangedCallback callback);
 
         static uint16_t encodeHSColor(double hue, double saturation);
@@ -97,20 +114,20 @@ class Config {
 
     private:
         void readFlags();
-        void writeColorScheme();
         void readColorScheme();
-        void readName();
-        void readWifiAndFloud();
         void readSpeed();
         void readMaxOpenLevel();
         void readColorBrightness();
-
-        void writeInt(uint16_t address, uint16_t value);
-        uint16_t readInt(uint16_t address);
-
-        void writeString(uint16_t address, String value, uint16_t sizeAddress, uint8_t maxLength);
-        String readString(uint16_t address, uint16_t sizeAddress, uint8_t maxLength);
-
+        bool writeKey(uint8_t key);
+        void markDirty(uint8_t key);
+        bool isClean(uint8_t key); // the value was not changed since loaded or committed
+
+        ConfigStore store;
+        uint16_t dirtyKeys = 0; // bits of the keys changed and not committed yet
+        bool commitPending = false;
+        unsigned long commitDueTime = 0;
+        uint32_t commits = 0;
+        uint32_t longestCommitTime = 0;
         uint8_t flags = 0;
         ConfigChangedCallback configChangedCallback;
         bool wifiChanged = false;
@@ -0,0 +1,367 @@
+#include "ConfigStore.h"
+#include "Config.h"
+#include "hal/Hal.h"
+#include <EEPROM.h>
+#include <string.h>
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define LOG_TAG ""
+#else
+#include "esp_log.h"
+static const char* LOG_TAG = "ConfigStore";
+#endif
+
+#define CONFIG_STORE_FREE 0xFF // erased flash, no record from there on
+#define CONFIG_STORE_RECORD_MAX (CONFIG_STORE_VALUE_MAX + CONFIG_STORE_RECORD_OVERHEAD)
+
+// layout of the EEPROM the configuration was kept in before the store (max 512B)
+#define EEPROM_SIZE 512
+#define EEPROM_ADDRESS_CONFIG_VERSION 0 // byte - version of configuration
+#define EEPROM_ADDRESS_SERVO_CLOSED 2 // integer (2 bytes) (since version 1)
+#define EEPROM_ADDRESS_SERVO_OPEN 4 // integer (2 bytes) (since version 1)
+#define EEPROM_ADDRESS_REVISION 6 // byte (since version 2)
+#define EEPROM_ADDRESS_SERIALNUMBER 7 // integer (2 bytes) (since version 2)
+#define EEPROM_ADDRESS_FLAGS 9 // byte (since version 3)
+#define EEPROM_ADDRESS_TOUCH_THRESHOLD 20 // byte (since version 2)
+#define EEPROM_ADDRESS_COLOR_SCHEME_LENGTH 22 // byte - number of colors (since version 2)
+#define EEPROM_ADDRESS_NAME_LENGTH 23 // byte (since version 2)
+#define EEPROM_ADDRESS_SPEED 24 // byte (since version 4)
+#define EEPROM_ADDRESS_MAX_OPEN_LEVEL 25 // byte (since version 4)
+#define EEPROM_ADDRESS_COLOR_BRIGHTNESS 26 // byte (since version 4)
+#define EEPROM_ADDRESS_COLOR_SCHEME 30 // 2 bytes per color (since version 4)
+#define EEPROM_ADDRESS_NAME 60 // max 25 chars (since version 2)
+#define EEPROM_ADDRESS_WIFI_SSID_LENGTH 100 // (since version 5)
+#define EEPROM_ADDRESS_WIFI_SSID 101
+#define EEPROM_ADDRESS_WIFI_PWD_LENGTH 133
+#define EEPROM_ADDRESS_WIFI_PWD 134
+#define EEPROM_ADDRESS_FLOUD_TOKEN_LENGTH 198
+#define EEPROM_ADDRESS_FLOUD_TOKEN 199
+#define EEPROM_ADDRESS_FLOUD_DEVICE_ID_LENGTH 239
+#define EEPROM_ADDRESS_FLOUD_DEVICE_ID 240
+
+static uint8_t crc8(const uint8_t *data, size_t length) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint32_t sectorAddress(uint8_t sector) {
+    return (uint32_t) sector * CONFIG_STORE_SECTOR_SIZE;
+}
+
+void ConfigStore::begin() {
+    mount();
+    migrate();
+}
+
+void ConfigStore::mount() {
+    activeSector = -1;
+    writeOffset = CONFIG_STORE_SECTOR_SIZE;
+    memset(offsets, 0, sizeof(offsets));
+
+    // the newest formatted sector is the active one, a sector with the header missing was not compacted completely
+    for (uint8_t sector = 0; sector < CONFIG_STORE_SECTORS; sector++) {
+        uint8_t header[CONFIG_STORE_HEADER_SIZE];
+        if (!halConfigRead(sectorAddress(sector), header, CONFIG_STORE_HEADER_SIZE)) {
+            continue;
+        }
+        uint16_t magic = header[0] | (header[1] << 8);
+        uint32_t headerSequence = header[4] | (header[5] << 8) | (header[6] << 16) | ((uint32_t) header[7] << 24);
+        if (magic == CONFIG_STORE_MAGIC && headerSequence != 0xFFFFFFFF && (activeSector < 0 || headerSequence > sequence)) {
+            activeSector = sector;
+            sequence = headerSequence;
+        }
+    }
+    if (activeSector < 0) {
+        ESP_LOGW(LOG_TAG, "Not formatted");
+        return;
+    }
+
+    uint16_t offset = CONFIG_STORE_HEADER_SIZE;
+    uint8_t record[CONFIG_STORE_RECORD_MAX];
+    while (offset < CONFIG_STORE_SECTOR_SIZE) {
+        uint8_t key;
+        if (!halConfigRead(sectorAddress(activeSector) + offset, &key, 1)) {
+            break;
+        }
+        if (key == CONFIG_STORE_FREE) {
+            writeOffset = offset;
+            break;
+        }
+        uint8_t recordLength = readRecord(sectorAddress(activeSector) + offset, record);
+        if (recordLength == 0) {
+            // torn by a power loss, nothing may be appended after it
+            ESP_LOGW(LOG_TAG, "Broken record at %d", offset);
+            break;
+        }
+        offsets[key] = offset;
+        offset += recordLength;
+    }
+    if (offset == CONFIG_STORE_SECTOR_SIZE) {
+        writeOffset = offset;
+    }
+    ESP_LOGI(LOG_TAG, "Sector %d, seq %d, %dB used", activeSector, sequence, writeOffset);
+}
+
+void ConfigStore::migrate() {
+    uint8_t version = readByte(CONFIG_KEY_VERSION, 0);
+    if (version == 0) {
+        version = migrateEeprom();
+        if (version == 0) {
+            return; // not configured
+        }
+    }
+
+    // backward compatibility => reset to factory settings
+    if (version < 2) {
+        writeByte(CONFIG_KEY_REVISION, 0);
+        writeUint16(CONFIG_KEY_SERIALNUMBER, 0);
+        writeByte(CONFIG_KEY_FLAGS, 0);
+        writeFactorySettings();
+    }
+
+    // backward compatibility => set calibrated ON
+    if (version < 3) {
+        writeByte(CONFIG_KEY_FLAGS, SET_BIT(readByte(CONFIG_KEY_FLAGS, 0), FLAG_BIT_CALIBRATED));
+    }
+
+    // backward compatibility => settings values
+    if (version < 4) {
+        writeDefaultColorScheme();
+        writeByte(CONFIG_KEY_TOUCH_THRESHOLD, DEFAULT_TOUCH_THRESHOLD);
+        writeByte(CONFIG_KEY_SPEED, DEFAULT_SPEED);
+        writeByte(CONFIG_KEY_MAX_OPEN_LEVEL, DEFAULT_MAX_OPEN_LEVEL);
+        writeByte(CONFIG_KEY_COLOR_BRIGHTNESS, DEFAULT_COLOR_BRIGHTNESS);
+    }
+
+    // backward compatibility => wifi settings
+    if (version < 5) {
+        writeString(CONFIG_KEY_WIFI_SSID, "", WIFI_SSID_MAX_LENGTH);
+        writeString(CONFIG_KEY_WIFI_PWD, "", WIFI_PWD_MAX_LENGTH);
+        writeString(CONFIG_KEY_FLOUD_DEVICE_ID, "", FLOUD_DEVICE_ID_MAX_LENGTH);
+        writeString(CONFIG_KEY_FLOUD_TOKEN, "", FLOUD_TOKEN_MAX_LENGTH);
+    }
+
+    if (version < CONFIG_VERSION) {
+        ESP_LOGW(LOG_TAG, "Config outdated %d -> %d", version, CONFIG_VERSION);
+        writeByte(CONFIG_KEY_VERSION, CONFIG_VERSION); // last, an interrupted upgrade is repeated
+    }
+}
+
+static void copyEeprom(ConfigStore *store, uint8_t key, uint16_t address, uint8_t length) {
+    uint8_t value[CONFIG_STORE_VALUE_MAX];
+    for (uint8_t i = 0; i < length; i++) {
+        value[i] = EEPROM.read(address + i);
+    }
+    store->write(key, value, length);
+}
+
+static void copyEepromString(ConfigStore *store, uint8_t key, uint16_t address, uint16_t sizeAddress, uint8_t maxLength) {
+    copyEeprom(store, key, address, _min(EEPROM.read(sizeAddress), maxLength));
+}
+
+uint8_t ConfigStore::migrateEeprom() {
+    EEPROM.begin(EEPROM_SIZE);
+    uint8_t version = EEPROM.read(EEPROM_ADDRESS_CONFIG_VERSION);
+    if (version == 0 || version == 255) {
+        return 0;
+    }
+    ESP_LOGW(LOG_TAG, "Moving config %d from EEPROM", version);
+
+    // only the values of the version, the upgrade sets the rest
+    copyEeprom(this, CONFIG_KEY_SERVO_CLOSED, EEPROM_ADDRESS_SERVO_CLOSED, 2);
+    copyEeprom(this, CONFIG_KEY_SERVO_OPEN, EEPROM_ADDRESS_SERVO_OPEN, 2);
+    if (version >= 2) {
+        copyEeprom(this, CONFIG_KEY_REVISION, EEPROM_ADDRESS_REVISION, 1);
+        copyEeprom(this, CONFIG_KEY_SERIALNUMBER, EEPROM_ADDRESS_SERIALNUMBER, 2);
+        copyEeprom(this, CONFIG_KEY_TOUCH_THRESHOLD, EEPROM_ADDRESS_TOUCH_THRESHOLD, 1);
+        copyEepromString(this, CONFIG_KEY_NAME, EEPROM_ADDRESS_NAME, EEPROM_ADDRESS_NAME_LENGTH, NAME_MAX_LENGTH);
+    }
+    if (version >= 3) {
+        copyEeprom(this, CONFIG_KEY_FLAGS, EEPROM_ADDRESS_FLAGS, 1);
+    }
+    if (version >= 4) {
+        uint8_t colors = _min(EEPROM.read(EEPROM_ADDRESS_COLOR_SCHEME_LENGTH), (uint8_t) COLOR_SCHEME_MAX_LENGTH);
+        copyEeprom(this, CONFIG_KEY_COLOR_SCHEME, EEPROM_ADDRESS_COLOR_SCHEME, colors * 2);
+        copyEeprom(this, CONFIG_KEY_SPEED, EEPROM_ADDRESS_SPEED, 1);
+        copyEeprom(this, CONFIG_KEY_MAX_OPEN_LEVEL, EEPROM_ADDRESS_MAX_OPEN_LEVEL, 1);
+        copyEeprom(this, CONFIG_KEY_COLOR_BRIGHTNESS, EEPROM_ADDRESS_COLOR_BRIGHTNESS, 1);
+    }
+    if (version >= 5) {
+        copyEepromString(this, CONFIG_KEY_WIFI_SSID, EEPROM_ADDRESS_WIFI_SSID, EEPROM_ADDRESS_WIFI_SSID_LENGTH, WIFI_SSID_MAX_LENGTH);
+        copyEepromString(this, CONFIG_KEY_WIFI_PWD, EEPROM_ADDRESS_WIFI_PWD, EEPROM_ADDRESS_WIFI_PWD_LENGTH, WIFI_PWD_MAX_LENGTH);
+        copyEepromString(this, CONFIG_KEY_FLOUD_TOKEN, EEPROM_ADDRESS_FLOUD_TOKEN, EEPROM_ADDRESS_FLOUD_TOKEN_LENGTH, FLOUD_TOKEN_MAX_LENGTH);
+        copyEepromString(this, CONFIG_KEY_FLOUD_DEVICE_ID, EEPROM_ADDRESS_FLOUD_DEVICE_ID, EEPROM_ADDRESS_FLOUD_DEVICE_ID_LENGTH, FLOUD_DEVICE_ID_MAX_LENGTH);
+    }
+    writeByte(CONFIG_KEY_VERSION, version); // last, an interrupted move is repeated
+    return version;
+}
+
+void ConfigStore::writeFactorySettings() {
+    writeString(CONFIG_KEY_NAME, "Floower", NAME_MAX_LENGTH);
+    writeByte(CONFIG_KEY_SPEED, DEFAULT_SPEED);
+    writeByte(CONFIG_KEY_MAX_OPEN_LEVEL, DEFAULT_MAX_OPEN_LEVEL);
+    writeByte(CONFIG_KEY_COLOR_BRIGHTNESS, DEFAULT_COLOR_BRIGHTNESS);
+    writeByte(CONFIG_KEY_TOUCH_THRESHOLD, DEFAULT_TOUCH_THRESHOLD);
+    writeDefaultColorScheme();
+}
+
+void ConfigStore::writeDefaultColorScheme() {
+    uint8_t value[DEFAULT_COLOR_SCHEME_SIZE * 2];
+    for (uint8_t i = 0; i < DEFAULT_COLOR_SCHEME_SIZE; i++) {
+        uint16_t valueHS = Config::encodeHSColor(defaultColorScheme[i].H, defaultColorScheme[i].S);
+        value[i * 2] = valueHS & 0xFF;
+        value[i * 2 + 1] = valueHS >> 8;
+    }
+    write(CONFIG_KEY_COLOR_SCHEME, value, sizeof(value));
+}
+
+uint8_t ConfigStore::readRecord(uint32_t address, uint8_t *record) {
+    uint32_t sectorEnd = (address / CONFIG_STORE_SECTOR_SIZE + 1) * CONFIG_STORE_SECTOR_SIZE;
+    if (address + CONFIG_STORE_RECORD_OVERHEAD > sectorEnd || !halConfigRead(address, record, 2)) {
+        return 0;
+    }
+    uint8_t length = record[1];
+    if (record[0] >= CONFIG_KEYS || length > CONFIG_STORE_VALUE_MAX || address + CONFIG_STORE_RECORD_OVERHEAD + length > sectorEnd) {
+        return 0;
+    }
+    if (!halConfigRead(address + 2, record + 2, length + 1) || crc8(record, length + 2) != record[length + 2]) {
+        return 0;
+    }
+    return length + CONFIG_STORE_RECORD_OVERHEAD;
+}
+
+bool ConfigStore::has(uint8_t key) {
+    return key < CONFIG_KEYS && offsets[key] != 0;
+}
+
+uint8_t ConfigStore::read(uint8_t key, uint8_t *value, uint8_t maxLength) {
+    uint8_t record[CONFIG_STORE_RECORD_MAX];
+    if (!has(key) || readRecord(sectorAddress(activeSector) + offsets[key], record) == 0) {
+        return 0;
+    }
+    uint8_t length = _min(record[1], maxLength);
+    memcpy(value, record + 2, length);
+    return length;
+}
+
+uint8_t ConfigStore::readByte(uint8_t key, uint8_t defaultValue) {
+    uint8_t value;
+    return read(key, &value, 1) == 1 ? value : defaultValue;
+}
+
+uint16_t ConfigStore::readUint16(uint8_t key, uint16_t defaultValue) {
+    uint8_t value[2];
+    return read(key, value, 2) == 2 ? value[0] | (value[1] << 8) : defaultValue;
+}
+
+String ConfigStore::readString(uint8_t key, uint8_t maxLength) {
+    char data[CONFIG_STORE_VALUE_MAX + 1];
+    uint8_t length = read(key, (uint8_t *) data, _min(maxLength, (uint8_t) CONFIG_STORE_VALUE_MAX));
+    data[length] = '\0';
+    return String(data);
+}
+
+bool ConfigStore::write(uint8_t key, const uint8_t *value, uint8_t length) {
+    if (key >= CONFIG_KEYS || length > CONFIG_STORE_VALUE_MAX) {
+        return false;
+    }
+    uint8_t record[CONFIG_STORE_RECORD_MAX];
+    record[0] = key;
+    record[1] = length;
+    memcpy(record + 2, value, length);
+    record[length + 2] = crc8(record, length + 2);
+    uint8_t recordLength = length + CONFIG_STORE_RECORD_OVERHEAD;
+
+    uint8_t current[CONFIG_STORE_RECORD_MAX];
+    if (has(key) && readRecord(sectorAddress(activeSector) + offsets[key], current) == recordLength && memcmp(current, record, recordLength) == 0) {
+        return true; // unchanged
+    }
+
+    if (activeSector >= 0 && writeOffset + recordLength <= CONFIG_STORE_SECTOR_SIZE) {
+        if (halConfigWrite(sectorAddress(activeSector) + writeOffset, record, recordLength)) {
+            offsets[key] = writeOffset;
+            writeOffset += recordLength;
+            records++;
+            return true;
+        }
+        ESP_LOGE(LOG_TAG, "Write failed at %d", writeOffset);
+        writeOffset = CONFIG_STORE_SECTOR_SIZE; // the rest of the sector is not trusted anymore
+    }
+    return compact(record, recordLength);
+}
+
+bool ConfigStore::compact(const uint8_t *record, uint8_t recordLength) {
+    uint8_t sector = activeSector < 0 ? 0 : (activeSector + 1) % CONFIG_STORE_SECTORS;
+    if (!halConfigErase(sectorAddress(sector))) {
+        ESP_LOGE(LOG_TAG, "Erase of %d failed", sector);
+        return false;
+    }
+    erases++;
+
+    // latest records of the keys, the new record replaces its key
+    uint16_t compacted[CONFIG_KEYS] = {0};
+    uint16_t offset = CONFIG_STORE_HEADER_SIZE;
+    uint8_t copy[CONFIG_STORE_RECORD_MAX];
+    for (uint8_t key = 0; key < CONFIG_KEYS; key++) {
+        const uint8_t *data = copy;
+        uint8_t length;
+        if (key == record[0]) {
+            data = record;
+            length = recordLength;
+        }
+        else if (!has(key) || (length = readRecord(sectorAddress(activeSector) + offsets[key], copy)) == 0) {
+            continue;
+        }
+        if (!halConfigWrite(sectorAddress(sector) + offset, data, length)) {
+            return false;
+        }
+        compacted[key] = offset;
+        offset += length;
+    }
+
+    // the header goes last, the sector is not mounted until all the records are in
+    uint32_t nextSequence = sequence + 1;
+    uint8_t header[CONFIG_STORE_HEADER_SIZE] = {
+        CONFIG_STORE_MAGIC & 0xFF, CONFIG_STORE_MAGIC >> 8, 0xFF, 0xFF,
+        (uint8_t) nextSequence, (uint8_t) (nextSequence >> 8), (uint8_t) (nextSequence >> 16), (uint8_t) (nextSequence >> 24)
+    };
+    if (!halConfigWrite(sectorAddress(sector), header, CONFIG_STORE_HEADER_SIZE)) {
+        return false;
+    }
+    activeSector = sector;
+    sequence = nextSequence;
+    writeOffset = offset;
+    memcpy(offsets, compacted, sizeof(offsets));
+    records++;
+    ESP_LOGI(LOG_TAG, "Compacted to %d, seq %d, %dB used", sector, sequence, offset);
+    return true;
+}
+
+bool ConfigStore::writeByte(uint8_t key, uint8_t value) {
+    return write(key, &value, 1);
+}
+
+bool ConfigStore::writeUint16(uint8_t key, uint16_t value) {
+    uint8_t data[2] = {(uint8_t) (value & 0xFF), (uint8_t) (value >> 8)};
+    return write(key, data, 2);
+}
+
+bool ConfigStore::writeString(uint8_t key, const String &value, uint8_t maxLength) {
+    uint8_t length = _min(value.length(), (unsigned int) maxLength);
+    return write(key, (const uint8_t *) value.c_str(), length);
+}
+
+uint32_t ConfigStore::getRecords() {
+    return records;
+}
+
+uint32_t ConfigStore::getErases() {
+    return erases;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Arduino.h"
+
+#define CONFIG_VERSION 5
+#define CONFIG_STORE_SECTORS 4 // flash sectors the records rotate over
+#define CONFIG_STORE_SECTOR_SIZE 4096
+#define CONFIG_STORE_MAGIC 0x4346 // sector header, "FC"
+#define CONFIG_STORE_HEADER_SIZE 8 // magic, reserved, sequence number
+#define CONFIG_STORE_RECORD_OVERHEAD 3 // key, length, CRC
+#define CONFIG_STORE_VALUE_MAX 64 // bytes
+
+// DO NOT CHANGE KEYS!
+#define CONFIG_KEY_VERSION 0 // byte - version of configuration
+#define CONFIG_KEY_SERVO_CLOSED 1 // integer (2 bytes) calibrated position of servo blossom closed
+#define CONFIG_KEY_SERVO_OPEN 2 // integer (2 bytes) calibrated position of servo blossom open
+#define CONFIG_KEY_REVISION 3 // byte - revision number of the logic board to enable features
+#define CONFIG_KEY_SERIALNUMBER 4 // integer (2 bytes)
+#define CONFIG_KEY_FLAGS 5 // byte (8 bites) - config flags [calibrated,bluetoothAlwaysOn,touchCalibrated,,,,,]
+#define CONFIG_KEY_TOUCH_THRESHOLD 6 // byte - calibrated touch threshold value
+#define CONFIG_KEY_COLOR_SCHEME 7 // 2 bytes per stored HSB color, B is missing [(H/9 + S/7), (H/9 + S/7), ..]
+#define CONFIG_KEY_NAME 8 // max 25 chars
+#define CONFIG_KEY_SPEED 9 // byte - speed of opening/closing in 0.1s
+#define CONFIG_KEY_MAX_OPEN_LEVEL 10 // byte - maximum open level in percents (0-100)
+#define CONFIG_KEY_COLOR_BRIGHTNESS 11 // byte - intensity of LEDs in percents (0-100)
+#define CONFIG_KEY_WIFI_SSID 12 // max 32 characters
+#define CONFIG_KEY_WIFI_PWD 13 // max 64 characters
+#define CONFIG_KEY_FLOUD_TOKEN 14 // max 40 characters
+#define CONFIG_KEY_FLOUD_DEVICE_ID 15 // max 40 characters
+#define CONFIG_KEYS 16
+
+// Log structured key/value store of the configuration in the flash. A change appends a record (key, length, value,
+// CRC) to the active sector and the latest record of a key wins. Once the sector is full, the latest records are
+// compacted to the next sector, so the erases rotate over all the sectors. A record torn by a power loss fails its CRC
+// and the sector is compacted before anything else is written. Configurations of older versions, including the EEPROM
+// layout used before the store, are migrated when mounted.
+class ConfigStore {
+    public:
+        void begin(); // mounts the newest sector and migrates older configurations
+
+        bool has(uint8_t key);
+        uint8_t read(uint8_t key, uint8_t *value, uint8_t maxLength); // returns length, 0 when missing
+        uint8_t readByte(uint8_t key, uint8_t defaultValue);
+        uint16_t readUint16(uint8_t key, uint16_t defaultValue);
+        String readString(uint8_t key, uint8_t maxLength);
+
+        bool write(uint8_t key, const uint8_t *value, uint8_t length); // nothing written when the value is unchanged
+        bool writeByte(uint8_t key, uint8_t value);
+        bool writeUint16(uint8_t key, uint16_t value);
+        bool writeString(uint8_t key, const String &value, uint8_t maxLength);
+
+        uint32_t getRecords(); // appended since begin
+        uint32_t getErases(); // since begin
+
+    private:
+        void mount();
+        void migrate();
+        uint8_t migrateEeprom(); // returns version of the configuration, 0 when not configured
+        void writeFactorySettings();
+        void writeDefaultColorScheme();
+        uint8_t readRecord(uint32_t address, uint8_t *record); // returns record length, 0 when invalid
+        bool compact(const uint8_t *record, uint8_t recordLength);
+
+        int8_t activeSector = -1; // none formatted yet
+        uint32_t sequence = 0;
+        uint16_t writeOffset = CONFIG_STORE_SECTOR_SIZE;
+        uint16_t offsets[CONFIG_KEYS]; // latest record of the keys in the active sector, 0 when missing
+        uint32_t records = 0;
+        uint32_t erases = 0;
+};
@@ -0,0 +1,108 @@
+#include "EnergyLedger.h"
+
+EnergyLedger::EnergyLedger() {
+    memset(currents, 0, sizeof(currents));
+    currents[ENERGY_CPU][CPU_ACTIVE] = ENERGY_CPU_ACTIVE;
+    currents[ENERGY_CPU][CPU_IDLE] = ENERGY_CPU_IDLE;
+    currents[ENERGY_CPU][CPU_LIGHT_SLEEP] = ENERGY_CPU_LIGHT_SLEEP;
+    currents[ENERGY_STEPPER][POWER_ON] = ENERGY_STEPPER_ENABLED;
+    currents[ENERGY_LEDS][POWER_ON] = ENERGY_LEDS_POWERED;
+    currents[ENERGY_WIFI][POWER_ON] = ENERGY_WIFI_ON;
+    currents[ENERGY_BLUETOOTH][BLUETOOTH_IDLE] = ENERGY_BLUETOOTH_IDLE;
+    currents[ENERGY_BLUETOOTH][BLUETOOTH_ADVERTISING] = ENERGY_BLUETOOTH_ADVERTISING;
+    currents[ENERGY_BLUETOOTH][BLUETOOTH_CONNECTED] = ENERGY_BLUETOOTH_CONNECTED;
+    memset(states, 0, sizeof(states)); // CPU active, everything else off
+    reset();
+}
+
+void EnergyLedger::setCurrent(EnergyConsumer consumer, uint8_t state, uint32_t current) {
+    if (consumer < ENERGY_CONSUMERS && state < ENERGY_STATES) {
+        currents[consumer][state] = current;
+    }
+}
+
+uint32_t EnergyLedger::getCurrent(EnergyConsumer consumer, uint8_t state) {
+    if (consumer < ENERGY_CONSUMERS && state < ENERGY_STATES) {
+        return currents[consumer][state];
+    }
+    return 0;
+}
+
+void EnergyLedger::setLedChannelCurrent(uint32_t current) {
+    ledChannelCurrent = current;
+}
+
+void EnergyLedger::setState(EnergyConsumer consumer, uint8_t state) {
+    if (consumer < ENERGY_CONSUMERS && state < ENERGY_STATES && states[consumer] != state) {
+        integrate(micros());
+        states[consumer] = state;
+    }
+}
+
+uint8_t EnergyLedger::getState(EnergyConsumer consumer) {
+    return consumer < ENERGY_CONSUMERS ? states[consumer] : 0;
+}
+
+void EnergyLedger::setLedsLight(uint32_t light) {
+    light = (uint64_t) light * 256 / GAMMA_MAX_LEVEL;
+    if (light != ledsLight) {
+        integrate(micros());
+        ledsLight = light;
+    }
+}
+
+uint32_t EnergyLedger::getCurrent() {
+    uint32_t current = (uint64_t) ledsLight * ledChannelCurrent / 256;
+    for (uint8_t consumer = 0; consumer < ENERGY_CONSUMERS; consumer++) {
+        current += currents[consumer][states[consumer]];
+    }
+    return current;
+}
+
+void EnergyLedger::update() {
+    integrate(micros());
+}
+
+uint32_t EnergyLedger::getStateTime(EnergyConsumer consumer, uint8_t state) {
+    if (consumer < ENERGY_CONSUMERS && state < ENERGY_STATES) {
+        return stateTimes[consumer][state] / 1000;
+    }
+    return 0;
+}
+
+uint32_t EnergyLedger::getCharge(EnergyConsumer consumer) {
+    if (consumer >= ENERGY_CONSUMERS) {
+        return 0;
+    }
+    double charge = 0; // uA us, read on demand so the precision is worth the soft float
+    for (uint8_t state = 0; state < ENERGY_STATES; state++) {
+        charge += (double) stateTimes[consumer][state] * currents[consumer][state];
+    }
+    if (consumer == ENERGY_LEDS) {
+        charge += (double) ledsLightTime * ledChannelCurrent / 256;
+    }
+    return charge / 3600000000.0;
+}
+
+uint32_t EnergyLedger::getTotalCharge() {
+    uint32_t charge = 0;
+    for (uint8_t consumer = 0; consumer < ENERGY_CONSUMERS; consumer++) {
+        charge += getCharge((EnergyConsumer) consumer);
+    }
+    return charge;
+}
+
+void EnergyLedger::reset() {
+    memset(stateTimes, 0, sizeof(stateTimes));
+    ledsLightTime = 0;
+    lastTime = micros();
+}
+
+void EnergyLedger::integrate(unsigned long now) {
+    uint32_t elapsed = (uint32_t) now - (uint32_t) lastTime; // survives the micros() overflow, the loop passes every second
+    lastTime = now;
+    for (uint8_t consumer = 0; consumer < ENERGY_CONSUMERS; consumer++) {
+        stateTimes[consumer][states[consumer]] += elapsed;
+    }
+    ledsLightTime += (uint64_t) ledsLight * elapsed;
+}
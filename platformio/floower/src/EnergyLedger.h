@@ -0,0 +1,79 @@
+#pragma once
+
+#include "Arduino.h"
+#include "hardware/GammaDither.h"
+
+// default current model, rough figures of the Floower board powered from the battery (uA)
+#define ENERGY_CPU_ACTIVE 45000 // loop running
+#define ENERGY_CPU_IDLE 25000 // loop task waiting, clocks running
+#define ENERGY_CPU_LIGHT_SLEEP 1500
+#define ENERGY_STEPPER_ENABLED 200000 // driver enabled, petals moving
+#define ENERGY_LEDS_POWERED 7000 // strip powered and dark, 1mA per pixel
+#define ENERGY_LED_CHANNEL 12000 // one pixel channel at full light
+#define ENERGY_WIFI_ON 80000
+#define ENERGY_BLUETOOTH_IDLE 5000 // stack initialized, radio not used
+#define ENERGY_BLUETOOTH_ADVERTISING 12000
+#define ENERGY_BLUETOOTH_CONNECTED 15000
+
+#define ENERGY_STATES 4 // max states of a consumer
+
+enum EnergyConsumer {
+    ENERGY_CPU,
+    ENERGY_STEPPER,
+    ENERGY_LEDS,
+    ENERGY_WIFI,
+    ENERGY_BLUETOOTH,
+    ENERGY_CONSUMERS
+};
+
+enum CpuEnergyState {
+    CPU_ACTIVE,
+    CPU_IDLE,
+    CPU_LIGHT_SLEEP
+};
+
+enum PowerEnergyState { // stepper, LEDs and WiFi
+    POWER_OFF,
+    POWER_ON
+};
+
+enum BluetoothEnergyState {
+    BLUETOOTH_OFF,
+    BLUETOOTH_IDLE,
+    BLUETOOTH_ADVERTISING,
+    BLUETOOTH_CONNECTED
+};
+
+// Accounts where the battery energy goes. Every consumer is in one of its states and the time spent in each state
+// is integrated, the charge is the time weighted by the current model of the state. The LEDs take the light of the
+// pixels on top of their powered state. Time starts at boot or wake up, the loop task is the only one to use it.
+class EnergyLedger {
+    public:
+        EnergyLedger();
+        void setCurrent(EnergyConsumer consumer, uint8_t state, uint32_t current); // uA
+        uint32_t getCurrent(EnergyConsumer consumer, uint8_t state);
+        void setLedChannelCurrent(uint32_t current); // uA
+
+        void setState(EnergyConsumer consumer, uint8_t state);
+        uint8_t getState(EnergyConsumer consumer);
+        void setLedsLight(uint32_t light); // sum of channel light levels, GAMMA_MAX_LEVEL is one channel at full light
+        uint32_t getCurrent(); // uA drawn right now by all consumers
+
+        void update(); // integrates up to now, the loop does it every pass so the readers never have to
+        uint32_t getStateTime(EnergyConsumer consumer, uint8_t state); // ms
+        uint32_t getCharge(EnergyConsumer consumer); // uAh
+        uint32_t getTotalCharge(); // uAh
+        void reset();
+
+    private:
+        void integrate(unsigned long now);
+
+        uint32_t currents[ENERGY_CONSUMERS][ENERGY_STATES];
+        uint32_t ledChannelCurrent = ENERGY_LED_CHANNEL;
+
+        uint8_t states[ENERGY_CONSUMERS];
+        uint32_t ledsLight = 0; // full channels in 8.8 fixed point
+        unsigned long lastTime = 0; // us
+        uint64_t stateTimes[ENERGY_CONSUMERS][ENERGY_STATES]; // us
+        uint64_t ledsLightTime = 0; // full channel us in 8.8 fixed point
+};
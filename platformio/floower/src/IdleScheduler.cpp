@@ -0,0 +1,77 @@
+#include "IdleScheduler.h"
+#include "hal/Hal.h"
+
+void IdleScheduler::begin(unsigned long now) {
+    this->now = now;
+    timeout = IDLE_MAX_TIME;
+    lightSleepAllowed = true;
+}
+
+void IdleScheduler::wakeAt(unsigned long time) {
+    int32_t remaining = (uint32_t) time - (uint32_t) now; // survives the millis() overflow
+    wakeIn(remaining > 0 ? remaining : 0);
+}
+
+void IdleScheduler::wakeIn(uint32_t timeout) {
+    if (timeout < this->timeout) {
+        this->timeout = timeout;
+    }
+}
+
+void IdleScheduler::preventLightSleep() {
+    lightSleepAllowed = false;
+}
+
+IdlePlan IdleScheduler::getPlan() {
+    if (timeout == 0) {
+        return {IDLE_NONE, 0};
+    }
+    if (lightSleepAllowed && timeout >= LIGHT_SLEEP_MIN_TIME) {
+        return {IDLE_LIGHT_SLEEP, timeout};
+    }
+    return {IDLE_WAIT, timeout};
+}
+
+bool IdleScheduler::idle() {
+    IdlePlan plan = getPlan();
+    stats.passes++;
+    bool touched = false;
+    unsigned long start = millis();
+    switch (plan.mode) {
+        case IDLE_NONE:
+            break;
+        case IDLE_WAIT:
+            accountCpu(CPU_IDLE);
+            halIdleWait(plan.duration);
+            stats.waitTime += millis() - start;
+            break;
+        case IDLE_LIGHT_SLEEP:
+            accountCpu(CPU_LIGHT_SLEEP);
+            touched = halLightSleep(plan.duration);
+            stats.lightSleepTime += millis() - start;
+            if (touched) {
+                stats.touchWakeUps++;
+            }
+            break;
+    }
+    accountCpu(CPU_ACTIVE);
+    return touched;
+}
+
+void IdleScheduler::setEnergyLedger(EnergyLedger *energyLedger) {
+    this->energyLedger = energyLedger;
+}
+
+void IdleScheduler::accountCpu(CpuEnergyState state) {
+    if (energyLedger != nullptr) {
+        energyLedger->setState(ENERGY_CPU, state);
+    }
+}
+
+IdleStats IdleScheduler::getStats() {
+    return stats;
+}
+
+void IdleScheduler::resetStats() {
+    stats = {0, 0, 0, 0};
+}
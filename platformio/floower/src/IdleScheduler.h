@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Arduino.h"
+#include "EnergyLedger.h"
+
+// Idles the main loop until the nearest deadline of the subsystems instead of polling. Every pass each subsystem
+// tells when it needs the loop again and whether the board may light sleep meanwhile, touch wakes the loop up early.
+
+#define IDLE_MAX_TIME 1000 // ms, longest idle without any deadline
+#define LIGHT_SLEEP_MIN_TIME 20 // ms, shorter idle does not pay off the wake up from light sleep
+
+enum IdleMode {
+    IDLE_NONE, // a deadline is due, run the next pass right away
+    IDLE_WAIT, // the loop task waits, other tasks and the radio keep running
+    IDLE_LIGHT_SLEEP // whole board sleeps, nothing is moving and the radio is off
+};
+
+struct IdlePlan {
+    IdleMode mode;
+    uint32_t duration; // ms
+};
+
+struct IdleStats {
+    uint32_t passes;
+    uint32_t waitTime; // ms
+    uint32_t lightSleepTime; // ms
+    uint32_t touchWakeUps; // from light sleep
+};
+
+class IdleScheduler {
+    public:
+        void begin(unsigned long now); // start of the planning, the subsystems add their deadlines then
+        void wakeAt(unsigned long time); // ms, a time already passed is due now
+        void wakeIn(uint32_t timeout); // ms
+        void preventLightSleep();
+        IdlePlan getPlan();
+        bool idle(); // executes the plan, true when woken up from light sleep by touch
+        void setEnergyLedger(EnergyLedger *energyLedger); // CPU gets accounted by idle()
+
+        IdleStats getStats();
+        void resetStats();
+
+    private:
+        void accountCpu(CpuEnergyState state);
+
+        unsigned long now = 0;
+        uint32_t timeout = IDLE_MAX_TIME;
+        bool lightSleepAllowed = true;
+        IdleStats stats = {0, 0, 0, 0};
+        EnergyLedger *energyLedger = nullptr;
+};
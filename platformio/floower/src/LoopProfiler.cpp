@@ -0,0 +1,133 @@
+#include "LoopProfiler.h"
+#include <math.h>
+#include <string.h>
+
+static const char *stageNames[PROFILER_STAGES] = {"floower", "behavior", "wifi", "loop"};
+
+void LatencyHistogram::record(uint32_t value) {
+    buckets[bucketIndex(value)]++;
+    count++;
+    if (value > max) {
+        max = value;
+    }
+}
+
+void LatencyHistogram::clear() {
+    memset(buckets, 0, sizeof(buckets));
+    count = 0;
+    max = 0;
+}
+
+uint32_t LatencyHistogram::getCount() const {
+    return count;
+}
+
+uint32_t LatencyHistogram::getMax() const {
+    return max;
+}
+
+uint32_t LatencyHistogram::getPercentile(float percentile) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint32_t rank = ceil(count * percentile / 100.0f);
+    if (rank >= count) {
+        return max;
+    }
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint32_t value = bucketLowerBound(i) + bucketWidth(i) / 2;
+            return value < max ? value : max;
+        }
+    }
+    return max;
+}
+
+uint8_t LatencyHistogram::bucketIndex(uint32_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return value;
+    }
+    uint8_t msb = 31 - __builtin_clz(value);
+    uint8_t shift = msb - HISTOGRAM_SUB_BUCKET_BITS;
+    return ((shift + 1) << HISTOGRAM_SUB_BUCKET_BITS) | ((value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+uint32_t LatencyHistogram::bucketLowerBound(uint8_t index) {
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+    uint8_t shift = (index >> HISTOGRAM_SUB_BUCKET_BITS) - 1;
+    return (uint32_t) (HISTOGRAM_SUB_BUCKETS | (index & (HISTOGRAM_SUB_BUCKETS - 1))) << shift;
+}
+
+uint32_t LatencyHistogram::bucketWidth(uint8_t index) {
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return 1;
+    }
+    return 1UL << ((index >> HISTOGRAM_SUB_BUCKET_BITS) - 1);
+}
+
+void LoopProfiler::record(uint8_t stage, uint32_t cycles) {
+    if (stage < PROFILER_STAGES) {
+        histograms[stage].record(cycles);
+    }
+}
+
+uint32_t LoopProfiler::lap(uint8_t stage, uint32_t startCycles) {
+    uint32_t cycles = now();
+    record(stage, cycles - startCycles); // unsigned math survives the cycle counter overflow
+    return cycles;
+}
+
+void LoopProfiler::reset() {
+    for (uint8_t i = 0; i < PROFILER_STAGES; i++) {
+        histograms[i].clear();
+    }
+}
+
+LatencyStats LoopProfiler::getStats(uint8_t stage) {
+    LatencyStats stats = {0, 0, 0, 0};
+    if (stage < PROFILER_STAGES) {
+        // read from other tasks (BLE, TCP) without locking, numbers of a single report may be slightly off
+        uint32_t cyclesPerUs = ESP.getCpuFreqMHz();
+        LatencyHistogram &histogram = histograms[stage];
+        stats.count = histogram.getCount();
+        stats.p50 = histogram.getPercentile(50) / cyclesPerUs;
+        stats.p99 = histogram.getPercentile(99) / cyclesPerUs;
+        stats.max = histogram.getMax() / cyclesPerUs;
+    }
+    return stats;
+}
+
+void LoopProfiler::onDeadlineMisses(DeadlineMissesCallback callback) {
+    deadlineMissesCallback = callback;
+}
+
+uint32_t LoopProfiler::getDeadlineMisses() {
+    return deadlineMissesCallback != nullptr ? deadlineMissesCallback() : 0;
+}
+
+void LoopProfiler::report() {
+    for (uint8_t i = 0; i < PROFILER_STAGES; i++) {
+        LatencyStats stats = getStats(i);
+        Serial.printf("%-8s n=%u p50=%uus p99=%uus max=%uus\n", getStageName(i), stats.count, stats.p50, stats.p99, stats.max);
+    }
+    Serial.printf("stepper deadline misses=%u\n", getDeadlineMisses());
+}
+
+void LoopProfiler::reportIfDue() {
+    unsigned long now = millis();
+    if (now - reportTime >= PROFILER_REPORT_INTERVAL) {
+        reportTime = now;
+        report();
+    }
+}
+
+const char *LoopProfiler::getStageName(uint8_t stage) {
+    return stage < PROFILER_STAGES ? stageNames[stage] : "";
+}
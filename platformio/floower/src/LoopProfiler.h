@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Arduino.h"
+#include <functional>
+
+// Main loop profiler, built in by the LOOP_PROFILER build flag only. Durations are measured in CPU cycles and kept in
+// log-bucketed histograms of fixed size, recording never allocates.
+
+#define HISTOGRAM_SUB_BUCKET_BITS 2 // 4 buckets per power of two, bucket width is at most 25% of its value
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS ((32 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+#define PROFILER_REPORT_INTERVAL 10000 // ms, how often to print the report on serial
+
+enum ProfilerStage {
+    PROFILER_STAGE_FLOOWER = 0, // floower.update()
+    PROFILER_STAGE_BEHAVIOR = 1, // behavior->loop()
+    PROFILER_STAGE_WIFI = 2, // bluetoothConnect.loop(), wifiConnect.loop() and both state publishers
+    PROFILER_STAGE_LOOP = 3, // whole loop() without the idle delay
+    PROFILER_STAGES = 4
+};
+
+struct LatencyStats {
+    uint32_t count;
+    uint32_t p50; // us
+    uint32_t p99; // us
+    uint32_t max; // us
+};
+
+typedef std::function<uint32_t()> DeadlineMissesCallback;
+
+class LatencyHistogram {
+    public:
+        void record(uint32_t value);
+        void clear();
+        uint32_t getCount() const;
+        uint32_t getMax() const;
+        uint32_t getPercentile(float percentile) const; // midpoint of the bucket, never more than max
+
+        static uint8_t bucketIndex(uint32_t value);
+        static uint32_t bucketLowerBound(uint8_t index);
+        static uint32_t bucketWidth(uint8_t index);
+
+    private:
+        uint32_t buckets[HISTOGRAM_BUCKETS] = {0};
+        uint32_t count = 0;
+        uint32_t max = 0;
+};
+
+class LoopProfiler {
+    public:
+        void record(uint8_t stage, uint32_t cycles);
+        uint32_t lap(uint8_t stage, uint32_t startCycles); // records cycles since start, returns current cycle count
+        void reset();
+        LatencyStats getStats(uint8_t stage);
+        void onDeadlineMisses(DeadlineMissesCallback callback);
+        uint32_t getDeadlineMisses();
+        void report();
+        void reportIfDue();
+
+        static uint32_t now() { return ESP.getCycleCount(); }
+        static const char *getStageName(uint8_t stage);
+
+    private:
+        LatencyHistogram histograms[PROFILER_STAGES];
+        DeadlineMissesCallback deadlineMissesCallback;
+        unsigned long reportTime = 0;
+};
+
+#define PROFILER_BEGIN(profiler) uint32_t profilerLoopStart = LoopProfiler::now(); uint32_t profilerLapStart = profilerLoopStart
+#define PROFILER_LAP(profiler, stage) profilerLapStart = (profiler).lap(stage, profilerLapStart)
+#define PROFILER_END(profiler) (profiler).lap(PROFILER_STAGE_LOOP, profilerLoopStart); (profiler).reportIfDue()
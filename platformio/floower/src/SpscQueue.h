@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Lock-free queue for exactly one producer and one consumer (each may run on a different core). The capacity must be
+// a power of two. The consumer can look at the front item and drop it only after it was fully processed.
+template <typename T, uint16_t CAPACITY>
+class SpscQueue {
+    static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+    public:
+        // producer side
+        bool push(const T &item) {
+            uint32_t tail = this->tail.load(std::memory_order_relaxed);
+            if (tail - head.load(std::memory_order_acquire) >= CAPACITY) {
+                return false; // full
+            }
+            items[tail & (CAPACITY - 1)] = item;
+            this->tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer side
+        T *front() {
+            uint32_t head = this->head.load(std::memory_order_relaxed);
+            if (head == tail.load(std::memory_order_acquire)) {
+                return nullptr; // empty
+            }
+            return &items[head & (CAPACITY - 1)];
+        }
+
+        void pop() {
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        bool pop(T &item) {
+            T *front = this->front();
+            if (front == nullptr) {
+                return false;
+            }
+            item = *front;
+            pop();
+            return true;
+        }
+
+        // either side
+        uint16_t size() const {
+            uint32_t head = this->head.load(std::memory_order_acquire); // head first, tail is never behind it
+            return tail.load(std::memory_order_acquire) - head;
+        }
+
+        bool isEmpty() const {
+            return size() == 0;
+        }
+
+        uint16_t capacity() const {
+            return CAPACITY;
+        }
+
+    private:
+        T items[CAPACITY];
+        std::atomic<uint32_t> head {0}; // written by the consumer only
+        std::atomic<uint32_t> tail {0}; // written by the producer only
+};
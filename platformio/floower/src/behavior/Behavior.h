@@ -1,12 +1,19 @@
 #pragma once
 
 #include "hardware/Floower.h"
+#include "IdleScheduler.h"
 
 typedef uint8_t state_t;
 
 class Behavior {
     public:
+        virtual ~Behavior() {}
         virtual void setup(bool wokeUp = false) = 0;
         virtual void loop() = 0;
         virtual bool isIdle() = 0;
+        virtual void planIdle(IdleScheduler &scheduler) {
+            if (!isIdle()) {
+                scheduler.wakeIn(0);
+            }
+        }
 };
\ No newline at end of file
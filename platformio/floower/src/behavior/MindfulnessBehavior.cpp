@@ -35,6 +35,13 @@ void MindfulnessBehavior::loop() {
     }
 }
 
+void MindfulnessBehavior::planIdle(IdleScheduler &scheduler) {
+    SmartPowerBehavior::planIdle(scheduler);
+    if (state == STATE_INHALE || state == STATE_EXHALE) {
+        scheduler.wakeAt(eventTime);
+    }
+}
+
 bool MindfulnessBehavior::onLeafTouch(FloowerTouchEvent event) {
     if (SmartPowerBehavior::onLeafTouch(event)) {
         return true;
@@ -15,9 +15,7 @@ static const char* LOG_TAG = "SmartPowerBehavior";
 #define INDICATE_STATUS_BLUETOOTH 2
 #define INDICATE_STATUS_WIFI 3
 
-// POWER MANAGEMENT (tuned for 1600mAh LIPO battery)
-
-#define LOW_BATTERY_THRESHOLD_V 3.4
+#define LOW_BATTERY_RECHECK_DELAY 250 // ms, between the readings confirming a dead battery on start up
 
 // TIMINGS
 
@@ -26,6 +24,7 @@ static const char* LOG_TAG = "SmartPowerBehavior";
 #define DEEP_SLEEP_INACTIVITY_TIMEOUT 60000 // fall in deep sleep after timeout
 #define LOW_BATTERY_WARNING_DURATION 5000 // how long to show battery dead status
 #define WATCHDOGS_INTERVAL 1000
+#define UPDATE_POLL_INTERVAL 10 // ms, while the firmware update is prepared and running
 
 SmartPowerBehavior::SmartPowerBehavior(Config *config, Floower *floower, RemoteControl *remoteControl)
         : config(config), floower(floower), remoteControl(remoteControl) {
@@ -35,8 +34,9 @@ SmartPowerBehavior::SmartPowerBehavior(Config *config, Floower *floower, RemoteC
 void SmartPowerBehavior::setup(bool wokeUp) {
     // check if there is enough power to run
     powerState = floower->readPowerState();
-    if (!powerState.usbPowered && powerState.batteryVoltage < LOW_BATTERY_THRESHOLD_V) {
-        delay(500); // wait and re-verify the voltage to make sure the battery is really dead
+    for (uint8_t i = 1; i < BATTERY_LOW_SAMPLES && !powerState.usbPowered && powerState.batteryVoltage * 1000 < BATTERY_LOW_VOLTAGE; i++) {
+        delay(LOW_BATTERY_RECHECK_DELAY); // wait and re-verify the voltage to make sure the battery is really dead
+        powerState = floower->readPowerState();
     }
 
     // run power watchdog to initialize state according to power
@@ -56,10 +56,10 @@ void SmartPowerBehavior::loop() {
         // reset remote control state in case the floower is idle
         changeState(STATE_STANDBY);
     }
-    else if (state == STATE_UPDATE_INIT && !floower->arePetalsMoving() && !updateFirmwareUrl.isEmpty()) {
+    else if (state == STATE_UPDATE_INIT && !floower->arePetalsMoving() && !updateManifest.url.isEmpty()) {
         // floower is closed, we can start upgrading
         changeState(STATE_UPDATE_RUNNING);
-        remoteControl->runUpdate(updateFirmwareUrl);
+        remoteControl->runUpdate(updateManifest);
     }
     else if (state == STATE_UPDATE_RUNNING && !remoteControl->isUpdateRunning()) {
         // restore after failed update
@@ -119,13 +119,13 @@ void SmartPowerBehavior::onRemoteControl() {
     changeState(STATE_REMOTE_CONTROL);
 }
 
-void SmartPowerBehavior::runUpdate(String firmwareUrl) {
+void SmartPowerBehavior::runUpdate(const OtaManifest &manifest) {
     changeState(STATE_UPDATE_INIT);
     floower->circleColor(colorPurple.H, colorPurple.S, 600);
     floower->setPetalsOpenLevel(0, 2500);
     floower->disableTouch();
     remoteControl->disableBluetooth();
-    updateFirmwareUrl = firmwareUrl;
+    updateManifest = manifest;
 }
 
 bool SmartPowerBehavior::canInitializeBluetooth() {
@@ -136,7 +136,7 @@ void SmartPowerBehavior::enablePeripherals(bool initial, bool wokeUp) {
     floower->initPetals(initial, wokeUp); // TODO
     floower->enableTouch([=](FloowerTouchEvent event){ onLeafTouch(event); }, !wokeUp);
     remoteControl->onRemoteControl([=]() { onRemoteControl(); });
-    remoteControl->onRunUpdate([=](String firmwareUrl) { runUpdate(firmwareUrl); });
+    remoteControl->onRunUpdate([=](const OtaManifest &manifest) { runUpdate(manifest); });
     if (config->bluetoothEnabled && config->bluetoothAlwaysOn) {
         bluetoothStartTime = millis() + BLUETOOTH_START_DELAY; // defer init of BLE by 5 seconds
     }
@@ -154,13 +154,34 @@ bool SmartPowerBehavior::isIdle() {
     return !floower->arePetalsMoving() && !floower->isChangingColor();
 }
 
+void SmartPowerBehavior::planIdle(IdleScheduler &scheduler) {
+    // timers of loop() fire once past their time
+    scheduler.wakeAt(watchDogsTime + 1);
+    if (bluetoothStartTime > 0) {
+        scheduler.wakeAt(bluetoothStartTime + 1);
+    }
+    if (wifiStartTime > 0) {
+        scheduler.wakeAt(wifiStartTime + 1);
+    }
+    if (deepSleepTime > 0) {
+        scheduler.wakeAt(deepSleepTime + 1);
+    }
+    if (state == STATE_UPDATE_INIT || state == STATE_UPDATE_RUNNING) {
+        scheduler.wakeIn(UPDATE_POLL_INTERVAL);
+        scheduler.preventLightSleep();
+    }
+    if (powerState.usbPowered) {
+        scheduler.preventLightSleep(); // no battery to save, keeps USB serial responsive
+    }
+}
+
 void SmartPowerBehavior::powerWatchDog(bool initial, bool wokeUp) {
     powerState = floower->readPowerState();
 
-    if (!powerState.usbPowered && powerState.batteryVoltage < LOW_BATTERY_THRESHOLD_V) {
+    if (!powerState.usbPowered && powerState.batteryLow) {
         // not powered by USB (switch must be ON) and low battery (* -> OFF)
         if (state != STATE_LOW_BATTERY) {
-            ESP_LOGW(LOG_TAG, "Shutting down, battery low voltage (%dV)", powerState.batteryVoltage);
+            ESP_LOGW(LOG_TAG, "Shutting down, battery low voltage (%.2fV)", powerState.batteryVoltage);
             floower->flashColor(colorRed.H, colorRed.S, 1000);
             floower->setPetalsOpenLevel(0, 2500);
             disablePeripherals();
@@ -250,7 +271,7 @@ void SmartPowerBehavior::indicateStatus(bool charging) {
         }
     }
     if (status == INDICATE_STATUS_IDLE) {
-        HsbColor color = HsbColor(colorRed.H, colorRed.S, 0.01);
+        HsbColor color = HsbColor(colorRed.H, colorRed.S, 0.12); // dimmed to about 1% of light by the gamma curve
         floower->showStatus(color, FloowerStatusAnimation::STILL, 0);
     }
     indicatingStatus = status;
@@ -265,6 +286,7 @@ void SmartPowerBehavior::planDeepSleep(long timeoutMs) {
 
 void SmartPowerBehavior::enterDeepSleep() {
     ESP_LOGI(LOG_TAG, "Going to sleep now");
+    config->flush();
     floower->beforeDeepSleep();
     esp_sleep_enable_touchpad_wakeup();
     esp_wifi_stop();
@@ -21,7 +21,8 @@ class SmartPowerBehavior : public Behavior {
         virtual void setup(bool wokeUp = false);
         virtual void loop();
         virtual bool isIdle();
-        virtual void runUpdate(String firmwareUrl);
+        virtual void planIdle(IdleScheduler &scheduler);
+        virtual void runUpdate(const OtaManifest &manifest);
         
     protected:
         virtual bool onLeafTouch(FloowerTouchEvent event);
@@ -57,6 +58,6 @@ class SmartPowerBehavior : public Behavior {
 
         uint8_t indicatingStatus = 0;
 
-        String updateFirmwareUrl;
+        OtaManifest updateManifest;
     
 };
\ No newline at end of file
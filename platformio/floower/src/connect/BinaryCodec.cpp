@@ -0,0 +1,76 @@
+#include "BinaryCodec.h"
+
+uint8_t BinaryCodec::negotiate(uint8_t clientVersion) {
+    return clientVersion < BINARY_CODEC_VERSION ? clientVersion : BINARY_CODEC_VERSION;
+}
+
+bool BinaryCodec::isBinary(const char *payload, uint16_t length) {
+    return length > 0 && (uint8_t) payload[0] >= 1 && (uint8_t) payload[0] <= BINARY_CODEC_VERSION;
+}
+
+bool BinaryCodec::decodePetals(const char *payload, uint16_t length, BinaryState &state) {
+    if (length != BINARY_PETALS_LENGTH || !isBinary(payload, length)) {
+        return false;
+    }
+    state.hasLevel = true;
+    state.level = (uint8_t) payload[1];
+    state.hasColor = false;
+    decodeTime(payload + 2, state);
+    return true;
+}
+
+bool BinaryCodec::decodeRgbColor(const char *payload, uint16_t length, BinaryState &state) {
+    if (length != BINARY_RGB_COLOR_LENGTH || !isBinary(payload, length)) {
+        return false;
+    }
+    state.hasLevel = false;
+    state.hasColor = true;
+    state.color = RgbColor((uint8_t) payload[1], (uint8_t) payload[2], (uint8_t) payload[3]);
+    decodeTime(payload + 4, state);
+    return true;
+}
+
+bool BinaryCodec::decodeWriteState(const char *payload, uint16_t length, BinaryState &state) {
+    if (length != BINARY_WRITE_STATE_LENGTH || !isBinary(payload, length)) {
+        return false;
+    }
+    uint8_t flags = payload[1];
+    state.hasLevel = flags & BINARY_STATE_LEVEL;
+    state.level = (uint8_t) payload[2];
+    state.hasColor = flags & BINARY_STATE_COLOR;
+    state.color = RgbColor((uint8_t) payload[3], (uint8_t) payload[4], (uint8_t) payload[5]);
+    decodeTime(payload + 6, state);
+    return true;
+}
+
+uint16_t BinaryCodec::encodeWriteState(const BinaryState &state, char *payload) {
+    payload[0] = BINARY_CODEC_VERSION;
+    payload[1] = (state.hasLevel ? BINARY_STATE_LEVEL : 0) | (state.hasColor ? BINARY_STATE_COLOR : 0);
+    payload[2] = state.level;
+    payload[3] = state.color.R;
+    payload[4] = state.color.G;
+    payload[5] = state.color.B;
+    encodeTime(state, payload + 6);
+    return BINARY_WRITE_STATE_LENGTH;
+}
+
+uint16_t BinaryCodec::encodeReadState(RgbColor color, uint8_t level, char *payload) {
+    payload[0] = BINARY_CODEC_VERSION;
+    payload[1] = color.R;
+    payload[2] = color.G;
+    payload[3] = color.B;
+    payload[4] = level;
+    return BINARY_READ_STATE_LENGTH;
+}
+
+void BinaryCodec::decodeTime(const char *data, BinaryState &state) {
+    uint16_t time = ((uint8_t) data[0] << 8) | (uint8_t) data[1];
+    state.hasTime = time != BINARY_TIME_DEFAULT;
+    state.time = time;
+}
+
+void BinaryCodec::encodeTime(const BinaryState &state, char *data) {
+    uint16_t time = state.hasTime ? state.time : BINARY_TIME_DEFAULT;
+    data[0] = time >> 8;
+    data[1] = time & 0xFF;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include "NeoPixelBus.h"
+
+// Fixed layout binary payloads of the high rate commands, decoded in place from the receive buffer. Every payload
+// starts with the codec version, multi-byte values are in network order as the message header. The version can never
+// be mistaken for MsgPack map (0x80-0x8f) the MsgPack payloads start with.
+//
+// v1 layouts:
+//   CMD_WRITE_PETALS      [ver][level][time:2]                          4 B
+//   CMD_WRITE_RGB_COLOR   [ver][r][g][b][time:2]                        6 B
+//   CMD_WRITE_STATE       [ver][flags][level][r][g][b][time:2]          8 B
+//   CMD_READ_STATE reply  [ver][r][g][b][level]                         5 B
+// time 0xFFFF means the configured transition speed
+
+#define COMMAND_CODEC_MSGPACK 0
+#define BINARY_CODEC_VERSION 1 // highest version this firmware speaks
+
+#define BINARY_TIME_DEFAULT 0xFFFF
+#define BINARY_STATE_LEVEL 0x01 // CMD_WRITE_STATE flags
+#define BINARY_STATE_COLOR 0x02
+
+#define BINARY_PETALS_LENGTH 4
+#define BINARY_RGB_COLOR_LENGTH 6
+#define BINARY_WRITE_STATE_LENGTH 8
+#define BINARY_READ_STATE_LENGTH 5
+
+struct BinaryState {
+    bool hasLevel;
+    uint8_t level;
+    bool hasColor;
+    RgbColor color;
+    bool hasTime;
+    uint16_t time;
+};
+
+class BinaryCodec {
+    public:
+        static uint8_t negotiate(uint8_t clientVersion); // version to use on the connection, COMMAND_CODEC_MSGPACK if none
+        static bool isBinary(const char *payload, uint16_t length);
+
+        // false when the payload doesn't match the layout
+        static bool decodePetals(const char *payload, uint16_t length, BinaryState &state);
+        static bool decodeRgbColor(const char *payload, uint16_t length, BinaryState &state);
+        static bool decodeWriteState(const char *payload, uint16_t length, BinaryState &state);
+
+        // return number of bytes written
+        static uint16_t encodeWriteState(const BinaryState &state, char *payload);
+        static uint16_t encodeReadState(RgbColor color, uint8_t level, char *payload);
+
+    private:
+        static void decodeTime(const char *data, BinaryState &state);
+        static void encodeTime(const BinaryState &state, char *data);
+};
@@ -79,6 +79,29 @@ void BluetoothConnect::disable() {
     server->disconnect(connectionId);
 }
 
+void BluetoothConnect::loop() {
+    // the commands drive the petals, LEDs and config owned by the loop, never run them on the BLE task
+    BluetoothCommand *command;
+    while ((command = commands.front()) != nullptr) {
+        cmdProtocol->run(command->type, command->payload, command->length, nullptr, nullptr, &codec);
+        commands.pop();
+    }
+
+    if (clientConnected.exchange(false)) {
+        if (!config->bluetoothAlwaysOn) {
+            config->setBluetoothAlwaysOn(true);
+            config->commitLater();
+        }
+        if (connectedCallback != nullptr) {
+            connectedCallback();
+        }
+    }
+}
+
+void BluetoothConnect::onConnected(ConnectedCallback callback) {
+    connectedCallback = callback;
+}
+
 void BluetoothConnect::init() {
     ESP_LOGI(LOG_TAG, "Initializing BLE server");
     BLECharacteristic* characteristic;
@@ -200,6 +223,18 @@ bool BluetoothConnect::isConnected() {
     return deviceConnected;
 }
 
+bool BluetoothConnect::isEnabled() {
+    return enabled;
+}
+
+bool BluetoothConnect::isInitialized() {
+    return initialized;
+}
+
+bool BluetoothConnect::isAdvertising() {
+    return advertising;
+}
+
 String BluetoothConnect::md5(String value) {
     MD5Builder md5;
     md5.begin();
@@ -227,7 +262,7 @@ void BluetoothConnect::updateStatusData(uint8_t batteryLevel, bool batteryChargi
     }
 }
 
-void BluetoothConnect::updateFloowerState(int8_t petalsOpenLevel, HsbColor hsbColor) {
+bool BluetoothConnect::updateFloowerState(int8_t petalsOpenLevel, HsbColor hsbColor) {
     if (commandService != nullptr) {
         RgbColor color = RgbColor(hsbColor);
         ESP_LOGD(LOG_TAG, "state: %d%%, [%d,%d,%d]", petalsOpenLevel, color.R, color.G, color.B);
@@ -236,6 +271,7 @@ void BluetoothConnect::updateFloowerState(int8_t petalsOpenLevel, HsbColor hsbCo
         stateCharacteristic->setValue((uint8_t *) &stateData, sizeof(stateData));
         stateCharacteristic->notify();
     }
+    return deviceConnected && commandService != nullptr; // the value is there to read, but nobody got notified
 }
 
 BLECharacteristic* BluetoothConnect::createROCharacteristics(BLEService *service, const char *uuid, const char *value) {
@@ -266,7 +302,13 @@ void BluetoothConnect::CommandCharacteristicsCallbacks::onWrite(BLECharacteristi
             }
         }
 
-        bluetoothConnect->cmdProtocol->run(messageHeader.type, bytes.data() + headerSize, messageHeader.length);
+        BluetoothCommand command;
+        command.type = messageHeader.type;
+        command.length = messageHeader.length;
+        memcpy(command.payload, bytes.data() + headerSize, messageHeader.length);
+        if (!bluetoothConnect->commands.push(command)) {
+            ESP_LOGW(LOG_TAG, "Command queue full, %d dropped", messageHeader.type);
+        }
     }
 }
 
@@ -275,11 +317,8 @@ void BluetoothConnect::ServerCallbacks::onConnect(BLEServer* server) {
     bluetoothConnect->deviceConnected = true;
     bluetoothConnect->advertising = false;
     bluetoothConnect->connectionId = server->getConnId(); // first one is 0
-
-    if (!bluetoothConnect->config->bluetoothAlwaysOn) {
-        bluetoothConnect->config->setBluetoothAlwaysOn(true);
-        bluetoothConnect->config->commit();
-    }
+    bluetoothConnect->codec = COMMAND_CODEC_MSGPACK; // until negotiated again
+    bluetoothConnect->clientConnected = true; // the loop takes it over
 };
 
 void BluetoothConnect::ServerCallbacks::onDisconnect(BLEServer* server) {
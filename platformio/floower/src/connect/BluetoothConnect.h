@@ -7,20 +7,35 @@
 #include "Config.h"
 #include "hardware/Floower.h"
 #include "CommandProtocol.h"
+#include "SpscQueue.h"
+#include <atomic>
 
 #define STATE_TRANSITION_MODE_BIT_COLOR 0
 #define STATE_TRANSITION_MODE_BIT_PETALS 1 // when this bit is set, the VALUE parameter means open level of petals (0-100%)
 #define STATE_TRANSITION_MODE_BIT_ANIMATION 2 // when this bit is set, the VALUE parameter means ID of animation
 
+#define BLUETOOTH_COMMAND_QUEUE_SIZE 8 // commands written by the app waiting for the loop, power of two
+
+struct BluetoothCommand {
+    uint16_t type;
+    uint16_t length;
+    char payload[MAX_MESSAGE_PAYLOAD_BYTES];
+};
+
 class BluetoothConnect {
     public:
         BluetoothConnect(Floower *floower, Config *config, CommandProtocol *cmdProtocol);
         void enable();
         void disable();
-        void updateFloowerState(int8_t petalsOpenLevel, HsbColor hsbColor);
+        void loop(); // runs the commands written by the app, they arrive on the BLE task
+        bool updateFloowerState(int8_t petalsOpenLevel, HsbColor hsbColor); // false when no client got notified
         void updateStatusData(uint8_t batteryLevel, bool batteryCharging, uint8_t wifiStatus);
         bool isConnected();
+        bool isEnabled();
+        bool isInitialized(); // BLE stack stays up once initialized
+        bool isAdvertising();
         void reloadConfig();
+        void onConnected(ConnectedCallback callback); // fired from loop()
 
     private:
         void init();
@@ -38,13 +53,17 @@ class BluetoothConnect {
         BLEService *batteryService = nullptr;
 
         bool deviceConnected = false;
+        std::atomic<bool> clientConnected {false}; // BLE task -> loop
+        ConnectedCallback connectedCallback;
         uint16_t connectionId;
+        uint8_t codec = COMMAND_CODEC_MSGPACK; // payload codec negotiated on the connection
         bool enabled = false;
         bool advertising = false;
         bool initialized = false;
         char receiveBuffer[MAX_MESSAGE_PAYLOAD_BYTES + 1]; // extra space for 0 terminating string
         char responseBuffer[MAX_MESSAGE_PAYLOAD_BYTES + 1]; // extra space for 0 terminating string
         StaticJsonDocument<MAX_MESSAGE_PAYLOAD_BYTES> jsonPayload;  
+        SpscQueue<BluetoothCommand, BLUETOOTH_COMMAND_QUEUE_SIZE> commands; // BLE task -> loop
 
         BLECharacteristic* createROCharacteristics(BLEService *service, const char *uuid, const char *value);
 
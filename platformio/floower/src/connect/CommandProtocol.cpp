@@ -11,7 +11,47 @@ void CommandProtocol::onRunOTAUpdate(RunOTAUpdateCallback callback) {
     runOTAUpdateCallback = callback;
 }
 
-uint16_t CommandProtocol::run(const uint16_t type, const char *payload, const uint16_t payloadLength, char *responsePayload, uint16_t *responseLength) {
+#ifdef LOOP_PROFILER
+void CommandProtocol::setLoopProfiler(LoopProfiler *loopProfiler) {
+    this->loopProfiler = loopProfiler;
+}
+#endif
+
+void CommandProtocol::setEnergyLedger(EnergyLedger *energyLedger) {
+    this->energyLedger = energyLedger;
+}
+
+void CommandProtocol::setStatePublishers(StatePublisher *bluetoothStatePublisher, StatePublisher *wifiStatePublisher) {
+    this->bluetoothStatePublisher = bluetoothStatePublisher;
+    this->wifiStatePublisher = wifiStatePublisher;
+}
+
+uint16_t CommandProtocol::run(const uint16_t type, const char *payload, const uint16_t payloadLength, char *responsePayload, uint16_t *responseLength, uint8_t *codec) {
+    if (type == CommandType::PROTOCOL_CODEC) {
+        // payload: <highest binary codec version of client>, response: <codec version of the connection, 0 for MsgPack>
+        if (codec == nullptr || payloadLength != 1) {
+            return STATUS_UNSUPPORTED;
+        }
+        *codec = BinaryCodec::negotiate(payload[0]);
+        if (responsePayload != nullptr && responseLength != nullptr) {
+            responsePayload[0] = *codec;
+            *responseLength = 1;
+        }
+        return STATUS_OK;
+    }
+
+    // binary hot path, MsgPack payloads are still accepted on binary connection
+    if (codec != nullptr && *codec != COMMAND_CODEC_MSGPACK) {
+        bool hotCommand = type == CommandType::CMD_WRITE_PETALS || type == CommandType::CMD_WRITE_RGB_COLOR || type == CommandType::CMD_WRITE_STATE;
+        if (hotCommand && BinaryCodec::isBinary(payload, payloadLength)) {
+            return runBinary(type, payload, payloadLength);
+        }
+        if (type == CommandType::CMD_READ_STATE && payloadLength == 0 && responsePayload != nullptr && responseLength != nullptr) {
+            *responseLength = BinaryCodec::encodeReadState(RgbColor(floower->getColor()), floower->getPetalsOpenLevel(), responsePayload);
+            return STATUS_OK;
+        }
+    }
+
     // commands that require request payload
     if (payloadLength > 0) {
         payloadUnpacker.feed((const uint8_t *) payload, payloadLength);
@@ -97,7 +137,7 @@ uint16_t CommandProtocol::run(const uint16_t type, const char *payload, const ui
                 if (jsonPayload.containsKey("dvc") && jsonPayload.containsKey("tkn")) {
                     config->setFloud(jsonPayload["dvc"], jsonPayload["tkn"]);
                 }
-                config->commit();
+                config->commitLater();
                 return STATUS_OK;
             }
             case CommandType::CMD_WRITE_NAME: {
@@ -106,7 +146,7 @@ uint16_t CommandProtocol::run(const uint16_t type, const char *payload, const ui
                 if (!name.isEmpty()) {
                     config->setName(name);
                 }
-                config->commit();
+                config->commitLater();
                 return STATUS_OK;
             }
             case CommandType::CMD_WRITE_CUSTOMIZATION: {
@@ -120,7 +160,7 @@ uint16_t CommandProtocol::run(const uint16_t type, const char *payload, const ui
                 if (jsonPayload.containsKey("mol")) {
                     config->setMaxOpenLevel(jsonPayload["mol"]);
                 }
-                config->commit();
+                config->commitLater();
                 return STATUS_OK;
             }
             case CommandType::CMD_WRITE_COLOR_SCHEME: {
@@ -136,15 +176,29 @@ uint16_t CommandProtocol::run(const uint16_t type, const char *payload, const ui
                         ESP_LOGI(LOG_TAG, "Color %d: %.2f,%.2f", i, colors[i].H, colors[i].S);
                     }
                     config->setColorScheme(colors, size);
-                    config->commit();
+                    config->commitLater();
                     return STATUS_OK;
                 }
                 return STATUS_ERROR;
             }
             case CommandType::CMD_RUN_OTA_UPDATE: {
-                // { u: <firmwareUrl> }
+                // { u: <firmwareUrl>, s: <size>, h: <sha256 hex>, d: <deltaUrl> }
                 if (jsonPayload.containsKey("u") && runOTAUpdateCallback != nullptr) {
-                    runOTAUpdateCallback(jsonPayload["u"]);
+                    OtaManifest manifest;
+                    manifest.url = jsonPayload["u"].as<const char*>();
+                    if (jsonPayload.containsKey("d")) {
+                        manifest.deltaUrl = jsonPayload["d"].as<const char*>();
+                    }
+                    if (jsonPayload.containsKey("s")) {
+                        manifest.size = jsonPayload["s"];
+                    }
+                    if (jsonPayload.containsKey("h")) {
+                        if (!Sha256::parseHex(jsonPayload["h"], manifest.sha256)) {
+                            return STATUS_ERROR;
+                        }
+                        manifest.hasDigest = true;
+                    }
+                    runOTAUpdateCallback(manifest);
                     return STATUS_OK;
                 }
                 return STATUS_ERROR;
@@ -205,12 +259,157 @@ uint16_t CommandProtocol::run(const uint16_t type, const char *payload, const ui
                 *responseLength = serializeMsgPack(jsonPayload, responsePayload, MAX_MESSAGE_PAYLOAD_BYTES);
                 return STATUS_OK;
             }
+            case CommandType::CMD_READ_LOOP_PROFILE: {
+                // response: { dm: <stepperDeadlineMisses>, st: [ [<count>, <p50>, <p99>, <max>], ... ] } in us, stages in ProfilerStage order
+#ifndef LOOP_PROFILER
+                return STATUS_UNSUPPORTED;
+#else
+                if (loopProfiler == nullptr) {
+                    return STATUS_UNSUPPORTED;
+                }
+                StaticJsonDocument<JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(PROFILER_STAGES) + PROFILER_STAGES * JSON_ARRAY_SIZE(4)> profile;
+                profile["dm"] = loopProfiler->getDeadlineMisses();
+                JsonArray stages = profile.createNestedArray("st");
+                for (uint8_t i = 0; i < PROFILER_STAGES; i++) {
+                    LatencyStats stats = loopProfiler->getStats(i);
+                    JsonArray stage = stages.createNestedArray();
+                    stage.add(stats.count);
+                    stage.add(stats.p50);
+                    stage.add(stats.p99);
+                    stage.add(stats.max);
+                }
+                *responseLength = serializeMsgPack(profile, responsePayload, MAX_MESSAGE_PAYLOAD_BYTES);
+                return STATUS_OK;
+#endif
+            }
+            case CommandType::CMD_READ_LEDS_FRAME_RATE: {
+                // response: { px: [<targetFps>, <fps>, <shown>, <skipped>], st: [...] } for petals and status LEDs
+                jsonPayload.clear();
+                FrameStats strips[] = { floower->getPixelsFrameStats(), floower->getStatusPixelsFrameStats() };
+                const char *keys[] = { "px", "st" };
+                for (uint8_t i = 0; i < 2; i++) {
+                    JsonArray strip = jsonPayload.createNestedArray(keys[i]);
+                    strip.add(strips[i].targetFps);
+                    strip.add(strips[i].fps);
+                    strip.add(strips[i].shown);
+                    strip.add(strips[i].skipped);
+                }
+                *responseLength = serializeMsgPack(jsonPayload, responsePayload, MAX_MESSAGE_PAYLOAD_BYTES);
+                return STATUS_OK;
+            }
+            case CommandType::CMD_READ_BATTERY: {
+                // response: { v: <voltage mV>, l: <level %>, r: <runtime min>, q: <confidence %>, c: <charging>, u: <usbPowered> }
+                PowerState powerState = floower->getPowerState();
+                jsonPayload.clear();
+                jsonPayload["v"] = (uint16_t) (powerState.batteryVoltage * 1000 + 0.5);
+                jsonPayload["l"] = powerState.batteryLevel;
+                jsonPayload["r"] = powerState.batteryRuntime;
+                jsonPayload["q"] = powerState.batteryConfidence;
+                jsonPayload["c"] = powerState.batteryCharging;
+                jsonPayload["u"] = powerState.usbPowered;
+                *responseLength = serializeMsgPack(jsonPayload, responsePayload, MAX_MESSAGE_PAYLOAD_BYTES);
+                return STATUS_OK;
+            }
+            case CommandType::CMD_READ_ENERGY: {
+                // response: { t: <total uAh>, c: [ [<uAh>, <ms in state 0>, ... <ms in state 3>], ... ] } consumers in EnergyConsumer order
+                if (energyLedger == nullptr) {
+                    return STATUS_UNSUPPORTED;
+                }
+                StaticJsonDocument<JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(ENERGY_CONSUMERS) + ENERGY_CONSUMERS * JSON_ARRAY_SIZE(1 + ENERGY_STATES)> energy;
+                energy["t"] = energyLedger->getTotalCharge();
+                JsonArray consumers = energy.createNestedArray("c");
+                for (uint8_t i = 0; i < ENERGY_CONSUMERS; i++) {
+                    JsonArray consumer = consumers.createNestedArray();
+                    consumer.add(energyLedger->getCharge((EnergyConsumer) i));
+                    for (uint8_t state = 0; state < ENERGY_STATES; state++) {
+                        consumer.add(energyLedger->getStateTime((EnergyConsumer) i, state));
+                    }
+                }
+                *responseLength = serializeMsgPack(energy, responsePayload, MAX_MESSAGE_PAYLOAD_BYTES);
+                return STATUS_OK;
+            }
+            case CommandType::CMD_READ_DRIVER_HEALTH: {
+                // response: { n: <samples>, i: <run current>, f: [<count>, ...], e: [ [<s>, <fault>, <run current>], ... ] } faults in DriverFault order, latest event first
+                DriverHealth *driverHealth = floower->getDriverHealth();
+                DriverFaultEvent events[HEALTH_EVENTS];
+                uint8_t eventsCount = driverHealth->getEvents(events, HEALTH_EVENTS);
+                StaticJsonDocument<JSON_OBJECT_SIZE(4) + JSON_ARRAY_SIZE(DRIVER_FAULTS) + JSON_ARRAY_SIZE(HEALTH_EVENTS) + HEALTH_EVENTS * JSON_ARRAY_SIZE(3)> health;
+                health["n"] = driverHealth->getSamples();
+                health["i"] = driverHealth->getIrun();
+                JsonArray faults = health.createNestedArray("f");
+                for (uint8_t i = 0; i < DRIVER_FAULTS; i++) {
+                    faults.add(driverHealth->getFaultCount((DriverFault) i));
+                }
+                JsonArray eventsArray = health.createNestedArray("e");
+                for (uint8_t i = 0; i < eventsCount; i++) {
+                    JsonArray event = eventsArray.createNestedArray();
+                    event.add(events[i].time);
+                    event.add(events[i].fault);
+                    event.add(events[i].irun);
+                }
+                *responseLength = serializeMsgPack(health, responsePayload, MAX_MESSAGE_PAYLOAD_BYTES);
+                return STATUS_OK;
+            }
+            case CommandType::CMD_READ_STATE_PUBLISHING: {
+                // response: { bt: [<sent>, <suppressed>, <rejected>], wf: [...] } for the BLE and Floud transports
+                if (bluetoothStatePublisher == nullptr || wifiStatePublisher == nullptr) {
+                    return STATUS_UNSUPPORTED;
+                }
+                StaticJsonDocument<JSON_OBJECT_SIZE(2) + 2 * JSON_ARRAY_SIZE(3)> publishing;
+                StatePublisher *publishers[] = { bluetoothStatePublisher, wifiStatePublisher };
+                const char *keys[] = { "bt", "wf" };
+                for (uint8_t i = 0; i < 2; i++) {
+                    JsonArray counters = publishing.createNestedArray(keys[i]);
+                    counters.add(publishers[i]->getSentCount());
+                    counters.add(publishers[i]->getSuppressedCount());
+                    counters.add(publishers[i]->getRejectedCount());
+                }
+                *responseLength = serializeMsgPack(publishing, responsePayload, MAX_MESSAGE_PAYLOAD_BYTES);
+                return STATUS_OK;
+            }
         }
     }
 
     return STATUS_UNSUPPORTED;
 }
 
+uint16_t CommandProtocol::runBinary(const uint16_t type, const char *payload, const uint16_t payloadLength) {
+    BinaryState state;
+    switch (type) {
+        case CommandType::CMD_WRITE_PETALS:
+            if (!BinaryCodec::decodePetals(payload, payloadLength, state) || state.level > 100) {
+                return STATUS_ERROR;
+            }
+            writeState(state);
+            return STATUS_OK;
+        case CommandType::CMD_WRITE_RGB_COLOR:
+            if (!BinaryCodec::decodeRgbColor(payload, payloadLength, state)) {
+                return STATUS_ERROR;
+            }
+            writeState(state);
+            return STATUS_OK;
+        case CommandType::CMD_WRITE_STATE:
+            if (!BinaryCodec::decodeWriteState(payload, payloadLength, state)) {
+                return STATUS_ERROR;
+            }
+            writeState(state);
+            return STATUS_OK;
+    }
+    return STATUS_UNSUPPORTED;
+}
+
+void CommandProtocol::writeState(const BinaryState &state) {
+    uint16_t time = state.hasTime ? state.time : config->speedMillis;
+    if (state.hasLevel && state.level <= 100) {
+        floower->setPetalsOpenLevel(state.level, time);
+    }
+    if (state.hasColor) {
+        HsbColor color = HsbColor(state.color);
+        floower->transitionColor(color.H, color.S, color.B, time);
+    }
+    fireControlCommandCallback();
+}
+
 uint16_t CommandProtocol::sendStatus(const uint8_t batteryLevel, const bool charging, char *payload, uint16_t *payloadLength) {
     // payload: { b: <batteryLevel>, bc: <batteryCharging> }
     jsonPayload.clear();
@@ -220,7 +419,13 @@ uint16_t CommandProtocol::sendStatus(const uint8_t batteryLevel, const bool char
     return PROTOCOL_STATUS;
 }
 
-uint16_t CommandProtocol::sendState(const int8_t petalsOpenLevel, const HsbColor hsbColor, char *payload, uint16_t *payloadLength) {
+uint16_t CommandProtocol::sendState(const int8_t petalsOpenLevel, const HsbColor hsbColor, char *payload, uint16_t *payloadLength, const uint8_t codec) {
+    if (codec != COMMAND_CODEC_MSGPACK) {
+        BinaryState state = {true, (uint8_t) petalsOpenLevel, true, RgbColor(hsbColor), false, 0};
+        *payloadLength = BinaryCodec::encodeWriteState(state, payload);
+        return CMD_WRITE_STATE;
+    }
+
     // payload: { r: <red>, g: <green>, b: <blue>, l: <level >}
     jsonPayload.clear();
     RgbColor color = RgbColor(hsbColor);
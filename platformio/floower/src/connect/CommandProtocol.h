@@ -6,24 +6,38 @@
 #include "ArduinoJson.h"
 #include "MsgPack.h"
 #include "CommandProtocolDef.h"
+#ifdef LOOP_PROFILER
+#include "LoopProfiler.h"
+#endif
+#include "EnergyLedger.h"
+#include "StatePublisher.h"
+#include "BinaryCodec.h"
+#include "OtaManifest.h"
 
 typedef std::function<void()> ControlCommandCallback;
-typedef std::function<void(String firmwareUrl)> RunOTAUpdateCallback;
+typedef std::function<void(const OtaManifest &manifest)> RunOTAUpdateCallback;
+typedef std::function<void()> ConnectedCallback;
 
 class CommandProtocol {
     public:
         CommandProtocol(Config *config, Floower *floower);
-        uint16_t run(
+        uint16_t run( // loop task only, the transports hand the received commands over to it
             const uint16_t type,
             const char *payload,
             const uint16_t payloadLength,
             char *responsePayload = nullptr,
-            uint16_t *responseLength = nullptr
+            uint16_t *responseLength = nullptr,
+            uint8_t *codec = nullptr // codec of the connection, set by PROTOCOL_CODEC
         );
         uint16_t sendStatus(const uint8_t batteryLevel, const bool charging, char *payload, uint16_t *payloadLength); // returns type of command that should be send
-        uint16_t sendState(const int8_t petalsOpenLevel, const HsbColor hsbColor, char *payload, uint16_t *payloadLength); // returns type of command that should be send
+        uint16_t sendState(const int8_t petalsOpenLevel, const HsbColor hsbColor, char *payload, uint16_t *payloadLength, const uint8_t codec = COMMAND_CODEC_MSGPACK); // returns type of command that should be send
         void onControlCommand(ControlCommandCallback callback);
         void onRunOTAUpdate(RunOTAUpdateCallback callback);
+#ifdef LOOP_PROFILER
+        void setLoopProfiler(LoopProfiler *loopProfiler);
+#endif
+        void setEnergyLedger(EnergyLedger *energyLedger);
+        void setStatePublishers(StatePublisher *bluetoothStatePublisher, StatePublisher *wifiStatePublisher);
         void enableBluetooth();
         void disbleBluetooth();
         
@@ -36,6 +50,14 @@ class CommandProtocol {
 
         Config *config;
         Floower *floower;
+#ifdef LOOP_PROFILER
+        LoopProfiler *loopProfiler = nullptr;
+#endif
+        EnergyLedger *energyLedger = nullptr;
+        StatePublisher *bluetoothStatePublisher = nullptr;
+        StatePublisher *wifiStatePublisher = nullptr;
 
+        uint16_t runBinary(const uint16_t type, const char *payload, const uint16_t payloadLength);
+        void writeState(const BinaryState &state);
         void fireControlCommandCallback(); 
 };
\ No newline at end of file
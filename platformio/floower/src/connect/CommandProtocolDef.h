@@ -14,6 +14,7 @@ enum CommandType {
     // protocol commands (16-63)
     PROTOCOL_AUTH               = 16, // authorize the connection with server by sending a secure token
     PROTOCOL_STATUS             = 17, // heartbeat status
+    PROTOCOL_CODEC              = 18, // negotiate binary payloads of the connection
 
     // device commands (64+)
     CMD_WRITE_PETALS            = 64,
@@ -31,7 +32,13 @@ enum CommandType {
     CMD_READ_CUSTOMIZATION      = 76,
     CMD_WRITE_COLOR_SCHEME      = 77,
     CMD_READ_COLOR_SCHEME       = 78,
-    CMD_READ_DEVICE_INFO        = 79 // serial number, name, hw revision, fw revision, model name
+    CMD_READ_DEVICE_INFO        = 79, // serial number, name, hw revision, fw revision, model name
+    CMD_READ_LOOP_PROFILE       = 80, // main loop latencies, only when built with LOOP_PROFILER
+    CMD_READ_LEDS_FRAME_RATE    = 81, // achieved frame rate and skipped frames of the LED strips
+    CMD_READ_BATTERY            = 82, // estimated battery state of charge, remaining runtime and confidence
+    CMD_READ_ENERGY             = 83, // consumed charge and time in states of the peripherals since boot
+    CMD_READ_DRIVER_HEALTH      = 84, // stepper driver fault counters and latest fault events
+    CMD_READ_STATE_PUBLISHING   = 85 // state updates sent, suppressed and rejected per transport
 };
 
 struct CommandMessageHeader {
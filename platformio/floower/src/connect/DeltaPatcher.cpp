@@ -0,0 +1,139 @@
+#include "DeltaPatcher.h"
+#include "hal/Hal.h"
+#include <string.h>
+
+static uint32_t readUint32(const uint8_t *data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+bool DeltaPatcher::isPatch(const uint8_t *header, size_t length) {
+    return length >= DELTA_HEADER_SIZE && memcmp(header, DELTA_MAGIC, 4) == 0;
+}
+
+bool DeltaPatcher::begin(const uint8_t *header) {
+    if (header[4] != DELTA_VERSION) {
+        return false;
+    }
+    sourceSize = readUint32(header + 8);
+    targetSize = readUint32(header + 12);
+    memcpy(sourceDigest, header + 16, SHA256_DIGEST_SIZE);
+    state = STATE_RECORD;
+    recordLength = 0;
+    sourcePosition = 0;
+    sourceLength = 0;
+    sourceSha256.begin();
+    checkedBytes = 0;
+    return sourceSize > 0 && targetSize > 0;
+}
+
+DeltaSourceCheck DeltaPatcher::checkSource() {
+    uint8_t block[DELTA_SOURCE_BUFFER]; // the source buffer is kept for the patching meanwhile
+    uint32_t end = _min(sourceSize, checkedBytes + DELTA_CHECK_BLOCK);
+    while (checkedBytes < end) {
+        size_t length = _min((uint32_t) DELTA_SOURCE_BUFFER, end - checkedBytes);
+        if (!halFirmwareRead(checkedBytes, block, length)) {
+            return SOURCE_DIFFERS;
+        }
+        sourceSha256.update(block, length);
+        checkedBytes += length;
+    }
+    if (checkedBytes < sourceSize) {
+        return SOURCE_CHECKING;
+    }
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    sourceSha256.finish(digest);
+    return memcmp(digest, sourceDigest, SHA256_DIGEST_SIZE) == 0 ? SOURCE_MATCHES : SOURCE_DIFFERS;
+}
+
+size_t DeltaPatcher::apply(const uint8_t *&input, size_t &length, uint8_t *output, size_t size) {
+    size_t produced = 0;
+    while (true) {
+        size_t part;
+        switch (state) {
+            case STATE_RECORD: {
+                if (length == 0) {
+                    return produced;
+                }
+                part = _min(length, (size_t) DELTA_RECORD_SIZE - recordLength);
+                memcpy(record + recordLength, input, part);
+                recordLength += part;
+                input += part;
+                length -= part;
+                if (recordLength < DELTA_RECORD_SIZE) {
+                    return produced;
+                }
+                recordLength = 0;
+                extraLength = readUint32(record);
+                diffLength = readUint32(record + 4);
+                int64_t position = (int64_t) sourcePosition + (int32_t) readUint32(record + 8);
+                if (position < 0 || position + diffLength > sourceSize) {
+                    state = STATE_INVALID;
+                    return produced;
+                }
+                sourcePosition = position;
+                state = STATE_EXTRA;
+                break;
+            }
+            case STATE_EXTRA:
+                if (extraLength == 0) {
+                    state = STATE_DIFF;
+                    break;
+                }
+                if (length == 0 || produced == size) {
+                    return produced;
+                }
+                part = _min(_min(length, size - produced), (size_t) extraLength);
+                memcpy(output + produced, input, part);
+                produced += part;
+                extraLength -= part;
+                input += part;
+                length -= part;
+                break;
+            case STATE_DIFF:
+                if (diffLength == 0) {
+                    state = STATE_RECORD;
+                    break;
+                }
+                if (length == 0 || produced == size) {
+                    return produced;
+                }
+                if (sourcePosition < sourceStart || sourcePosition >= sourceStart + sourceLength) {
+                    if (!readSource()) {
+                        state = STATE_INVALID;
+                        return produced;
+                    }
+                }
+                part = _min(_min(length, size - produced), (size_t) diffLength);
+                part = _min(part, (size_t) (sourceStart + sourceLength - sourcePosition));
+                for (size_t i = 0; i < part; i++) {
+                    output[produced + i] = input[i] + source[sourcePosition - sourceStart + i];
+                }
+                produced += part;
+                diffLength -= part;
+                sourcePosition += part;
+                input += part;
+                length -= part;
+                break;
+            case STATE_INVALID:
+                return produced;
+        }
+    }
+}
+
+bool DeltaPatcher::readSource() {
+    sourceStart = sourcePosition;
+    sourceLength = _min((uint32_t) DELTA_SOURCE_BUFFER, sourceSize - sourcePosition);
+    return halFirmwareRead(sourceStart, source, sourceLength);
+}
+
+bool DeltaPatcher::isInvalid() {
+    return state == STATE_INVALID;
+}
+
+uint32_t DeltaPatcher::getSourceSize() {
+    return sourceSize;
+}
+
+uint32_t DeltaPatcher::getTargetSize() {
+    return targetSize;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Sha256.h"
+
+#define DELTA_MAGIC "FLDP" // see tools/ota-packer
+#define DELTA_VERSION 1
+#define DELTA_HEADER_SIZE 48 // magic, version, pad, source size, target size, source digest
+#define DELTA_RECORD_SIZE 12 // extra length, diff length, source seek
+#define DELTA_SOURCE_BUFFER 256 // bytes of the running firmware read at once
+#define DELTA_CHECK_BLOCK 16384 // bytes of the running firmware hashed by one call of checkSource()
+
+enum DeltaSourceCheck {
+    SOURCE_CHECKING, // call again
+    SOURCE_MATCHES,
+    SOURCE_DIFFERS // or not readable
+};
+
+// Applies a delta patch to the running firmware as the patch streams in. The patch is a sequence of records, each
+// brings bytes new to the target (extra) followed by bytes sent as the difference to the source (diff), which are
+// mostly zeros where the code only moved. The source position moves by the seek of the record before the diff. Only
+// a small block of the source is held in RAM.
+class DeltaPatcher {
+    public:
+        static bool isPatch(const uint8_t *header, size_t length);
+        bool begin(const uint8_t *header); // false for unsupported patch
+        // hashes the next block of the running firmware, tells once done whether the patch was made from it
+        DeltaSourceCheck checkSource();
+        // patches until the output is full or the input used up, input is advanced past the bytes consumed
+        size_t apply(const uint8_t *&input, size_t &length, uint8_t *output, size_t size); // returns bytes patched
+        bool isInvalid(); // record reaching out of the source or the source not readable
+        uint32_t getSourceSize();
+        uint32_t getTargetSize();
+
+    private:
+        enum State {
+            STATE_RECORD,
+            STATE_EXTRA,
+            STATE_DIFF,
+            STATE_INVALID
+        };
+
+        bool readSource();
+
+        uint32_t sourceSize = 0;
+        uint32_t targetSize = 0;
+        uint8_t sourceDigest[SHA256_DIGEST_SIZE];
+        Sha256 sourceSha256;
+        uint32_t checkedBytes = 0;
+        State state = STATE_RECORD;
+        uint8_t record[DELTA_RECORD_SIZE];
+        uint8_t recordLength = 0;
+        uint32_t extraLength = 0;
+        uint32_t diffLength = 0;
+        uint32_t sourcePosition = 0;
+        uint8_t source[DELTA_SOURCE_BUFFER];
+        uint32_t sourceStart = 0; // source offset of the block read
+        size_t sourceLength = 0;
+};
@@ -0,0 +1,88 @@
+#include "FrameReassembler.h"
+#include <string.h>
+
+FrameStatus FrameReassembler::feed(const char *data, size_t length) {
+    uint32_t frameStart = tail.load(std::memory_order_relaxed);
+    if (writePosition - head.load(std::memory_order_acquire) + length > FRAME_BUFFER_SIZE) {
+        overflows++;
+        return FRAME_OVERFLOW;
+    }
+
+    // copy all in, wrapping around the end of the buffer
+    size_t offset = writePosition & (FRAME_BUFFER_SIZE - 1);
+    size_t firstPart = FRAME_BUFFER_SIZE - offset < length ? FRAME_BUFFER_SIZE - offset : length;
+    memcpy(buffer + offset, data, firstPart);
+    memcpy(buffer, data + firstPart, length - firstPart);
+    writePosition += length;
+
+    // publish all frames completed by this data
+    FrameStatus status = FRAME_OK;
+    uint16_t completed = 0;
+    while (writePosition - frameStart >= FRAME_HEADER_SIZE) {
+        uint16_t payloadLength = (byteAt(frameStart + 4) << 8) | byteAt(frameStart + 5);
+        if (payloadLength > MAX_MESSAGE_PAYLOAD_BYTES) {
+            writePosition = frameStart; // frames before the invalid one are still good
+            status = FRAME_INVALID;
+            break;
+        }
+        if (writePosition - frameStart < FRAME_HEADER_SIZE + payloadLength) {
+            break; // rest of the frame comes with the next data
+        }
+        frameStart += FRAME_HEADER_SIZE + payloadLength;
+        completed++;
+    }
+    if (completed > 0) {
+        receivedFrames += completed;
+        queuedFrames.fetch_add(completed, std::memory_order_relaxed);
+        tail.store(frameStart, std::memory_order_release);
+    }
+    return status;
+}
+
+void FrameReassembler::discardPartial() {
+    writePosition = tail.load(std::memory_order_relaxed);
+}
+
+bool FrameReassembler::next(CommandMessageHeader &header, char *payload) {
+    uint32_t frameStart = head.load(std::memory_order_relaxed);
+    if (frameStart == tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    header.type = (byteAt(frameStart) << 8) | byteAt(frameStart + 1);
+    header.id = (byteAt(frameStart + 2) << 8) | byteAt(frameStart + 3);
+    header.length = (byteAt(frameStart + 4) << 8) | byteAt(frameStart + 5);
+    read(frameStart + FRAME_HEADER_SIZE, payload, header.length);
+
+    queuedFrames.fetch_sub(1, std::memory_order_relaxed);
+    head.store(frameStart + FRAME_HEADER_SIZE + header.length, std::memory_order_release);
+    return true;
+}
+
+void FrameReassembler::clear() {
+    CommandMessageHeader header;
+    char payload[MAX_MESSAGE_PAYLOAD_BYTES];
+    while (next(header, payload));
+}
+
+uint16_t FrameReassembler::getQueuedFrames() {
+    return queuedFrames.load(std::memory_order_relaxed);
+}
+
+uint32_t FrameReassembler::getReceivedFrames() {
+    return receivedFrames;
+}
+
+uint32_t FrameReassembler::getOverflows() {
+    return overflows;
+}
+
+void FrameReassembler::read(uint32_t position, char *data, size_t length) {
+    size_t offset = position & (FRAME_BUFFER_SIZE - 1);
+    size_t firstPart = FRAME_BUFFER_SIZE - offset < length ? FRAME_BUFFER_SIZE - offset : length;
+    memcpy(data, buffer + offset, firstPart);
+    memcpy(data + firstPart, buffer, length - firstPart);
+}
+
+uint8_t FrameReassembler::byteAt(uint32_t position) {
+    return buffer[position & (FRAME_BUFFER_SIZE - 1)];
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "CommandProtocolDef.h"
+
+#define FRAME_BUFFER_SIZE 2048 // bytes, power of two, holds complete frames waiting for the loop and the one being received
+#define FRAME_HEADER_SIZE sizeof(CommandMessageHeader)
+
+enum FrameStatus {
+    FRAME_OK,
+    FRAME_OVERFLOW, // loop is not keeping up, data was dropped
+    FRAME_INVALID // payload length over the limit, the stream cannot be trusted anymore
+};
+
+// Reassembles CommandMessageHeader framed messages from a TCP stream split or coalesced in any way. Bytes are kept in
+// a ring buffer and published to the consumer only once the whole frame arrived, so the ring is also the bounded
+// queue of complete frames. One producer (the TCP task) and one consumer (the loop) can run concurrently.
+class FrameReassembler {
+    public:
+        // producer side
+        FrameStatus feed(const char *data, size_t length);
+        void discardPartial(); // drop incomplete frame, on new connection
+
+        // consumer side, header is returned in host byte order and payload must hold MAX_MESSAGE_PAYLOAD_BYTES
+        bool next(CommandMessageHeader &header, char *payload);
+        void clear(); // drop all complete frames
+        uint16_t getQueuedFrames();
+
+        uint32_t getReceivedFrames();
+        uint32_t getOverflows();
+
+    private:
+        void read(uint32_t position, char *data, size_t length);
+        uint8_t byteAt(uint32_t position);
+
+        char buffer[FRAME_BUFFER_SIZE];
+        std::atomic<uint32_t> head {0}; // consumer, start of the first complete frame
+        std::atomic<uint32_t> tail {0}; // producer, end of the last complete frame
+        std::atomic<uint16_t> queuedFrames {0};
+        uint32_t writePosition = 0; // producer, end of received data
+        uint32_t receivedFrames = 0;
+        uint32_t overflows = 0;
+};
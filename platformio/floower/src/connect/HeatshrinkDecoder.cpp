@@ -0,0 +1,84 @@
+#include "HeatshrinkDecoder.h"
+#include <string.h>
+
+bool HeatshrinkDecoder::begin(uint8_t windowBits, uint8_t lookaheadBits) {
+    if (windowBits > HEATSHRINK_WINDOW_BITS_MAX || lookaheadBits < HEATSHRINK_LOOKAHEAD_BITS_MIN || lookaheadBits >= windowBits) {
+        return false;
+    }
+    this->windowBits = windowBits;
+    this->lookaheadBits = lookaheadBits;
+    windowMask = (1 << windowBits) - 1;
+    windowPosition = 0;
+    memset(window, 0, sizeof(window)); // references before the start read zeros
+    state = STATE_TAG;
+    bitBuffer = 0;
+    bitCount = 0;
+    copyCount = 0;
+    return true;
+}
+
+size_t HeatshrinkDecoder::decode(const uint8_t *&input, size_t &length, uint8_t *output, size_t size) {
+    size_t produced = 0;
+    while (produced < size) {
+        int32_t value;
+        switch (state) {
+            case STATE_TAG:
+                value = readBits(1, input, length);
+                if (value < 0) {
+                    return produced;
+                }
+                state = value ? STATE_LITERAL : STATE_INDEX;
+                break;
+            case STATE_LITERAL:
+                value = readBits(8, input, length);
+                if (value < 0) {
+                    return produced;
+                }
+                output[produced++] = value;
+                window[windowPosition++ & windowMask] = value;
+                state = STATE_TAG;
+                break;
+            case STATE_INDEX:
+                value = readBits(windowBits, input, length);
+                if (value < 0) {
+                    return produced;
+                }
+                copyOffset = value + 1;
+                state = STATE_COUNT;
+                break;
+            case STATE_COUNT:
+                value = readBits(lookaheadBits, input, length);
+                if (value < 0) {
+                    return produced;
+                }
+                copyCount = value + 1;
+                state = STATE_COPY;
+                break;
+            case STATE_COPY:
+                while (copyCount > 0 && produced < size) {
+                    uint8_t byte = window[(windowPosition - copyOffset) & windowMask];
+                    output[produced++] = byte;
+                    window[windowPosition++ & windowMask] = byte;
+                    copyCount--;
+                }
+                if (copyCount == 0) {
+                    state = STATE_TAG;
+                }
+                break;
+        }
+    }
+    return produced;
+}
+
+int32_t HeatshrinkDecoder::readBits(uint8_t count, const uint8_t *&input, size_t &length) {
+    while (bitCount < count) {
+        if (length == 0) {
+            return -1;
+        }
+        bitBuffer = (bitBuffer << 8) | *input++;
+        length--;
+        bitCount += 8;
+    }
+    bitCount -= count;
+    return (bitBuffer >> bitCount) & ((1 << count) - 1);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HEATSHRINK_WINDOW_BITS_MAX 11 // 2KB of history kept
+#define HEATSHRINK_LOOKAHEAD_BITS_MIN 3
+
+// Streaming decoder of the heatshrink bitstream, an LZSS with a fixed window: 1 tag bit and a byte for a literal, 0
+// tag bit, window index and count bits for a back reference into the bytes decoded before. Input is taken in chunks of
+// any size and decoded into the caller's buffer, only the window is kept in between.
+class HeatshrinkDecoder {
+    public:
+        bool begin(uint8_t windowBits, uint8_t lookaheadBits); // false for unsupported sizes
+        // decodes until the output is full or the input used up, input is advanced past the bytes consumed
+        size_t decode(const uint8_t *&input, size_t &length, uint8_t *output, size_t size); // returns bytes decoded
+
+    private:
+        enum State {
+            STATE_TAG,
+            STATE_LITERAL,
+            STATE_INDEX,
+            STATE_COUNT,
+            STATE_COPY
+        };
+
+        int32_t readBits(uint8_t count, const uint8_t *&input, size_t &length); // -1 until enough input came
+
+        uint8_t window[1 << HEATSHRINK_WINDOW_BITS_MAX];
+        uint16_t windowMask = 0;
+        uint16_t windowPosition = 0;
+        uint8_t windowBits = 0;
+        uint8_t lookaheadBits = 0;
+        State state = STATE_TAG;
+        uint32_t bitBuffer = 0;
+        uint8_t bitCount = 0; // bits of the input read ahead
+        uint16_t copyOffset = 0;
+        uint16_t copyCount = 0;
+};
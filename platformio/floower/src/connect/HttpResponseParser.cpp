@@ -0,0 +1,151 @@
+#include "HttpResponseParser.h"
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+
+HttpResponseParser::HttpResponseParser() {
+    reset();
+}
+
+void HttpResponseParser::reset() {
+    state = HTTP_STATUS_LINE;
+    lineLength = 0;
+    headLength = 0;
+    statusCode = 0;
+    contentLength = -1;
+    contentType[0] = '\0';
+    contentRange = false;
+    rangeStart = 0;
+    rangeTotal = -1;
+    chunked = false;
+}
+
+size_t HttpResponseParser::feed(const char *data, size_t length) {
+    size_t consumed = 0;
+    while (consumed < length && (state == HTTP_STATUS_LINE || state == HTTP_HEADERS)) {
+        char c = data[consumed++];
+        if (++headLength > HTTP_HEAD_MAX) {
+            state = HTTP_INVALID;
+        }
+        else if (c == '\n') {
+            parseLine();
+            lineLength = 0;
+        }
+        else if (c != '\r' && lineLength < HTTP_LINE_MAX) {
+            line[lineLength++] = c;
+        }
+    }
+    return consumed;
+}
+
+HttpParserState HttpResponseParser::getState() {
+    return state;
+}
+
+bool HttpResponseParser::isComplete() {
+    return state == HTTP_BODY;
+}
+
+bool HttpResponseParser::isInvalid() {
+    return state == HTTP_INVALID;
+}
+
+uint16_t HttpResponseParser::getStatusCode() {
+    return statusCode;
+}
+
+int32_t HttpResponseParser::getContentLength() {
+    return contentLength;
+}
+
+const char *HttpResponseParser::getContentType() {
+    return contentType;
+}
+
+bool HttpResponseParser::hasContentRange() {
+    return contentRange;
+}
+
+int32_t HttpResponseParser::getRangeStart() {
+    return rangeStart;
+}
+
+int32_t HttpResponseParser::getRangeTotal() {
+    return rangeTotal;
+}
+
+bool HttpResponseParser::isChunked() {
+    return chunked;
+}
+
+void HttpResponseParser::parseLine() {
+    line[lineLength] = '\0';
+    if (state == HTTP_STATUS_LINE) {
+        // HTTP/1.1 200 OK
+        if (lineLength < 12 || strncmp(line, "HTTP/1.", 7) != 0 || line[8] != ' ') {
+            state = HTTP_INVALID;
+            return;
+        }
+        statusCode = atoi(line + 9);
+        state = statusCode >= 100 && statusCode < 600 ? HTTP_HEADERS : HTTP_INVALID;
+    }
+    else if (lineLength == 0) {
+        state = HTTP_BODY;
+    }
+    else {
+        char *value = strchr(line, ':');
+        if (value == nullptr) {
+            return; // not a header, ignored
+        }
+        *value++ = '\0';
+        while (*value == ' ' || *value == '\t') {
+            value++;
+        }
+        char *end = line + lineLength;
+        while (end > value && (end[-1] == ' ' || end[-1] == '\t')) {
+            *--end = '\0';
+        }
+        parseHeader(line, value);
+    }
+}
+
+void HttpResponseParser::parseHeader(const char *name, const char *value) {
+    char *end;
+    if (strcasecmp(name, "Content-Length") == 0) {
+        long length = strtol(value, &end, 10);
+        if (end == value || *end != '\0' || length < 0) {
+            state = HTTP_INVALID;
+            return;
+        }
+        contentLength = length;
+    }
+    else if (strcasecmp(name, "Content-Type") == 0) {
+        size_t length = strcspn(value, "; ");
+        length = length < HTTP_CONTENT_TYPE_MAX ? length : HTTP_CONTENT_TYPE_MAX;
+        memcpy(contentType, value, length);
+        contentType[length] = '\0';
+    }
+    else if (strcasecmp(name, "Content-Range") == 0) {
+        // bytes <first>-<last>/<total or *>
+        if (strncasecmp(value, "bytes ", 6) != 0) {
+            state = HTTP_INVALID;
+            return;
+        }
+        long first = strtol(value + 6, &end, 10);
+        if (*end != '-') {
+            state = HTTP_INVALID;
+            return;
+        }
+        strtol(end + 1, &end, 10);
+        if (*end != '/') {
+            state = HTTP_INVALID;
+            return;
+        }
+        contentRange = true;
+        rangeStart = first;
+        rangeTotal = end[1] == '*' ? -1 : strtol(end + 1, nullptr, 10);
+    }
+    else if (strcasecmp(name, "Transfer-Encoding") == 0) {
+        chunked = strstr(value, "chunked") != nullptr;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HTTP_LINE_MAX 128 // longest header line kept, the rest of a longer one is ignored
+#define HTTP_HEAD_MAX 4096 // bytes of the status line and headers together
+#define HTTP_CONTENT_TYPE_MAX 48
+
+enum HttpParserState {
+    HTTP_STATUS_LINE,
+    HTTP_HEADERS,
+    HTTP_BODY, // head complete, the rest of the stream is the body
+    HTTP_INVALID
+};
+
+// Incremental parser of an HTTP/1.1 response head. The head may be split across any number of chunks, each chunk is
+// consumed up to the end of the head and the caller gets the body that follows. Only headers the firmware download
+// needs are kept.
+class HttpResponseParser {
+    public:
+        HttpResponseParser();
+        void reset();
+        size_t feed(const char *data, size_t length); // returns bytes of the head consumed
+        HttpParserState getState();
+        bool isComplete();
+        bool isInvalid();
+
+        uint16_t getStatusCode();
+        int32_t getContentLength(); // -1 when not sent
+        const char *getContentType(); // without parameters
+        bool hasContentRange();
+        int32_t getRangeStart(); // first byte of the body in the whole resource
+        int32_t getRangeTotal(); // size of the whole resource, -1 when unknown
+        bool isChunked();
+
+    private:
+        void parseLine();
+        void parseHeader(const char *name, const char *value);
+
+        HttpParserState state;
+        char line[HTTP_LINE_MAX + 1];
+        uint16_t lineLength;
+        uint16_t headLength;
+
+        uint16_t statusCode;
+        int32_t contentLength;
+        char contentType[HTTP_CONTENT_TYPE_MAX + 1];
+        bool contentRange;
+        int32_t rangeStart;
+        int32_t rangeTotal;
+        bool chunked;
+};
@@ -0,0 +1,74 @@
+#include "InflightTable.h"
+
+InflightTable::InflightTable(uint8_t window) {
+    setWindow(window);
+}
+
+void InflightTable::setWindow(uint8_t window) {
+    if (window < 1) {
+        window = 1;
+    }
+    else if (window > INFLIGHT_MAX_WINDOW) {
+        window = INFLIGHT_MAX_WINDOW;
+    }
+    this->window = window;
+}
+
+uint8_t InflightTable::getWindow() {
+    return window;
+}
+
+bool InflightTable::isFull() {
+    return count >= window;
+}
+
+bool InflightTable::add(uint16_t id, uint16_t type, unsigned long now, unsigned long timeout) {
+    if (isFull()) {
+        return false;
+    }
+    requests[count++] = { id, type, now + timeout };
+    return true;
+}
+
+bool InflightTable::complete(uint16_t id, InflightRequest *request) {
+    for (uint8_t i = 0; i < count; i++) {
+        if (requests[i].id == id) {
+            if (request != nullptr) {
+                *request = requests[i];
+            }
+            // keep the order of sending
+            for (uint8_t j = i + 1; j < count; j++) {
+                requests[j - 1] = requests[j];
+            }
+            count--;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t InflightTable::expire(unsigned long now, InflightRequest *first) {
+    uint8_t expired = 0;
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if ((long) (now - requests[i].deadline) >= 0) { // overflow safe
+            if (expired == 0 && first != nullptr) {
+                *first = requests[i];
+            }
+            expired++;
+        }
+        else {
+            requests[kept++] = requests[i];
+        }
+    }
+    count = kept;
+    return expired;
+}
+
+void InflightTable::clear() {
+    count = 0;
+}
+
+uint8_t InflightTable::getCount() {
+    return count;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+#define INFLIGHT_MAX_WINDOW 8 // max number of requests waiting for response
+
+struct InflightRequest {
+    uint16_t id;
+    uint16_t type;
+    unsigned long deadline; // ms
+};
+
+// Requests sent over a connection and waiting for their response, matched by message id. Lets several requests be
+// pipelined over one socket while each one keeps its own timeout.
+class InflightTable {
+    public:
+        InflightTable(uint8_t window = INFLIGHT_MAX_WINDOW);
+        void setWindow(uint8_t window);
+        uint8_t getWindow();
+
+        bool isFull();
+        bool add(uint16_t id, uint16_t type, unsigned long now, unsigned long timeout);
+        bool complete(uint16_t id, InflightRequest *request = nullptr); // false for unknown or already expired id
+        uint8_t expire(unsigned long now, InflightRequest *first = nullptr); // removes timed out requests and returns their count
+        void clear();
+        uint8_t getCount();
+
+    private:
+        InflightRequest requests[INFLIGHT_MAX_WINDOW];
+        uint8_t window;
+        uint8_t count = 0;
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "Arduino.h"
+#include "Sha256.h"
+
+// firmware image to update to, as announced by the update command
+struct OtaManifest {
+    String url; // host[:port]/path, plain HTTP
+    String deltaUrl; // patch from the running firmware, the full image at url is the fallback, empty when none
+    uint32_t size = 0; // bytes of the image as flashed (unpacked), 0 when not announced
+    bool hasDigest = false; // images are verified only when the digest was announced
+    uint8_t sha256[SHA256_DIGEST_SIZE];
+};
@@ -0,0 +1,525 @@
+#include "OtaStream.h"
+#include "hal/Hal.h"
+#include <string.h>
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define LOG_TAG ""
+#else
+#include "esp_log.h"
+static const char* LOG_TAG = "OtaStream";
+#endif
+
+#define OTA_CONTENT_TYPE "application/octet-stream"
+
+bool OtaStream::begin(const OtaManifest &manifest, TcpSocket *client) {
+    delta = !manifest.deltaUrl.isEmpty();
+    if (!parseUrl(manifest.url) || (delta && !parseUrl(manifest.deltaUrl))) {
+        return false;
+    }
+    fullUrl = manifest.url;
+
+    if (writing) {
+        halFirmwareAbort(); // previous update left unfinished
+        writing = false;
+    }
+    this->client = client;
+    expectedSize = manifest.size;
+    hasDigest = manifest.hasDigest;
+    memcpy(digest, manifest.sha256, SHA256_DIGEST_SIZE);
+    if (!hasDigest) {
+        ESP_LOGW(LOG_TAG, "No digest, image will not be verified");
+    }
+    connections = 0;
+    restart();
+    return true;
+}
+
+bool OtaStream::parseUrl(const String &url) {
+    String location = url;
+    if (location.startsWith("http://")) {
+        location = location.substring(7);
+    }
+    int pathIndex = location.indexOf('/');
+    if (pathIndex <= 0) {
+        return false;
+    }
+    host = location.substring(0, pathIndex);
+    path = location.substring(pathIndex);
+    port = 80;
+    int portIndex = host.indexOf(':');
+    if (portIndex != -1) {
+        port = host.substring(portIndex + 1).toInt();
+        host = host.substring(0, portIndex);
+    }
+    return !host.isEmpty() && port != 0;
+}
+
+void OtaStream::restart() {
+    for (Buffer &buffer : buffers) {
+        buffer.length = 0;
+        buffer.full.store(false, std::memory_order_relaxed);
+    }
+    fillIndex = 0;
+    flushIndex = 0;
+    pendingAck = 0;
+    totalBytes = 0;
+    receivedBytes = 0;
+    flushedBytes = 0;
+    headerLength = 0;
+    formatKnown = false;
+    packed = false;
+    payloadSize = 0;
+    payloadBytes = 0;
+    payloadHeaderLength = 0;
+    patching = false;
+    checkingSource = false;
+    sectorLength = 0;
+    imageSize = 0;
+    writtenBytes = 0;
+    attempts = 0;
+    sha256.begin();
+    connectTime = millis();
+    state = OTA_RESUMING; // connects right away
+}
+
+OtaState OtaStream::loop() {
+    flush();
+    if (checkingSource && getState() != OTA_FAILED) {
+        checkSource();
+    }
+
+    OtaState current = getState();
+    unsigned long now = millis();
+    if (current == OTA_RESUMING && (long) (now - connectTime) >= 0) {
+        if (!buffers[0].full.load(std::memory_order_acquire) && !buffers[1].full.load(std::memory_order_acquire)) {
+            connect();
+        }
+    }
+    else if (current == OTA_CONNECTING || current == OTA_REQUESTED || current == OTA_RECEIVING) {
+        if (current == OTA_RECEIVING && flushedBytes == totalBytes) {
+            if (!checkingSource) {
+                verify();
+            }
+        }
+        else if (now - dataTime >= OTA_RESPONSE_TIMEOUT) {
+            ESP_LOGW(LOG_TAG, "OTA server timeout");
+            client->close(true); // resumed once disconnected
+        }
+    }
+
+    if (getState() == OTA_FAILED && writing) {
+        halFirmwareAbort();
+        writing = false;
+    }
+    if (getState() == OTA_FAILED && delta) {
+        ESP_LOGW(LOG_TAG, "Delta update failed, downloading the full image");
+        delta = false;
+        parseUrl(fullUrl);
+        restart();
+    }
+    return getState();
+}
+
+void OtaStream::connect() {
+    parser.reset();
+    skipBytes = 0;
+    resumeOffset = receivedBytes;
+    dataTime = millis();
+    connections++;
+    state = OTA_CONNECTING;
+    if (resumeOffset > 0) {
+        ESP_LOGI(LOG_TAG, "Resuming OTA download: %u/%u", resumeOffset, (uint32_t) totalBytes);
+    }
+    if (!client->connect(host.c_str(), port)) {
+        retry();
+    }
+}
+
+void OtaStream::onConnected() {
+    uint8_t expected = OTA_CONNECTING;
+    if (!state.compare_exchange_strong(expected, OTA_REQUESTED)) {
+        return;
+    }
+    connection++;
+    dataTime = millis();
+
+    String request = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\nCache-Control: no-cache\r\n";
+    if (resumeOffset > 0) {
+        request += "Range: bytes=" + String(resumeOffset) + "-\r\n";
+    }
+    request += "Connection: close\r\n\r\n";
+    client->write(request.c_str());
+}
+
+void OtaStream::onData(const char *data, size_t length) {
+    dataTime = millis();
+    size_t consumed = 0;
+    if (getState() == OTA_REQUESTED) {
+        consumed = parser.feed(data, length);
+        if (parser.isInvalid()) {
+            ESP_LOGW(LOG_TAG, "Invalid response from OTA server");
+            fail();
+            return;
+        }
+        if (!parser.isComplete()) {
+            return;
+        }
+        if (!acceptResponse()) {
+            if (parser.getStatusCode() >= 500) {
+                client->close(true); // server trouble, tried again later
+            }
+            else {
+                fail();
+            }
+            return;
+        }
+        state = OTA_RECEIVING;
+    }
+    if (getState() == OTA_RECEIVING && store(data + consumed, length - consumed, consumed)) {
+        client->ackLater(); // once written to the flash, holds the server back meanwhile
+    }
+}
+
+void OtaStream::onDisconnected() {
+    OtaState current = getState();
+    if (current != OTA_CONNECTING && current != OTA_REQUESTED && current != OTA_RECEIVING) {
+        return;
+    }
+    if (current == OTA_RECEIVING && receivedBytes == totalBytes) {
+        return; // complete, verified by the loop
+    }
+    Buffer &buffer = buffers[fillIndex];
+    if (!buffer.full.load(std::memory_order_acquire) && buffer.length > 0) {
+        completeBuffer(); // keep what arrived, resumed after it
+    }
+    retry();
+}
+
+bool OtaStream::acceptResponse() {
+    uint16_t statusCode = parser.getStatusCode();
+    int32_t contentLength = parser.getContentLength();
+    uint32_t total;
+    if (statusCode == 206 && resumeOffset > 0 && parser.hasContentRange()) {
+        if ((uint32_t) parser.getRangeStart() != resumeOffset) {
+            ESP_LOGW(LOG_TAG, "Unexpected range from OTA server: %d", parser.getRangeStart());
+            return false;
+        }
+        total = parser.getRangeTotal() >= 0 ? parser.getRangeTotal() : resumeOffset + contentLength;
+    }
+    else if (statusCode == 200) {
+        total = contentLength;
+        skipBytes = resumeOffset; // range ignored, the whole image comes again
+    }
+    else {
+        ESP_LOGW(LOG_TAG, "Invalid response from OTA server: %d", statusCode);
+        return false;
+    }
+
+    if (contentLength <= 0 || parser.isChunked()) {
+        ESP_LOGW(LOG_TAG, "OTA response without length");
+        return false;
+    }
+    if (strcmp(parser.getContentType(), OTA_CONTENT_TYPE) != 0) {
+        ESP_LOGW(LOG_TAG, "Invalid firmware content type: %s", parser.getContentType());
+        return false;
+    }
+    if (statusCode == 206 && resumeOffset + contentLength != total) {
+        ESP_LOGW(LOG_TAG, "OTA range does not reach the end: %d", contentLength);
+        return false;
+    }
+    if (totalBytes > 0 && total != totalBytes) {
+        ESP_LOGW(LOG_TAG, "Firmware size changed: %u", total);
+        return false;
+    }
+    if (totalBytes == 0) {
+        ESP_LOGI(LOG_TAG, "Running OTA update: size=%u", total);
+    }
+    totalBytes = total;
+    return true;
+}
+
+bool OtaStream::store(const char *data, size_t length, size_t received) {
+    size_t unaccounted = received; // head and skipped bytes go with the data they came with
+    bool stored = false;
+    uint32_t total = totalBytes;
+    while (length > 0) {
+        if (skipBytes > 0) {
+            size_t part = skipBytes < length ? skipBytes : length;
+            skipBytes -= part;
+            unaccounted += part;
+            data += part;
+            length -= part;
+            continue;
+        }
+        uint32_t remaining = total - receivedBytes;
+        if (remaining == 0) {
+            break; // beyond the image, ignored
+        }
+        Buffer &buffer = buffers[fillIndex];
+        if (buffer.full.load(std::memory_order_acquire)) {
+            ESP_LOGW(LOG_TAG, "OTA buffers overflow");
+            client->close(true); // resumed from what is stored
+            return stored;
+        }
+        size_t part = _min(length, _min(OTA_BUFFER_SIZE - buffer.length, remaining));
+        memcpy(buffer.data + buffer.length, data, part);
+        buffer.length += part;
+        pendingAck += unaccounted + part;
+        unaccounted = 0;
+        stored = true;
+        receivedBytes += part;
+        data += part;
+        length -= part;
+        if (buffer.length == OTA_BUFFER_SIZE || receivedBytes == total) {
+            completeBuffer();
+        }
+    }
+    pendingAck += stored ? unaccounted + length : 0;
+    return stored;
+}
+
+void OtaStream::completeBuffer() {
+    Buffer &buffer = buffers[fillIndex];
+    buffer.ackLength = pendingAck;
+    buffer.connection = connection;
+    pendingAck = 0;
+    buffer.full.store(true, std::memory_order_release);
+    fillIndex ^= 1;
+}
+
+void OtaStream::flush() {
+    while (buffers[flushIndex].full.load(std::memory_order_acquire)) {
+        Buffer &buffer = buffers[flushIndex];
+        if (!writeBody(buffer.data, buffer.length)) {
+            fail();
+            return;
+        }
+        flushedBytes += buffer.length;
+        if (buffer.connection == connection && client->connected()) {
+            client->ack(buffer.ackLength); // let the server send more
+        }
+        buffer.length = 0;
+        buffer.full.store(false, std::memory_order_release);
+        flushIndex ^= 1;
+    }
+}
+
+bool OtaStream::writeBody(const uint8_t *data, size_t length) {
+    if (!formatKnown) {
+        // the header tells a compressed image, may come over several buffers
+        size_t part = _min(length, (size_t) OTA_PACKED_HEADER_SIZE - headerLength);
+        memcpy(header + headerLength, data, part);
+        headerLength += part;
+        data += part;
+        length -= part;
+        if (headerLength < OTA_PACKED_HEADER_SIZE && flushedBytes + part < totalBytes) {
+            return true;
+        }
+        formatKnown = true;
+        packed = headerLength == OTA_PACKED_HEADER_SIZE && memcmp(header, OTA_PACKED_MAGIC, 4) == 0;
+        if (packed) {
+            payloadSize = header[8] | (header[9] << 8) | (header[10] << 16) | ((uint32_t) header[11] << 24);
+            if (header[4] != OTA_PACKED_VERSION || !decoder.begin(header[5], header[6]) || payloadSize == 0) {
+                ESP_LOGE(LOG_TAG, "Unsupported compressed image: version=%d window=%d lookahead=%d", header[4], header[5], header[6]);
+                return false;
+            }
+        }
+        else {
+            payloadSize = totalBytes;
+            if (!writePayload(header, headerLength)) {
+                return false;
+            }
+        }
+    }
+    if (!packed) {
+        return writePayload(data, length);
+    }
+
+    uint8_t chunk[OTA_CHUNK_SIZE];
+    while (payloadBytes < payloadSize) {
+        size_t decoded = decoder.decode(data, length, chunk, _min((uint32_t) OTA_CHUNK_SIZE, payloadSize - payloadBytes));
+        if (decoded == 0) {
+            break; // needs more input, a long back reference goes on without
+        }
+        if (!writePayload(chunk, decoded)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OtaStream::writePayload(const uint8_t *data, size_t length) {
+    payloadBytes += length;
+    if (!writing) {
+        // the header tells a delta patch
+        size_t part = _min(length, (size_t) DELTA_HEADER_SIZE - payloadHeaderLength);
+        memcpy(payloadHeader + payloadHeaderLength, data, part);
+        payloadHeaderLength += part;
+        data += part;
+        length -= part;
+        if (payloadHeaderLength < DELTA_HEADER_SIZE && payloadBytes < payloadSize) {
+            return true;
+        }
+        patching = DeltaPatcher::isPatch(payloadHeader, payloadHeaderLength);
+        if (!beginImage()) {
+            return false;
+        }
+        if (!patching && !writeImage(payloadHeader, payloadHeaderLength)) {
+            return false;
+        }
+    }
+    if (!patching) {
+        return writeImage(data, length);
+    }
+
+    uint8_t chunk[OTA_CHUNK_SIZE];
+    while (length > 0 && writtenBytes + sectorLength < imageSize) {
+        size_t patched = patcher.apply(data, length, chunk, _min((uint32_t) OTA_CHUNK_SIZE, imageSize - writtenBytes - sectorLength));
+        if (patcher.isInvalid()) {
+            ESP_LOGE(LOG_TAG, "Invalid delta patch");
+            return false;
+        }
+        if (!writeImage(chunk, patched)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OtaStream::beginImage() {
+    if (patching) {
+        if (!patcher.begin(payloadHeader)) {
+            ESP_LOGE(LOG_TAG, "Unsupported delta patch: version=%d", payloadHeader[4]);
+            return false;
+        }
+        imageSize = patcher.getTargetSize();
+    }
+    else {
+        imageSize = payloadSize;
+    }
+    if (expectedSize > 0 && imageSize != expectedSize) {
+        ESP_LOGW(LOG_TAG, "Firmware size mismatch: %u", imageSize);
+        return false;
+    }
+    checkingSource = patching; // hashing the whole running firmware at once would block the loop for seconds
+    if (!halFirmwareBegin(imageSize)) {
+        ESP_LOGE(LOG_TAG, "Low space for OTA: size=%u", imageSize);
+        return false;
+    }
+    ESP_LOGI(LOG_TAG, "Flashing OTA image: size=%u packed=%d delta=%d", imageSize, packed, patching);
+    writing = true;
+    return true;
+}
+
+bool OtaStream::writeImage(const uint8_t *data, size_t length) {
+    while (length > 0) {
+        size_t part = _min(length, (size_t) OTA_BUFFER_SIZE - sectorLength);
+        memcpy(sector + sectorLength, data, part);
+        sectorLength += part;
+        data += part;
+        length -= part;
+        if (sectorLength == OTA_BUFFER_SIZE || writtenBytes + sectorLength == imageSize) {
+            sha256.update(sector, sectorLength);
+            if (!halFirmwareWrite(sector, sectorLength)) {
+                ESP_LOGE(LOG_TAG, "OTA flash write failed");
+                return false;
+            }
+            writtenBytes += sectorLength;
+            sectorLength = 0;
+        }
+    }
+    return true;
+}
+
+void OtaStream::checkSource() {
+    DeltaSourceCheck check = patcher.checkSource();
+    if (check == SOURCE_CHECKING) {
+        return;
+    }
+    checkingSource = false;
+    if (check == SOURCE_DIFFERS) {
+        ESP_LOGW(LOG_TAG, "Delta patch is not for the running firmware");
+        fail();
+    }
+}
+
+void OtaStream::verify() {
+    if (!writing || writtenBytes != imageSize) {
+        ESP_LOGE(LOG_TAG, "OTA image incomplete: %u/%u", writtenBytes, imageSize);
+        fail();
+        return;
+    }
+    uint8_t result[SHA256_DIGEST_SIZE];
+    sha256.finish(result);
+    if (hasDigest && memcmp(result, digest, SHA256_DIGEST_SIZE) != 0) {
+        ESP_LOGE(LOG_TAG, "OTA image digest mismatch");
+        fail();
+        return;
+    }
+    writing = false;
+    if (!halFirmwareEnd()) {
+        ESP_LOGE(LOG_TAG, "OTA image rejected");
+        fail();
+        return;
+    }
+    ESP_LOGI(LOG_TAG, "OTA image verified, %d connections", connections);
+    state = OTA_FINISHED;
+    client->close(true);
+}
+
+void OtaStream::retry() {
+    if (receivedBytes > resumeOffset) {
+        attempts = 0; // made progress
+    }
+    if (++attempts >= OTA_RESUME_ATTEMPTS) {
+        ESP_LOGE(LOG_TAG, "OTA download failed: %u/%u", (uint32_t) receivedBytes, (uint32_t) totalBytes);
+        state = OTA_FAILED;
+        return;
+    }
+    connectTime = millis() + OTA_RESUME_DELAY;
+    state = OTA_RESUMING;
+}
+
+void OtaStream::fail() {
+    state = OTA_FAILED;
+    if (client->connected() || client->connecting()) {
+        client->close(true);
+    }
+}
+
+OtaState OtaStream::getState() {
+    return (OtaState) state.load();
+}
+
+const char *OtaStream::getHost() {
+    return host.c_str();
+}
+
+uint16_t OtaStream::getPort() {
+    return port;
+}
+
+uint32_t OtaStream::getTotalBytes() {
+    return totalBytes;
+}
+
+uint32_t OtaStream::getReceivedBytes() {
+    return receivedBytes;
+}
+
+uint32_t OtaStream::getImageSize() {
+    return imageSize;
+}
+
+uint32_t OtaStream::getWrittenBytes() {
+    return writtenBytes;
+}
+
+uint8_t OtaStream::getConnections() {
+    return connections;
+}
+
+bool OtaStream::isDelta() {
+    return delta;
+}
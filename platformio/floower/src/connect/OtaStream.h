@@ -0,0 +1,134 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "Arduino.h"
+#include "hal/TcpSocket.h"
+#include "HttpResponseParser.h"
+#include "HeatshrinkDecoder.h"
+#include "DeltaPatcher.h"
+#include "OtaManifest.h"
+#include "Sha256.h"
+
+#define OTA_BUFFER_SIZE 4096 // bytes, a flash sector, must be under the TCP receive window
+#define OTA_RESPONSE_TIMEOUT 10000 // ms without data before the connection is dropped and resumed
+#define OTA_RESUME_DELAY 2000 // ms after the connection was lost
+#define OTA_RESUME_ATTEMPTS 5 // connections in a row without receiving any data
+#define OTA_PACKED_MAGIC "FLHS" // compressed image, see tools/ota-packer
+#define OTA_PACKED_VERSION 1
+#define OTA_PACKED_HEADER_SIZE 12 // magic, version, window bits, lookahead bits, pad, unpacked size
+#define OTA_CHUNK_SIZE 256 // bytes unpacked or patched at once
+
+enum OtaState {
+    OTA_IDLE,
+    OTA_CONNECTING,
+    OTA_REQUESTED, // waiting for the response head
+    OTA_RECEIVING,
+    OTA_RESUMING, // connection lost, connects again after a while
+    OTA_FINISHED, // image verified and bootable
+    OTA_FAILED
+};
+
+// Downloads a firmware image over HTTP into the OTA partition. The TCP task only parses the response and copies the
+// body into one of two sector buffers, the loop writes the full ones to the flash and hashes them. Data is
+// acknowledged once written, so the server never gets ahead of the flash by more than the TCP window. A lost
+// connection is resumed by a Range request from the last byte received and the image is checked against the digest of
+// the manifest before it is made bootable. A compressed image (see tools/ota-packer) is told by its header and
+// decompressed on the way to the flash, a delta patch is applied to the running firmware. The running firmware is
+// checked to be the base of the patch block by block over the loop passes while the patch goes on. When the delta
+// can't be applied, the full image is downloaded instead.
+class OtaStream {
+    public:
+        bool begin(const OtaManifest &manifest, TcpSocket *client); // false for invalid urls
+        OtaState loop();
+
+        // TCP task
+        void onConnected();
+        void onData(const char *data, size_t length);
+        void onDisconnected();
+
+        OtaState getState();
+        const char *getHost();
+        uint16_t getPort();
+        uint32_t getTotalBytes(); // 0 until the server told
+        uint32_t getReceivedBytes();
+        uint32_t getImageSize(); // bytes flashed, 0 until the header came
+        uint32_t getWrittenBytes();
+        uint8_t getConnections();
+        bool isDelta(); // downloading the delta, not fallen back to the full image
+
+    private:
+        struct Buffer {
+            uint8_t data[OTA_BUFFER_SIZE];
+            size_t length = 0;
+            size_t ackLength = 0; // bytes received meanwhile, acknowledged once the buffer is written
+            uint8_t connection = 0;
+            std::atomic<bool> full {false};
+        };
+
+        bool parseUrl(const String &url);
+        void restart();
+        void connect();
+        bool acceptResponse();
+        bool store(const char *data, size_t length, size_t received);
+        void completeBuffer();
+        void flush();
+        bool writeBody(const uint8_t *data, size_t length);
+        bool writePayload(const uint8_t *data, size_t length);
+        bool beginImage();
+        bool writeImage(const uint8_t *data, size_t length);
+        void checkSource();
+        void verify();
+        void retry();
+        void fail();
+
+        TcpSocket *client = nullptr;
+        String host;
+        String path;
+        uint16_t port = 80;
+        String fullUrl; // fallback of the delta
+        bool delta = false;
+        uint32_t expectedSize = 0;
+        bool hasDigest = false;
+        uint8_t digest[SHA256_DIGEST_SIZE];
+
+        std::atomic<uint8_t> state {OTA_IDLE};
+        std::atomic<uint8_t> connection {0};
+        std::atomic<unsigned long> connectTime {0};
+        std::atomic<unsigned long> dataTime {0};
+        std::atomic<uint32_t> totalBytes {0};
+        std::atomic<uint32_t> receivedBytes {0};
+        uint8_t attempts = 0;
+        uint8_t connections = 0;
+
+        // TCP task
+        HttpResponseParser parser;
+        Buffer buffers[2];
+        uint8_t fillIndex = 0;
+        uint32_t resumeOffset = 0; // first byte requested over the connection
+        uint32_t skipBytes = 0; // sent again by a server not honoring the range
+        size_t pendingAck = 0; // deferred bytes not accounted to a buffer yet
+
+        // loop
+        Sha256 sha256;
+        uint8_t flushIndex = 0;
+        uint32_t flushedBytes = 0; // body bytes taken from the buffers
+        uint8_t header[OTA_PACKED_HEADER_SIZE];
+        uint8_t headerLength = 0;
+        bool formatKnown = false; // packed or not
+        bool packed = false;
+        HeatshrinkDecoder decoder;
+        uint32_t payloadSize = 0; // unpacked body
+        uint32_t payloadBytes = 0;
+        uint8_t payloadHeader[DELTA_HEADER_SIZE];
+        uint8_t payloadHeaderLength = 0;
+        bool patching = false;
+        DeltaPatcher patcher;
+        bool checkingSource = false; // image is not verified until the patch is known to fit the running firmware
+        uint8_t sector[OTA_BUFFER_SIZE]; // written to the flash at once
+        size_t sectorLength = 0;
+        uint32_t imageSize = 0;
+        uint32_t writtenBytes = 0;
+        bool writing = false; // OTA partition begun
+};
@@ -1,9 +1,12 @@
 #include "RemoteControl.h"
+#include "BluetoothConnect.h"
+#include "CommandProtocol.h"
+#include "WifiConnect.h"
 
 RemoteControl::RemoteControl(BluetoothConnect *bluetoothConnect, WifiConnect *wifiConnect, CommandProtocol *cmdInterpreter):
         bluetoothConnect(bluetoothConnect), wifiConnect(wifiConnect), cmdInterpreter(cmdInterpreter) {
     cmdInterpreter->onControlCommand([=]() { fireRemoteControl(); });
-    cmdInterpreter->onRunOTAUpdate([=](String firmwareUrl) { fireRunUpdate(firmwareUrl); });
+    cmdInterpreter->onRunOTAUpdate([=](const OtaManifest &manifest) { fireRunUpdate(manifest); });
 }
 
 void RemoteControl::onRemoteControl(RemoteControlCallback callback) {
@@ -44,13 +47,38 @@ bool RemoteControl::isWifiEnabled() {
     return wifiConnect->isEnabled();
 }
 
+void RemoteControl::planIdle(IdleScheduler &scheduler) {
+    if (bluetoothConnect->isEnabled() || wifiConnect->isEnabled()) {
+        // commands arrive from the radio tasks without waking up the loop, poll for them
+        scheduler.wakeIn(REMOTE_POLL_INTERVAL);
+    }
+    if (bluetoothConnect->isInitialized() || wifiConnect->isEnabled()) {
+        scheduler.preventLightSleep();
+    }
+}
+
+void RemoteControl::accountEnergy(EnergyLedger &energyLedger) {
+    uint8_t bluetoothState = BLUETOOTH_OFF;
+    if (bluetoothConnect->isConnected()) {
+        bluetoothState = BLUETOOTH_CONNECTED;
+    }
+    else if (bluetoothConnect->isAdvertising()) {
+        bluetoothState = BLUETOOTH_ADVERTISING;
+    }
+    else if (bluetoothConnect->isInitialized()) {
+        bluetoothState = BLUETOOTH_IDLE;
+    }
+    energyLedger.setState(ENERGY_BLUETOOTH, bluetoothState);
+    energyLedger.setState(ENERGY_WIFI, wifiConnect->isEnabled() ? POWER_ON : POWER_OFF);
+}
+
 void RemoteControl::updateStatusData(uint8_t batteryLevel, bool batteryCharging) {
     wifiConnect->updateStatusData(batteryLevel, batteryCharging);
     bluetoothConnect->updateStatusData(batteryLevel, batteryCharging, wifiConnect->getStatus());
 }
 
-void RemoteControl::runUpdate(String firmwareUrl) {
-    wifiConnect->startOTAUpdate(firmwareUrl);
+void RemoteControl::runUpdate(const OtaManifest &manifest) {
+    wifiConnect->startOTAUpdate(manifest);
 }
 
 bool RemoteControl::isUpdateRunning() {
@@ -61,8 +89,8 @@ void RemoteControl::onRunUpdate(RunUpdateCallback callback) {
     runUpdateCallback = callback;
 }
 
-void RemoteControl::fireRunUpdate(String firmwareUrl) {
+void RemoteControl::fireRunUpdate(const OtaManifest &manifest) {
     if (runUpdateCallback != nullptr) {
-        runUpdateCallback(firmwareUrl);
+        runUpdateCallback(manifest);
     }
 }
\ No newline at end of file
@@ -3,12 +3,16 @@
 #include "Arduino.h"
 #include "Config.h"
 #include "hardware/Floower.h"
-#include "BluetoothConnect.h"
-#include "CommandProtocol.h"
-#include "WifiConnect.h"
+#include "OtaManifest.h"
+
+#define REMOTE_POLL_INTERVAL 10 // ms
+
+class BluetoothConnect;
+class WifiConnect;
+class CommandProtocol;
 
 typedef std::function<void()> RemoteControlCallback;
-typedef std::function<void(String firmwareUrl)> RunUpdateCallback;
+typedef std::function<void(const OtaManifest &manifest)> RunUpdateCallback;
 
 class RemoteControl {
     public:
@@ -22,10 +26,12 @@ class RemoteControl {
         void enableWifi();
         void disableWifi();
         bool isWifiEnabled();
+        void planIdle(IdleScheduler &scheduler);
+        void accountEnergy(EnergyLedger &energyLedger); // radio states change on their own tasks, polled by the loop
         void updateStatusData(uint8_t batteryLevel, bool batteryCharging);
 
         void onRunUpdate(RunUpdateCallback callback);
-        void runUpdate(String firmwareUrl);
+        void runUpdate(const OtaManifest &manifest);
         bool isUpdateRunning();
 
     private:
@@ -36,5 +42,5 @@ class RemoteControl {
         RunUpdateCallback runUpdateCallback;
 
         void fireRemoteControl();
-        void fireRunUpdate(String firmwareUrl);
+        void fireRunUpdate(const OtaManifest &manifest);
 };
\ No newline at end of file
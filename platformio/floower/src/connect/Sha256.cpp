@@ -0,0 +1,142 @@
+#include "Sha256.h"
+#include <string.h>
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+Sha256::Sha256() {
+    begin();
+}
+
+void Sha256::begin() {
+    state[0] = 0x6a09e667;
+    state[1] = 0xbb67ae85;
+    state[2] = 0x3c6ef372;
+    state[3] = 0xa54ff53a;
+    state[4] = 0x510e527f;
+    state[5] = 0x9b05688c;
+    state[6] = 0x1f83d9ab;
+    state[7] = 0x5be0cd19;
+    length = 0;
+    blockLength = 0;
+}
+
+void Sha256::update(const uint8_t *data, size_t length) {
+    this->length += length;
+    if (blockLength > 0) {
+        size_t part = SHA256_BLOCK_SIZE - blockLength;
+        part = part < length ? part : length;
+        memcpy(block + blockLength, data, part);
+        blockLength += part;
+        data += part;
+        length -= part;
+        if (blockLength < SHA256_BLOCK_SIZE) {
+            return;
+        }
+        transform(block);
+        blockLength = 0;
+    }
+    // whole blocks straight from the data
+    while (length >= SHA256_BLOCK_SIZE) {
+        transform(data);
+        data += SHA256_BLOCK_SIZE;
+        length -= SHA256_BLOCK_SIZE;
+    }
+    memcpy(block, data, length);
+    blockLength = length;
+}
+
+void Sha256::finish(uint8_t *digest) {
+    uint64_t bits = length * 8;
+    block[blockLength++] = 0x80;
+    if (blockLength > SHA256_BLOCK_SIZE - 8) {
+        memset(block + blockLength, 0, SHA256_BLOCK_SIZE - blockLength);
+        transform(block);
+        blockLength = 0;
+    }
+    memset(block + blockLength, 0, SHA256_BLOCK_SIZE - 8 - blockLength);
+    for (uint8_t i = 0; i < 8; i++) {
+        block[SHA256_BLOCK_SIZE - 1 - i] = bits >> (i * 8);
+    }
+    transform(block);
+
+    for (uint8_t i = 0; i < 8; i++) {
+        digest[i * 4] = state[i] >> 24;
+        digest[i * 4 + 1] = state[i] >> 16;
+        digest[i * 4 + 2] = state[i] >> 8;
+        digest[i * 4 + 3] = state[i];
+    }
+}
+
+bool Sha256::parseHex(const char *hex, uint8_t *digest) {
+    if (hex == nullptr || strlen(hex) != SHA256_DIGEST_SIZE * 2) {
+        return false;
+    }
+    for (uint8_t i = 0; i < SHA256_DIGEST_SIZE * 2; i++) {
+        char c = hex[i];
+        uint8_t nibble;
+        if (c >= '0' && c <= '9') {
+            nibble = c - '0';
+        }
+        else if (c >= 'a' && c <= 'f') {
+            nibble = c - 'a' + 10;
+        }
+        else if (c >= 'A' && c <= 'F') {
+            nibble = c - 'A' + 10;
+        }
+        else {
+            return false;
+        }
+        digest[i / 2] = (i % 2 == 0) ? nibble << 4 : digest[i / 2] | nibble;
+    }
+    return true;
+}
+
+void Sha256::transform(const uint8_t *block) {
+    uint32_t w[64];
+    for (uint8_t i = 0; i < 16; i++) {
+        w[i] = ((uint32_t) block[i * 4] << 24) | ((uint32_t) block[i * 4 + 1] << 16) | ((uint32_t) block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    }
+    for (uint8_t i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (uint8_t i = 0; i < 64; i++) {
+        uint32_t s1 = ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + ch + K[i] + w[i];
+        uint32_t s0 = ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SHA256_DIGEST_SIZE 32 // bytes
+#define SHA256_BLOCK_SIZE 64
+
+// Incremental SHA-256, the digest of a stream is built chunk by chunk as it arrives.
+class Sha256 {
+    public:
+        Sha256();
+        void begin();
+        void update(const uint8_t *data, size_t length);
+        void finish(uint8_t *digest); // SHA256_DIGEST_SIZE bytes, begin() again to hash another stream
+
+        static bool parseHex(const char *hex, uint8_t *digest); // 64 hex digits
+
+    private:
+        void transform(const uint8_t *block);
+
+        uint32_t state[8];
+        uint64_t length; // bytes hashed
+        uint8_t block[SHA256_BLOCK_SIZE];
+        uint8_t blockLength;
+};
@@ -0,0 +1,86 @@
+#include "StatePublisher.h"
+
+StatePublisher::StatePublisher(unsigned long minInterval, StatePublishCallback callback)
+        : minInterval(minInterval), callback(callback) {
+}
+
+void StatePublisher::setMinInterval(unsigned long minInterval) {
+    this->minInterval = minInterval;
+}
+
+void StatePublisher::publish(int8_t petalsOpenLevel, HsbColor hsbColor) {
+    if (pending) {
+        suppressedCount++; // replaced by the newer state before being sent
+    }
+    pending = true;
+    pendingPetalsOpenLevel = petalsOpenLevel;
+    pendingColor = hsbColor;
+    update();
+}
+
+void StatePublisher::update() {
+    if (!pending || (long) (millis() - getDueTime()) < 0) {
+        return;
+    }
+    if (!isChanged(pendingPetalsOpenLevel, RgbColor(pendingColor))) {
+        pending = false;
+        suppressedCount++; // nothing new for the listeners
+    }
+    else if (send()) {
+        pending = false;
+    }
+}
+
+void StatePublisher::invalidate() {
+    sentValid = false;
+    rejected = false; // e.g. the transport just connected, try right away
+}
+
+void StatePublisher::planIdle(IdleScheduler &scheduler) {
+    if (pending) {
+        scheduler.wakeAt(getDueTime());
+    }
+}
+
+bool StatePublisher::isPending() {
+    return pending;
+}
+
+uint32_t StatePublisher::getSentCount() {
+    return sentCount;
+}
+
+uint32_t StatePublisher::getSuppressedCount() {
+    return suppressedCount;
+}
+
+uint32_t StatePublisher::getRejectedCount() {
+    return rejectedCount;
+}
+
+bool StatePublisher::isChanged(int8_t petalsOpenLevel, RgbColor color) {
+    return !sentValid || petalsOpenLevel != sentPetalsOpenLevel || color != sentColor;
+}
+
+unsigned long StatePublisher::getDueTime() {
+    if (rejected) {
+        return rejectedTime + minInterval;
+    }
+    return sentValid ? sentTime + minInterval : millis();
+}
+
+bool StatePublisher::send() {
+    if (callback == nullptr || !callback(pendingPetalsOpenLevel, pendingColor)) {
+        rejected = true;
+        rejectedTime = millis();
+        rejectedCount++;
+        return false;
+    }
+    rejected = false;
+    sentValid = true;
+    sentPetalsOpenLevel = pendingPetalsOpenLevel;
+    sentColor = RgbColor(pendingColor);
+    sentTime = millis();
+    sentCount++;
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Arduino.h"
+#include "NeoPixelBus.h"
+#include "IdleScheduler.h"
+#include <functional>
+
+typedef std::function<bool(int8_t petalsOpenLevel, HsbColor hsbColor)> StatePublishCallback; // false when the transport did not take it
+
+// Coalesces state changes for one transport. Publishes at most once per min interval, the latest state wins and
+// state with the same level and RGB color as the last sent one is not published at all. State the transport did not
+// take is kept pending and tried again once per min interval.
+class StatePublisher {
+    public:
+        StatePublisher(unsigned long minInterval, StatePublishCallback callback);
+        void setMinInterval(unsigned long minInterval);
+        void publish(int8_t petalsOpenLevel, HsbColor hsbColor);
+        void update(); // sends the pending state once the interval passed, call periodically
+        void invalidate(); // next state gets sent even if unchanged, e.g. on new connection
+        void planIdle(IdleScheduler &scheduler);
+
+        bool isPending();
+        uint32_t getSentCount();
+        uint32_t getSuppressedCount(); // replaced by a newer state or unchanged
+        uint32_t getRejectedCount(); // attempts the transport did not take
+
+    private:
+        bool isChanged(int8_t petalsOpenLevel, RgbColor color);
+        unsigned long getDueTime();
+        bool send();
+
+        unsigned long minInterval;
+        StatePublishCallback callback;
+
+        bool pending = false;
+        int8_t pendingPetalsOpenLevel;
+        HsbColor pendingColor;
+
+        bool sentValid = false;
+        int8_t sentPetalsOpenLevel;
+        RgbColor sentColor;
+        unsigned long sentTime = 0;
+        bool rejected = false; // last attempt, retried after the interval
+        unsigned long rejectedTime = 0;
+
+        uint32_t sentCount = 0;
+        uint32_t suppressedCount = 0;
+        uint32_t rejectedCount = 0;
+};
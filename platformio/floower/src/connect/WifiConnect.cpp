@@ -1,5 +1,4 @@
 #include "WifiConnect.h"
-#include <Update.h>
 #include <esp_task_wdt.h>
 #include <esp_wifi.h>
 
@@ -24,18 +23,14 @@ static const char* LOG_TAG = "WifiConnect";
 
 // ota state
 #define STATE_OTA_UPDATE_PREPARING 10
-#define STATE_OTA_UPDATE_READY 11
-#define STATE_OTA_UPDATE_CONNECTING 12
-#define STATE_OTA_UPDATE_CONNECTED 13
-#define STATE_OTA_UPDATE_HEADER 14
-#define STATE_OTA_UPDATE_DATA 15
+#define STATE_OTA_UPDATE_RUNNING 11
 
 // running mode
 #define MODE_FLOUD 0
 #define MODE_OTA_UPDATE 1
 
-#define OTA_UPDATE_RESPONSE_TIMEOUT_MS 10000
-#define SOCKET_RESPONSE_TIMEOUT_MS 2000
+#define FLOUD_INFLIGHT_WINDOW 4 // requests pipelined over the socket, state updates wait for a free slot then
+#define MAX_MESSAGES_PER_LOOP 8 // handle bursts of commands without starving the rest of the loop
 
 #define RECONNECT_INTERVAL_MS 3000
 #define CONNECT_RETRY_INTERVAL_MS 30000
@@ -45,6 +40,7 @@ WifiConnect::WifiConnect(Config *config, CommandProtocol *cmdProtocol)
     mode = MODE_FLOUD;
     state = STATE_FLOUD_DISCONNECTED;
     client = NULL;
+    inflight.setWindow(FLOUD_INFLIGHT_WINDOW);
 }
 
 void WifiConnect::setup() {
@@ -111,17 +107,45 @@ void WifiConnect::reconnect() {
 
 void WifiConnect::updateStatusData(uint8_t batteryLevel, bool batteryCharging) {
     if (enabled && state == STATE_FLOUD_AUTHORIZED) {
-        uint16_t payloadSize = 0;
-        uint16_t type = cmdProtocol->sendStatus(batteryLevel, batteryCharging, sendBuffer, &payloadSize);
-        sendRequest(type, receivedMessage.id, sendBuffer, payloadSize);
+        if (statusPending) {
+            droppedUpdates++; // older status never left, the newer one replaces it
+            ESP_LOGW(LOG_TAG, "Status replaced, too many requests in flight (%d dropped)", droppedUpdates);
+        }
+        statusPending = true;
+        pendingBatteryLevel = batteryLevel;
+        pendingBatteryCharging = batteryCharging;
+        sendPendingUpdates();
     }
 }
 
-void WifiConnect::updateFloowerState(int8_t petalsOpenLevel, HsbColor hsbColor) {
+bool WifiConnect::updateFloowerState(int8_t petalsOpenLevel, HsbColor hsbColor) {
     if (enabled && state == STATE_FLOUD_AUTHORIZED) {
+        if (floowerStatePending) {
+            droppedUpdates++;
+            ESP_LOGW(LOG_TAG, "State replaced, too many requests in flight (%d dropped)", droppedUpdates);
+        }
+        floowerStatePending = true;
+        pendingPetalsOpenLevel = petalsOpenLevel;
+        pendingColor = hsbColor;
+        sendPendingUpdates();
+        return true; // sent or waiting for the window
+    }
+    return false;
+}
+
+void WifiConnect::sendPendingUpdates() {
+    // only the latest state and status wait for a free slot of the in flight window, older ones are worthless
+    if (floowerStatePending && !inflight.isFull()) {
+        uint16_t payloadSize = 0;
+        uint16_t type = cmdProtocol->sendState(pendingPetalsOpenLevel, pendingColor, sendBuffer, &payloadSize, codec);
+        sendRequest(type, sendBuffer, payloadSize);
+        floowerStatePending = false;
+    }
+    if (statusPending && !inflight.isFull()) {
         uint16_t payloadSize = 0;
-        uint16_t type = cmdProtocol->sendState(petalsOpenLevel, hsbColor, sendBuffer, &payloadSize);
-        sendRequest(type, receivedMessage.id, sendBuffer, payloadSize);
+        uint16_t type = cmdProtocol->sendStatus(pendingBatteryLevel, pendingBatteryCharging, sendBuffer, &payloadSize);
+        sendRequest(type, sendBuffer, payloadSize);
+        statusPending = false;
     }
 }
 
@@ -148,10 +172,10 @@ uint8_t WifiConnect::getStatus() {
 
 void WifiConnect::ensureClient() {
     if (client == NULL) {
-        client = new AsyncClient(NULL);
-        client->onData([=](void* arg, AsyncClient* client, void *data, size_t len){ onSocketData((char *)data, len); });
-        client->onConnect([=](void* arg, AsyncClient* client){ onSocketConnected(); });
-        client->onDisconnect([=](void* arg, AsyncClient* client){ onSocketDisconnected(); });
+        client = new TcpSocket(NULL);
+        client->onData([=](void* arg, TcpSocket* client, void *data, size_t len){ onSocketData((char *)data, len); });
+        client->onConnect([=](void* arg, TcpSocket* client){ onSocketConnected(); });
+        client->onDisconnect([=](void* arg, TcpSocket* client){ onSocketDisconnected(); });
     }
 }
 
@@ -169,6 +193,7 @@ void WifiConnect::loop() {
                         if (reconnectTime <= millis()) {
                             ESP_LOGI(LOG_TAG, "Connecting to Floud");
                             ensureClient();
+                            inflight.clear(); // responses of the previous connection never come
                             client->connect(FLOUD_HOST, FLOUD_PORT);
                             reconnectTime = millis() + CONNECT_RETRY_INTERVAL_MS;
                             state = STATE_FLOUD_CONNECTING;
@@ -181,32 +206,31 @@ void WifiConnect::loop() {
                 }
             }
         } 
-        else if (mode == MODE_OTA_UPDATE) {
-            switch (state) {
-                case STATE_OTA_UPDATE_READY:
-                    ensureClient();
-                    client->connect(updateFirmwareHost.c_str(), 80);
-                    state = STATE_OTA_UPDATE_CONNECTING;
-                    break;
-                case STATE_OTA_UPDATE_CONNECTED:
-                    requestOTAUpdateData();
-                    break;
-            }
-        }
     }
     else if (reconnectTime > 0 && reconnectTime <= millis()) {
         reconnectTime = millis() + CONNECT_RETRY_INTERVAL_MS;
         reconnect();
     }
 
-    if (received) {
-        // got message to process   
+    if (mode == MODE_OTA_UPDATE && state == STATE_OTA_UPDATE_RUNNING) {
+        runOTAUpdate(); // keeps writing what was received while the WiFi is down
+    }
+
+    uint8_t handled = 0;
+    while (handled < MAX_MESSAGES_PER_LOOP && frames.next(receivedMessage, receiveBuffer)) {
+        // got message to process
         handleReceivedMessage();
-        received = false;
+        handled++;
+    }
+
+    if (state == STATE_FLOUD_AUTHORIZED) {
+        sendPendingUpdates(); // responses received above may have freed the window
     }
-    else if (receiveTime > 0 && receiveTime <= millis()) {
+
+    InflightRequest expired;
+    if (inflight.expire(millis(), &expired) > 0) {
         // did not received resposne
-        ESP_LOGW(LOG_TAG, "Floud response timeout");
+        ESP_LOGW(LOG_TAG, "Floud response timeout: %d/%d", expired.type, expired.id);
         socketReconnect();
     }
 }
@@ -215,6 +239,10 @@ void WifiConnect::handleReceivedMessage() {
     ESP_LOGI(LOG_TAG, "Got message: %d/%d/%d", receivedMessage.type, receivedMessage.id, receivedMessage.length);
     
     // check for response codes
+    if (receivedMessage.type <= CommandType::STATUS_UNSUPPORTED && !inflight.complete(receivedMessage.id)) {
+        ESP_LOGW(LOG_TAG, "Unexpected response: %d", receivedMessage.id);
+    }
+
     if (receivedMessage.type == CommandType::STATUS_ERROR) {
         socketReconnect(); // reset on error
     }
@@ -223,6 +251,9 @@ void WifiConnect::handleReceivedMessage() {
             ESP_LOGI(LOG_TAG, "Authorized");
             authorizationFailed = false;
             state = STATE_FLOUD_AUTHORIZED;
+            if (connectedCallback != nullptr) {
+                connectedCallback();
+            }
         }
     }
     else if (receivedMessage.type == CommandType::STATUS_UNAUTHORIZED) {
@@ -233,14 +264,13 @@ void WifiConnect::handleReceivedMessage() {
     else if (state == STATE_FLOUD_AUTHORIZED) {
         // handle commands
         uint16_t responseSize = 0;
-        uint16_t responseType = cmdProtocol->run(receivedMessage.type, receiveBuffer, receivedMessage.length, sendBuffer, &responseSize);
+        uint16_t responseType = cmdProtocol->run(receivedMessage.type, receiveBuffer, receivedMessage.length, sendBuffer, &responseSize, &codec);
         sendMessage(responseType, receivedMessage.id, sendBuffer, responseSize);
     }
 }
 
 void WifiConnect::socketReconnect() {
-    receiveTime = 0;
-    received = false;
+    inflight.clear();
     if (client != NULL) {
         client->stop();
     }
@@ -253,17 +283,19 @@ void WifiConnect::sendAuthorization() {
     authorizationMessageId = sendRequest(CommandType::PROTOCOL_AUTH, sendBuffer, token.length()); // dont send the 0 terminate char
 }
 
-uint16_t WifiConnect::sendRequest(const uint16_t type, const char* payload, const size_t payloadSize) {
+uint16_t WifiConnect::sendRequest(const uint16_t type, const char* payload, const size_t payloadSize, const unsigned long timeout) {
+    if (inflight.isFull()) {
+        return 0;
+    }
     uint16_t messageId = messageIdCounter++;
-    sendRequest(type, messageId, payload, payloadSize);
+    if (messageIdCounter == 0) {
+        messageIdCounter = 1; // 0 means not sent
+    }
+    inflight.add(messageId, type, millis(), timeout);
+    sendMessage(type, messageId, payload, payloadSize);
     return messageId;
 }
 
-void WifiConnect::sendRequest(const uint16_t type, const uint16_t id, const char* payload, const size_t payloadSize) {
-    sendMessage(type, id, payload, payloadSize);
-    receiveTime = millis() + SOCKET_RESPONSE_TIMEOUT_MS;
-}
-
 void WifiConnect::sendMessage(const uint16_t type, const uint16_t id, const char* payload, const size_t payloadSize) {
     CommandMessageHeader header = {
         htons(type), htons(id), htons(payloadSize)
@@ -275,37 +307,15 @@ void WifiConnect::sendMessage(const uint16_t type, const uint16_t id, const char
 }
 
 void WifiConnect::receiveMessage(char *data, size_t len) {
-    if (received) {
-        return; // cannot receive another message yet
-    }
-
-    size_t headerSize = sizeof(receivedMessage);
-    if (len < headerSize) {
-        return; // cannot receive
-    }
-    
-    memcpy(&receivedMessage, data, headerSize);
-    receivedMessage.type = ntohs(receivedMessage.type);
-    receivedMessage.id = ntohs(receivedMessage.id);
-    receivedMessage.length = ntohs(receivedMessage.length);
-
-    if (receivedMessage.length > 0) {
-        size_t available = len - headerSize;
-        if (available > MAX_MESSAGE_PAYLOAD_BYTES) {
-            // invalid package, reset
-            socketReconnect();
-        }
-        else if (available >= receivedMessage.length) {
-            // receive payload
-            memcpy(receiveBuffer, data + headerSize, receivedMessage.length);
-            received = true;
-            receiveTime = 0;
-        }
-        // else invalid packet, payload incomplete or missing
-    }
-    else {
-        received = true;
-        receiveTime = 0;
+    // TCP may split a message or coalesce several into one packet, reassemble them and queue for the loop
+    FrameStatus status = frames.feed(data, len);
+    if (status == FRAME_INVALID) {
+        ESP_LOGW(LOG_TAG, "Invalid message, reconnecting");
+        client->stop(); // in flight requests are owned by the loop, cleared there on connect
+    }
+    else if (status == FRAME_OVERFLOW) {
+        ESP_LOGW(LOG_TAG, "Receive buffer overflow, reconnecting");
+        client->stop();
     }
 }
 
@@ -313,8 +323,8 @@ void WifiConnect::onSocketData(char *data, size_t len) {
     if (mode == MODE_FLOUD) {
         receiveMessage(data, len);
     }
-    else if (mode == MODE_OTA_UPDATE) {
-        receiveOTAUpdateData(data, len);
+    else if (state == STATE_OTA_UPDATE_RUNNING) {
+        otaStream.onData(data, len);
     }
 }
 
@@ -322,11 +332,13 @@ void WifiConnect::onSocketConnected() {
     if (mode == MODE_FLOUD) {
         ESP_LOGI(LOG_TAG, "Connected to Floud");
         reconnectTime = 0;
+        codec = COMMAND_CODEC_MSGPACK; // until negotiated again
+        frames.discardPartial(); // leftovers of the previous connection
         state = STATE_FLOUD_ESTABLISHED;
     }
-    else if (mode == MODE_OTA_UPDATE) {
+    else if (state == STATE_OTA_UPDATE_RUNNING) {
         ESP_LOGI(LOG_TAG, "Connected to OTA server");
-        state = STATE_OTA_UPDATE_CONNECTED;
+        otaStream.onConnected();
     }
 }
 
@@ -344,16 +356,11 @@ void WifiConnect::onSocketDisconnected() {
     }
     else if (mode == MODE_OTA_UPDATE) {
         if (state == STATE_OTA_UPDATE_PREPARING) {
-            state = STATE_OTA_UPDATE_READY;
-        }
-        else if (state == STATE_OTA_UPDATE_DATA) {
-            ESP_LOGI(LOG_TAG, "OTA data received");
-            finalizeOTAUpdate();
+            state = STATE_OTA_UPDATE_RUNNING; // disconnected from floud
         }
         else {
             ESP_LOGI(LOG_TAG, "Disconnected from OTA server");
-            mode = MODE_FLOUD;
-            state = STATE_FLOUD_DISCONNECTED;
+            otaStream.onDisconnected();
         }
     }
 }
@@ -389,130 +396,47 @@ void WifiConnect::onWifiGotIp(WiFiEvent_t event, WiFiEventInfo_t info) {
 
 // OTA
 
+void WifiConnect::onConnected(ConnectedCallback callback) {
+    connectedCallback = callback;
+}
+
 bool WifiConnect::isOTAUpdateRunning() {
     return mode == MODE_OTA_UPDATE;
 }
 
-void WifiConnect::startOTAUpdate(String firmwareUrl) {
+void WifiConnect::startOTAUpdate(const OtaManifest &manifest) {
     if (WiFi.status() == WL_CONNECTED) {
-        ESP_LOGI(LOG_TAG, "Staring OTA update: %s", firmwareUrl.c_str());
-        String host, path;
-
-        int hostIndex = firmwareUrl.indexOf('/');
-        if (hostIndex != -1) {
-            host = firmwareUrl.substring(0, hostIndex);
-            path = firmwareUrl.substring(hostIndex);
-        }
-
-        if (host.isEmpty() || path.isEmpty()) {
-            ESP_LOGI(LOG_TAG, "Invalid firmware url: %s", firmwareUrl.c_str());
+        ESP_LOGI(LOG_TAG, "Staring OTA update: %s", manifest.url.c_str());
+        ensureClient();
+        if (!otaStream.begin(manifest, client)) {
+            ESP_LOGI(LOG_TAG, "Invalid firmware url: %s", manifest.url.c_str());
             return;
         }
 
         mode = MODE_OTA_UPDATE;
-        receiveTime = 0;
-        received = false;
-        updateFirmwareHost = host;
-        updateFirmwarePath = path;
+        inflight.clear();
+        frames.clear();
 
-        if (client != NULL && (client->connecting() || client->connected())) {
+        if (client->connecting() || client->connected()) {
             state = STATE_OTA_UPDATE_PREPARING;
             client->stop(); // disconnect from floud and wait for confirm
         }
         else {
-            state = STATE_OTA_UPDATE_READY;
+            state = STATE_OTA_UPDATE_RUNNING;
         }
     }
 }
 
-void WifiConnect::requestOTAUpdateData() {
-    state = STATE_OTA_UPDATE_HEADER;
-
-    ESP_LOGI(LOG_TAG, "Requesting OTA update: host=%s path=%s", updateFirmwareHost.c_str(), updateFirmwarePath.c_str());
-    client->write(String("GET " + updateFirmwarePath + " HTTP/1.1\r\n").c_str());
-    client->write(String("Host: " + updateFirmwareHost + "\r\n").c_str());
-    client->write("Cache-Control: no-cache\r\n");
-    client->write("Connection: close\r\n\r\n");
-}
-
-inline String getHeaderValue(String header, String headerName) {
-    return header.substring(strlen(headerName.c_str()));
-}
-
-void WifiConnect::receiveOTAUpdateData(char *data, size_t len) {
-    if (state == STATE_OTA_UPDATE_HEADER) {
-        int contentLength = 0;
-        bool isValidContentType = false;
-        bool isSuccess = false;
-        String line;
-
-        char *token = strtok(data, "\n");
-        while (token) {
-            line = String(token);
-            line.trim();
-            
-            if (line.startsWith("HTTP/1.1")) {
-                if (line.indexOf("200") != -1) {
-                    isSuccess = true;
-                }
-                else {
-                    ESP_LOGE(LOG_TAG, "Invalid reponse from server: %s", line.c_str());
-                }
-            }
-            else if (line.startsWith("Content-Length: ")) {
-                contentLength = atoi((getHeaderValue(line, "Content-Length: ")).c_str());
-                ESP_LOGI(LOG_TAG, "Firmware size: %d", contentLength);
-            }
-            else if (line.startsWith("Content-Type: ")) {
-                String contentType = getHeaderValue(line, "Content-Type: ");
-                ESP_LOGI(LOG_TAG, "Content type: %s", contentType.c_str());
-                if (contentType == "application/octet-stream") {
-                    isValidContentType = true;
-                }
-            }
-            else if (line.isEmpty()) { // end of headers
-                break;
-            }
-
-            token = strtok(NULL, "\n");
-        }
-
-        if (isSuccess && contentLength > 0 && isValidContentType) {
-            if (Update.begin(contentLength)) {
-                ESP_LOGI(LOG_TAG, "Running OTA update: size=%d", contentLength);
-                state = STATE_OTA_UPDATE_DATA;
-                updateDataLength = contentLength;
-                updateReceivedBytes = 0;
-            }
-            else {
-                ESP_LOGI(LOG_TAG, "Low space for OTA: size=%d", contentLength);
-                client->close();
-            }
-        }
-        else {
-            ESP_LOGI(LOG_TAG, "Invalid firmware file");
-            client->close();
-        }
-    }
-    else if (state == STATE_OTA_UPDATE_DATA) {
-        updateReceivedBytes += len;
-        Update.write((uint8_t *)data, len);
+void WifiConnect::runOTAUpdate() {
+    OtaState otaState = otaStream.loop();
+    if (otaState == OTA_FINISHED) {
+        ESP_LOGI(LOG_TAG, "OTA successful, restarting");
+        config->flush();
+        ESP.restart();
     }
-}
-
-void WifiConnect::finalizeOTAUpdate() {
-    if (Update.end()) {
-        if (Update.isFinished()) {
-            ESP_LOGI(LOG_TAG, "OTA successful, restarting");
-            ESP.restart();
-        }
-        else {
-            ESP_LOGI(LOG_TAG, "OTA failed");
-        }
-    }
-    else {
-        ESP_LOGI(LOG_TAG, "OTA failed: %d", Update.getError());
+    else if (otaState == OTA_FAILED) {
+        ESP_LOGI(LOG_TAG, "OTA failed");
+        mode = MODE_FLOUD;
+        state = STATE_FLOUD_DISCONNECTED;
     }
-    mode = MODE_FLOUD;
-    state = STATE_FLOUD_DISCONNECTED;
 }
\ No newline at end of file
@@ -7,8 +7,11 @@
 #include "CommandProtocolDef.h"
 #include "hardware/Floower.h"
 #include "WiFi.h"
-#include "AsyncTCP.h"
+#include "hal/TcpSocket.h"
 #include "CommandProtocol.h"
+#include "FrameReassembler.h"
+#include "InflightTable.h"
+#include "OtaStream.h"
 
 // network status
 #define WIFI_STATUS_DISABLED 0
@@ -18,6 +21,8 @@
 #define WIFI_STATUS_FLOUD_UNAUTHORIZED 3
 #define WIFI_STATUS_FLOUD_CONNECTED 4
 
+#define SOCKET_RESPONSE_TIMEOUT_MS 2000 // default time for the reply to a request
+
 class WifiConnect {
     public:
         WifiConnect(Config *config, CommandProtocol *cmdProtocol);
@@ -26,13 +31,14 @@ class WifiConnect {
         void enable();
         void disable();
         void reconnect();
-        void updateFloowerState(int8_t petalsOpenLevel, HsbColor hsbColor);
+        bool updateFloowerState(int8_t petalsOpenLevel, HsbColor hsbColor); // false when not connected to Floud
         void updateStatusData(uint8_t batteryLevel, bool batteryCharging);
         bool isEnabled();
         bool isConnected();
         uint8_t getStatus();
-        void startOTAUpdate(String firmwareUrl);
+        void startOTAUpdate(const OtaManifest &manifest);
         bool isOTAUpdateRunning();
+        void onConnected(ConnectedCallback callback); // authorized by Floud, fired from loop()
 
     private:
         void onWifiDisconnected(WiFiEvent_t event, WiFiEventInfo_t info);
@@ -49,17 +55,15 @@ class WifiConnect {
 
         void handleReceivedMessage();
         void receiveMessage(char *data, size_t len);
-        uint16_t sendRequest(const uint16_t type, const char* payload, const size_t payloadSize);
-        void sendRequest(const uint16_t type, const uint16_t id, const char* payload, const size_t payloadSize);
+        uint16_t sendRequest(const uint16_t type, const char* payload, const size_t payloadSize, const unsigned long timeout = SOCKET_RESPONSE_TIMEOUT_MS);
         void sendMessage(const uint16_t type, const uint16_t id, const char* payload, const size_t payloadSize);
+        void sendPendingUpdates();
 
-        void requestOTAUpdateData();
-        void receiveOTAUpdateData(char *data, size_t len);
-        void finalizeOTAUpdate();
+        void runOTAUpdate();
 
         Config *config;
         CommandProtocol *cmdProtocol;
-        AsyncClient *client;
+        TcpSocket *client;
         bool enabled = false;
         bool wifiOn = false;
         bool wifiConnected = false;
@@ -74,16 +78,22 @@ class WifiConnect {
         unsigned long reconnectTime = 0;
         uint16_t messageIdCounter = 1;
         uint16_t authorizationMessageId;
+        uint8_t codec = COMMAND_CODEC_MSGPACK; // payload codec negotiated on the connection
         bool authorizationFailed = false;
+        ConnectedCallback connectedCallback;
         char sendBuffer[MAX_MESSAGE_PAYLOAD_BYTES + 1]; // extra space for 0 terminating string
 
-        unsigned long receiveTime = 0; // time when reply should be received
-        volatile bool received = false;
-        CommandMessageHeader receivedMessage; 
+        InflightTable inflight; // requests waiting for reply
+        bool floowerStatePending = false; // waiting for a free slot in the in flight window
+        int8_t pendingPetalsOpenLevel;
+        HsbColor pendingColor;
+        bool statusPending = false;
+        uint8_t pendingBatteryLevel;
+        bool pendingBatteryCharging;
+        uint32_t droppedUpdates = 0; // replaced by newer ones before they could be sent
+        FrameReassembler frames;
+        CommandMessageHeader receivedMessage; // message being handled
         char receiveBuffer[MAX_MESSAGE_PAYLOAD_BYTES + 1]; // extra space for 0 terminating string
 
-        String updateFirmwareHost;
-        String updateFirmwarePath;
-        size_t updateDataLength;
-        size_t updateReceivedBytes;
+        OtaStream otaStream;
 };
@@ -0,0 +1,38 @@
+#pragma once
+
+// Thin hardware abstraction layer. Clock, GPIO, ADC and touch are the Arduino core API (simulated by hal/native
+// on the host), devices with more state are reached through the types and factories below.
+
+#include "Arduino.h"
+#include "hal/LedStrip.h"
+#include "hal/TcpSocket.h"
+#include "hardware/StepGenerator.h"
+
+// UART connected to the TMC2300 stepper driver
+Stream *halBeginTmcUart(uint32_t baudRate, int8_t rxPin, int8_t txPin);
+
+// STEP pulses generator
+StepGenerator *halCreateStepGenerator(uint8_t stepPin, uint8_t timerIndex);
+
+// idle of the main loop, returns early once woken up by halWakeUpFromISR()
+void halIdleWait(uint32_t timeout);
+
+// light sleep of the whole board with the radio off, wakes up by the timer or touch, true when woken up by touch
+bool halLightSleep(uint32_t timeout);
+
+// wakes up the idle main loop, safe to call from an interrupt
+void halWakeUpFromISR();
+
+// new firmware image written to the inactive OTA partition, boots on the next restart once ended
+bool halFirmwareBegin(uint32_t size);
+bool halFirmwareWrite(const uint8_t *data, size_t length);
+bool halFirmwareEnd();
+void halFirmwareAbort();
+
+// image of the running firmware, base of a delta update
+bool halFirmwareRead(uint32_t offset, uint8_t *data, size_t length);
+
+// flash area of the configuration store, erased by 4KB sectors to 0xFF, a write only clears bits
+bool halConfigRead(uint32_t address, uint8_t *data, size_t length);
+bool halConfigWrite(uint32_t address, const uint8_t *data, size_t length);
+bool halConfigErase(uint32_t address); // the sector at the address
@@ -0,0 +1,13 @@
+#pragma once
+
+#ifdef NATIVE
+#include "hal/native/SimLedStrip.h"
+
+typedef SimLedStrip PixelsStrip;
+typedef SimLedStrip StatusPixelStrip;
+#else
+#include <NeoPixelBus.h>
+
+typedef NeoPixelBus<NeoGrbFeature, NeoEsp32I2s0800KbpsMethod> PixelsStrip;
+typedef NeoPixelBus<NeoGrbFeature, NeoEsp32I2s1800KbpsMethod> StatusPixelStrip;
+#endif
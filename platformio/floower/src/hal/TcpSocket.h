@@ -0,0 +1,11 @@
+#pragma once
+
+#ifdef NATIVE
+#include "hal/native/SimTcpSocket.h"
+
+typedef SimTcpSocket TcpSocket;
+#else
+#include <AsyncTCP.h>
+
+typedef AsyncClient TcpSocket;
+#endif
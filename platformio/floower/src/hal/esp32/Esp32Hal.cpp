@@ -0,0 +1,84 @@
+#ifdef ARDUINO_ARCH_ESP32
+
+#include "hal/Hal.h"
+#include <esp_sleep.h>
+#include <Update.h>
+#include <esp_ota_ops.h>
+
+static TaskHandle_t idleTask = nullptr;
+
+Stream *halBeginTmcUart(uint32_t baudRate, int8_t rxPin, int8_t txPin) {
+    Serial1.begin(baudRate, SERIAL_8N1, rxPin, txPin);
+    return &Serial1;
+}
+
+StepGenerator *halCreateStepGenerator(uint8_t stepPin, uint8_t timerIndex) {
+    return new TimerStepGenerator(stepPin, timerIndex);
+}
+
+void halIdleWait(uint32_t timeout) {
+    idleTask = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout)); // returns right away when woken up meanwhile
+}
+
+bool halLightSleep(uint32_t timeout) {
+    esp_sleep_enable_timer_wakeup((uint64_t) timeout * 1000);
+    esp_sleep_enable_touchpad_wakeup();
+    esp_light_sleep_start();
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER); // must not wake up the deep sleep later
+    return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TOUCHPAD;
+}
+
+void IRAM_ATTR halWakeUpFromISR() {
+    if (idleTask != nullptr) {
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(idleTask, &higherPriorityTaskWoken);
+        if (higherPriorityTaskWoken) {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
+
+bool halFirmwareBegin(uint32_t size) {
+    return Update.begin(size);
+}
+
+bool halFirmwareWrite(const uint8_t *data, size_t length) {
+    return Update.write((uint8_t *) data, length) == length;
+}
+
+bool halFirmwareEnd() {
+    return Update.end() && Update.isFinished();
+}
+
+void halFirmwareAbort() {
+    Update.abort();
+}
+
+bool halFirmwareRead(uint32_t offset, uint8_t *data, size_t length) {
+    const esp_partition_t *partition = esp_ota_get_running_partition();
+    return partition != nullptr && esp_partition_read(partition, offset, data, length) == ESP_OK;
+}
+
+static const esp_partition_t *configPartition() {
+    // beginning of the SPIFFS partition, not used otherwise
+    static const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, nullptr);
+    return partition;
+}
+
+bool halConfigRead(uint32_t address, uint8_t *data, size_t length) {
+    const esp_partition_t *partition = configPartition();
+    return partition != nullptr && esp_partition_read(partition, address, data, length) == ESP_OK;
+}
+
+bool halConfigWrite(uint32_t address, const uint8_t *data, size_t length) {
+    const esp_partition_t *partition = configPartition();
+    return partition != nullptr && esp_partition_write(partition, address, data, length) == ESP_OK;
+}
+
+bool halConfigErase(uint32_t address) {
+    const esp_partition_t *partition = configPartition();
+    return partition != nullptr && esp_partition_erase_range(partition, address, SPI_FLASH_SEC_SIZE) == ESP_OK;
+}
+
+#endif
@@ -0,0 +1,97 @@
+#pragma once
+
+// Arduino core API for the host build, backed by the simulated hardware in SimHardware
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <functional>
+#include "WString.h"
+#include "Stream.h"
+#include "SimHardware.h"
+
+using std::min;
+using std::max;
+
+#define _min(a, b) ((a) < (b) ? (a) : (b))
+#define _max(a, b) ((a) > (b) ? (a) : (b))
+
+#define IRAM_ATTR
+
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x02
+#define INPUT_PULLUP 0x05
+#define SERIAL_8N1 0x800001c
+
+#define BIN 2
+#define DEC 10
+#define HEX 16
+
+typedef enum {
+    GPIO_NUM_0 = 0, GPIO_NUM_1, GPIO_NUM_2, GPIO_NUM_3, GPIO_NUM_4, GPIO_NUM_5, GPIO_NUM_6, GPIO_NUM_7,
+    GPIO_NUM_8, GPIO_NUM_9, GPIO_NUM_10, GPIO_NUM_11, GPIO_NUM_12, GPIO_NUM_13, GPIO_NUM_14, GPIO_NUM_15,
+    GPIO_NUM_16, GPIO_NUM_17, GPIO_NUM_18, GPIO_NUM_19, GPIO_NUM_20, GPIO_NUM_21, GPIO_NUM_22, GPIO_NUM_23,
+    GPIO_NUM_25 = 25, GPIO_NUM_26, GPIO_NUM_27, GPIO_NUM_32 = 32, GPIO_NUM_33, GPIO_NUM_34, GPIO_NUM_35,
+    GPIO_NUM_36, GPIO_NUM_37, GPIO_NUM_38, GPIO_NUM_39
+} gpio_num_t;
+
+typedef enum {
+    ADC_0db, ADC_2_5db, ADC_6db, ADC_11db
+} adc_attenuation_t;
+
+typedef enum {
+    ESP_SLEEP_WAKEUP_UNDEFINED, ESP_SLEEP_WAKEUP_ALL, ESP_SLEEP_WAKEUP_EXT0, ESP_SLEEP_WAKEUP_EXT1,
+    ESP_SLEEP_WAKEUP_TIMER, ESP_SLEEP_WAKEUP_TOUCHPAD
+} esp_sleep_wakeup_cause_t;
+
+typedef enum {
+    ESP_EXT1_WAKEUP_ALL_LOW = 0, ESP_EXT1_WAKEUP_ANY_HIGH = 1
+} esp_sleep_ext1_wakeup_mode_t;
+
+// clock
+inline unsigned long millis() { return SimHardware::micros() / 1000; }
+inline unsigned long micros() { return SimHardware::micros(); }
+inline void delay(uint32_t ms) { SimHardware::advance(ms * 1000); }
+inline void delayMicroseconds(uint32_t us) { SimHardware::advance(us); }
+
+// gpio
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+inline void digitalWrite(uint8_t pin, uint8_t value) { SimHardware::digitalWrite(pin, value); }
+inline int digitalRead(uint8_t pin) { return SimHardware::digitalRead(pin); }
+
+// adc
+inline uint16_t analogRead(uint8_t pin) { return SimHardware::analogRead(pin); }
+inline void analogReadResolution(uint8_t bits) {}
+inline void analogSetAttenuation(adc_attenuation_t attenuation) {}
+
+// touch
+inline uint16_t touchRead(uint8_t pin) { return SimHardware::touchRead(pin); }
+inline void touchAttachInterrupt(uint8_t pin, void (*isr)(), uint16_t threshold) { SimHardware::attachTouch(pin, isr, threshold); }
+inline void detachInterrupt(uint8_t pin) { SimHardware::detachTouch(pin); }
+
+// sleep and radio
+inline esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() { return ESP_SLEEP_WAKEUP_UNDEFINED; }
+inline int esp_sleep_enable_ext1_wakeup(uint64_t mask, esp_sleep_ext1_wakeup_mode_t mode) { return 0; }
+inline int esp_sleep_enable_touchpad_wakeup() { return 0; }
+inline void esp_deep_sleep_start() { SimHardware::deepSleep(); }
+inline bool btStop() { return true; }
+
+// random
+inline long random(long max) { return max > 0 ? SimHardware::random() % max : 0; }
+inline long random(long min, long max) { return min >= max ? min : min + random(max - min); }
+inline void randomSeed(unsigned long seed) { SimHardware::randomSeed(seed); }
+
+class EspClass {
+    public:
+        void restart() { SimHardware::restart(); }
+        uint32_t getCycleCount() { return SimHardware::micros() * 240; } // 240MHz core clock
+        uint32_t getCpuFreqMHz() { return 240; }
+};
+
+extern EspClass ESP;
+extern SimSerial Serial;
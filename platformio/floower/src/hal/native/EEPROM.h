@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#define SIM_EEPROM_SIZE 4096
+
+// emulated EEPROM, commit() counts as one flash sector erase
+class EEPROMClass {
+    public:
+        bool begin(size_t size) {
+            this->size = size < SIM_EEPROM_SIZE ? size : SIM_EEPROM_SIZE;
+            return true;
+        }
+        uint8_t read(int address) { return address >= 0 && (size_t) address < size ? data[address] : 0; }
+        void write(int address, uint8_t value) {
+            if (address >= 0 && (size_t) address < size) {
+                data[address] = value;
+            }
+        }
+        bool commit() {
+            commits++;
+            return true;
+        }
+
+        void erase() {
+            memset(data, 0xFF, sizeof(data));
+            commits = 0;
+        }
+        uint32_t getCommits() { return commits; }
+
+    private:
+        uint8_t data[SIM_EEPROM_SIZE];
+        size_t size = 0;
+        uint32_t commits = 0;
+};
+
+extern EEPROMClass EEPROM;
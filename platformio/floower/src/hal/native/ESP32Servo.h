@@ -0,0 +1,17 @@
+#pragma once
+
+// servo of the old Floower revisions, position is only remembered
+class Servo {
+    public:
+        void setPeriodHertz(int hertz) {}
+        int attach(int pin) { attached = true; return pin; }
+        int attach(int pin, int min, int max) { attached = true; return pin; }
+        void detach() { attached = false; }
+        void write(int value) { this->value = value; }
+        int read() { return value; }
+        bool isAttached() { return attached; }
+
+    private:
+        int value = 0;
+        bool attached = false;
+};
@@ -0,0 +1,85 @@
+#include "hal/Hal.h"
+#include "EEPROM.h"
+#include "SimTmcUart.h"
+#include "SimHardware.h"
+#include "SimFirmware.h"
+#include "SimConfigFlash.h"
+#include <atomic>
+#include <string.h>
+
+EEPROMClass EEPROM;
+SimTmcUart tmcUart;
+SimFirmware firmware;
+SimConfigFlash configFlash;
+static std::atomic<bool> wakeUpRequested {false};
+
+Stream *halBeginTmcUart(uint32_t baudRate, int8_t rxPin, int8_t txPin) {
+    tmcUart.reset(); // freshly powered driver
+    SimHardware::registerTmcUart(&tmcUart);
+    return &tmcUart;
+}
+
+StepGenerator *halCreateStepGenerator(uint8_t stepPin, uint8_t timerIndex) {
+    FakeStepGenerator *stepGenerator = new FakeStepGenerator();
+    stepGenerator->onStep([stepGenerator](uint32_t time, long position) {
+        tmcUart.step(stepGenerator->getDirection()); // the motor turns the petals
+    });
+    SimHardware::registerStepGenerator(stepGenerator);
+    return stepGenerator;
+}
+
+void halIdleWait(uint32_t timeout) {
+    // simulated time moves in 1ms steps, the touch ISR fires meanwhile
+    for (uint32_t i = 0; i < timeout && !wakeUpRequested; i++) {
+        delay(1);
+    }
+    wakeUpRequested = false;
+}
+
+bool halLightSleep(uint32_t timeout) {
+    halIdleWait(timeout);
+    return false; // the simulated touch ISR keeps running, no touch wake up to report
+}
+
+void halWakeUpFromISR() {
+    wakeUpRequested = true;
+}
+
+bool halFirmwareBegin(uint32_t size) {
+    SimHardware::registerFirmware(&firmware);
+    return firmware.begin(size);
+}
+
+bool halFirmwareWrite(const uint8_t *data, size_t length) {
+    return firmware.write(data, length);
+}
+
+bool halFirmwareEnd() {
+    return firmware.end();
+}
+
+void halFirmwareAbort() {
+    firmware.abort();
+}
+
+bool halFirmwareRead(uint32_t offset, uint8_t *data, size_t length) {
+    const std::vector<uint8_t> &image = SimHardware::getRunningFirmware();
+    if (offset + length > image.size()) {
+        return false;
+    }
+    SimHardware::advance((uint64_t) length * SIM_FLASH_READ_TIME / SIM_FLASH_SECTOR_SIZE);
+    memcpy(data, image.data() + offset, length);
+    return true;
+}
+
+bool halConfigRead(uint32_t address, uint8_t *data, size_t length) {
+    return configFlash.read(address, data, length);
+}
+
+bool halConfigWrite(uint32_t address, const uint8_t *data, size_t length) {
+    return configFlash.write(address, data, length);
+}
+
+bool halConfigErase(uint32_t address) {
+    return configFlash.erase(address);
+}
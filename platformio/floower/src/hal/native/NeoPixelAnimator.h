@@ -0,0 +1,114 @@
+#pragma once
+
+// NeoPixelAnimator for the host build, driven by the simulated clock
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+#include "Arduino.h"
+
+enum AnimationState {
+    AnimationState_Started,
+    AnimationState_Progress,
+    AnimationState_Completed
+};
+
+struct AnimationParam {
+    float progress;
+    uint16_t index;
+    AnimationState state;
+};
+
+typedef std::function<void(const AnimationParam& param)> AnimUpdateCallback;
+
+class NeoPixelAnimator {
+    public:
+        NeoPixelAnimator(uint16_t countAnimations) : animations(countAnimations) {
+            lastTick = millis();
+        }
+
+        bool IsAnimating() const {
+            return activeAnimations > 0;
+        }
+
+        bool IsAnimationActive(uint16_t index) const {
+            return index < animations.size() && animations[index].remaining > 0;
+        }
+
+        void StartAnimation(uint16_t index, uint16_t duration, AnimUpdateCallback animUpdate) {
+            if (index >= animations.size()) {
+                return;
+            }
+            if (duration == 0) {
+                duration = 1;
+            }
+            if (animations[index].remaining == 0) {
+                activeAnimations++;
+            }
+            animations[index].duration = duration;
+            animations[index].remaining = duration;
+            animations[index].callback = animUpdate;
+            animations[index].started = false;
+        }
+
+        void StopAnimation(uint16_t index) {
+            if (IsAnimationActive(index)) {
+                activeAnimations--;
+                animations[index].remaining = 0;
+                animations[index].callback = nullptr;
+            }
+        }
+
+        void RestartAnimation(uint16_t index) {
+            if (index < animations.size() && animations[index].duration > 0) {
+                StartAnimation(index, animations[index].duration, animations[index].callback);
+            }
+        }
+
+        void UpdateAnimations() {
+            unsigned long now = millis();
+            uint32_t delta = now - lastTick;
+            lastTick = now;
+
+            for (uint16_t i = 0; i < animations.size(); i++) {
+                Animation &animation = animations[i];
+                if (animation.remaining == 0) {
+                    continue;
+                }
+                AnimationParam param;
+                param.index = i;
+                if (!animation.started) {
+                    animation.started = true;
+                    param.state = AnimationState_Started;
+                    param.progress = 0;
+                }
+                else if (delta < animation.remaining) {
+                    animation.remaining -= delta;
+                    param.state = AnimationState_Progress;
+                    param.progress = (float) (animation.duration - animation.remaining) / animation.duration;
+                }
+                else {
+                    animation.remaining = 0;
+                    activeAnimations--;
+                    param.state = AnimationState_Completed;
+                    param.progress = 1.0f;
+                }
+                AnimUpdateCallback callback = animation.callback; // callback may restart or replace the animation
+                if (callback != nullptr) {
+                    callback(param);
+                }
+            }
+        }
+
+    private:
+        struct Animation {
+            uint16_t duration = 0;
+            uint16_t remaining = 0;
+            bool started = false;
+            AnimUpdateCallback callback;
+        };
+
+        std::vector<Animation> animations;
+        uint16_t activeAnimations = 0;
+        unsigned long lastTick;
+};
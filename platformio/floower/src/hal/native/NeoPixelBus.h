@@ -0,0 +1,145 @@
+#pragma once
+
+// color types of NeoPixelBus for the host build, same conversions as the library
+
+#include <stdint.h>
+#include <math.h>
+
+struct HsbColor;
+
+struct RgbColor {
+    RgbColor() : R(0), G(0), B(0) {}
+    RgbColor(uint8_t r, uint8_t g, uint8_t b) : R(r), G(g), B(b) {}
+    RgbColor(uint8_t brightness) : R(brightness), G(brightness), B(brightness) {}
+    RgbColor(const HsbColor &color);
+
+    bool operator==(const RgbColor &other) const { return R == other.R && G == other.G && B == other.B; }
+    bool operator!=(const RgbColor &other) const { return !(*this == other); }
+
+    static RgbColor LinearBlend(const RgbColor &left, const RgbColor &right, float progress) {
+        return RgbColor(
+            left.R + ((right.R - left.R) * progress),
+            left.G + ((right.G - left.G) * progress),
+            left.B + ((right.B - left.B) * progress));
+    }
+
+    uint8_t R;
+    uint8_t G;
+    uint8_t B;
+};
+
+struct HsbColor {
+    HsbColor() : H(0), S(0), B(0) {}
+    HsbColor(float h, float s, float b) : H(h), S(s), B(b) {}
+    HsbColor(const RgbColor &color) {
+        float r = color.R / 255.0f;
+        float g = color.G / 255.0f;
+        float b = color.B / 255.0f;
+        float max = (r > g && r > b) ? r : (g > b) ? g : b;
+        float min = (r < g && r < b) ? r : (g < b) ? g : b;
+        float d = max - min;
+        float h = 0.0;
+        float v = max;
+        float s = (v == 0.0f) ? 0 : (d / v);
+        if (d != 0.0f) {
+            if (r == max) {
+                h = (g - b) / d + (g < b ? 6.0f : 0.0f);
+            }
+            else if (g == max) {
+                h = (b - r) / d + 2.0f;
+            }
+            else {
+                h = (r - g) / d + 4.0f;
+            }
+            h /= 6.0f;
+        }
+        H = h;
+        S = s;
+        B = v;
+    }
+
+    template <typename T_NEOHUEBLEND> static HsbColor LinearBlend(const HsbColor &left, const HsbColor &right, float progress) {
+        return HsbColor(T_NEOHUEBLEND::HueBlend(left.H, right.H, progress),
+            left.S + ((right.S - left.S) * progress),
+            left.B + ((right.B - left.B) * progress));
+    }
+
+    float H;
+    float S;
+    float B;
+};
+
+inline RgbColor::RgbColor(const HsbColor &color) {
+    float r;
+    float g;
+    float b;
+    float h = color.H;
+    float s = color.S;
+    float v = color.B;
+
+    if (color.S == 0.0f) {
+        r = g = b = v; // achromatic or black
+    }
+    else {
+        if (h < 0.0f) {
+            h += 1.0f;
+        }
+        else if (h >= 1.0f) {
+            h -= 1.0f;
+        }
+        h *= 6.0f;
+        int i = (int) h;
+        float f = h - i;
+        float q = v * (1.0f - s * f);
+        float p = v * (1.0f - s);
+        float t = v * (1.0f - s * (1.0f - f));
+        switch (i) {
+            case 0: r = v; g = t; b = p; break;
+            case 1: r = q; g = v; b = p; break;
+            case 2: r = p; g = v; b = t; break;
+            case 3: r = p; g = q; b = v; break;
+            case 4: r = t; g = p; b = v; break;
+            default: r = v; g = p; b = q; break;
+        }
+    }
+
+    R = (uint8_t) (r * 255.0f);
+    G = (uint8_t) (g * 255.0f);
+    B = (uint8_t) (b * 255.0f);
+}
+
+class NeoHueBlendShortestDistance {
+    public:
+        static float HueBlend(float left, float right, float progress) {
+            float delta = right - left;
+            float base = left;
+            if (delta > 0.5f) {
+                base = right;
+                delta = 1.0f - delta;
+                progress = 1.0f - progress;
+            }
+            else if (delta < -0.5f) {
+                delta = 1.0f + delta;
+            }
+            float hue = base + delta * progress;
+            if (hue < 0.0f) {
+                hue += 1.0f;
+            }
+            else if (hue > 1.0f) {
+                hue -= 1.0f;
+            }
+            return hue;
+        }
+};
+
+class NeoEase {
+    public:
+        static float CubicInOut(float unitValue) {
+            unitValue *= 2.0f;
+            if (unitValue < 1.0f) {
+                return 0.5f * unitValue * unitValue * unitValue;
+            }
+            unitValue -= 2.0f;
+            return 0.5f * (unitValue * unitValue * unitValue + 2.0f);
+        }
+};
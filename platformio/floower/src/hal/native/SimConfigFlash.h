@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "SimHardware.h"
+#include "SimFirmware.h"
+
+#define SIM_CONFIG_FLASH_SIZE 0x10000 // bytes of the SPIFFS partition simulated
+#define SIM_FLASH_ERASE_TIME 45000 // us to erase a sector
+#define SIM_FLASH_PAGE_SIZE 256
+#define SIM_FLASH_PAGE_TIME 700 // us to program a page
+
+// NOR flash of the configuration store, survives SimHardware::reset() like the real one. Power can be cut after a
+// number of bytes written to tear a write.
+class SimConfigFlash {
+    public:
+        SimConfigFlash() {
+            eraseAll();
+        }
+
+        bool read(uint32_t address, uint8_t *data, size_t length) {
+            if (address + length > SIM_CONFIG_FLASH_SIZE) {
+                return false;
+            }
+            memcpy(data, flash + address, length);
+            return true;
+        }
+        bool write(uint32_t address, const uint8_t *data, size_t length) {
+            if (address + length > SIM_CONFIG_FLASH_SIZE || powerBudget == 0) {
+                return false;
+            }
+            size_t written = length < powerBudget ? length : powerBudget;
+            for (size_t i = 0; i < written; i++) {
+                flash[address + i] &= data[i]; // bits only cleared
+            }
+            powerBudget -= written;
+            bytesWritten += written;
+            SimHardware::advance((uint32_t) ((written * SIM_FLASH_PAGE_TIME + SIM_FLASH_PAGE_SIZE - 1) / SIM_FLASH_PAGE_SIZE));
+            return written == length;
+        }
+        bool erase(uint32_t address) {
+            if (address % SIM_FLASH_SECTOR_SIZE != 0 || address >= SIM_CONFIG_FLASH_SIZE || powerBudget == 0) {
+                return false;
+            }
+            memset(flash + address, 0xFF, SIM_FLASH_SECTOR_SIZE);
+            erases[address / SIM_FLASH_SECTOR_SIZE]++;
+            SimHardware::advance(SIM_FLASH_ERASE_TIME);
+            return true;
+        }
+
+        void eraseAll() {
+            memset(flash, 0xFF, sizeof(flash));
+            memset(erases, 0, sizeof(erases));
+            bytesWritten = 0;
+            powerBudget = SIZE_MAX;
+        }
+        void cutPowerAfter(size_t bytes) { powerBudget = bytes; } // writes fail from then on
+        void powerOn() { powerBudget = SIZE_MAX; }
+        uint32_t getErases(uint8_t sector) { return erases[sector]; }
+        uint32_t getBytesWritten() { return bytesWritten; }
+
+    private:
+        uint8_t flash[SIM_CONFIG_FLASH_SIZE];
+        uint32_t erases[SIM_CONFIG_FLASH_SIZE / SIM_FLASH_SECTOR_SIZE];
+        uint32_t bytesWritten = 0;
+        size_t powerBudget = SIZE_MAX;
+};
+
+extern SimConfigFlash configFlash;
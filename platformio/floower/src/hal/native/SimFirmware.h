@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "SimHardware.h"
+
+#define SIM_FIRMWARE_PARTITION 0x1E0000 // bytes, app partition of min_spiffs.csv
+#define SIM_FLASH_SECTOR_SIZE 4096
+#define SIM_FLASH_SECTOR_TIME 40000 // us to erase and program a sector
+#define SIM_FLASH_READ_TIME 400 // us to read a sector
+
+// inactive OTA partition, writes take the time of the flash
+class SimFirmware {
+    public:
+        bool begin(uint32_t size) {
+            image.clear();
+            this->size = size;
+            running = size > 0 && size <= SIM_FIRMWARE_PARTITION;
+            bootable = false;
+            writes = 0;
+            return running;
+        }
+        bool write(const uint8_t *data, size_t length) {
+            if (!running || image.size() + length > size) {
+                return false;
+            }
+            SimHardware::advance((uint64_t) length * SIM_FLASH_SECTOR_TIME / SIM_FLASH_SECTOR_SIZE);
+            image.insert(image.end(), data, data + length);
+            writes++;
+            return true;
+        }
+        bool end() {
+            bootable = running && image.size() == size;
+            running = false;
+            return bootable;
+        }
+        void abort() {
+            running = false;
+            bootable = false;
+        }
+
+        const std::vector<uint8_t> &getImage() { return image; }
+        bool isRunning() { return running; }
+        bool isBootable() { return bootable; }
+        uint32_t getWrites() { return writes; }
+
+    private:
+        std::vector<uint8_t> image;
+        uint32_t size = 0;
+        bool running = false;
+        bool bootable = false;
+        uint32_t writes = 0;
+};
@@ -0,0 +1,192 @@
+#include "SimHardware.h"
+#include "SimLedStrip.h"
+#include "Arduino.h"
+#include "hardware/StepGenerator.h"
+
+uint64_t SimHardware::time = 0;
+uint8_t SimHardware::digital[SIM_PINS];
+uint16_t SimHardware::analog[SIM_PINS];
+uint16_t SimHardware::touch[SIM_PINS];
+uint16_t SimHardware::touchThreshold[SIM_PINS];
+void (*SimHardware::touchIsr[SIM_PINS])();
+uint64_t SimHardware::lastTouchIsrTime = 0;
+std::vector<FakeStepGenerator*> SimHardware::stepGenerators;
+std::vector<SimLedStrip*> SimHardware::ledStrips;
+SimTmcUart *SimHardware::tmcUart = nullptr;
+SimFirmware *SimHardware::firmware = nullptr;
+std::vector<uint8_t> SimHardware::runningFirmware;
+bool SimHardware::deepSleeping = false;
+uint32_t SimHardware::restarts = 0;
+uint32_t SimHardware::randomState = 1;
+bool SimHardware::verbose = false;
+
+EspClass ESP;
+SimSerial Serial;
+
+void SimHardware::reset() {
+    time = 0;
+    for (uint8_t i = 0; i < SIM_PINS; i++) {
+        digital[i] = LOW;
+        analog[i] = 0;
+        touch[i] = 100; // not touched
+        touchThreshold[i] = 0;
+        touchIsr[i] = nullptr;
+    }
+    lastTouchIsrTime = 0;
+    stepGenerators.clear();
+    ledStrips.clear();
+    tmcUart = nullptr;
+    firmware = nullptr;
+    runningFirmware.clear();
+    deepSleeping = false;
+    restarts = 0;
+    randomState = 1;
+}
+
+void SimHardware::advance(uint32_t us) {
+    uint64_t endTime = time + us;
+    while (time < endTime) {
+        // move in small increments to let the touch ISR fire as on the real sensor
+        uint32_t increment = endTime - time > SIM_TOUCH_ISR_INTERVAL ? SIM_TOUCH_ISR_INTERVAL : endTime - time;
+        time += increment;
+        for (FakeStepGenerator *stepGenerator : stepGenerators) {
+            stepGenerator->advance(increment);
+        }
+        if (time - lastTouchIsrTime >= SIM_TOUCH_ISR_INTERVAL) {
+            lastTouchIsrTime = time;
+            for (uint8_t i = 0; i < SIM_PINS; i++) {
+                if (touchIsr[i] != nullptr && touch[i] < touchThreshold[i]) {
+                    touchIsr[i]();
+                }
+            }
+        }
+    }
+}
+
+uint64_t SimHardware::micros() {
+    return time;
+}
+
+void SimHardware::digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin < SIM_PINS) {
+        digital[pin] = value;
+    }
+}
+
+int SimHardware::digitalRead(uint8_t pin) {
+    return pin < SIM_PINS ? digital[pin] : LOW;
+}
+
+void SimHardware::setDigital(uint8_t pin, uint8_t value) {
+    digitalWrite(pin, value);
+}
+
+uint16_t SimHardware::analogRead(uint8_t pin) {
+    return pin < SIM_PINS ? analog[pin] : 0;
+}
+
+void SimHardware::setAnalog(uint8_t pin, uint16_t value) {
+    if (pin < SIM_PINS) {
+        analog[pin] = value;
+    }
+}
+
+uint16_t SimHardware::touchRead(uint8_t pin) {
+    return pin < SIM_PINS ? touch[pin] : 0;
+}
+
+void SimHardware::attachTouch(uint8_t pin, void (*isr)(), uint16_t threshold) {
+    if (pin < SIM_PINS) {
+        touchIsr[pin] = isr;
+        touchThreshold[pin] = threshold;
+    }
+}
+
+void SimHardware::detachTouch(uint8_t pin) {
+    if (pin < SIM_PINS) {
+        touchIsr[pin] = nullptr;
+    }
+}
+
+void SimHardware::setTouch(uint8_t pin, uint16_t value) {
+    if (pin < SIM_PINS) {
+        touch[pin] = value;
+    }
+}
+
+void SimHardware::registerStepGenerator(FakeStepGenerator *stepGenerator) {
+    stepGenerators.push_back(stepGenerator);
+}
+
+void SimHardware::registerLedStrip(SimLedStrip *strip) {
+    ledStrips.push_back(strip);
+}
+
+SimLedStrip *SimHardware::getLedStrip(uint8_t pin) {
+    for (SimLedStrip *strip : ledStrips) {
+        if (strip->getPin() == pin) {
+            return strip;
+        }
+    }
+    return nullptr;
+}
+
+void SimHardware::registerTmcUart(SimTmcUart *tmcUart) {
+    SimHardware::tmcUart = tmcUart;
+}
+
+SimTmcUart *SimHardware::getTmcUart() {
+    return tmcUart;
+}
+
+void SimHardware::registerFirmware(SimFirmware *firmware) {
+    SimHardware::firmware = firmware;
+}
+
+SimFirmware *SimHardware::getFirmware() {
+    return firmware;
+}
+
+void SimHardware::setRunningFirmware(const std::vector<uint8_t> &image) {
+    runningFirmware = image;
+}
+
+const std::vector<uint8_t> &SimHardware::getRunningFirmware() {
+    return runningFirmware;
+}
+
+void SimHardware::deepSleep() {
+    deepSleeping = true;
+}
+
+bool SimHardware::isDeepSleeping() {
+    return deepSleeping;
+}
+
+void SimHardware::restart() {
+    restarts++;
+}
+
+uint32_t SimHardware::getRestarts() {
+    return restarts;
+}
+
+uint32_t SimHardware::random() {
+    // xorshift, deterministic across runs
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+void SimHardware::randomSeed(uint32_t seed) {
+    randomState = seed != 0 ? seed : 1;
+}
+
+void SimHardware::setVerbose(bool verbose) {
+    SimHardware::verbose = verbose;
+}
+
+bool SimHardware::isVerbose() {
+    return verbose;
+}
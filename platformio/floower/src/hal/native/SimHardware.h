@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#define SIM_PINS 40
+#define SIM_TOUCH_ISR_INTERVAL 10000 // us, how often the touch ISR fires while the sensor is touched
+
+class FakeStepGenerator;
+class SimLedStrip;
+class SimTmcUart;
+class SimFirmware;
+
+// simulated board, time only moves when advanced by the test (or by delay())
+class SimHardware {
+    public:
+        static void reset();
+        static void advance(uint32_t us);
+        static uint64_t micros();
+
+        // gpio
+        static void digitalWrite(uint8_t pin, uint8_t value);
+        static int digitalRead(uint8_t pin);
+        static void setDigital(uint8_t pin, uint8_t value);
+
+        // adc
+        static uint16_t analogRead(uint8_t pin);
+        static void setAnalog(uint8_t pin, uint16_t value);
+
+        // touch
+        static uint16_t touchRead(uint8_t pin);
+        static void attachTouch(uint8_t pin, void (*isr)(), uint16_t threshold);
+        static void detachTouch(uint8_t pin);
+        static void setTouch(uint8_t pin, uint16_t value);
+
+        // devices
+        static void registerStepGenerator(FakeStepGenerator *stepGenerator);
+        static void registerLedStrip(SimLedStrip *strip);
+        static SimLedStrip *getLedStrip(uint8_t pin);
+        static void registerTmcUart(SimTmcUart *tmcUart);
+        static SimTmcUart *getTmcUart(); // stepper driver with the motor and petals
+        static void registerFirmware(SimFirmware *firmware);
+        static SimFirmware *getFirmware(); // OTA partition, once an update began
+        static void setRunningFirmware(const std::vector<uint8_t> &image);
+        static const std::vector<uint8_t> &getRunningFirmware();
+
+        // system
+        static void deepSleep();
+        static bool isDeepSleeping();
+        static void restart();
+        static uint32_t getRestarts();
+        static uint32_t random();
+        static void randomSeed(uint32_t seed);
+        static void setVerbose(bool verbose);
+        static bool isVerbose();
+
+    private:
+        static uint64_t time;
+        static uint8_t digital[SIM_PINS];
+        static uint16_t analog[SIM_PINS];
+        static uint16_t touch[SIM_PINS];
+        static uint16_t touchThreshold[SIM_PINS];
+        static void (*touchIsr[SIM_PINS])();
+        static uint64_t lastTouchIsrTime;
+        static std::vector<FakeStepGenerator*> stepGenerators;
+        static std::vector<SimLedStrip*> ledStrips;
+        static SimTmcUart *tmcUart;
+        static SimFirmware *firmware;
+        static std::vector<uint8_t> runningFirmware;
+        static bool deepSleeping;
+        static uint32_t restarts;
+        static uint32_t randomState;
+        static bool verbose;
+};
@@ -0,0 +1,73 @@
+#include "SimLedStrip.h"
+#include "SimHardware.h"
+
+SimLedStrip::SimLedStrip(uint16_t count, uint8_t pin) : pin(pin), pixels(count), shown(count) {
+    SimHardware::registerLedStrip(this);
+}
+
+void SimLedStrip::Begin() {
+}
+
+void SimLedStrip::Show() {
+    shown = pixels;
+    showCount++;
+    dirty = false;
+}
+
+bool SimLedStrip::CanShow() const {
+    return true;
+}
+
+bool SimLedStrip::IsDirty() const {
+    return dirty;
+}
+
+void SimLedStrip::Dirty() {
+    dirty = true;
+}
+
+void SimLedStrip::ResetDirty() {
+    dirty = false;
+}
+
+uint16_t SimLedStrip::PixelCount() const {
+    return pixels.size();
+}
+
+void SimLedStrip::SetPixelColor(uint16_t index, RgbColor color) {
+    if (index < pixels.size()) {
+        pixels[index] = color;
+        dirty = true;
+    }
+}
+
+RgbColor SimLedStrip::GetPixelColor(uint16_t index) const {
+    return index < pixels.size() ? pixels[index] : RgbColor();
+}
+
+void SimLedStrip::ClearTo(RgbColor color) {
+    for (RgbColor &pixel : pixels) {
+        pixel = color;
+    }
+    dirty = true;
+}
+
+uint8_t *SimLedStrip::Pixels() {
+    return (uint8_t *) pixels.data();
+}
+
+size_t SimLedStrip::PixelsSize() const {
+    return pixels.size() * sizeof(RgbColor);
+}
+
+uint8_t SimLedStrip::getPin() const {
+    return pin;
+}
+
+RgbColor SimLedStrip::getShownColor(uint16_t index) const {
+    return index < shown.size() ? shown[index] : RgbColor();
+}
+
+uint32_t SimLedStrip::getShowCount() const {
+    return showCount;
+}
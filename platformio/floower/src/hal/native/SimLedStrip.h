@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "NeoPixelBus.h"
+
+// LED strip with the NeoPixelBus API, keeps the last shown frame for inspection
+class SimLedStrip {
+    public:
+        SimLedStrip(uint16_t count, uint8_t pin);
+
+        void Begin();
+        void Show();
+        bool CanShow() const;
+        bool IsDirty() const;
+        void Dirty();
+        void ResetDirty();
+        uint16_t PixelCount() const;
+        void SetPixelColor(uint16_t index, RgbColor color);
+        RgbColor GetPixelColor(uint16_t index) const;
+        void ClearTo(RgbColor color);
+        uint8_t *Pixels();
+        size_t PixelsSize() const;
+
+        uint8_t getPin() const;
+        RgbColor getShownColor(uint16_t index) const;
+        uint32_t getShowCount() const;
+
+    private:
+        uint8_t pin;
+        bool dirty = false;
+        uint32_t showCount = 0;
+        std::vector<RgbColor> pixels;
+        std::vector<RgbColor> shown;
+};
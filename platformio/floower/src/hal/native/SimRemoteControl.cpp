@@ -0,0 +1,59 @@
+#include "connect/RemoteControl.h"
+
+// RemoteControl of the host build, there is no radio so nothing gets ever connected
+
+RemoteControl::RemoteControl(BluetoothConnect *bluetoothConnect, WifiConnect *wifiConnect, CommandProtocol *cmdInterpreter):
+        bluetoothConnect(bluetoothConnect), wifiConnect(wifiConnect), cmdInterpreter(cmdInterpreter) {
+}
+
+void RemoteControl::onRemoteControl(RemoteControlCallback callback) {
+    remoteControlCallback = callback;
+}
+
+void RemoteControl::fireRemoteControl() {
+    if (remoteControlCallback != nullptr) {
+        remoteControlCallback();
+    }
+}
+
+void RemoteControl::enableBluetooth() {}
+
+void RemoteControl::disableBluetooth() {}
+
+bool RemoteControl::isBluetoothConnected() {
+    return false;
+}
+
+bool RemoteControl::isWifiConnected() {
+    return false;
+}
+
+void RemoteControl::enableWifi() {}
+
+void RemoteControl::disableWifi() {}
+
+bool RemoteControl::isWifiEnabled() {
+    return false;
+}
+
+void RemoteControl::planIdle(IdleScheduler &scheduler) {}
+
+void RemoteControl::accountEnergy(EnergyLedger &energyLedger) {}
+
+void RemoteControl::updateStatusData(uint8_t batteryLevel, bool batteryCharging) {}
+
+void RemoteControl::runUpdate(const OtaManifest &manifest) {}
+
+bool RemoteControl::isUpdateRunning() {
+    return false;
+}
+
+void RemoteControl::onRunUpdate(RunUpdateCallback callback) {
+    runUpdateCallback = callback;
+}
+
+void RemoteControl::fireRunUpdate(const OtaManifest &manifest) {
+    if (runUpdateCallback != nullptr) {
+        runUpdateCallback(manifest);
+    }
+}
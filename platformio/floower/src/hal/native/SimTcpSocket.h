@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <string.h>
+#include <functional>
+
+class SimTcpSocket;
+
+typedef std::function<void(void *arg, SimTcpSocket *client)> SimTcpConnectHandler;
+typedef std::function<void(void *arg, SimTcpSocket *client, void *data, size_t len)> SimTcpDataHandler;
+
+// TCP client with the AsyncClient API, the test plays the server side
+class SimTcpSocket {
+    public:
+        SimTcpSocket(void *arg = nullptr) {}
+
+        void onConnect(SimTcpConnectHandler callback, void *arg = nullptr) { connectCallback = callback; }
+        void onDisconnect(SimTcpConnectHandler callback, void *arg = nullptr) { disconnectCallback = callback; }
+        void onData(SimTcpDataHandler callback, void *arg = nullptr) { dataCallback = callback; }
+
+        bool connect(const char *host, uint16_t port) {
+            this->host = host;
+            this->port = port;
+            state = STATE_CONNECTING;
+            return true;
+        }
+        bool connecting() { return state == STATE_CONNECTING; }
+        bool connected() { return state == STATE_CONNECTED; }
+        size_t write(const char *data) { return write(data, strlen(data)); }
+        size_t write(const char *data, size_t size) {
+            if (state != STATE_CONNECTED) {
+                return 0;
+            }
+            sent.append(data, size);
+            return size;
+        }
+        void close(bool now = false) { serverDisconnect(); }
+        void stop() { serverDisconnect(); }
+        void ackLater() { ackDeferred = true; } // data of the current callback stays unacknowledged
+        size_t ack(size_t len) {
+            len = len < unacked ? len : unacked;
+            unacked -= len;
+            return len;
+        }
+
+        // server side
+        void serverAccept() {
+            state = STATE_CONNECTED;
+            unacked = 0;
+            if (connectCallback != nullptr) {
+                connectCallback(nullptr, this);
+            }
+        }
+        void serverSend(const void *data, size_t len) {
+            if (state == STATE_CONNECTED && dataCallback != nullptr) {
+                ackDeferred = false;
+                dataCallback(nullptr, this, (void *) data, len);
+                if (ackDeferred) {
+                    unacked += len;
+                }
+            }
+        }
+        void serverDisconnect() {
+            if (state != STATE_DISCONNECTED) {
+                state = STATE_DISCONNECTED;
+                if (disconnectCallback != nullptr) {
+                    disconnectCallback(nullptr, this);
+                }
+            }
+        }
+        std::string &getSent() { return sent; }
+        size_t getUnacked() { return unacked; } // received and not acknowledged yet, closes the TCP window
+        const char *getHost() { return host.c_str(); }
+        uint16_t getPort() { return port; }
+
+    private:
+        enum State { STATE_DISCONNECTED, STATE_CONNECTING, STATE_CONNECTED };
+
+        State state = STATE_DISCONNECTED;
+        std::string host;
+        uint16_t port = 0;
+        std::string sent;
+        size_t unacked = 0;
+        bool ackDeferred = false;
+        SimTcpConnectHandler connectCallback;
+        SimTcpConnectHandler disconnectCallback;
+        SimTcpDataHandler dataCallback;
+};
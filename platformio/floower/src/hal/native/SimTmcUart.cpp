@@ -0,0 +1,165 @@
+#include "SimTmcUart.h"
+#include "SimHardware.h"
+
+#define TMC_SYNC 0x05
+#define TMC_WRITE 0x80
+#define TMC_MASTER_ADDRESS 0xFF
+
+#define TMC_REG_GSTAT 0x01
+#define TMC_REG_IOIN 0x06
+#define TMC_REG_DRV_STATUS 0x6F
+#define TMC_REG_CHOPCONF 0x6C
+#define TMC_REG_SG_VALUE 0x41
+
+SimTmcUart::SimTmcUart() {
+    reset();
+}
+
+void SimTmcUart::reset() {
+    for (uint8_t i = 0; i < SIM_TMC_REGISTERS; i++) {
+        registers[i] = 0;
+    }
+    // power-on values
+    registers[TMC_REG_IOIN] = 0x40000000; // version 0x40
+    registers[TMC_REG_GSTAT] = 0x1; // reset
+    registers[TMC_REG_CHOPCONF] = 0x13008001;
+    registers[TMC_REG_DRV_STATUS] = 0x80000000; // standstill
+    registers[TMC_REG_SG_VALUE] = SIM_TMC_SG_FREE;
+    sgFree = SIM_TMC_SG_FREE;
+    requestLength = 0;
+    response.clear();
+    readCount = 0;
+    writeCount = 0;
+    connected = true;
+    motorPosition = 0;
+    obstacle = LONG_MAX;
+    stalled = false;
+    stalledSteps = 0;
+}
+
+int SimTmcUart::available() {
+    return response.size();
+}
+
+int SimTmcUart::read() {
+    if (response.empty()) {
+        SimHardware::advance(10); // polling takes time, lets the driver timeouts expire
+        return -1;
+    }
+    uint8_t data = response.front();
+    response.pop_front();
+    return data;
+}
+
+int SimTmcUart::peek() {
+    return response.empty() ? -1 : response.front();
+}
+
+size_t SimTmcUart::write(uint8_t data) {
+    if (!connected) {
+        return 1;
+    }
+    response.push_back(data); // single wire, every byte sent is echoed back
+
+    if (requestLength == 0 && data != TMC_SYNC) {
+        return 1; // wait for sync
+    }
+    request[requestLength++] = data;
+    if ((requestLength == 4 && (request[2] & TMC_WRITE) == 0) || requestLength == 8) {
+        handleRequest();
+        requestLength = 0;
+    }
+    return 1;
+}
+
+void SimTmcUart::handleRequest() {
+    uint8_t address = request[2] & ~TMC_WRITE;
+    if (crc(request, requestLength - 1) != request[requestLength - 1] || address >= SIM_TMC_REGISTERS) {
+        return; // driver ignores invalid datagrams
+    }
+
+    if (request[2] & TMC_WRITE) {
+        uint32_t value = ((uint32_t) request[3] << 24) | ((uint32_t) request[4] << 16) | ((uint32_t) request[5] << 8) | request[6];
+        registers[address] = address == TMC_REG_GSTAT ? registers[address] & ~value : value; // GSTAT flags are cleared by writing them
+        writeCount++;
+    }
+    else {
+        uint32_t value = registers[address];
+        uint8_t reply[8] = {TMC_SYNC, TMC_MASTER_ADDRESS, address, (uint8_t) (value >> 24), (uint8_t) (value >> 16), (uint8_t) (value >> 8), (uint8_t) value, 0};
+        reply[7] = crc(reply, 7);
+        for (uint8_t i = 0; i < 8; i++) {
+            response.push_back(reply[i]);
+        }
+        readCount++;
+    }
+}
+
+void SimTmcUart::setRegister(uint8_t address, uint32_t value) {
+    if (address < SIM_TMC_REGISTERS) {
+        registers[address] = value;
+    }
+}
+
+uint32_t SimTmcUart::getRegister(uint8_t address) {
+    return address < SIM_TMC_REGISTERS ? registers[address] : 0;
+}
+
+uint32_t SimTmcUart::getReadCount() {
+    return readCount;
+}
+
+uint32_t SimTmcUart::getWriteCount() {
+    return writeCount;
+}
+
+void SimTmcUart::setConnected(bool connected) {
+    this->connected = connected;
+}
+
+void SimTmcUart::step(int8_t direction) {
+    stalled = (direction < 0 && motorPosition <= 0) || (direction > 0 && motorPosition >= obstacle);
+    if (stalled) {
+        stalledSteps++;
+    }
+    else {
+        motorPosition += direction;
+    }
+    registers[TMC_REG_SG_VALUE] = stalled ? SIM_TMC_SG_STALLED : sgFree;
+}
+
+void SimTmcUart::setMotorPosition(long position) {
+    motorPosition = position;
+}
+
+void SimTmcUart::setObstacle(long position) {
+    obstacle = position;
+}
+
+void SimTmcUart::setFreeSgValue(uint16_t value) {
+    sgFree = value;
+}
+
+long SimTmcUart::getMotorPosition() {
+    return motorPosition;
+}
+
+uint32_t SimTmcUart::getStalledSteps() {
+    return stalledSteps;
+}
+
+uint8_t SimTmcUart::crc(const uint8_t *datagram, uint8_t length) {
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < length; i++) {
+        uint8_t currentByte = datagram[i];
+        for (uint8_t j = 0; j < 8; j++) {
+            if ((crc >> 7) ^ (currentByte & 0x01)) {
+                crc = (crc << 1) ^ 0x07;
+            }
+            else {
+                crc = (crc << 1);
+            }
+            currentByte = currentByte >> 1;
+        }
+    }
+    return crc;
+}
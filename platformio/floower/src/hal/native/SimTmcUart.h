@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <limits.h>
+#include <deque>
+#include "Stream.h"
+
+#define SIM_TMC_REGISTERS 128
+#define SIM_TMC_SG_FREE 150 // StallGuard result of the motor turning the petals
+#define SIM_TMC_SG_STALLED 5 // StallGuard result of the motor pushing against the closed end-stop
+
+// TMC2300 on the single wire UART, answers register reads and stores register writes. The motor turns the petals
+// which are blocked by the end-stop once closed, the StallGuard result reflects whether the last step turned them.
+class SimTmcUart : public Stream {
+    public:
+        SimTmcUart();
+        void reset(); // power-on registers, petals closed
+
+        int available();
+        int read();
+        int peek();
+        size_t write(uint8_t data);
+
+        void setRegister(uint8_t address, uint32_t value);
+        uint32_t getRegister(uint8_t address);
+        uint32_t getReadCount();
+        uint32_t getWriteCount();
+        void setConnected(bool connected);
+
+        void step(int8_t direction); // STEP pulse, STEP_DIRECTION_CW opens the petals
+        void setMotorPosition(long position); // steps from the closed end-stop
+        long getMotorPosition();
+        void setObstacle(long position); // blocks the petals from opening further
+        void setFreeSgValue(uint16_t value); // StallGuard result of the motor turning the petals
+        uint32_t getStalledSteps(); // steps lost pushing against the end-stop
+
+        static uint8_t crc(const uint8_t *datagram, uint8_t length);
+
+    private:
+        void handleRequest();
+
+        uint32_t registers[SIM_TMC_REGISTERS];
+        uint8_t request[8];
+        uint8_t requestLength = 0;
+        std::deque<uint8_t> response;
+        uint32_t readCount = 0;
+        uint32_t writeCount = 0;
+        bool connected = true;
+
+        long motorPosition = 0;
+        long obstacle = LONG_MAX;
+        bool stalled = false;
+        uint16_t sgFree = SIM_TMC_SG_FREE;
+        uint32_t stalledSteps = 0;
+};
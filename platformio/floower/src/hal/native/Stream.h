@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+class Stream {
+    public:
+        virtual ~Stream() {}
+        virtual int available() = 0;
+        virtual int read() = 0;
+        virtual int peek() = 0;
+        virtual size_t write(uint8_t data) = 0;
+        virtual void flush() {}
+
+        size_t write(const uint8_t *data, size_t size) {
+            size_t written = 0;
+            for (size_t i = 0; i < size; i++) {
+                written += write(data[i]);
+            }
+            return written;
+        }
+};
+
+// serial console, printed to stdout
+class SimSerial : public Stream {
+    public:
+        void begin(unsigned long baudRate) {}
+        int available() { return 0; }
+        int read() { return -1; }
+        int peek() { return -1; }
+        size_t write(uint8_t data) { return fputc(data, stdout) == EOF ? 0 : 1; }
+
+        template<typename T> void print(T value) { printValue(value); }
+        template<typename T> void println(T value) { printValue(value); write('\n'); }
+        void println() { write('\n'); }
+        void printf(const char *format, ...) {
+            va_list args;
+            va_start(args, format);
+            vprintf(format, args);
+            va_end(args);
+        }
+
+    private:
+        void printValue(const char *value) { fputs(value, stdout); }
+        void printValue(char value) { write(value); }
+        void printValue(int value) { ::printf("%d", value); }
+        void printValue(unsigned int value) { ::printf("%u", value); }
+        void printValue(long value) { ::printf("%ld", value); }
+        void printValue(unsigned long value) { ::printf("%lu", value); }
+        void printValue(double value) { ::printf("%.2f", value); }
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+// subset of Arduino String used by the firmware, backed by std::string
+class String {
+    public:
+        String() {}
+        String(const char *value) : value(value != nullptr ? value : "") {}
+        String(const std::string &value) : value(value) {}
+        String(char value) : value(1, value) {}
+        String(int value) : value(std::to_string(value)) {}
+        String(unsigned int value) : value(std::to_string(value)) {}
+        String(long value) : value(std::to_string(value)) {}
+        String(unsigned long value) : value(std::to_string(value)) {}
+        String(unsigned char value) : value(std::to_string(value)) {}
+
+        unsigned int length() const { return value.length(); }
+        const char *c_str() const { return value.c_str(); }
+        bool isEmpty() const { return value.empty(); }
+        long toInt() const { return atol(value.c_str()); }
+        void toCharArray(char *buffer, unsigned int size) const {
+            if (size == 0) {
+                return;
+            }
+            size_t length = value.copy(buffer, size - 1);
+            buffer[length] = '\0';
+        }
+
+        int indexOf(char c) const { return find(value.find(c)); }
+        int indexOf(const String &s) const { return find(value.find(s.value)); }
+        bool startsWith(const String &prefix) const { return value.compare(0, prefix.value.length(), prefix.value) == 0; }
+        String substring(unsigned int from) const { return from < value.length() ? String(value.substr(from)) : String(); }
+        String substring(unsigned int from, unsigned int to) const { return from < value.length() ? String(value.substr(from, to - from)) : String(); }
+        void trim() {
+            size_t start = value.find_first_not_of(" \t\r\n");
+            size_t end = value.find_last_not_of(" \t\r\n");
+            value = start == std::string::npos ? "" : value.substr(start, end - start + 1);
+        }
+
+        char operator[](unsigned int index) const { return index < value.length() ? value[index] : 0; }
+        String &operator+=(const String &s) { value += s.value; return *this; }
+        String &operator+=(const char *s) { value += s; return *this; }
+        String &operator+=(char c) { value += c; return *this; }
+        friend String operator+(const String &a, const String &b) { return String(a.value + b.value); }
+        friend String operator+(const String &a, const char *b) { return String(a.value + b); }
+        friend String operator+(const char *a, const String &b) { return String(a + b.value); }
+        bool operator==(const String &s) const { return value == s.value; }
+        bool operator==(const char *s) const { return value == s; }
+        bool operator!=(const String &s) const { return value != s.value; }
+
+    private:
+        static int find(size_t position) { return position == std::string::npos ? -1 : (int) position; }
+
+        std::string value;
+};
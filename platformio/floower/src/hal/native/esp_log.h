@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdio.h>
+#include "SimHardware.h"
+
+// tag is ignored as with the Arduino logging, lines are printed only in verbose simulation
+#define SIM_LOG(level, format, ...) do { if (SimHardware::isVerbose()) { printf("[%c] " format "\n", level, ##__VA_ARGS__); } } while (0)
+
+#define ESP_LOGE(tag, format, ...) SIM_LOG('E', format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) SIM_LOG('W', format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) SIM_LOG('I', format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) SIM_LOG('D', format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) SIM_LOG('V', format, ##__VA_ARGS__)
@@ -0,0 +1,3 @@
+#pragma once
+
+inline int esp_wifi_stop() { return 0; }
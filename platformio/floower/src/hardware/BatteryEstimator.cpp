@@ -0,0 +1,122 @@
+#include "BatteryEstimator.h"
+
+#define FILTER_WEIGHT 64 // of 256, weight of a new sample at normal load
+#define FILTER_WEIGHT_HIGH_LOAD 16
+#define LOAD_FILTER_WEIGHT 8 // runtime follows the load averaged over about half a minute of samples
+#define CHARGING_UNCERTAINTY 150 // mV, charger lifts the voltage above the open circuit one
+#define HALF_CONFIDENCE_UNCERTAINTY 20 // mV, uncertainty at 50% confidence
+
+struct CurvePoint {
+    uint16_t voltage; // mV, open circuit
+    uint8_t level; // %
+};
+
+// LiPo cell discharged at low rate, flat in the middle and steep at both ends
+static const CurvePoint dischargeCurve[] = {
+    {3300, 0}, {3500, 3}, {3600, 5}, {3680, 10}, {3740, 20}, {3780, 30}, {3810, 40},
+    {3850, 50}, {3890, 60}, {3950, 70}, {4020, 80}, {4090, 90}, {4200, 100}
+};
+static const uint8_t dischargeCurvePoints = sizeof(dischargeCurve) / sizeof(CurvePoint);
+
+static uint32_t filter(uint32_t value, uint32_t sample, uint16_t weight) {
+    return (int32_t) value + ((int32_t) sample - (int32_t) value) * (int32_t) weight / 256;
+}
+
+void BatteryEstimator::reset() {
+    voltage = 0;
+    uncertainty = 0;
+    loadCurrent = 0;
+    samples = 0;
+    lowSamples = 0;
+    charging = false;
+}
+
+void BatteryEstimator::addSample(uint16_t *readings, uint8_t count, uint16_t loadCurrent, bool charging) {
+    if (count == 0) {
+        return;
+    }
+    // insertion sort, the burst is short
+    for (uint8_t i = 1; i < count; i++) {
+        uint16_t reading = readings[i];
+        uint8_t j = i;
+        for (; j > 0 && readings[j - 1] > reading; j--) {
+            readings[j] = readings[j - 1];
+        }
+        readings[j] = reading;
+    }
+
+    uint16_t sag = (uint32_t) loadCurrent * BATTERY_INTERNAL_RESISTANCE / 1000; // mV
+    uint16_t sampleVoltage = toMillivolts(readings[count / 2]) + sag;
+    uint16_t spread = toMillivolts(readings[count * 3 / 4]) - toMillivolts(readings[count / 4]); // interquartile range
+    uint16_t sampleUncertainty = spread + sag / 2 + (charging ? CHARGING_UNCERTAINTY : 0); // resistance is known roughly
+
+    if (charging != this->charging) {
+        samples = 0; // voltage jumps when the charger is connected or done
+        this->charging = charging;
+    }
+    if (samples == 0) {
+        voltage = (uint32_t) sampleVoltage << 8;
+        uncertainty = (uint32_t) sampleUncertainty << 8;
+        this->loadCurrent = (uint32_t) loadCurrent << 8;
+        lowSamples = 0;
+    }
+    else {
+        bool highLoad = loadCurrent >= BATTERY_HIGH_LOAD;
+        voltage = filter(voltage, (uint32_t) sampleVoltage << 8, highLoad ? FILTER_WEIGHT_HIGH_LOAD : FILTER_WEIGHT);
+        uncertainty = filter(uncertainty, (uint32_t) sampleUncertainty << 8, FILTER_WEIGHT);
+        this->loadCurrent = filter(this->loadCurrent, (uint32_t) loadCurrent << 8, LOAD_FILTER_WEIGHT);
+    }
+    if (samples < 0xFFFF) {
+        samples++;
+    }
+
+    // low battery counts only when both the sample and the filtered voltage are low, a low sample taken under high
+    // load does not count, the movement is over in a few seconds
+    bool low = !charging && sampleVoltage < BATTERY_LOW_VOLTAGE && (voltage >> 8) < BATTERY_LOW_VOLTAGE;
+    if (!low) {
+        lowSamples = 0;
+    }
+    else if (loadCurrent < BATTERY_HIGH_LOAD && lowSamples < BATTERY_LOW_SAMPLES) {
+        lowSamples++;
+    }
+}
+
+BatteryEstimate BatteryEstimator::getEstimate() {
+    BatteryEstimate estimate = {0, 0, 0, 0, false};
+    if (samples == 0) {
+        return estimate;
+    }
+    estimate.voltage = (voltage + 128) >> 8;
+    estimate.level = levelFromVoltage(estimate.voltage);
+
+    uint32_t load = (loadCurrent + 128) >> 8;
+    if (!charging && load > 0) {
+        uint32_t runtime = (uint32_t) estimate.level * BATTERY_CAPACITY * 60 / 100 / load;
+        estimate.runtime = runtime > 0xFFFF ? 0xFFFF : runtime;
+    }
+
+    uint32_t settled = samples < BATTERY_SETTLE_SAMPLES ? samples : BATTERY_SETTLE_SAMPLES;
+    uint32_t mv = (uncertainty + 128) >> 8;
+    estimate.confidence = 100 * HALF_CONFIDENCE_UNCERTAINTY * settled / (HALF_CONFIDENCE_UNCERTAINTY + mv) / BATTERY_SETTLE_SAMPLES;
+    estimate.low = lowSamples >= BATTERY_LOW_SAMPLES;
+    return estimate;
+}
+
+uint16_t BatteryEstimator::toMillivolts(uint16_t reading) {
+    // 1/4096 for scale * analog reference voltage 3.6V * 2 for the 1:1 voltage divider + adjustment
+    return (uint32_t) reading * 181 / 100;
+}
+
+uint8_t BatteryEstimator::levelFromVoltage(uint16_t voltage) {
+    if (voltage <= dischargeCurve[0].voltage) {
+        return 0;
+    }
+    for (uint8_t i = 1; i < dischargeCurvePoints; i++) {
+        const CurvePoint &upper = dischargeCurve[i];
+        if (voltage < upper.voltage) {
+            const CurvePoint &lower = dischargeCurve[i - 1];
+            return lower.level + (uint32_t) (voltage - lower.voltage) * (upper.level - lower.level) / (upper.voltage - lower.voltage);
+        }
+    }
+    return 100;
+}
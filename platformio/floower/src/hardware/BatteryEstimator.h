@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+// POWER MANAGEMENT (tuned for 1600mAh LIPO battery)
+
+#define BATTERY_OVERSAMPLING 16 // ADC readings per sample, the median of them is taken
+#define BATTERY_CAPACITY 1600 // mAh
+#define BATTERY_INTERNAL_RESISTANCE 200 // mOhm, cell, protection circuit and wiring
+#define BATTERY_LOW_VOLTAGE 3400 // mV, open circuit voltage to shut down at
+#define BATTERY_LOW_SAMPLES 3 // consecutive samples below the low voltage to confirm it
+#define BATTERY_HIGH_LOAD 150 // mA, compensated voltage is less reliable above, such samples are filtered slowly
+#define BATTERY_SETTLE_SAMPLES 8 // samples until the filter settles
+
+struct BatteryEstimate {
+    uint16_t voltage; // mV, filtered open circuit voltage
+    uint8_t level; // %, state of charge
+    uint16_t runtime; // minutes remaining at the average load, 0 while charging
+    uint8_t confidence; // %, of the voltage and level
+    bool low; // confirmed by consecutive samples, load spikes do not trigger it
+};
+
+// Estimates battery state of charge from bursts of ADC readings. A burst is reduced to its median to drop the
+// spikes of stepper and LEDs PWM, the voltage sag is compensated by the load current known to the caller and the
+// open circuit voltage is low-pass filtered before it's looked up on the LiPo discharge curve.
+class BatteryEstimator {
+    public:
+        void reset();
+        void addSample(uint16_t *readings, uint8_t count, uint16_t loadCurrent, bool charging); // raw ADC, mA, readings get sorted
+        BatteryEstimate getEstimate();
+
+        static uint16_t toMillivolts(uint16_t reading);
+        static uint8_t levelFromVoltage(uint16_t voltage); // mV to %, LiPo discharge curve
+
+    private:
+        uint32_t voltage = 0; // mV in 24.8 fixed point
+        uint32_t uncertainty = 0; // mV in 24.8 fixed point
+        uint32_t loadCurrent = 0; // mA in 24.8 fixed point
+        uint16_t samples = 0;
+        uint8_t lowSamples = 0;
+        bool charging = false;
+};
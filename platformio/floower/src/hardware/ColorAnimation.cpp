@@ -0,0 +1,51 @@
+#include "ColorAnimation.h"
+
+#define HUE_BLEND_MAX_DIFF 0.2 // hue distance to transition over the color wheel
+
+AnimationTables::AnimationTables() {
+    for (uint16_t i = 0; i < HUE_WHEEL_STEPS; i++) {
+        hueWheel[i] = HsbColor((float) i / HUE_WHEEL_STEPS, 1, 1);
+    }
+    for (uint16_t i = 0; i <= EASE_STEPS; i++) {
+        ease[i] = NeoEase::CubicInOut((float) i / EASE_STEPS) * 65535 + 0.5f;
+    }
+}
+
+const AnimationTables animationTables;
+
+void ColorTransition::compile(const HsbColor &origin, const HsbColor &target) {
+    this->origin = origin;
+    this->target = target;
+    float diff = origin.H - target.H;
+    hueBlend = diff < HUE_BLEND_MAX_DIFF && diff > -HUE_BLEND_MAX_DIFF;
+
+    for (uint8_t i = 0; i < TRANSITION_KEYFRAMES; i++) {
+        float progress = (float) i / TRANSITION_KEYFRAMES;
+        if (hueBlend) {
+            keyframes[i] = HsbColor::LinearBlend<NeoHueBlendShortestDistance>(origin, target, progress);
+        }
+        else {
+            keyframes[i] = RgbColor::LinearBlend(origin, target, progress);
+        }
+    }
+    keyframes[TRANSITION_KEYFRAMES] = target; // exactly the target color
+}
+
+RgbColor ColorTransition::rgbAt(uint16_t progress) {
+    uint32_t position = (uint32_t) progress * TRANSITION_KEYFRAMES; // keyframe index in upper 16 bits
+    position += position >> 16; // stretch so that full progress ends exactly at the last keyframe
+    uint8_t index = position >> 16;
+    if (index >= TRANSITION_KEYFRAMES) {
+        return keyframes[TRANSITION_KEYFRAMES];
+    }
+    return blendRgb(keyframes[index], keyframes[index + 1], position & 0xFFFF);
+}
+
+HsbColor ColorTransition::hsbAt(float progress) {
+    if (hueBlend) {
+        return HsbColor::LinearBlend<NeoHueBlendShortestDistance>(origin, target, progress);
+    }
+    else {
+        return RgbColor::LinearBlend(origin, target, progress);
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Arduino.h"
+#include "NeoPixelBus.h"
+
+// Integer color math for LED animations. Effects are compiled into RGB tables once and every frame only interpolates
+// between table entries, no float HSB conversion per pixel and frame.
+// Progress and hue are fixed point 0-65535 for 0.0-1.0, brightness is 0-255.
+
+#define HUE_WHEEL_STEPS 256 // precomputed fully saturated hues
+#define EASE_STEPS 256 // precomputed points of the ease curve
+#define TRANSITION_KEYFRAMES 16 // precomputed colors of a transition
+
+struct AnimationTables {
+    AnimationTables();
+
+    RgbColor hueWheel[HUE_WHEEL_STEPS];
+    uint16_t ease[EASE_STEPS + 1];
+};
+
+extern const AnimationTables animationTables;
+
+inline uint16_t toFixedProgress(float progress) {
+    if (progress <= 0) {
+        return 0;
+    }
+    if (progress >= 1) {
+        return 65535;
+    }
+    return progress * 65535;
+}
+
+inline RgbColor blendRgb(const RgbColor &left, const RgbColor &right, uint16_t progress) {
+    return RgbColor(
+        left.R + (((right.R - left.R) * (int32_t) progress + 32768) >> 16),
+        left.G + (((right.G - left.G) * (int32_t) progress + 32768) >> 16),
+        left.B + (((right.B - left.B) * (int32_t) progress + 32768) >> 16));
+}
+
+inline RgbColor scaleRgb(const RgbColor &color, uint8_t brightness) {
+    uint16_t scale = brightness + 1;
+    return RgbColor((color.R * scale) >> 8, (color.G * scale) >> 8, (color.B * scale) >> 8);
+}
+
+// fully saturated color of the hue
+inline RgbColor hueToRgb(uint16_t hue, uint8_t brightness) {
+    uint8_t index = hue >> 8; // 256 steps, wraps around
+    RgbColor color = blendRgb(animationTables.hueWheel[index], animationTables.hueWheel[(uint8_t) (index + 1)], (hue & 0xFF) << 8);
+    return scaleRgb(color, brightness);
+}
+
+inline uint16_t easeCubicInOut(uint16_t progress) {
+    uint16_t index = progress >> 8;
+    uint16_t left = animationTables.ease[index];
+    uint16_t right = animationTables.ease[index + 1];
+    return left + (((right - left) * (int32_t) (progress & 0xFF)) >> 8);
+}
+
+// transition between two colors, follows the hue for similar colors and blends RGB for distant ones
+class ColorTransition {
+    public:
+        void compile(const HsbColor &origin, const HsbColor &target);
+        RgbColor rgbAt(uint16_t progress);
+        HsbColor hsbAt(float progress); // exact, for reading current color only
+
+    private:
+        HsbColor origin;
+        HsbColor target;
+        bool hueBlend;
+        RgbColor keyframes[TRANSITION_KEYFRAMES + 1];
+};
@@ -0,0 +1,98 @@
+#include "DriverHealth.h"
+
+#define EVENT_TIME_SHIFT 9
+#define EVENT_FAULT_SHIFT 5
+#define EVENT_IRUN_MASK 0x1F
+
+void DriverHealth::begin(uint8_t irun) {
+    irunMax = irun;
+    this->irun.store(irun, std::memory_order_relaxed);
+    activeFaults = 0;
+}
+
+bool DriverHealth::isSampleDue(unsigned long now) {
+    return now - sampleTime >= HEALTH_SAMPLING_PERIOD;
+}
+
+void DriverHealth::addSample(bool ok, const TMC2300Status &status, unsigned long now) {
+    sampleTime = now;
+    samples.fetch_add(1, std::memory_order_relaxed);
+
+    uint16_t faults = 0;
+    if (!ok) {
+        faults |= 1 << FAULT_UART;
+    }
+    else {
+        const REG_DRV_STATUS &drvStatus = status.drvStatus;
+        faults |= status.gstat.reset << FAULT_RESET;
+        faults |= status.gstat.drv_err << FAULT_DRIVER_ERROR;
+        faults |= status.gstat.u3v5 << FAULT_UNDERVOLTAGE;
+        faults |= drvStatus.otpw << FAULT_OVERTEMP_WARNING;
+        faults |= drvStatus.ot << FAULT_OVERTEMP;
+        faults |= (drvStatus.s2ga || drvStatus.s2gb || drvStatus.s2vsa || drvStatus.s2vsb) << FAULT_SHORT;
+        faults |= (drvStatus.ola || drvStatus.olb) << FAULT_OPEN_LOAD;
+    }
+    uint16_t appeared = faults & ~activeFaults;
+    activeFaults = faults;
+    for (uint8_t fault = 0; fault < DRIVER_FAULTS; fault++) {
+        if (appeared & (1 << fault)) {
+            record((DriverFault) fault, now);
+        }
+    }
+    if (!ok) {
+        return;
+    }
+
+    // derate the run current while the driver is hot, restore it slowly once it is not
+    uint8_t current = irun.load(std::memory_order_relaxed);
+    if (status.drvStatus.ot) {
+        current = HEALTH_IRUN_MIN; // shut down already, come back cool
+        derateTime = now;
+        warningTime = now;
+    }
+    else if (status.drvStatus.otpw) {
+        if ((appeared & (1 << FAULT_OVERTEMP_WARNING)) || now - derateTime >= HEALTH_DERATE_PERIOD) {
+            current = current > HEALTH_IRUN_MIN + HEALTH_IRUN_STEP ? current - HEALTH_IRUN_STEP : HEALTH_IRUN_MIN;
+            derateTime = now;
+        }
+        warningTime = now;
+    }
+    else if (current < irunMax && now - warningTime >= HEALTH_RESTORE_PERIOD && now - derateTime >= HEALTH_RESTORE_PERIOD) {
+        current = _min(current + HEALTH_IRUN_STEP, irunMax);
+        derateTime = now;
+    }
+    irun.store(_min(current, irunMax), std::memory_order_relaxed);
+}
+
+uint8_t DriverHealth::getIrun() {
+    return irun.load(std::memory_order_relaxed);
+}
+
+uint32_t DriverHealth::getSamples() {
+    return samples.load(std::memory_order_relaxed);
+}
+
+uint32_t DriverHealth::getFaultCount(DriverFault fault) {
+    return fault < DRIVER_FAULTS ? faultCounts[fault].load(std::memory_order_relaxed) : 0;
+}
+
+uint8_t DriverHealth::getEvents(DriverFaultEvent *events, uint8_t maxEvents) {
+    uint32_t count = eventsCount.load(std::memory_order_acquire);
+    uint8_t length = 0;
+    while (length < maxEvents && length < HEALTH_EVENTS && length < count) {
+        uint32_t event = this->events[(count - 1 - length) & (HEALTH_EVENTS - 1)].load(std::memory_order_relaxed);
+        events[length].time = event >> EVENT_TIME_SHIFT;
+        events[length].fault = (event >> EVENT_FAULT_SHIFT) & 0xF;
+        events[length].irun = event & EVENT_IRUN_MASK;
+        length++;
+    }
+    return length;
+}
+
+void DriverHealth::record(DriverFault fault, unsigned long now) {
+    faultCounts[fault].fetch_add(1, std::memory_order_relaxed);
+    uint32_t event = ((uint32_t) (now / 1000) << EVENT_TIME_SHIFT) | ((uint32_t) fault << EVENT_FAULT_SHIFT) | (irun.load(std::memory_order_relaxed) & EVENT_IRUN_MASK);
+    uint32_t count = eventsCount.load(std::memory_order_relaxed);
+    events[count & (HEALTH_EVENTS - 1)].store(event, std::memory_order_relaxed);
+    eventsCount.store(count + 1, std::memory_order_release);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <tmc2300.h>
+
+#define HEALTH_SAMPLING_PERIOD 500 // ms, while the driver is enabled
+#define HEALTH_EVENTS 16 // fault events kept, power of two
+#define HEALTH_IRUN_MIN 16 // run current derating stops here, about half of the torque
+#define HEALTH_IRUN_STEP 3
+#define HEALTH_DERATE_PERIOD 5000 // ms, between derating steps while the warning lasts
+#define HEALTH_RESTORE_PERIOD 60000 // ms without the warning to restore a derating step
+
+enum DriverFault {
+    FAULT_UART, // status not read
+    FAULT_RESET, // driver was reset, configuration is lost
+    FAULT_DRIVER_ERROR, // driver shut down by overtemperature or short
+    FAULT_UNDERVOLTAGE,
+    FAULT_OVERTEMP_WARNING,
+    FAULT_OVERTEMP,
+    FAULT_SHORT, // to ground or supply
+    FAULT_OPEN_LOAD,
+    DRIVER_FAULTS
+};
+
+struct DriverFaultEvent {
+    uint32_t time; // s since boot
+    uint8_t fault;
+    uint8_t irun; // run current when it happened
+};
+
+// Watches the stepper driver status sampled by the petals. Faults are counted when they appear and logged to a ring
+// of the latest events, overtemperature warnings derate the run current step by step until the warning is gone and
+// restore it once the driver cooled down. Samples are fed from the motion task, counters and events can be read from
+// any core.
+class DriverHealth {
+    public:
+        void begin(uint8_t irun); // configured run current
+        bool isSampleDue(unsigned long now); // ms
+        void addSample(bool ok, const TMC2300Status &status, unsigned long now); // ms
+        uint8_t getIrun(); // derated run current
+
+        uint32_t getSamples();
+        uint32_t getFaultCount(DriverFault fault);
+        uint8_t getEvents(DriverFaultEvent *events, uint8_t maxEvents); // latest first, returns count
+
+    private:
+        void record(DriverFault fault, unsigned long now);
+
+        uint8_t irunMax = 31;
+        std::atomic<uint8_t> irun {31};
+        unsigned long sampleTime = 0;
+        unsigned long derateTime = 0;
+        unsigned long warningTime = 0;
+        uint16_t activeFaults = 0; // bit mask of faults present in the last sample
+
+        std::atomic<uint32_t> samples {0};
+        std::atomic<uint32_t> faultCounts[DRIVER_FAULTS] = {};
+        std::atomic<uint32_t> events[HEALTH_EVENTS] = {}; // packed time, fault and run current
+        std::atomic<uint32_t> eventsCount {0};
+};
@@ -0,0 +1,89 @@
+#include "StepGenerator.h"
+
+void FakeStepGenerator::begin() {
+}
+
+bool FakeStepGenerator::start(const StepSchedule &schedule, int8_t direction) {
+    stop();
+    if (schedule.size == 0) {
+        return false;
+    }
+
+    this->schedule = schedule;
+    this->direction = direction;
+    segmentIndex = 0;
+    segmentSteps = schedule.segments[0].steps;
+    nextStepTime = time + schedule.segments[0].interval;
+    running = true;
+    return true;
+}
+
+void FakeStepGenerator::stop() {
+    running = false;
+}
+
+bool FakeStepGenerator::isRunning() {
+    return running;
+}
+
+long FakeStepGenerator::getPosition() {
+    return position;
+}
+
+void FakeStepGenerator::setPosition(long position) {
+    if (!running) {
+        this->position = position;
+    }
+}
+
+uint32_t FakeStepGenerator::getInterval() {
+    uint8_t index = segmentIndex;
+    if (!running || index >= schedule.size) {
+        return 0;
+    }
+    return schedule.segments[index].interval;
+}
+
+uint32_t FakeStepGenerator::getDeadlineMisses() {
+    return 0;
+}
+
+void FakeStepGenerator::advance(uint32_t us) {
+    uint32_t endTime = time + us;
+    while (running && nextStepTime <= endTime) {
+        time = nextStepTime;
+        position += direction;
+        stepCount++;
+        segmentSteps--;
+        if (stepCallback != nullptr) {
+            stepCallback(time, position);
+        }
+
+        if (segmentSteps == 0) {
+            segmentIndex++;
+            if (segmentIndex >= schedule.size) {
+                running = false;
+                break;
+            }
+            segmentSteps = schedule.segments[segmentIndex].steps;
+        }
+        nextStepTime = time + schedule.segments[segmentIndex].interval;
+    }
+    time = endTime;
+}
+
+void FakeStepGenerator::onStep(StepCallback callback) {
+    stepCallback = callback;
+}
+
+int8_t FakeStepGenerator::getDirection() {
+    return direction;
+}
+
+uint32_t FakeStepGenerator::getTime() {
+    return time;
+}
+
+uint32_t FakeStepGenerator::getStepCount() {
+    return stepCount;
+}
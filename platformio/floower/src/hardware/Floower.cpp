@@ -1,4 +1,5 @@
 #include "Floower.h"
+#include "hal/Hal.h"
 
 #if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
 #include "esp32-hal-log.h"
@@ -19,9 +20,26 @@ static const char* LOG_TAG = "Floower";
 #define ACTY_LED_PIN GPIO_NUM_2
 #define ACTY_BLINK_TIME 50
 
-#define ANIMATIONS_INDECES 3
-#define ANIMATION_INDEX_LEDS 1
+#define STATUS_PIXEL_INDEX PIXELS_COUNT // status LED is composed after the petals pixels
+#define PETALS_PIXELS_MASK ((1 << PIXELS_COUNT) - 1)
+
+// LED frame rates by animation, as low as possible without visible steps
+#define FRAME_RATE_STATIC 20 // fps, solid color changed only by commands
+#define FRAME_RATE_TRANSITION 60 // color transitions and flashes
+#define FRAME_RATE_SLOW_FADE 30 // rainbow and circle
+#define FRAME_RATE_FLICKER 40 // candle
+#define LEDS_REPORT_INTERVAL 10000 // ms
+#define LEDS_RETRY_INTERVAL 1 // ms, frame not accepted by the motion task
+#define MOTION_POLL_INTERVAL 10 // ms, petals moving longer than planned or the motion task not yet settled
+#define PIXELS_GAMMA GAMMA_2_2 // color brightness is perceived brightness
+#define BATTERY_SAVING_LEVEL 20 // %, LEDs are dimmed on battery below it
+#define BATTERY_SAVING_HYSTERESIS 5 // %, dimmed LEDs draw less and the compensated level rises
+#define BATTERY_SAVING_BRIGHTNESS 153 // max channel level of the dimmed LEDs, 60%
+
+#define ANIMATIONS_INDECES 4
+#define ANIMATION_INDEX_LEDS 1 // base color
 #define ANIMATION_INDEX_STATUS 2
+#define ANIMATION_INDEX_EFFECT 3 // circle, rainbow loop and candle over the base color
 
 #define TOUCH_SENSOR_PIN GPIO_NUM_4
 #define TOUCH_FADE_TIME 75 // 50
@@ -34,21 +52,25 @@ unsigned long Floower::touchEndedTime = 0;
 unsigned long Floower::lastTouchTime = 0;
 
 const HsbColor candleColor(0.042, 1.0, 1.0); // candle orange color
+const RgbColor candleRgbColor(candleColor);
 
 Floower::Floower(Config *config) 
-        : animations(ANIMATIONS_INDECES), config(config), pixels(7, NEOPIXEL_PIN), statusPixel(2, STATUS_NEOPIXEL_PIN) {
+        : animations(ANIMATIONS_INDECES), config(config), motionTask(NEOPIXEL_PIN, STATUS_NEOPIXEL_PIN), compositor(PIXELS_COUNT + 1) {
 }
 
 void Floower::init() {
     // petals instance
+    Petals *petals;
     if (config->hardwareRevision >= 9 || !config->calibrated) {
         ESP_LOGI(LOG_TAG, "Using STEPPER");
-        petals = new StepperPetals(config);
+        petals = new StepperPetals(config, &driverHealth);
     }
     else {
         ESP_LOGI(LOG_TAG, "Using SERVO");
         petals = new ServoPetals(config);
     }
+    motionTask.init(petals);
+    motionTask.setGamma(PIXELS_GAMMA);
 
     // LEDs
     pixelsPowerOn = true; // to make setPixelsPowerOn effective
@@ -58,14 +80,10 @@ void Floower::init() {
     pixelsColor = colorBlack;
     pixelsOriginColor = colorBlack;
     pixelsTargetColor = colorBlack;
-    pixels.Begin();
-    pixels.ClearTo(pixelsColor);
-    pixels.Show();
-
     statusColor = colorBlack;
-    statusPixel.Begin();
-    statusPixel.SetPixelColor(0, statusColor);
-    statusPixel.Show();
+    showColor(pixelsColor);
+    setStatusColor(statusColor);
+    compositor.compose(); // strips were cleared by the motion task init
 
     // configure ADC for battery level reading
     analogReadResolution(12); // se0t 12bit resolution (0-4095)
@@ -78,27 +96,52 @@ void Floower::init() {
     esp_sleep_enable_ext1_wakeup(0x800000000, ESP_EXT1_WAKEUP_ALL_LOW);
 }
 
+void Floower::startMotionTask() {
+    motionTask.begin();
+}
+
 void Floower::initPetals(bool initial, bool wokeUp) {
-    petals->init(initial, wokeUp);
+    motionTask.initPetals(initial, wokeUp);
 }
 
 void Floower::update() {
-    petals->update();
     animations.UpdateAnimations();
 
-    // show pixels
-    if (pixelsColor.B > 0) {
-        setPixelsPowerOn(true);
-        if (pixels.IsDirty() && pixels.CanShow()) {
-            pixels.Show();
+    // show pixels, only when the composed frame changed
+    if (compositor.compose()) {
+        for (uint8_t i = 0; i < PIXELS_COUNT; i++) {
+            leds.pixels[i] = compositor.getPixel(i);
         }
+        leds.status = compositor.getPixel(STATUS_PIXEL_INDEX);
+        ledsChanged = true;
+        ledsLight = lightOf(leds);
+    }
+    uint8_t frameRate = getAnimationsFrameRate();
+    if (frameRate == 0) {
+        frameRate = FRAME_RATE_STATIC;
+    }
+    if (frameRate != motionTaskFrameRate) {
+        motionTaskFrameRate = frameRate;
+        motionTask.setPixelsFrameRate(frameRate);
+    }
+    reportLedsIfDue();
+
+    if (arePixelsLit()) {
+        setPixelsPowerOn(true);
     }
     else if (pixelsPowerOn) {
-        pixels.Show();
         setPixelsPowerOn(false);
     }
-    if (statusPixel.IsDirty() && statusPixel.CanShow()) {
-        statusPixel.Show();
+    if (ledsChanged && motionTask.showLeds(leds)) {
+        ledsChanged = false; // otherwise retry with the next update
+    }
+    if (!motionTask.isRunning()) {
+        motionTask.run();
+    }
+    if (energyLedger != nullptr) {
+        energyLedger->setState(ENERGY_STEPPER, motionTask.arePetalsEnabled() ? POWER_ON : POWER_OFF);
+        energyLedger->setState(ENERGY_LEDS, pixelsPowerOn ? POWER_ON : POWER_OFF);
+        energyLedger->setLedsLight(pixelsPowerOn ? ledsLight : 0);
     }
 
     unsigned long now = millis();
@@ -150,6 +193,54 @@ void Floower::update() {
     }
 }
 
+void Floower::planIdle(IdleScheduler &scheduler) {
+    if (ledsChanged) {
+        scheduler.wakeIn(LEDS_RETRY_INTERVAL);
+    }
+    if (animations.IsAnimating()) {
+        // animations are calculated here, the next frame is the deadline
+        uint8_t frameRate = getAnimationsFrameRate();
+        scheduler.wakeIn(1000 / (frameRate > 0 ? frameRate : FRAME_RATE_SLOW_FADE)); // status animation only
+        scheduler.preventLightSleep();
+    }
+    bool petalsMoving = motionTask.arePetalsMoving();
+    if (petalsMoving || !motionTask.isSettled()) {
+        scheduler.preventLightSleep();
+        if (!motionTask.isRunning()) {
+            scheduler.wakeIn(MOTION_TASK_PERIOD); // petals and LEDs are driven by the loop itself
+        }
+        else if (petalsMoving) {
+            long remaining = (long) (petalsMovementEndTime - millis());
+            scheduler.wakeIn(remaining > 0 ? remaining : MOTION_POLL_INTERVAL);
+        }
+        else {
+            scheduler.wakeIn(MOTION_POLL_INTERVAL);
+        }
+    }
+
+    if (touchStartedTime > 0) {
+        if (!longTouchRegistered) {
+            scheduler.wakeAt(touchStartedTime + TOUCH_LONG_TIME_THRESHOLD + 1);
+        }
+        if (!holdTouchRegistered) {
+            scheduler.wakeAt(touchStartedTime + TOUCH_HOLD_TIME_THRESHOLD + 1);
+        }
+        scheduler.wakeAt(lastTouchTime + TOUCH_FADE_TIME + 1);
+        scheduler.preventLightSleep(); // the touch ISR keeps measuring the touch
+    }
+    else if (touchEndedTime > 0) {
+        scheduler.wakeAt(touchEndedTime + TOUCH_COOLDOWN_TIME + 1);
+    }
+}
+
+void Floower::setEnergyLedger(EnergyLedger *energyLedger) {
+    this->energyLedger = energyLedger;
+}
+
+DriverHealth *Floower::getDriverHealth() {
+    return &driverHealth;
+}
+
 void Floower::registerOutsideTouch() {
     touchISR();
 }
@@ -180,6 +271,7 @@ void Floower::touchISR() {
     lastTouchTime = millis();
     if (touchStartedTime == 0 && touchEndedTime == 0) {
         touchStartedTime = lastTouchTime;
+        halWakeUpFromISR(); // touch down is handled without waiting for the idle loop
     }
 }
 
@@ -192,20 +284,26 @@ void Floower::onChange(FloowerChangeCallback callback) {
 }
 
 void Floower::setPetalsOpenLevel(int8_t level, int transitionTime) {
-    petals->setPetalsOpenLevel(level, transitionTime);
-    wasChanged = true;
+    if (motionTask.setPetalsOpenLevel(level, transitionTime)) {
+        petalsMovementEndTime = millis() + transitionTime;
+        wasChanged = true;
+    }
 }
 
 int8_t Floower::getPetalsOpenLevel() {
-    return petals->getPetalsOpenLevel();
+    return motionTask.getPetalsOpenLevel();
 }
 
 int8_t Floower::getCurrentPetalsOpenLevel() {
-    return petals->getCurrentPetalsOpenLevel();
+    return motionTask.getCurrentPetalsOpenLevel();
 }
 
 bool Floower::arePetalsMoving() {
-    return petals->arePetalsMoving();
+    return motionTask.arePetalsMoving();
+}
+
+uint32_t Floower::getPetalsDeadlineMisses() {
+    return motionTask.getDeadlineMisses();
 }
 
 void Floower::transitionColorBrightness(double brightness, int transitionTime) {
@@ -219,6 +317,7 @@ void Floower::transitionColor(double hue, double saturation, double brightness,
     if (hue == pixelsTargetColor.H && saturation == pixelsTargetColor.S && brightness == pixelsTargetColor.B) {
         return; // no change
     }
+    syncPixelsColor();
 
     // make smooth transition
     if (pixelsColor.B == 0) { // current color is black
@@ -232,6 +331,9 @@ void Floower::transitionColor(double hue, double saturation, double brightness,
 
     pixelsTargetColor = HsbColor(hue, saturation, brightness);
     interruptiblePixelsAnimation = false;
+    if (interruptibleEffect || brightness == 0) {
+        stopEffect(); // new color replaces the color mode, turning the light off ends the indications too
+    }
 
     ESP_LOGI(LOG_TAG, "Color %.2f,%.2f,%.2f", pixelsTargetColor.H, pixelsTargetColor.S, pixelsTargetColor.B);
 
@@ -241,6 +343,8 @@ void Floower::transitionColor(double hue, double saturation, double brightness,
     }
     else {
         pixelsOriginColor = pixelsColor;
+        pixelsTransition.compile(pixelsOriginColor, pixelsTargetColor);
+        pixelsFrameRate = FRAME_RATE_TRANSITION;
         animations.StartAnimation(ANIMATION_INDEX_LEDS, transitionTime, [=](const AnimationParam& param){ pixelsTransitionAnimationUpdate(param); });  
     }
 
@@ -248,34 +352,43 @@ void Floower::transitionColor(double hue, double saturation, double brightness,
 }
 
 void Floower::pixelsTransitionAnimationUpdate(const AnimationParam& param) {
-    double diff = pixelsOriginColor.H - pixelsTargetColor.H;
-    if (diff < 0.2 && diff > -0.2) {
-        pixelsColor = HsbColor::LinearBlend<NeoHueBlendShortestDistance>(pixelsOriginColor, pixelsTargetColor, param.progress);
+    // current HSB color is calculated only when someone asks for it
+    pixelsTransitionProgress = param.progress;
+    pixelsColorOutdated = param.state != AnimationState_Completed;
+    if (!pixelsColorOutdated) {
+        pixelsColor = pixelsTargetColor;
     }
-    else {
-        pixelsColor = RgbColor::LinearBlend(pixelsOriginColor, pixelsTargetColor, param.progress);
+    showPixelsColor(pixelsTransition.rgbAt(toFixedProgress(param.progress)));
+}
+
+void Floower::syncPixelsColor() {
+    if (pixelsColorOutdated) {
+        pixelsColor = pixelsTransition.hsbAt(pixelsTransitionProgress);
+        pixelsColorOutdated = false;
     }
-    showColor(pixelsColor);
 }
 
 void Floower::flashColor(double hue, double saturation, int flashDuration) {
+    pixelsColorOutdated = false;
     pixelsTargetColor = HsbColor(hue, saturation, 1.0);
+    pixelsRgbColor = pixelsTargetColor;
     pixelsColor = pixelsTargetColor;
     pixelsColor.B = 0;
 
     interruptiblePixelsAnimation = false;
+    if (interruptibleEffect) {
+        stopEffect();
+    }
+    pixelsFrameRate = FRAME_RATE_TRANSITION;
     animations.StartAnimation(ANIMATION_INDEX_LEDS, flashDuration, [=](const AnimationParam& param){ pixelsFlashAnimationUpdate(param); });
 }
 
 void Floower::pixelsFlashAnimationUpdate(const AnimationParam& param) {
-    if (param.progress < 0.5) {
-        pixelsColor.B = NeoEase::CubicInOut(param.progress * 2);
-    }
-    else {
-        pixelsColor.B = NeoEase::CubicInOut((1 - param.progress) * 2);
-    }
+    uint16_t progress = toFixedProgress(param.progress);
+    uint16_t brightness = easeCubicInOut(progress < 32768 ? progress * 2 : (65535 - progress) * 2);
+    pixelsColor.B = brightness / 65535.0f;
 
-    showColor(pixelsColor);
+    showPixelsColor(scaleRgb(pixelsRgbColor, brightness >> 8));
 
     if (param.state == AnimationState_Completed) {
         if (pixelsTargetColor.B > 0) { // while there is something to show
@@ -285,32 +398,27 @@ void Floower::pixelsFlashAnimationUpdate(const AnimationParam& param) {
 }
 
 void Floower::circleColor(double hue, double saturation, int flashDuration) {
-    pixelsTargetColor = HsbColor(hue, saturation, 1.0);
-    pixelsColor = pixelsTargetColor;
-
-    interruptiblePixelsAnimation = false;
-    animations.StartAnimation(ANIMATION_INDEX_LEDS, flashDuration, [=](const AnimationParam& param){ pixelsCircleAnimationUpdate(param); });
+    // indication over the base color, runs until stopped
+    effectRgbColor = HsbColor(hue, saturation, 1.0);
+    interruptibleEffect = false;
+    effectFrameRate = FRAME_RATE_SLOW_FADE;
+    animations.StartAnimation(ANIMATION_INDEX_EFFECT, flashDuration, [=](const AnimationParam& param){ pixelsCircleAnimationUpdate(param); });
 }
 
 void Floower::pixelsCircleAnimationUpdate(const AnimationParam& param) {
+    const uint8_t brightness[] = {255, 140, 25}; // head and fading tail
     int index = (param.progress * 6) + 1;
-    float brightness = 1;
 
-    pixels.ClearTo(colorBlack);
-    for (uint8_t i = 0; i < 3; i++, index--, brightness -= 0.45) {
+    compositor.clear(LAYER_EFFECT); // the rest of the petals shows the base color
+    for (uint8_t i = 0; i < 3; i++, index--) {
         if (index < 1) {
             index += 6;
         }
-        if (brightness < 0) {
-            brightness = 0;
-        }
-        pixels.SetPixelColor(index, HsbColor(pixelsColor.H, pixelsColor.S, brightness));
+        setPixelColor(index, scaleRgb(effectRgbColor, brightness[i]));
     }
 
     if (param.state == AnimationState_Completed) {
-        if (pixelsTargetColor.B > 0) { // while there is something to show
-            animations.RestartAnimation(param.index);
-        }
+        animations.RestartAnimation(param.index);
     }
 }
 
@@ -319,44 +427,75 @@ HsbColor Floower::getColor() {
 }
 
 HsbColor Floower::getCurrentColor() {
+    syncPixelsColor();
     return pixelsColor;
 }
 
 void Floower::startAnimation(uint8_t animation) {
+    syncPixelsColor();
     interruptiblePixelsAnimation = true;
 
     if (animation == RAINBOW) {
+        if (interruptibleEffect) {
+            stopEffect();
+        }
         pixelsOriginColor = pixelsColor;
+        pixelsFrameRate = FRAME_RATE_SLOW_FADE;
         animations.StartAnimation(ANIMATION_INDEX_LEDS, 10000, [=](const AnimationParam& param){ pixelsRainbowAnimationUpdate(param); });
     }
-    else if (animation == RAINBOW_LOOP) {
-        pixelsTargetColor = pixelsColor = colorWhite;
-        animations.StartAnimation(ANIMATION_INDEX_LEDS, 10000, [=](const AnimationParam& param){ pixelsRainbowLoopAnimationUpdate(param); });
-    }
-    else if (animation == CANDLE) {
-        pixelsTargetColor = pixelsColor = candleColor; // candle orange
-        for (uint8_t i = 0; i < 6; i++) {
-            candleOriginColors[i] = pixelsTargetColor;
-            candleTargetColors[i] = pixelsTargetColor;
+    else if (animation == RAINBOW_LOOP || animation == CANDLE) {
+        // effects covering all the petals, the base color under them is the one retained when they stop
+        animations.StopAnimation(ANIMATION_INDEX_LEDS);
+        pixelsTargetColor = pixelsColor = animation == CANDLE ? candleColor : colorWhite;
+        showColor(pixelsColor);
+        interruptibleEffect = true;
+        if (animation == CANDLE) {
+            for (uint8_t i = 0; i < 6; i++) {
+                candleOriginBrightness[i] = 255;
+                candleTargetBrightness[i] = 255;
+            }
+            effectFrameRate = FRAME_RATE_FLICKER;
+            animations.StartAnimation(ANIMATION_INDEX_EFFECT, 100, [=](const AnimationParam& param){ pixelsCandleAnimationUpdate(param); });
+        }
+        else {
+            effectFrameRate = FRAME_RATE_SLOW_FADE;
+            animations.StartAnimation(ANIMATION_INDEX_EFFECT, 10000, [=](const AnimationParam& param){ pixelsRainbowLoopAnimationUpdate(param); });
         }
-        animations.StartAnimation(ANIMATION_INDEX_LEDS, 100, [=](const AnimationParam& param){ pixelsCandleAnimationUpdate(param); });
     }
 }
 
 void Floower::stopAnimation(bool retainColor) {
     animations.StopAnimation(ANIMATION_INDEX_LEDS);
+    stopEffect();
+    syncPixelsColor();
     if (retainColor) {
         pixelsTargetColor = pixelsColor;
     }
 }
 
+void Floower::stopEffect() {
+    animations.StopAnimation(ANIMATION_INDEX_EFFECT);
+    compositor.clear(LAYER_EFFECT);
+}
+
+uint8_t Floower::getAnimationsFrameRate() {
+    uint8_t frameRate = 0;
+    if (animations.IsAnimationActive(ANIMATION_INDEX_LEDS)) {
+        frameRate = pixelsFrameRate;
+    }
+    if (animations.IsAnimationActive(ANIMATION_INDEX_EFFECT)) {
+        frameRate = _max(frameRate, effectFrameRate);
+    }
+    return frameRate;
+}
+
 void Floower::pixelsRainbowAnimationUpdate(const AnimationParam& param) {
     float hue = pixelsOriginColor.H + param.progress;
     if (hue >= 1.0) {
         hue = hue - 1;
     }
     pixelsColor = HsbColor(hue, 1, pixelsOriginColor.B);
-    showColor(pixelsColor);
+    showPixelsColor(hueToRgb(toFixedProgress(hue), pixelsOriginColor.B * 255));
 
     if (param.state == AnimationState_Completed) {
         if (pixelsTargetColor.B > 0) { // while there is something to show
@@ -366,14 +505,11 @@ void Floower::pixelsRainbowAnimationUpdate(const AnimationParam& param) {
 }
 
 void Floower::pixelsRainbowLoopAnimationUpdate(const AnimationParam& param) {
-    double hue = param.progress;
-    double step = 1.0 / 6.0;
-    pixels.SetPixelColor(0, HsbColor(param.progress, 1, config->colorBrightnessDecimal));
-    for (uint8_t i = 1; i < 7; i++, hue += step) {
-        if (hue >= 1.0) {
-            hue = hue - 1;
-        }
-        pixels.SetPixelColor(i, HsbColor(hue, 1, config->colorBrightnessDecimal));
+    uint16_t hue = toFixedProgress(param.progress);
+    uint8_t brightness = config->colorBrightnessDecimal * 255;
+    setPixelColor(0, hueToRgb(hue, brightness));
+    for (uint8_t i = 1; i < 7; i++, hue += 65536 / 6) { // wraps around the color wheel
+        setPixelColor(i, hueToRgb(hue, brightness));
     }
     if (param.state == AnimationState_Completed) {
         animations.RestartAnimation(param.index);
@@ -381,22 +517,77 @@ void Floower::pixelsRainbowLoopAnimationUpdate(const AnimationParam& param) {
 }
 
 void Floower::pixelsCandleAnimationUpdate(const AnimationParam& param) {
-    pixels.SetPixelColor(0, pixelsTargetColor);
+    // flames differ in brightness only, hue and saturation stay
+    uint16_t progress = toFixedProgress(param.progress);
+    setPixelColor(0, candleRgbColor);
     for (uint8_t i = 0; i < 6; i++) {
-        pixels.SetPixelColor(i + 1, HsbColor::LinearBlend<NeoHueBlendShortestDistance>(candleOriginColors[i], candleTargetColors[i], param.progress));
+        uint8_t brightness = candleOriginBrightness[i] + (((candleTargetBrightness[i] - candleOriginBrightness[i]) * (int32_t) progress + 32768) >> 16);
+        setPixelColor(i + 1, scaleRgb(candleRgbColor, brightness));
     }
 
     if (param.state == AnimationState_Completed) {
         for (uint8_t i = 0; i < 6; i++) {
-            candleOriginColors[i] = candleTargetColors[i];
-            candleTargetColors[i] = HsbColor(candleColor.H, candleColor.S, random(20, 100) / 100.0);
+            candleOriginBrightness[i] = candleTargetBrightness[i];
+            candleTargetBrightness[i] = random(20, 100) * 255 / 100;
         }
         animations.StartAnimation(param.index, random(10, 400), [=](const AnimationParam& param){ pixelsCandleAnimationUpdate(param); });
     }
 }
 
 void Floower::showColor(HsbColor color) {
-    pixels.ClearTo(color);
+    showPixelsColor(color);
+}
+
+void Floower::showPixelsColor(RgbColor color) {
+    compositor.fill(LAYER_BASE, color, PETALS_PIXELS_MASK);
+}
+
+bool Floower::arePixelsLit() {
+    for (uint8_t i = 0; i < PIXELS_COUNT; i++) {
+        if (compositor.getPixel(i) != RgbColor(0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Floower::setPixelColor(uint8_t index, RgbColor color) {
+    if (index < PIXELS_COUNT) {
+        compositor.setPixel(LAYER_EFFECT, index, color);
+    }
+}
+
+void Floower::setStatusColor(RgbColor color) {
+    compositor.setPixel(LAYER_STATUS, STATUS_PIXEL_INDEX, color);
+}
+
+FrameStats Floower::getPixelsFrameStats() {
+    return motionTask.getPixelsFrameStats();
+}
+
+FrameStats Floower::getStatusPixelsFrameStats() {
+    return motionTask.getStatusPixelsFrameStats();
+}
+
+void Floower::reportLedsIfDue() {
+    unsigned long now = millis();
+    if (now - ledsReportTime < LEDS_REPORT_INTERVAL) {
+        return;
+    }
+    ledsReportTime = now;
+    FrameStats stats = getPixelsFrameStats();
+    if (stats.shown != ledsReportedFrames) { // quiet while nothing is shown
+        ledsReportedFrames = stats.shown;
+        ESP_LOGI(LOG_TAG, "LEDs %d/%d fps, shown %u, skipped %u", stats.fps, stats.targetFps, stats.shown, stats.skipped);
+    }
+}
+
+void Floower::setBrightnessLimit(uint8_t limit) {
+    compositor.setBrightnessLimit(limit);
+}
+
+void Floower::setGamma(GammaCurve curve) {
+    motionTask.setGamma(curve);
 }
 
 bool Floower::isLit() {
@@ -404,16 +595,17 @@ bool Floower::isLit() {
 }
 
 bool Floower::isAnimating() {
-    return animations.IsAnimationActive(ANIMATION_INDEX_LEDS) || petals->arePetalsMoving();
+    return animations.IsAnimationActive(ANIMATION_INDEX_LEDS) || animations.IsAnimationActive(ANIMATION_INDEX_EFFECT) || motionTask.arePetalsMoving();
 }
 
 bool Floower::isChangingColor() {
-    return (!interruptiblePixelsAnimation && animations.IsAnimationActive(ANIMATION_INDEX_LEDS));
+    return (!interruptiblePixelsAnimation && animations.IsAnimationActive(ANIMATION_INDEX_LEDS))
+        || (!interruptibleEffect && animations.IsAnimationActive(ANIMATION_INDEX_EFFECT));
 }
 
 void Floower::showStatus(HsbColor color, FloowerStatusAnimation animation, int duration) {
     statusColor = color;
-    statusPixel.SetPixelColor(0, color);
+    setStatusColor(color);
 
     if (animation == STILL) {
         animations.StopAnimation(ANIMATION_INDEX_STATUS);    
@@ -429,7 +621,7 @@ void Floower::showStatus(HsbColor color, FloowerStatusAnimation animation, int d
 void Floower::statusBlinkOnceAnimationUpdate(const AnimationParam& param) {
     if (param.state == AnimationState_Completed) {
         statusColor = colorBlack;
-        statusPixel.SetPixelColor(0, statusColor);
+        setStatusColor(statusColor);
     }
 }
 
@@ -441,7 +633,7 @@ void Floower::statusPulsatingAnimationUpdate(const AnimationParam& param) {
         statusColor.B = NeoEase::CubicInOut(param.progress - 0.25);
     }
 
-    statusPixel.SetPixelColor(0, statusColor);
+    setStatusColor(statusColor);
 
     if (param.state == AnimationState_Completed) {
         if (statusColor.B > 0) { // while there is something to show
@@ -468,33 +660,70 @@ bool Floower::setPixelsPowerOn(bool powerOn) {
 }
 
 PowerState Floower::readPowerState() {
-    float reading = analogRead(BATTERY_ANALOG_PIN); // 0-4095
-    float voltage = reading * 0.00181; // 1/4069 for scale * analog reference voltage is 3.6V * 2 for using 1:1 voltage divider + adjustment
-    uint8_t level = _min(_max(0, voltage - 3.3) * 111, 100); // 3.3 .. 0%, 4.2 .. 100%
-
+    uint16_t readings[BATTERY_OVERSAMPLING];
+    for (uint8_t i = 0; i < BATTERY_OVERSAMPLING; i++) {
+        readings[i] = analogRead(BATTERY_ANALOG_PIN); // 0-4095
+    }
     bool charging = digitalRead(CHARGE_PIN) == LOW;
-    bool switchedOn = reading > 0; // there is voltage of battery present
+    uint16_t loadCurrent = estimateLoadCurrent();
+    batteryEstimator.addSample(readings, BATTERY_OVERSAMPLING, loadCurrent, charging);
+    BatteryEstimate battery = batteryEstimator.getEstimate();
+
+    bool switchedOn = readings[BATTERY_OVERSAMPLING / 2] > 0; // there is voltage of battery present
     bool usbPowered = true;
 
     if (config->hardwareRevision > 5) { // logic board with revision 5 lack the USB detection circuitry, pretend its always charging
         usbPowered = analogRead(USB_ANALOG_PIN) > 2000; // ~2900 is 5V
     }
 
-    ESP_LOGD(LOG_TAG, "Battery %.0f %.2fV %d%% %s", reading, voltage, level, charging ? "CHRG" : (usbPowered ? "USB" : ""));
+    ESP_LOGD(LOG_TAG, "Battery %d %dmV %dmA %d%% %dmin (%d%%) %s", readings[BATTERY_OVERSAMPLING / 2], battery.voltage, loadCurrent,
+        battery.level, battery.runtime, battery.confidence, charging ? "CHRG" : (usbPowered ? "USB" : ""));
 
-    powerState = {voltage, level, charging, usbPowered, switchedOn};
+    powerState = {battery.voltage / 1000.0f, battery.level, charging, usbPowered, switchedOn, battery.runtime, battery.confidence, battery.low};
+
+    bool saving = !usbPowered && battery.level < BATTERY_SAVING_LEVEL + (batterySaving ? BATTERY_SAVING_HYSTERESIS : 0);
+    if (saving != batterySaving) {
+        ESP_LOGI(LOG_TAG, "Battery saving %s", saving ? "on" : "off");
+        batterySaving = saving;
+        setBrightnessLimit(saving ? BATTERY_SAVING_BRIGHTNESS : 255);
+    }
     return powerState;
 }
 
+PowerState Floower::getPowerState() {
+    return powerState;
+}
+
+uint16_t Floower::estimateLoadCurrent() {
+    if (energyLedger != nullptr) {
+        return energyLedger->getCurrent() / 1000; // whole board including the radio
+    }
+    // hardware driven by Floower only, by the default current model
+    uint32_t current = ENERGY_CPU_ACTIVE;
+    if (pixelsPowerOn) {
+        current += ENERGY_LEDS_POWERED + (uint64_t) ledsLight * ENERGY_LED_CHANNEL / GAMMA_MAX_LEVEL;
+    }
+    if (motionTask.arePetalsMoving()) {
+        current += ENERGY_STEPPER_ENABLED;
+    }
+    return current / 1000;
+}
+
+uint32_t Floower::lightOf(const LedsFrame &frame) {
+    GammaCurve curve = motionTask.getGamma();
+    uint32_t light = 0;
+    for (uint8_t i = 0; i < PIXELS_COUNT; i++) {
+        RgbColor pixel = frame.pixels[i];
+        light += GammaDither::toLightLevel(pixel.R, curve) + GammaDither::toLightLevel(pixel.G, curve) + GammaDither::toLightLevel(pixel.B, curve);
+    }
+    return light;
+}
+
 bool Floower::isUsbPowered() {
     return powerState.usbPowered;
 }
 
 void Floower::beforeDeepSleep() {
-    pixels.ClearTo(colorBlack);
-    pixels.Show();
-    statusPixel.ClearTo(colorBlack);
-    statusPixel.Show();
-    petals->setEnabled(false);
+    motionTask.shutdown();
     setPixelsPowerOn(false);
 }
\ No newline at end of file
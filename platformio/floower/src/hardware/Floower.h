@@ -2,10 +2,16 @@
 
 #include "Arduino.h"
 #include "Config.h"
+#include "IdleScheduler.h"
+#include "EnergyLedger.h"
 #include "hardware/Petals.h"
+#include "hardware/MotionTask.h"
+#include "hardware/ColorAnimation.h"
+#include "hardware/LedCompositor.h"
+#include "hardware/BatteryEstimator.h"
+#include "hardware/DriverHealth.h"
 #include <tmc2300.h>
 #include <functional>
-#include <NeoPixelBus.h>
 #include <NeoPixelAnimator.h>
 
 enum FloowerColorAnimation {
@@ -28,11 +34,14 @@ enum FloowerTouchEvent {
 };
 
 struct PowerState {
-    float batteryVoltage;
+    float batteryVoltage; // filtered open circuit voltage
     uint8_t batteryLevel;
     bool batteryCharging;
     bool usbPowered;
     bool switchedOn;
+    uint16_t batteryRuntime; // minutes
+    uint8_t batteryConfidence; // %
+    bool batteryLow; // confirmed by consecutive readings
 };
 
 typedef std::function<void(const FloowerTouchEvent& event)> FloowerOnLeafTouchCallback;
@@ -42,6 +51,7 @@ class Floower {
     public:
         Floower(Config *config);
         void init();
+        void startMotionTask();
         void initPetals(bool initial, bool wokeUp);
         void update();
 
@@ -67,16 +77,27 @@ class Floower {
         bool isAnimating();
         bool arePetalsMoving();
         bool isChangingColor();
+        uint32_t getPetalsDeadlineMisses();
 
         void showStatus(HsbColor color, FloowerStatusAnimation animation, int duration);
+        void setBrightnessLimit(uint8_t limit); // max channel level of the LEDs, lowered by readPowerState() on a weak battery
+        void setGamma(GammaCurve curve);
+        FrameStats getPixelsFrameStats();
+        FrameStats getStatusPixelsFrameStats();
+        void planIdle(IdleScheduler &scheduler);
+        void setEnergyLedger(EnergyLedger *energyLedger); // stepper and LEDs get accounted by update()
+        DriverHealth *getDriverHealth(); // of the stepper driver, nothing is sampled with servo petals
 
         PowerState readPowerState();
+        PowerState getPowerState(); // last read
         bool isUsbPowered();
         void beforeDeepSleep();
 
     private:
         bool setStepperPowerOn(bool powerOn);
         bool setPixelsPowerOn(bool powerOn);
+        uint16_t estimateLoadCurrent(); // mA
+        uint32_t lightOf(const LedsFrame &frame); // sum of gamma corrected channel light levels
 
         NeoPixelAnimator animations; // animation management object used for both servo and pixels to animate
         void pixelsTransitionAnimationUpdate(const AnimationParam& param);
@@ -85,7 +106,15 @@ class Floower {
         void pixelsRainbowAnimationUpdate(const AnimationParam& param);
         void pixelsRainbowLoopAnimationUpdate(const AnimationParam& param);
         void pixelsCandleAnimationUpdate(const AnimationParam& param);
+        void stopEffect();
+        uint8_t getAnimationsFrameRate(); // of the running base color and effect animations, 0 when none runs
         void showColor(HsbColor color);
+        void showPixelsColor(RgbColor color);
+        bool arePixelsLit();
+        void syncPixelsColor();
+        void reportLedsIfDue();
+        void setPixelColor(uint8_t index, RgbColor color);
+        void setStatusColor(RgbColor color);
         void statusBlinkOnceAnimationUpdate(const AnimationParam& param);
         void statusPulsatingAnimationUpdate(const AnimationParam& param);
 
@@ -95,26 +124,38 @@ class Floower {
         FloowerChangeCallback changeCallback;
         bool wasChanged = false;
 
-        // petals motor
-        Petals *petals;
-
-        // leds
-        NeoPixelBus<NeoGrbFeature, NeoEsp32I2s0800KbpsMethod> pixels;
+        // petals and leds hardware
+        MotionTask motionTask;
+        LedCompositor compositor;
+        LedsFrame leds; // last composed frame
+        bool ledsChanged = false; // not yet handed over to the motion task
+        uint32_t ledsLight = 0; // of the last composed frame
+        unsigned long petalsMovementEndTime = 0; // as planned by the last movement
+        uint8_t motionTaskFrameRate = 0;
+        unsigned long ledsReportTime = 0;
+        uint32_t ledsReportedFrames = 0;
 
         // leds state
         HsbColor pixelsColor; // current color
         HsbColor pixelsOriginColor; // color before animation
         HsbColor pixelsTargetColor; // color after animation
+        RgbColor pixelsRgbColor; // full brightness color of the flash animation
+        ColorTransition pixelsTransition;
+        float pixelsTransitionProgress;
+        bool pixelsColorOutdated = false; // current color not calculated during transition
+        uint8_t pixelsFrameRate = 0; // fps of the running base color animation
         bool pixelsPowerOn;
 
-        // leds animations
+        // leds animations, effects run in their own slot and draw over the base color
         bool interruptiblePixelsAnimation = false;
-        HsbColor candleOriginColors[6];
-        HsbColor candleTargetColors[6];
+        bool interruptibleEffect = false; // color modes end with a new color, indications keep running over it
+        RgbColor effectRgbColor; // full brightness color of the circle effect
+        uint8_t effectFrameRate = 0; // fps of the running effect
+        uint8_t candleOriginBrightness[6];
+        uint8_t candleTargetBrightness[6];
 
         // status LED
         HsbColor statusColor = colorBlack;
-        NeoPixelBus<NeoGrbFeature, NeoEsp32I2s1800KbpsMethod> statusPixel;
 
         // touch
         FloowerOnLeafTouchCallback touchCallback;
@@ -126,5 +167,10 @@ class Floower {
         bool longTouchRegistered = false;
 
         // battery
+        EnergyLedger *energyLedger = nullptr;
+        BatteryEstimator batteryEstimator;
         PowerState powerState;
+        bool batterySaving = false; // LEDs dimmed
+
+        DriverHealth driverHealth;
 };
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "FrameGovernor.h"
+
+FrameGovernor::FrameGovernor(uint8_t targetFps) {
+    setTargetFps(targetFps);
+}
+
+void FrameGovernor::setTargetFps(uint8_t targetFps) {
+    if (targetFps < 1) {
+        targetFps = 1;
+    }
+    else if (targetFps > FRAME_RATE_MAX) {
+        targetFps = FRAME_RATE_MAX;
+    }
+    this->targetFps.store(targetFps, std::memory_order_relaxed);
+}
+
+uint8_t FrameGovernor::getTargetFps() {
+    return targetFps.load(std::memory_order_relaxed);
+}
+
+void FrameGovernor::setMinFps(uint8_t minFps) {
+    this->minFps = minFps > FRAME_RATE_MAX ? FRAME_RATE_MAX : minFps;
+}
+
+bool FrameGovernor::isFrameDue(unsigned long now) {
+    if (now - windowStart >= FRAME_RATE_WINDOW) {
+        fps.store((uint64_t) windowFrames * 1000000 / (now - windowStart), std::memory_order_relaxed);
+        windowStart = now;
+        windowFrames = 0;
+    }
+    uint8_t frameRate = getTargetFps();
+    if (frameRate < minFps) {
+        frameRate = minFps;
+    }
+    return !anyFrame || now - lastFrameTime >= 1000000 / frameRate;
+}
+
+bool FrameGovernor::submitFrame(const uint8_t *data, size_t length, unsigned long now) {
+    uint32_t frameHash = hash(data, length);
+    if (anyFrame && frameHash == lastHash) {
+        lastFrameTime = now; // shown frame stays on for this slot, dithered frames keep their timing
+        skipped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    anyFrame = true;
+    lastHash = frameHash;
+    lastFrameTime = now;
+    windowFrames++;
+    shown.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+FrameStats FrameGovernor::getStats() {
+    return {
+        getTargetFps(),
+        fps.load(std::memory_order_relaxed),
+        shown.load(std::memory_order_relaxed),
+        skipped.load(std::memory_order_relaxed)
+    };
+}
+
+uint32_t FrameGovernor::hash(const uint8_t *data, size_t length) {
+    // FNV-1a
+    uint32_t hash = 2166136261;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#define FRAME_RATE_MAX 120 // fps
+#define FRAME_RATE_WINDOW 1000000 // us, window of measuring the achieved frame rate
+
+struct FrameStats {
+    uint8_t targetFps;
+    uint8_t fps; // achieved in the last window
+    uint32_t shown;
+    uint32_t skipped; // identical to the shown frame
+};
+
+// Limits how often a LED strip is shown and skips frames with the same content as the one already shown. Runs on
+// the task showing the strip, target rate and stats can be accessed from any other.
+class FrameGovernor {
+    public:
+        FrameGovernor(uint8_t targetFps);
+        void setTargetFps(uint8_t targetFps);
+        uint8_t getTargetFps();
+        void setMinFps(uint8_t minFps); // raises the target while needed by the showing task, 0 to follow the target
+
+        bool isFrameDue(unsigned long now); // us
+        bool submitFrame(const uint8_t *data, size_t length, unsigned long now); // true when the frame should be shown, a skipped one still takes its time slot
+        FrameStats getStats();
+
+        static uint32_t hash(const uint8_t *data, size_t length);
+
+    private:
+        std::atomic<uint8_t> targetFps;
+        uint8_t minFps = 0;
+        unsigned long lastFrameTime = 0;
+        bool anyFrame = false;
+        uint32_t lastHash = 0;
+
+        unsigned long windowStart = 0;
+        uint16_t windowFrames = 0;
+        std::atomic<uint8_t> fps {0};
+        std::atomic<uint32_t> shown {0};
+        std::atomic<uint32_t> skipped {0};
+};
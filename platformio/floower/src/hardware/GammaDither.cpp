@@ -0,0 +1,161 @@
+#include "GammaDither.h"
+
+#define ERROR_SEED_STEP 158 // spreads the dither phase of the channels, equal pixels do not toggle together
+
+// compile time math of the gamma tables, constexpr functions are single expressions so the loops are recursions
+
+namespace {
+
+constexpr double LN_2 = 0.6931471805599453;
+
+// series of atanh(z) / z, converges fast for |z| <= 1/3
+constexpr double atanhSeries(double z2, double power, int n) {
+    return n > 41 ? 0 : power / n + atanhSeries(z2, power * z2, n + 2);
+}
+
+constexpr double lnMantissa(double z) {
+    return 2 * z * atanhSeries(z * z, 1, 1);
+}
+
+// ln(x) for x in (0, 1], scaled into [0.5, 1] by powers of two
+constexpr double naturalLog(double x, int exponent = 0) {
+    return x < 0.5 ? naturalLog(x * 2, exponent + 1) : lnMantissa((x - 1) / (x + 1)) - exponent * LN_2;
+}
+
+constexpr double expSeries(double y, double term, int n) {
+    return n > 16 ? 0 : term + expSeries(y, term * y / (n + 1), n + 1);
+}
+
+constexpr double square(double value, int times) {
+    return times == 0 ? value : square(value * value, times - 1);
+}
+
+// exp(y) for y <= 0 as exp(y / 32) ^ 32
+constexpr double naturalExp(double y) {
+    return square(expSeries(y / 32, 1, 0), 5);
+}
+
+constexpr uint16_t lightLevel(int value, double gamma) {
+    return value == 0 ? 0 : (uint16_t) (naturalExp(gamma * naturalLog(value / 255.0)) * GAMMA_MAX_LEVEL + 0.5);
+}
+
+template <int... I> struct Levels {};
+template <int N, int... I> struct MakeLevels : MakeLevels<N - 1, N - 1, I...> {};
+template <int... I> struct MakeLevels<0, I...> {
+    typedef Levels<I...> type;
+};
+
+struct GammaTable {
+    uint16_t levels[GAMMA_LEVELS];
+};
+
+template <int... I> constexpr GammaTable gammaTable(double gamma, Levels<I...>) {
+    return {{ lightLevel(I, gamma)... }};
+}
+
+constexpr GammaTable gammaTables[GAMMA_CURVES] = {
+    gammaTable(1.0, MakeLevels<GAMMA_LEVELS>::type()),
+    gammaTable(1.8, MakeLevels<GAMMA_LEVELS>::type()),
+    gammaTable(2.2, MakeLevels<GAMMA_LEVELS>::type()),
+    gammaTable(2.5, MakeLevels<GAMMA_LEVELS>::type())
+};
+
+static_assert(gammaTables[GAMMA_LINEAR].levels[1] == 256 && gammaTables[GAMMA_LINEAR].levels[128] == 128 * 256, "linear curve must keep the colors");
+static_assert(gammaTables[GAMMA_2_5].levels[255] == GAMMA_MAX_LEVEL, "full brightness must stay full");
+
+}
+
+GammaDither::GammaDither(uint8_t pixelsCount, GammaCurve curve) : pixelsCount(_min(pixelsCount, DITHER_MAX_PIXELS)) {
+    setCurve(curve);
+    renderedCurve = curve;
+    for (uint8_t i = 0; i < DITHER_MAX_PIXELS; i++) {
+        for (uint8_t c = 0; c < 3; c++) {
+            error[i][c] = (i * 3 + c) * ERROR_SEED_STEP;
+        }
+    }
+}
+
+void GammaDither::setCurve(GammaCurve curve) {
+    if (curve >= GAMMA_CURVES) {
+        curve = GAMMA_LINEAR;
+    }
+    this->curve.store(curve, std::memory_order_relaxed);
+}
+
+GammaCurve GammaDither::getCurve() {
+    return (GammaCurve) curve.load(std::memory_order_relaxed);
+}
+
+void GammaDither::setDithering(bool enabled) {
+    dithering.store(enabled, std::memory_order_relaxed);
+}
+
+void GammaDither::setPixel(uint8_t index, RgbColor color) {
+    if (index < pixelsCount && pixels[index] != color) {
+        pixels[index] = color;
+        changed = true;
+    }
+}
+
+RgbColor GammaDither::getPixel(uint8_t index) {
+    return index < pixelsCount ? pixels[index] : RgbColor(0);
+}
+
+bool GammaDither::isPending() {
+    return hasChanges() || isDithering();
+}
+
+bool GammaDither::hasChanges() {
+    return changed || renderedCurve != curve.load(std::memory_order_relaxed);
+}
+
+bool GammaDither::isDithering() {
+    return fractional && dithering.load(std::memory_order_relaxed);
+}
+
+static inline uint8_t ditherChannel(uint16_t level, uint8_t &error) {
+    uint16_t sum = level + error; // at most 0xFFFF, level tops at 255.0
+    error = sum & 0xFF;
+    return sum >> 8;
+}
+
+static inline uint8_t roundChannel(uint16_t level) {
+    return (level + 0x80) >> 8;
+}
+
+static inline uint8_t outputChannel(uint16_t level, uint8_t &error, uint16_t ditherBelow, uint16_t &fractions) {
+    if (level < ditherBelow) {
+        fractions |= level & 0xFF;
+        return ditherChannel(level, error);
+    }
+    return roundChannel(level);
+}
+
+void GammaDither::render(RgbColor *output) {
+    renderedCurve = curve.load(std::memory_order_relaxed);
+    const uint16_t *levels = gammaTables[renderedCurve].levels;
+    if (changed) {
+        fadeFrames = DITHER_FADE_FRAMES;
+    }
+    else if (fadeFrames > 0) {
+        fadeFrames--; // the last one rounds the settled levels
+    }
+    uint16_t ditherBelow = 0; // nothing
+    if (dithering.load(std::memory_order_relaxed)) {
+        ditherBelow = fadeFrames > 0 ? 0xFFFF : DITHER_LOW_LEVEL;
+    }
+    uint16_t fractions = 0;
+
+    for (uint8_t i = 0; i < pixelsCount; i++) {
+        uint8_t r = outputChannel(levels[pixels[i].R], error[i][0], ditherBelow, fractions);
+        uint8_t g = outputChannel(levels[pixels[i].G], error[i][1], ditherBelow, fractions);
+        uint8_t b = outputChannel(levels[pixels[i].B], error[i][2], ditherBelow, fractions);
+        output[i] = RgbColor(r, g, b);
+    }
+    fractional = fractions != 0;
+    changed = false;
+}
+
+uint16_t GammaDither::toLightLevel(uint8_t value, GammaCurve curve) {
+    return gammaTables[curve < GAMMA_CURVES ? curve : GAMMA_LINEAR].levels[value];
+}
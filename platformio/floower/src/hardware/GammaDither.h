@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Arduino.h"
+#include "NeoPixelBus.h"
+#include <atomic>
+
+#define GAMMA_LEVELS 256
+#define GAMMA_MAX_LEVEL 65280 // 255.0 in 8.8 fixed point, the dithered output never overflows 8 bits
+#define DITHER_MAX_PIXELS 16
+#define DITHER_FRAME_RATE 100 // fps, minimal rate of dithered frames to not see them flicker
+#define DITHER_FADE_FRAMES 50 // frames dithered after the last change of the pixels, slow fades change them less often
+#define DITHER_LOW_LEVEL 0x200 // 8.8 fixed point, static colors are dithered only below it where rounding is visible
+
+enum GammaCurve {
+    GAMMA_LINEAR, // colors are shown as they are
+    GAMMA_1_8,
+    GAMMA_2_2, // close to sRGB, brightness is perceived linearly
+    GAMMA_2_5,
+    GAMMA_CURVES
+};
+
+// Output stage of a LED strip. Colors are taken as perceived brightness and mapped by the gamma curve to 8.8 fixed
+// point light levels, the fractional part is spread over the following frames (temporal dithering) so that dim
+// colors and slow fades keep their resolution. Once the pixels settle only the dim levels keep being dithered, the
+// rest is rounded so the strip can stop being refreshed. The curves are constexpr tables, no float math at runtime.
+// Pixels are set and rendered by the task showing the strip, curve and dithering can be changed from any other.
+class GammaDither {
+    public:
+        GammaDither(uint8_t pixelsCount, GammaCurve curve = GAMMA_LINEAR);
+        void setCurve(GammaCurve curve);
+        GammaCurve getCurve();
+        void setDithering(bool enabled);
+
+        void setPixel(uint8_t index, RgbColor color);
+        RgbColor getPixel(uint8_t index);
+        bool isPending(); // pixels or curve changed, or dithered frames are still running
+        bool hasChanges(); // pixels or curve changed since the last frame
+        bool isDithering(); // further frames differ, they have to be shown at the dithering frame rate
+        void render(RgbColor *output); // next frame of the pixels
+
+        static uint16_t toLightLevel(uint8_t value, GammaCurve curve); // 8.8 fixed point
+
+    private:
+        uint8_t pixelsCount;
+        std::atomic<uint8_t> curve;
+        std::atomic<bool> dithering {true};
+        uint8_t renderedCurve;
+        bool changed = true;
+        bool fractional = false; // some dithered light level in between the output levels
+        uint8_t fadeFrames = 0; // left to dither all levels since the last change
+
+        RgbColor pixels[DITHER_MAX_PIXELS];
+        uint8_t error[DITHER_MAX_PIXELS][3]; // accumulated fractional part per channel
+};
@@ -0,0 +1,119 @@
+#include "LedCompositor.h"
+
+LedCompositor::LedCompositor(uint8_t pixelsCount)
+        : pixelsCount(pixelsCount <= COMPOSITOR_MAX_PIXELS ? pixelsCount : COMPOSITOR_MAX_PIXELS) {
+}
+
+void LedCompositor::setBlendMode(uint8_t layer, BlendMode mode, uint8_t alpha) {
+    if (layer < COMPOSITOR_LAYERS && (layers[layer].mode != mode || layers[layer].alpha != alpha)) {
+        layers[layer].mode = mode;
+        layers[layer].alpha = alpha;
+        dirty |= layers[layer].opaque;
+    }
+}
+
+void LedCompositor::setPixel(uint8_t layer, uint8_t index, RgbColor color) {
+    if (layer >= COMPOSITOR_LAYERS || index >= pixelsCount) {
+        return;
+    }
+    Layer &target = layers[layer];
+    uint16_t bit = 1 << index;
+    if (!(target.opaque & bit) || target.pixels[index] != color) {
+        target.pixels[index] = color;
+        target.opaque |= bit;
+        dirty |= bit;
+    }
+}
+
+void LedCompositor::fill(uint8_t layer, RgbColor color, uint16_t mask) {
+    for (uint8_t i = 0; i < pixelsCount; i++) {
+        if (mask & (1 << i)) {
+            setPixel(layer, i, color);
+        }
+    }
+}
+
+void LedCompositor::clearPixel(uint8_t layer, uint8_t index) {
+    if (layer >= COMPOSITOR_LAYERS || index >= pixelsCount) {
+        return;
+    }
+    uint16_t bit = 1 << index;
+    if (layers[layer].opaque & bit) {
+        layers[layer].opaque &= ~bit;
+        dirty |= bit;
+    }
+}
+
+void LedCompositor::clear(uint8_t layer) {
+    if (layer < COMPOSITOR_LAYERS) {
+        dirty |= layers[layer].opaque;
+        layers[layer].opaque = 0;
+    }
+}
+
+void LedCompositor::setBrightnessLimit(uint8_t limit) {
+    if (brightnessLimit != limit) {
+        brightnessLimit = limit;
+        dirty = (1 << pixelsCount) - 1;
+    }
+}
+
+bool LedCompositor::compose() {
+    changed = 0;
+    for (uint8_t i = 0; dirty != 0 && i < pixelsCount; i++) {
+        uint16_t bit = 1 << i;
+        if (dirty & bit) {
+            dirty &= ~bit;
+            RgbColor color = composePixel(i);
+            if (color != output[i]) {
+                output[i] = color;
+                changed |= bit;
+            }
+        }
+    }
+    return changed != 0;
+}
+
+RgbColor LedCompositor::getPixel(uint8_t index) {
+    return index < pixelsCount ? output[index] : RgbColor(0);
+}
+
+uint16_t LedCompositor::getChangedPixels() {
+    return changed;
+}
+
+RgbColor LedCompositor::composePixel(uint8_t index) {
+    RgbColor color(0);
+    uint16_t bit = 1 << index;
+    for (uint8_t layer = 0; layer < COMPOSITOR_LAYERS; layer++) {
+        if (layers[layer].opaque & bit) {
+            color = blend(color, layers[layer].pixels[index], layers[layer].mode, layers[layer].alpha);
+        }
+    }
+
+    uint8_t level = _max(color.R, _max(color.G, color.B));
+    if (level > brightnessLimit) {
+        uint16_t scale = ((uint16_t) brightnessLimit << 8) / level;
+        color = RgbColor((color.R * scale) >> 8, (color.G * scale) >> 8, (color.B * scale) >> 8);
+    }
+    return color;
+}
+
+static inline uint8_t mix(uint8_t below, uint8_t channel, uint8_t alpha) {
+    return below + ((channel - below) * alpha + (channel >= below ? 127 : -127)) / 255;
+}
+
+RgbColor LedCompositor::blend(const RgbColor &below, const RgbColor &color, BlendMode mode, uint8_t alpha) {
+    switch (mode) {
+        case BLEND_ADD:
+            return RgbColor(_min(below.R + color.R, 255), _min(below.G + color.G, 255), _min(below.B + color.B, 255));
+        case BLEND_MULTIPLY:
+            return RgbColor((below.R * (color.R + 1)) >> 8, (below.G * (color.G + 1)) >> 8, (below.B * (color.B + 1)) >> 8);
+        case BLEND_LIGHTEN:
+            return RgbColor(_max(below.R, color.R), _max(below.G, color.G), _max(below.B, color.B));
+        case BLEND_ALPHA:
+            return RgbColor(mix(below.R, color.R, alpha), mix(below.G, color.G, alpha), mix(below.B, color.B, alpha));
+        default:
+            return color;
+    }
+}
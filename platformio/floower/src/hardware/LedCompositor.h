@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Arduino.h"
+#include "NeoPixelBus.h"
+
+#define COMPOSITOR_MAX_PIXELS 16
+
+enum CompositorLayer {
+    LAYER_BASE, // solid color of the flower
+    LAYER_EFFECT, // per pixel animations over the base color
+    LAYER_STATUS, // status indication on top of everything
+    COMPOSITOR_LAYERS
+};
+
+enum BlendMode {
+    BLEND_NORMAL, // replaces the layers below
+    BLEND_ADD, // saturating add to the layers below
+    BLEND_MULTIPLY, // darkens the layers below
+    BLEND_LIGHTEN, // brightest of the channels
+    BLEND_ALPHA // mixed with the layers below by the alpha of the layer
+};
+
+// Composes LED pixels from a stack of layers into a framebuffer. Pixels of a layer are transparent until set, a set
+// pixel is blended over the layers below by the mode of its layer. The brightness limiter scales the composed colors
+// last. Only pixels touched since the last composition are recomposed and the caller is told whether the output
+// changed, so the strip is shown only when needed.
+class LedCompositor {
+    public:
+        LedCompositor(uint8_t pixelsCount);
+        void setBlendMode(uint8_t layer, BlendMode mode, uint8_t alpha = 255); // alpha of BLEND_ALPHA, 255 is opaque
+        void setPixel(uint8_t layer, uint8_t index, RgbColor color);
+        void fill(uint8_t layer, RgbColor color, uint16_t mask = 0xFFFF); // pixels selected by the bit mask
+        void clearPixel(uint8_t layer, uint8_t index);
+        void clear(uint8_t layer);
+        void setBrightnessLimit(uint8_t limit); // max channel level of the output, colors are scaled down to keep the hue
+
+        bool compose(); // true when the output changed
+        RgbColor getPixel(uint8_t index);
+        uint16_t getChangedPixels(); // bit mask of pixels changed by the last composition
+
+    private:
+        RgbColor composePixel(uint8_t index);
+        static RgbColor blend(const RgbColor &below, const RgbColor &color, BlendMode mode, uint8_t alpha);
+
+        struct Layer {
+            RgbColor pixels[COMPOSITOR_MAX_PIXELS];
+            uint16_t opaque = 0; // bit mask of set pixels
+            BlendMode mode = BLEND_NORMAL;
+            uint8_t alpha = 255;
+        };
+
+        uint8_t pixelsCount;
+        Layer layers[COMPOSITOR_LAYERS];
+        RgbColor output[COMPOSITOR_MAX_PIXELS];
+        uint16_t dirty = 0;
+        uint16_t changed = 0;
+        uint8_t brightnessLimit = 255;
+};
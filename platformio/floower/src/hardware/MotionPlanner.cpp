@@ -0,0 +1,202 @@
+#include "MotionPlanner.h"
+#include <math.h>
+
+MotionPlanner::MotionPlanner(float acceleration, MotionProfile profile) : profile(profile), acceleration(acceleration) {
+    startSpeed = cruiseSpeed = 0;
+    accelTime = cruiseTime = decelTime = 0;
+}
+
+void MotionPlanner::setProfile(MotionProfile profile) {
+    this->profile = profile;
+}
+
+void MotionPlanner::setAcceleration(float acceleration) {
+    this->acceleration = acceleration;
+}
+
+bool MotionPlanner::plan(uint32_t steps, uint32_t duration, float startSpeed, StepSchedule &schedule) {
+    schedule.clear();
+    if (steps == 0) {
+        this->startSpeed = cruiseSpeed = 0;
+        accelTime = cruiseTime = decelTime = 0;
+        return false;
+    }
+
+    float distance = steps;
+    float time = duration > 0 ? duration / 1000.0 : 0;
+    float a = acceleration;
+    float v0 = startSpeed > 0 ? startSpeed : 0;
+
+    if (profile == PROFILE_CONSTANT || time <= 0) {
+        // no ramps, fastest possible when there is no time given
+        this->startSpeed = cruiseSpeed = time > 0 ? distance / time : 1000000.0 / STEP_MIN_INTERVAL;
+        accelTime = decelTime = 0;
+        cruiseTime = distance / cruiseSpeed;
+        buildSchedule(steps, schedule);
+        return true;
+    }
+
+    // ramp v0 -> v, cruise at v, ramp v -> 0, all within the time
+    // D = (-2v^2 + 2v(Ta + v0) - v0^2) / 2a, solved for v
+    float b = time * a + v0;
+    float discriminant = b * b - 2 * (v0 * v0 + 2 * a * distance);
+    if (discriminant < 0) {
+        // not enough acceleration to make it in time, use the lowest acceleration that does (triangle profile)
+        float c = 4 * distance - 2 * time * v0;
+        a = (c + sqrt(c * c + 4 * time * time * v0 * v0)) / (2 * time * time);
+        b = time * a + v0;
+        discriminant = 0;
+    }
+    float v = (b - sqrt(discriminant)) / 2;
+
+    if (v < v0) {
+        // arriving too fast, ramp down to cruise speed instead
+        // D = v0^2 / 2a + v(T - v0 / a)
+        float cruiseWindow = time - v0 / a;
+        v = cruiseWindow > 0 ? (distance - v0 * v0 / (2 * a)) / cruiseWindow : -1;
+        if (v < 0 || v > v0) {
+            // cannot make it, stop as soon as possible with the acceleration needed to hit the target
+            v = v0;
+            a = v0 * v0 / (2 * distance);
+        }
+    }
+
+    this->startSpeed = v0;
+    cruiseSpeed = v;
+    accelTime = fabs(v - v0) / a;
+    decelTime = v / a;
+    cruiseTime = v > 0 ? (distance - (v0 + v) / 2 * accelTime - v / 2 * decelTime) / v : 0;
+    if (cruiseTime < 0) {
+        cruiseTime = 0;
+    }
+
+    buildSchedule(steps, schedule);
+    return true;
+}
+
+uint32_t MotionPlanner::planStop(float speed, StepSchedule &schedule) {
+    schedule.clear();
+    startSpeed = cruiseSpeed = speed;
+    accelTime = cruiseTime = 0;
+    decelTime = speed / acceleration;
+
+    uint32_t steps = lround(positionAt(decelTime));
+    if (steps > 0) {
+        buildSchedule(steps, schedule);
+    }
+    return steps;
+}
+
+float MotionPlanner::ramp(float progress) {
+    if (profile == PROFILE_S_CURVE) {
+        return progress * progress * (3 - 2 * progress);
+    }
+    return progress;
+}
+
+float MotionPlanner::rampDistance(float progress) {
+    if (profile == PROFILE_S_CURVE) {
+        return progress * progress * progress * (1 - progress / 2);
+    }
+    return progress * progress / 2;
+}
+
+float MotionPlanner::speedAt(float time) {
+    if (time < 0) {
+        return 0;
+    }
+    if (time < accelTime) {
+        return startSpeed + (cruiseSpeed - startSpeed) * ramp(time / accelTime);
+    }
+    time -= accelTime;
+    if (time < cruiseTime) {
+        return cruiseSpeed;
+    }
+    time -= cruiseTime;
+    if (time < decelTime) {
+        return cruiseSpeed * (1 - ramp(time / decelTime));
+    }
+    return 0;
+}
+
+float MotionPlanner::positionAt(float time) {
+    if (time <= 0) {
+        return 0;
+    }
+    if (time < accelTime) {
+        return startSpeed * time + (cruiseSpeed - startSpeed) * accelTime * rampDistance(time / accelTime);
+    }
+    float position = (startSpeed + cruiseSpeed) / 2 * accelTime;
+    time -= accelTime;
+    if (time < cruiseTime) {
+        return position + cruiseSpeed * time;
+    }
+    position += cruiseSpeed * cruiseTime;
+    time -= cruiseTime;
+    if (time > decelTime) {
+        time = decelTime;
+    }
+    return position + cruiseSpeed * time - (decelTime > 0 ? cruiseSpeed * decelTime * rampDistance(time / decelTime) : 0);
+}
+
+float MotionPlanner::timeAt(float position) {
+    // profile is monotonic, bisect
+    float from = 0;
+    float to = getDuration();
+    for (uint8_t i = 0; i < 24; i++) {
+        float time = (from + to) / 2;
+        if (positionAt(time) < position) {
+            from = time;
+        }
+        else {
+            to = time;
+        }
+    }
+    return (from + to) / 2;
+}
+
+float MotionPlanner::getPeakSpeed() {
+    return startSpeed > cruiseSpeed ? startSpeed : cruiseSpeed;
+}
+
+float MotionPlanner::getDuration() {
+    return accelTime + cruiseTime + decelTime;
+}
+
+void MotionPlanner::buildSchedule(uint32_t steps, StepSchedule &schedule) {
+    // slice the profile in time
+    float sliceEnds[MOTION_PLANNER_RAMP_SLICES * 2 + 1];
+    uint8_t slices = 0;
+    for (uint8_t i = 1; accelTime > 0 && i <= MOTION_PLANNER_RAMP_SLICES; i++) {
+        sliceEnds[slices++] = accelTime * i / MOTION_PLANNER_RAMP_SLICES;
+    }
+    if (cruiseTime > 0) {
+        sliceEnds[slices++] = accelTime + cruiseTime;
+    }
+    for (uint8_t i = 1; decelTime > 0 && i <= MOTION_PLANNER_RAMP_SLICES; i++) {
+        sliceEnds[slices++] = accelTime + cruiseTime + decelTime * i / MOTION_PLANNER_RAMP_SLICES;
+    }
+
+    // every segment runs at the ideal average speed between its first and last step
+    uint32_t emitted = 0;
+    float emittedTime = 0;
+    for (uint8_t i = 0; i < slices; i++) {
+        uint32_t target = i == slices - 1 ? steps : (uint32_t) positionAt(sliceEnds[i]);
+        if (target > steps) {
+            target = steps;
+        }
+        if (target <= emitted) {
+            continue; // not even a single step, merge with the next slice
+        }
+        uint32_t count = target - emitted;
+        float targetTime = i == slices - 1 ? getDuration() : timeAt(target);
+        uint32_t interval = lround((targetTime - emittedTime) * 1000000.0 / count);
+        if (!schedule.add(count, interval)) {
+            // should not happen, finish the movement with the last speed
+            schedule.segments[schedule.size - 1].steps += steps - emitted;
+            return;
+        }
+        emitted = target;
+        emittedTime = targetTime;
+    }
+}
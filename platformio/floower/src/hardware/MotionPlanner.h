@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include "hardware/StepGenerator.h"
+
+#define MOTION_PLANNER_RAMP_SLICES 12 // number of constant speed segments approximating each ramp
+
+enum MotionProfile {
+    PROFILE_CONSTANT = 0, // instant start and stop at full speed
+    PROFILE_TRAPEZOIDAL = 1, // constant acceleration ramps
+    PROFILE_S_CURVE = 2 // smoothstep ramps, no step in acceleration
+};
+
+// plans acceleration limited movements of the stepper and converts them into step schedules
+class MotionPlanner {
+    public:
+        MotionPlanner(float acceleration, MotionProfile profile = PROFILE_TRAPEZOIDAL);
+        void setProfile(MotionProfile profile);
+        void setAcceleration(float acceleration);
+
+        // movement of given steps to be done in given duration starting at given speed (steps/s), ending at rest
+        bool plan(uint32_t steps, uint32_t duration, float startSpeed, StepSchedule &schedule);
+        // shortest stop from given speed, returns the number of steps needed
+        uint32_t planStop(float speed, StepSchedule &schedule);
+
+        // ideal profile of the last plan, used to verify the schedule
+        float speedAt(float time); // time in seconds from the start of movement
+        float positionAt(float time);
+        float timeAt(float position);
+        float getPeakSpeed();
+        float getDuration(); // seconds
+
+    private:
+        float ramp(float progress); // speed fraction 0-1 during ramp
+        float rampDistance(float progress); // integral of ramp() from 0 to progress
+        void buildSchedule(uint32_t steps, StepSchedule &schedule);
+
+        MotionProfile profile;
+        float acceleration; // steps/s^2
+
+        // last plan
+        float startSpeed;
+        float cruiseSpeed;
+        float accelTime;
+        float cruiseTime;
+        float decelTime;
+};
@@ -0,0 +1,253 @@
+#include "MotionTask.h"
+
+#if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
+#include "esp32-hal-log.h"
+#define LOG_TAG ""
+#else
+#include "esp_log.h"
+static const char* LOG_TAG = "MotionTask";
+#endif
+
+MotionTask::MotionTask(uint8_t pixelsPin, uint8_t statusPixelsPin)
+        : pixels(PIXELS_COUNT, pixelsPin), statusPixel(STATUS_PIXELS_COUNT, statusPixelsPin),
+        pixelsGovernor(PIXELS_FRAME_RATE), statusPixelsGovernor(STATUS_PIXELS_FRAME_RATE),
+        pixelsOutput(PIXELS_COUNT), statusPixelsOutput(STATUS_PIXELS_COUNT) {
+}
+
+void MotionTask::init(Petals *petals) {
+    this->petals = petals;
+
+    pixels.Begin();
+    pixels.ClearTo(RgbColor(0));
+    pixels.Show();
+
+    statusPixel.Begin();
+    statusPixel.ClearTo(RgbColor(0));
+    statusPixel.Show();
+}
+
+#ifdef ARDUINO_ARCH_ESP32
+
+void MotionTask::begin() {
+    if (!running) {
+        stopRequested = false;
+        running = true;
+        xTaskCreatePinnedToCore(MotionTask::taskLoop, "motion", MOTION_TASK_STACK_SIZE, this, MOTION_TASK_PRIORITY, &task, MOTION_TASK_CORE);
+    }
+}
+
+void MotionTask::end() {
+    if (running) {
+        stopRequested = true;
+        while (running) {
+            delay(1);
+        }
+        task = nullptr;
+    }
+}
+
+void MotionTask::taskLoop(void *arg) {
+    MotionTask *motionTask = (MotionTask *) arg;
+    TickType_t wakeTime = xTaskGetTickCount();
+    while (!motionTask->stopRequested) {
+        motionTask->run();
+        vTaskDelayUntil(&wakeTime, pdMS_TO_TICKS(MOTION_TASK_PERIOD));
+    }
+    motionTask->running = false;
+    vTaskDelete(nullptr);
+}
+
+#else
+
+void MotionTask::begin() {
+    if (!running) {
+        stopRequested = false;
+        running = true;
+        task = std::thread([this]() {
+            while (!stopRequested) {
+                run();
+                std::this_thread::sleep_for(std::chrono::milliseconds(MOTION_TASK_PERIOD));
+            }
+        });
+    }
+}
+
+void MotionTask::end() {
+    if (running) {
+        stopRequested = true;
+        task.join();
+        running = false;
+    }
+}
+
+#endif
+
+bool MotionTask::isRunning() {
+    return running;
+}
+
+void MotionTask::run() {
+    // apply commands first so a movement and the frame requested together start together
+    MotionCommand *command;
+    while ((command = queue.front()) != nullptr) {
+        settled.store(false, std::memory_order_relaxed); // published by the pop, never looks settled in between
+        apply(*command);
+        queue.pop();
+    }
+
+    if (petals != nullptr) {
+        petals->update();
+    }
+    unsigned long now = micros();
+    showIfDue(pixels, pixelsGovernor, pixelsOutput, now);
+    showIfDue(statusPixel, statusPixelsGovernor, statusPixelsOutput, now);
+
+    bool petalsMoving = petals != nullptr && petals->arePetalsMoving();
+    petalsEnabled.store(petals != nullptr && petals->isEnabled(), std::memory_order_relaxed);
+    // dithered frames of a dim color need the CPU awake as much as a new frame does
+    settled.store(!petalsMoving && !pixelsOutput.isPending() && !statusPixelsOutput.isPending(), std::memory_order_release);
+}
+
+template <typename T_STRIP> void MotionTask::showIfDue(T_STRIP &strip, FrameGovernor &governor, GammaDither &output, unsigned long now) {
+    if (governor.isFrameDue(now) && output.isPending() && strip.CanShow()) {
+        RgbColor frame[DITHER_MAX_PIXELS];
+        output.render(frame);
+        for (uint8_t i = 0; i < strip.PixelCount(); i++) {
+            if (strip.GetPixelColor(i) != frame[i]) {
+                strip.SetPixelColor(i, frame[i]);
+            }
+        }
+        // dithered frames average out only when shown fast enough
+        governor.setMinFps(output.isDithering() ? DITHER_FRAME_RATE : 0);
+        if (governor.submitFrame(strip.Pixels(), strip.PixelsSize(), now)) {
+            strip.Show();
+        }
+        else {
+            strip.ResetDirty(); // same as shown already, save the transfer
+        }
+    }
+}
+
+void MotionTask::apply(const MotionCommand &command) {
+    switch (command.type) {
+        case MOTION_INIT_PETALS:
+            petals->init(command.initial, command.wokeUp);
+            break;
+        case MOTION_SET_PETALS:
+            petals->setPetalsOpenLevel(command.level, command.transitionTime);
+            petalsCommandsApplied.fetch_add(1, std::memory_order_release);
+            break;
+        case MOTION_SHOW_LEDS:
+            // unchanged pixels are not rendered and shown again
+            for (uint8_t i = 0; i < PIXELS_COUNT; i++) {
+                pixelsOutput.setPixel(i, command.leds.pixels[i]);
+            }
+            statusPixelsOutput.setPixel(0, command.leds.status);
+            break;
+    }
+}
+
+bool MotionTask::push(const MotionCommand &command) {
+    if (!queue.push(command)) {
+        ESP_LOGE(LOG_TAG, "Queue full, command %d dropped", command.type);
+        return false;
+    }
+    return true;
+}
+
+bool MotionTask::initPetals(bool initial, bool wokeUp) {
+    MotionCommand command;
+    command.type = MOTION_INIT_PETALS;
+    command.initial = initial;
+    command.wokeUp = wokeUp;
+    return push(command);
+}
+
+bool MotionTask::setPetalsOpenLevel(int8_t level, int transitionTime) {
+    MotionCommand command;
+    command.type = MOTION_SET_PETALS;
+    command.level = level;
+    command.transitionTime = transitionTime;
+    // count before pushing, the movement must never look finished while it's queued
+    petalsCommandsPushed.fetch_add(1, std::memory_order_release);
+    if (!push(command)) {
+        petalsCommandsPushed.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+    requestedPetalsOpenLevel = level;
+    return true;
+}
+
+bool MotionTask::showLeds(const LedsFrame &leds) {
+    MotionCommand command;
+    command.type = MOTION_SHOW_LEDS;
+    command.leds = leds;
+    return push(command);
+}
+
+int8_t MotionTask::getPetalsOpenLevel() {
+    if (petalsCommandsApplied.load(std::memory_order_acquire) != petalsCommandsPushed.load(std::memory_order_acquire)) {
+        return requestedPetalsOpenLevel;
+    }
+    return petals->getPetalsOpenLevel();
+}
+
+int8_t MotionTask::getCurrentPetalsOpenLevel() {
+    return petals->getCurrentPetalsOpenLevel();
+}
+
+bool MotionTask::arePetalsMoving() {
+    // applied counter first, the petals are moving by the time it's incremented
+    uint32_t applied = petalsCommandsApplied.load(std::memory_order_acquire);
+    return applied != petalsCommandsPushed.load(std::memory_order_acquire) || petals->arePetalsMoving();
+}
+
+bool MotionTask::isSettled() {
+    return queue.isEmpty() && settled.load(std::memory_order_acquire);
+}
+
+bool MotionTask::arePetalsEnabled() {
+    return petalsEnabled.load(std::memory_order_relaxed);
+}
+
+uint32_t MotionTask::getDeadlineMisses() {
+    return petals->getDeadlineMisses();
+}
+
+void MotionTask::setPixelsFrameRate(uint8_t fps) {
+    pixelsGovernor.setTargetFps(fps);
+}
+
+void MotionTask::setGamma(GammaCurve curve) {
+    pixelsOutput.setCurve(curve);
+    statusPixelsOutput.setCurve(curve);
+}
+
+GammaCurve MotionTask::getGamma() {
+    return pixelsOutput.getCurve();
+}
+
+void MotionTask::setDithering(bool enabled) {
+    pixelsOutput.setDithering(enabled);
+    statusPixelsOutput.setDithering(enabled);
+}
+
+FrameStats MotionTask::getPixelsFrameStats() {
+    return pixelsGovernor.getStats();
+}
+
+FrameStats MotionTask::getStatusPixelsFrameStats() {
+    return statusPixelsGovernor.getStats();
+}
+
+void MotionTask::shutdown() {
+    end();
+    run(); // flush what's left in the queue
+    pixels.ClearTo(RgbColor(0));
+    pixels.Show();
+    statusPixel.ClearTo(RgbColor(0));
+    statusPixel.Show();
+    if (petals != nullptr) {
+        petals->setEnabled(false);
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Arduino.h"
+#include "hardware/Petals.h"
+#include "hardware/FrameGovernor.h"
+#include "hardware/GammaDither.h"
+#include "hal/LedStrip.h"
+#include "SpscQueue.h"
+#include <atomic>
+#ifndef ARDUINO_ARCH_ESP32
+#include <thread>
+#endif
+
+#define PIXELS_COUNT 7
+#define STATUS_PIXELS_COUNT 2
+
+#define MOTION_QUEUE_SIZE 16
+#define MOTION_TASK_PERIOD 1 // ms
+#define MOTION_TASK_STACK_SIZE 4096
+#define MOTION_TASK_PRIORITY 20 // above BLE host and TCP tasks, below the WiFi driver (23)
+#define MOTION_TASK_CORE 0 // Arduino loop runs on core 1
+#define PIXELS_FRAME_RATE 60 // fps, until set by the animation
+#define STATUS_PIXELS_FRAME_RATE 30 // fps
+
+struct LedsFrame {
+    RgbColor pixels[PIXELS_COUNT];
+    RgbColor status;
+};
+
+enum MotionCommandType {
+    MOTION_INIT_PETALS,
+    MOTION_SET_PETALS,
+    MOTION_SHOW_LEDS
+};
+
+struct MotionCommand {
+    uint8_t type;
+    bool initial; // MOTION_INIT_PETALS
+    bool wokeUp; // MOTION_INIT_PETALS
+    int8_t level; // MOTION_SET_PETALS
+    int transitionTime; // MOTION_SET_PETALS
+    LedsFrame leds; // MOTION_SHOW_LEDS
+};
+
+// Owns the petals and the LED strips. Once started it runs as a high priority task pinned to its own core, the Arduino
+// loop (behaviors and connectivity) only sends it commands through a lock-free queue. Without the task the loop has
+// to call run() itself.
+class MotionTask {
+    public:
+        MotionTask(uint8_t pixelsPin, uint8_t statusPixelsPin);
+        void init(Petals *petals); // before begin(), on the calling core
+        void begin();
+        void end(); // returns once the task stopped, the caller can access the hardware directly then
+        bool isRunning();
+        void run(); // single iteration: apply queued commands, update petals, refresh LEDs
+
+        // commands, called from a single producer (the Arduino loop), false when the queue is full
+        bool initPetals(bool initial, bool wokeUp);
+        bool setPetalsOpenLevel(int8_t level, int transitionTime);
+        bool showLeds(const LedsFrame &leds);
+        void setPixelsFrameRate(uint8_t fps); // any core
+        void setGamma(GammaCurve curve); // any core, both strips
+        GammaCurve getGamma(); // any core
+        void setDithering(bool enabled); // any core, both strips
+
+        // state, read from any core
+        int8_t getPetalsOpenLevel();
+        int8_t getCurrentPetalsOpenLevel();
+        bool arePetalsMoving(); // including queued movements
+        bool isSettled(); // no queued commands, petals stand still and LEDs show the last frame without dithering
+        bool arePetalsEnabled(); // stepper driver or servo powered
+        uint32_t getDeadlineMisses();
+        FrameStats getPixelsFrameStats();
+        FrameStats getStatusPixelsFrameStats();
+
+        // stops the task and turns off the hardware
+        void shutdown();
+
+    private:
+        void apply(const MotionCommand &command);
+        bool push(const MotionCommand &command);
+        template <typename T_STRIP> void showIfDue(T_STRIP &strip, FrameGovernor &governor, GammaDither &output, unsigned long now);
+
+        Petals *petals = nullptr;
+        PixelsStrip pixels;
+        StatusPixelStrip statusPixel;
+        FrameGovernor pixelsGovernor;
+        FrameGovernor statusPixelsGovernor;
+        GammaDither pixelsOutput;
+        GammaDither statusPixelsOutput;
+
+        SpscQueue<MotionCommand, MOTION_QUEUE_SIZE> queue;
+        std::atomic<uint32_t> petalsCommandsPushed {0};
+        std::atomic<uint32_t> petalsCommandsApplied {0};
+        int8_t requestedPetalsOpenLevel = 0;
+        std::atomic<bool> settled {false};
+        std::atomic<bool> petalsEnabled {false};
+
+        std::atomic<bool> stopRequested {false};
+        std::atomic<bool> running {false};
+#ifdef ARDUINO_ARCH_ESP32
+        static void taskLoop(void *arg);
+        TaskHandle_t task = nullptr;
+#else
+        std::thread task;
+#endif
+};
@@ -2,11 +2,15 @@
 
 #include "Arduino.h"
 #include "Config.h"
+#include "hardware/StepGenerator.h"
+#include "hardware/MotionPlanner.h"
+#include "hardware/DriverHealth.h"
 #include <tmc2300.h>
 #include <ESP32Servo.h>
 
 class Petals {
     public:
+        virtual ~Petals() {}
         virtual void init(bool initial, bool wokeUp) = 0;
         virtual void update() = 0;
 
@@ -15,11 +19,13 @@ class Petals {
         virtual int8_t getCurrentPetalsOpenLevel() = 0;
         virtual bool arePetalsMoving() = 0;
         virtual bool setEnabled(bool enabled) = 0;
+        virtual bool isEnabled() = 0;
+        virtual uint32_t getDeadlineMisses() = 0;
 };
 
 class StepperPetals : public Petals {
     public:
-        StepperPetals(Config *config);
+        StepperPetals(Config *config, DriverHealth *driverHealth = nullptr);
         void init(bool initial, bool wokeUp);
         void update();
 
@@ -28,26 +34,49 @@ class StepperPetals : public Petals {
         int8_t getCurrentPetalsOpenLevel();
         bool arePetalsMoving();
         bool setEnabled(bool enabled);
+        bool isEnabled();
+        uint32_t getDeadlineMisses();
 
     private:
-        bool runStepper();
-        void detectStall();
+        void configure();
+        void startMovement(int transitionTime, float startSpeed);
+        void seekClosed(uint32_t steps);
+        void monitorStall();
+        void stallSampled(TMC2300Status status);
+        void closedReached(bool stalled);
+        void requestHealth();
+        void healthSampled(bool ok, TMC2300Status status);
 
         Config *config;
+        DriverHealth *driverHealth;
 
         // stepper config
         TMC2300 stepperDriver;
+        StepGenerator *stepGenerator;
+        MotionPlanner motionPlanner;
 
         // stepper state
         int8_t petalsOpenLevel; // 0-100% (target angle in percentage)
         int8_t direction; // 1 CW, -1 CCW
         long targetSteps;
-        long currentSteps;
-        unsigned long lastStepTime;
-        unsigned long stepInterval;
-        bool enabled;
+        long currentSteps; // updated from step generator in update()
+        bool pendingMovement = false; // movement to start once the petals stop after change of direction
+        int pendingTransitionTime;
+        bool enabled = false;
         bool initialized;
+
+        // closed end-stop detection by StallGuard
+        bool stallGuard = false; // driver responds, StallGuard results can be read
+        bool homing = false; // looking for the closed end-stop, the position is not known yet
+        bool seeking = false; // running towards the closed end-stop
+        bool sgPending = false; // StallGuard result requested from the driver
+        uint8_t stalledSamples = 0;
         unsigned long sgTimer = 0;
+
+        // driver status watched between and during movements
+        uint8_t irun = 0; // configured run current
+        bool healthPending = false;
+        bool movementChecked = true; // status read after the last movement
 };
 
 class ServoPetals : public Petals {
@@ -61,6 +90,8 @@ class ServoPetals : public Petals {
         int8_t getCurrentPetalsOpenLevel();
         bool arePetalsMoving();
         bool setEnabled(bool enabled);
+        bool isEnabled();
+        uint32_t getDeadlineMisses();
 
     private:
         Config *config;
@@ -75,7 +106,7 @@ class ServoPetals : public Petals {
         int16_t servoTargetAngle; // angle after animation, keep signed to be able to calculate closing
         unsigned long movementStartTime;
         uint16_t movementTransitionTime;
-        bool enabled;
+        bool enabled = false;
         unsigned long servoPowerOffTime; // time when servo should power off (after animation is finished)
         bool initialized;
 };
\ No newline at end of file
@@ -113,6 +113,10 @@ bool ServoPetals::arePetalsMoving() {
     return servoAngle != servoTargetAngle;
 }
 
+uint32_t ServoPetals::getDeadlineMisses() {
+    return 0;
+}
+
 bool ServoPetals::setEnabled(bool enabled) {
     if (enabled && !this->enabled) {
         this->enabled = true;
@@ -127,4 +131,8 @@ bool ServoPetals::setEnabled(bool enabled) {
         return true;
     }
     return false; // no change
+}
+
+bool ServoPetals::isEnabled() {
+    return enabled;
 }
\ No newline at end of file
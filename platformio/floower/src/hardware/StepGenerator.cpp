@@ -0,0 +1,39 @@
+#include "StepGenerator.h"
+
+void StepSchedule::clear() {
+    size = 0;
+}
+
+bool StepSchedule::add(uint32_t steps, uint32_t interval) {
+    if (steps == 0) {
+        return true; // nothing to add
+    }
+    if (interval < STEP_MIN_INTERVAL) {
+        interval = STEP_MIN_INTERVAL;
+    }
+    if (size > 0 && segments[size - 1].interval == interval) {
+        segments[size - 1].steps += steps; // merge with previous segment of the same speed
+        return true;
+    }
+    if (size >= STEP_SCHEDULE_MAX_SEGMENTS) {
+        return false;
+    }
+    segments[size++] = {steps, interval};
+    return true;
+}
+
+uint32_t StepSchedule::getTotalSteps() const {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < size; i++) {
+        total += segments[i].steps;
+    }
+    return total;
+}
+
+uint32_t StepSchedule::getDuration() const {
+    uint32_t duration = 0;
+    for (uint8_t i = 0; i < size; i++) {
+        duration += segments[i].steps * segments[i].interval;
+    }
+    return duration;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+
+#define STEP_SCHEDULE_MAX_SEGMENTS 32
+#define STEP_MIN_PULSE_WIDTH 2 // us, TMC2300 needs >100ns, keep some margin for the GPIO
+#define STEP_MIN_INTERVAL 20 // us, maximum step rate of 50kHz
+#define STEP_DEADLINE_TOLERANCE 10 // us, step pulse started later than this after its due time is a deadline miss
+
+#define STEP_DIRECTION_CW 1
+#define STEP_DIRECTION_CCW -1
+
+// run of steps with constant interval between the pulses
+struct StepSegment {
+    uint32_t steps;
+    uint32_t interval; // us
+};
+
+// precomputed step pattern of single movement, computed in the main loop and consumed by the step generator
+class StepSchedule {
+    public:
+        void clear();
+        bool add(uint32_t steps, uint32_t interval); // false when the schedule is full
+        uint32_t getTotalSteps() const;
+        uint32_t getDuration() const; // us
+
+        StepSegment segments[STEP_SCHEDULE_MAX_SEGMENTS];
+        uint8_t size = 0;
+};
+
+typedef std::function<void(uint32_t time, long position)> StepCallback;
+
+// generates STEP pulses according to schedule independently of the main loop
+class StepGenerator {
+    public:
+        virtual ~StepGenerator() {}
+        virtual void begin() = 0;
+        virtual bool start(const StepSchedule &schedule, int8_t direction) = 0; // replaces any running schedule
+        virtual void stop() = 0;
+        virtual bool isRunning() = 0;
+        virtual long getPosition() = 0;
+        virtual void setPosition(long position) = 0; // only when stopped
+        virtual uint32_t getInterval() = 0; // interval of the running segment in us, 0 when stopped
+        virtual uint32_t getDeadlineMisses() = 0; // steps pulsed late since begin()
+};
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <esp32-hal-timer.h>
+
+// hardware timer backend, the whole pulse train is generated from the timer ISR
+class TimerStepGenerator : public StepGenerator {
+    public:
+        TimerStepGenerator(uint8_t stepPin, uint8_t timerIndex);
+        void begin();
+        bool start(const StepSchedule &schedule, int8_t direction);
+        void stop();
+        bool isRunning();
+        long getPosition();
+        void setPosition(long position);
+        uint32_t getInterval();
+        uint32_t getDeadlineMisses();
+
+    private:
+        static void IRAM_ATTR onTimer();
+        void IRAM_ATTR pulse();
+
+        static TimerStepGenerator *instance;
+
+        uint8_t stepPin;
+        uint8_t timerIndex;
+        hw_timer_t *timer = nullptr;
+
+        // state shared with ISR
+        StepSchedule schedule;
+        volatile uint8_t segmentIndex;
+        volatile uint32_t segmentSteps;
+        volatile long position = 0;
+        volatile bool running = false;
+        volatile bool pulseHigh = false;
+        volatile uint32_t deadlineMisses = 0;
+        int8_t direction;
+};
+#endif
+
+// deterministic host backend, time advances only when told so, records the exact time of every step
+class FakeStepGenerator : public StepGenerator {
+    public:
+        void begin();
+        bool start(const StepSchedule &schedule, int8_t direction);
+        void stop();
+        bool isRunning();
+        long getPosition();
+        void setPosition(long position);
+        uint32_t getInterval();
+        uint32_t getDeadlineMisses(); // always 0, steps are exact
+
+        void advance(uint32_t us);
+        void onStep(StepCallback callback);
+        int8_t getDirection();
+        uint32_t getTime();
+        uint32_t getStepCount();
+
+    private:
+        StepSchedule schedule;
+        StepCallback stepCallback;
+        uint8_t segmentIndex = 0;
+        uint32_t segmentSteps = 0;
+        uint32_t time = 0;
+        uint32_t nextStepTime = 0;
+        uint32_t stepCount = 0;
+        long position = 0;
+        bool running = false;
+        int8_t direction = STEP_DIRECTION_CW;
+};
@@ -1,4 +1,5 @@
 #include "Petals.h"
+#include "hal/Hal.h"
 
 #if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
 #include "esp32-hal-log.h"
@@ -16,16 +17,26 @@ static const char* LOG_TAG = "StepperPetals";
 #define TMC_DRIVER_ADDRESS 0b00 // TMC2209 Driver address according to MS1 and MS2
 #define TMC_R_SENSE 0.13f       // Match to your driver Rsense
 #define TMC_MICROSTEPS 32
+#define TMC_IRUN 31 // run current, derated by the health monitor when the driver gets hot
 #define TMC_OPEN_STEPS 30000
 
-#define TMC_MIN_PULSE_WIDTH 1
-#define DIRECTION_CW 1
-#define DIRECTION_CCW -1
+#define TMC_ACCELERATION 20000 // steps/s^2
+#define STEP_TIMER_INDEX 0
+#define DIRECTION_CW STEP_DIRECTION_CW
+#define DIRECTION_CCW STEP_DIRECTION_CCW
 
-//#define STALLGUARD_SAMPLING_PERIOD 50
+// closed end-stop detection, the motor stalls against it
+#define TMC_CLOCK 12000000 // Hz, internal clock TSTEP is measured in
+#define TMC_SG_THRESHOLD 30 // stall is signaled with StallGuard result at or below twice the threshold
+#define TMC_SG_MIN_SPEED 2000 // steps/s, StallGuard result is not reliable when slower
+#define TMC_SG_SAMPLING_PERIOD 10 // ms
+#define TMC_STALL_SAMPLES 2 // consecutive stalled samples to take it as the end-stop
+#define TMC_SEEK_SPEED 4000 // steps/s, approaching the end-stop
+#define TMC_CLOSE_OVERTRAVEL 400 // steps, closing looks for the end-stop at most this far beyond the closed position
 
-StepperPetals::StepperPetals(Config *config) : config(config), stepperDriver(&Serial1, TMC_R_SENSE, TMC_DRIVER_ADDRESS) {
-    Serial1.begin(500000, SERIAL_8N1, TMC_UART_RX_PIN, TMC_UART_TX_PIN);
+StepperPetals::StepperPetals(Config *config, DriverHealth *driverHealth)
+        : config(config), driverHealth(driverHealth), stepperDriver(halBeginTmcUart(500000, TMC_UART_RX_PIN, TMC_UART_TX_PIN), TMC_R_SENSE, TMC_DRIVER_ADDRESS), motionPlanner(TMC_ACCELERATION, PROFILE_S_CURVE) {
+    stepGenerator = halCreateStepGenerator(TMC_STEP_PIN, STEP_TIMER_INDEX);
     initialized = false;
     petalsOpenLevel = 0; // 0-100%
 }
@@ -36,114 +47,145 @@ void StepperPetals::init(bool initial, bool wokeUp) {
     setEnabled(true); // it will be auto-disabled in update method
     pinMode(TMC_EN_PIN, OUTPUT);
 
+    stepGenerator->begin();
+    stepGenerator->stop();
+    stepGenerator->setPosition(0);
     currentSteps = 0;
     targetSteps = 0;
-    stepInterval = 200; // default speed
-    lastStepTime = 0;
-    pinMode(TMC_STEP_PIN, OUTPUT);
-    digitalWrite(TMC_STEP_PIN, LOW);
-
-    if (initial && !wokeUp) {
-        // make sure the Floower is closed for the first time it's turned on
-        currentSteps = 0; // TODO
-    }
+    pendingMovement = false;
+    homing = false;
+    seeking = false;
 
     direction = DIRECTION_CCW; // default is closing
     pinMode(TMC_DIR_PIN, OUTPUT);
     digitalWrite(TMC_DIR_PIN, HIGH);
 
-    // verify stepper is available
-    if (stepperDriver.testConnection()) {
+    // verify stepper is available, the version is never 0
+    REG_IOIN iont = stepperDriver.readIontReg();
+    stallGuard = iont.version != 0;
+    if (!stallGuard) {
         ESP_LOGE(LOG_TAG, "TMC2300 failed");
     }
 
     if (!initialized) {
-        REG_IOIN iont = stepperDriver.readIontReg();
-        (void)iont; // to disable unused variable warning
         ESP_LOGI(LOG_TAG, "TMC2300: v=%d", iont.version);
+        irun = TMC_IRUN;
+        if (driverHealth != nullptr) {
+            driverHealth->begin(TMC_IRUN);
+        }
+        if (stallGuard) {
+            // reset flag of the power-on is not a fault, the driver is configured right away
+            REG_GSTAT gstat = stepperDriver.readGStat();
+            if (gstat.sr) {
+                stepperDriver.writeGStat(gstat);
+            }
+        }
+        configure();
+        stepperDriver.flush();
+        initialized = true;
+    }
 
-        REG_CHOPCONF chopconf = stepperDriver.readChopconf();
-        chopconf.setMicrosteps(TMC_MICROSTEPS);
-        chopconf.diss2vs = true; // HOTFIX
-        chopconf.diss2g = true; // HOTFIX
-        stepperDriver.writeChopconfReg(chopconf);
+    if (initial && !wokeUp && stallGuard) {
+        // position is unknown when turned on, close the petals until they hit the end-stop
+        homing = true;
+        seekClosed(TMC_OPEN_STEPS + TMC_CLOSE_OVERTRAVEL);
+    }
+}
 
-        REG_IHOLD_IRUN iholdIrun;
-        iholdIrun.irun = 31;
-        iholdIrun.ihold = 1;
-        iholdIrun.iholddelay = 1;
-        stepperDriver.writeIholdIrunReg(iholdIrun);
+void StepperPetals::configure() {
+    // configuration is composed in the register shadow and written at once
+    REG_CHOPCONF chopconf = stepperDriver.readChopconf();
+    chopconf.setMicrosteps(TMC_MICROSTEPS);
+    chopconf.diss2vs = true; // HOTFIX
+    chopconf.diss2g = true; // HOTFIX
+    stepperDriver.setRegister(REG_CHOPCONF::address, chopconf.sr);
 
-        initialized = true;
-    }
+    REG_IHOLD_IRUN iholdIrun;
+    iholdIrun.irun = irun;
+    iholdIrun.ihold = 1;
+    iholdIrun.iholddelay = 1;
+    stepperDriver.setRegister(REG_IHOLD_IRUN::address, iholdIrun.sr);
+
+    // StallGuard above the minimal speed, TSTEP is the time of 1/256 microstep
+    stepperDriver.setRegister(REG_TCOOLTHRS_ADDRESS, TMC_CLOCK / ((uint32_t) TMC_SG_MIN_SPEED * (256 / TMC_MICROSTEPS)));
+    stepperDriver.setRegister(REG_SGTHRS_ADDRESS, TMC_SG_THRESHOLD);
 }
 
 void StepperPetals::update() {
-    if (currentSteps != targetSteps) {
-        runStepper();
-        //detectStall();
+    stepperDriver.poll(); // register access never blocks the loop, results come in callbacks
+
+    // steps are generated by the step generator, just keep track of the position
+    currentSteps = stepGenerator->getPosition();
+
+    if (stepGenerator->isRunning()) {
+        monitorStall();
     }
-    else if (enabled) {
-        setEnabled(false);
-        sgTimer = 0;
+    else if (seeking) {
+        closedReached(false); // end-stop not detected, the petals are as closed as they can be anyway
+    }
+    else if (pendingMovement) {
+        // stopped after change of direction, continue to the target
+        pendingMovement = false;
+        startMovement(pendingTransitionTime, 0);
+    }
+    else if (enabled && !healthPending) {
+        if (driverHealth != nullptr && !movementChecked) {
+            movementChecked = true;
+            requestHealth(); // last look at the driver before it is disabled
+        }
+        else {
+            setEnabled(false);
+        }
+    }
+
+    if (enabled && driverHealth != nullptr && !healthPending && !sgPending && driverHealth->isSampleDue(millis())) {
+        requestHealth();
     }
 }
 
 void StepperPetals::setPetalsOpenLevel(int8_t level, int transitionTime) {
     ESP_LOGI(LOG_TAG, "Petals %d%%->%d%%", petalsOpenLevel, level);
-/*
-    REG_GSTAT gstat = stepperDriver.readGStat();
-    Serial.print("GSTAT=");
-    Serial.println(gstat.sr, BIN);
-    Serial.print("reset=");
-    Serial.println(gstat.reset);
-    Serial.print("drv_err=");
-    Serial.println(gstat.drv_err);
-
-    REG_DRV_STATUS drvStatus = stepperDriver.readDrvStatusReg();
-    Serial.print("DRV_STATUS=");
-    Serial.println(drvStatus.sr, BIN);
-    Serial.print("s2vsa=");
-    Serial.println(drvStatus.s2vsa);
-    Serial.print("s2vsb=");
-    Serial.println(drvStatus.s2vsb);
-    Serial.print("s2ga=");
-    Serial.println(drvStatus.s2ga);
-    Serial.print("s2gb=");
-    Serial.println(drvStatus.s2gb);
-    Serial.print("ot=");
-    Serial.println(drvStatus.ot);
-*/
     if (level == petalsOpenLevel) {
         return; // no change, keep doing the old movement until done
     }
     petalsOpenLevel = level;
+    if (homing) {
+        // continue once the position is known
+        targetSteps = _max(0, _min(level, 100)) * TMC_OPEN_STEPS / 100;
+        pendingTransitionTime = transitionTime;
+        return;
+    }
+
+    // take over from the current position and speed of running movement
+    uint32_t interval = stepGenerator->getInterval();
+    float speed = interval > 0 ? 1000000.0 / interval : 0;
+    stepGenerator->stop();
+    currentSteps = stepGenerator->getPosition();
+    pendingMovement = false;
 
+    seeking = false;
     if (level >= 100) {
         targetSteps = TMC_OPEN_STEPS;
     }
     else if (level <= 0) {
-        currentSteps += 1000; // TODO: make sure the petals will close completelly
-        targetSteps = 0;
+        targetSteps = 0; // movement continues until the end-stop
     }
     else {
         targetSteps = level * TMC_OPEN_STEPS / 100;
     }
 
-    // calculate the speed
-    float stepsToTake = abs(targetSteps - currentSteps);
-    float stepsPerMs = stepsToTake / transitionTime;
-    stepInterval = fabs(1000.0 / stepsPerMs);
-
-    // set direction upfront
-    direction = targetSteps >= currentSteps ? DIRECTION_CW : DIRECTION_CCW;
-    digitalWrite(TMC_DIR_PIN, direction == DIRECTION_CW ? LOW : HIGH);
-    
-    // enable
-    setEnabled(true);
-#ifdef STALLGUARD_SAMPLING_PERIOD
-    sgTimer = millis() + STALLGUARD_SAMPLING_PERIOD;
-#endif
+    int8_t newDirection = targetSteps >= currentSteps ? DIRECTION_CW : DIRECTION_CCW;
+    if (speed > 0 && newDirection != direction) {
+        // petals are moving the other way, stop them smoothly first
+        StepSchedule schedule;
+        motionPlanner.planStop(speed, schedule);
+        pendingMovement = true;
+        pendingTransitionTime = max(0, transitionTime - (int) (motionPlanner.getDuration() * 1000));
+        stepGenerator->start(schedule, direction);
+    }
+    else {
+        startMovement(transitionTime, speed);
+    }
 }
 
 int8_t StepperPetals::getPetalsOpenLevel() {
@@ -151,15 +193,22 @@ int8_t StepperPetals::getPetalsOpenLevel() {
 }
 
 int8_t StepperPetals::getCurrentPetalsOpenLevel() {
+    if (homing || currentSteps < 0) {
+        return 0; // closing beyond the closed position
+    }
     if (currentSteps != targetSteps) {
-        return (currentSteps / TMC_OPEN_STEPS) * 100;
+        return currentSteps * 100 / TMC_OPEN_STEPS;
     }
     // optimization, no need to calculate the actual position when movement is finished
     return petalsOpenLevel;
 }
 
 bool StepperPetals::arePetalsMoving() {
-    return currentSteps != targetSteps;
+    return stepGenerator->isRunning() || pendingMovement || seeking;
+}
+
+uint32_t StepperPetals::getDeadlineMisses() {
+    return stepGenerator->getDeadlineMisses();
 }
 
 bool StepperPetals::setEnabled(bool enabled) {
@@ -178,37 +227,133 @@ bool StepperPetals::setEnabled(bool enabled) {
     return false; // no change
 }
 
-bool StepperPetals::runStepper() {
-    if (stepInterval <= 0) {
-	    return false;
+bool StepperPetals::isEnabled() {
+    return enabled;
+}
+
+void StepperPetals::startMovement(int transitionTime, float startSpeed) {
+    currentSteps = stepGenerator->getPosition();
+    uint32_t stepsToTake = abs(targetSteps - currentSteps);
+    if (stepsToTake == 0) {
+        return;
     }
 
-    unsigned long time = micros();
-    if (time - lastStepTime >= stepInterval) {
-        currentSteps += direction;
-        //Serial.println(currentSteps);
+    StepSchedule schedule;
+    motionPlanner.plan(stepsToTake, transitionTime, startSpeed, schedule);
 
-        // step
-        digitalWrite(TMC_STEP_PIN, HIGH);
-        // Caution 200ns setup time 
-        // Delay the minimum allowed pulse width
-        delayMicroseconds(TMC_MIN_PULSE_WIDTH);
-        digitalWrite(TMC_STEP_PIN, LOW);
+    // set direction upfront
+    direction = targetSteps >= currentSteps ? DIRECTION_CW : DIRECTION_CCW;
+    digitalWrite(TMC_DIR_PIN, direction == DIRECTION_CW ? LOW : HIGH);
+
+    if (targetSteps == 0 && direction == DIRECTION_CCW) {
+        // closing, the end-stop should be right there, approach it at the speed StallGuard works at
+        seeking = schedule.add(TMC_CLOSE_OVERTRAVEL, 1000000 / TMC_SEEK_SPEED);
+    }
+
+    // enable and let the step generator do the work
+    setEnabled(true);
+    stepGenerator->start(schedule, direction);
+    stalledSamples = 0;
+    sgTimer = millis() + TMC_SG_SAMPLING_PERIOD;
+    movementChecked = false;
+}
 
-	    lastStepTime = time; // Caution: does not account for costs in step()
-	    return true;
+void StepperPetals::seekClosed(uint32_t steps) {
+    StepSchedule schedule;
+    schedule.add(steps, 1000000 / TMC_SEEK_SPEED);
+    direction = DIRECTION_CCW;
+    digitalWrite(TMC_DIR_PIN, HIGH);
+    seeking = true;
+
+    setEnabled(true);
+    stepGenerator->start(schedule, direction);
+    stalledSamples = 0;
+    sgTimer = millis() + TMC_SG_SAMPLING_PERIOD;
+    movementChecked = false;
+}
+
+void StepperPetals::monitorStall() {
+    if (!stallGuard || sgPending || (long) (millis() - sgTimer) < 0) {
+        return;
+    }
+    sgTimer = millis() + TMC_SG_SAMPLING_PERIOD;
+    uint32_t interval = stepGenerator->getInterval();
+    if (interval == 0 || interval > 1000000 / TMC_SG_MIN_SPEED) {
+        stalledSamples = 0; // too slow to tell
+        return;
     }
-	return false;
+    sgPending = stepperDriver.readStatusAsync([this](bool ok, TMC2300Status status) {
+        sgPending = false;
+        healthSampled(ok, status); // the same status tells about the driver health
+        if (ok && stepGenerator->isRunning()) {
+            stallSampled(status);
+        }
+    });
 }
 
-void StepperPetals::detectStall() {
-#ifdef STALLGUARD_SAMPLING_PERIOD
-    if (sgTimer > 0 && sgTimer < millis()) {
-        uint8_t sgValue = stepperDriver.readSGValue();
-        Serial.print("sgValue=");
-        Serial.println(sgValue);
-        sgTimer = millis() + STALLGUARD_SAMPLING_PERIOD;
+void StepperPetals::stallSampled(TMC2300Status status) {
+    if (status.sgValue > 2 * TMC_SG_THRESHOLD) {
+        stalledSamples = 0;
+        return;
+    }
+    if (++stalledSamples < TMC_STALL_SAMPLES) {
+        return;
+    }
+
+    stepGenerator->stop();
+    if (direction == DIRECTION_CCW) {
+        if (!homing) {
+            pendingTransitionTime = (long) config->speedMillis * targetSteps / TMC_OPEN_STEPS; // open again at the usual speed
+        }
+        closedReached(true);
+    }
+    else {
+        // something blocks the petals from opening, don't grind against it
+        currentSteps = stepGenerator->getPosition();
+        targetSteps = currentSteps;
+        pendingMovement = false;
+        petalsOpenLevel = currentSteps * 100 / TMC_OPEN_STEPS;
+        ESP_LOGW(LOG_TAG, "Petals blocked at %ld", currentSteps);
+    }
+}
+
+void StepperPetals::closedReached(bool stalled) {
+    ESP_LOGI(LOG_TAG, "Petals closed %s at %ld", stalled ? "on end-stop" : "without end-stop", stepGenerator->getPosition());
+    seeking = false;
+    homing = false;
+    stepGenerator->setPosition(0);
+    currentSteps = 0;
+    if (targetSteps > 0) {
+        startMovement(pendingTransitionTime, 0); // closed earlier than expected or homed, continue to the requested level
+    }
+}
+
+void StepperPetals::requestHealth() {
+    healthPending = stepperDriver.readStatusAsync([this](bool ok, TMC2300Status status) {
+        healthPending = false;
+        healthSampled(ok, status);
+    });
+}
+
+void StepperPetals::healthSampled(bool ok, TMC2300Status status) {
+    if (driverHealth == nullptr) {
+        return;
+    }
+    driverHealth->addSample(ok, status, millis());
+    if (ok && status.gstat.sr) {
+        ESP_LOGW(LOG_TAG, "TMC2300: gstat=%x drv_status=%x", status.gstat.sr, status.drvStatus.sr);
+        stepperDriver.writeAsync(REG_GSTAT::address, status.gstat.sr); // flags are cleared by writing them back
+        if (status.gstat.reset) {
+            // driver lost its configuration
+            stepperDriver.resetShadow();
+            configure();
+            stepperDriver.flushAsync();
+        }
+    }
+    if (driverHealth->getIrun() != irun) {
+        ESP_LOGW(LOG_TAG, "TMC2300: irun %d->%d", irun, driverHealth->getIrun());
+        irun = driverHealth->getIrun();
+        configure();
+        stepperDriver.flushAsync();
     }
-#endif
-    // also check error conditions
 }
\ No newline at end of file
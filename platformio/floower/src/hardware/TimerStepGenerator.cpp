@@ -0,0 +1,116 @@
+#ifdef ARDUINO_ARCH_ESP32
+
+#include "StepGenerator.h"
+#include "Arduino.h"
+
+#define TIMER_DIVIDER 80 // 80MHz APB clock -> 1us timer tick
+
+TimerStepGenerator *TimerStepGenerator::instance = nullptr;
+
+TimerStepGenerator::TimerStepGenerator(uint8_t stepPin, uint8_t timerIndex) : stepPin(stepPin), timerIndex(timerIndex) {
+}
+
+void TimerStepGenerator::begin() {
+    pinMode(stepPin, OUTPUT);
+    digitalWrite(stepPin, LOW);
+
+    if (timer == nullptr) {
+        instance = this;
+        timer = timerBegin(timerIndex, TIMER_DIVIDER, true);
+        deadlineMisses = 0;
+        timerAttachInterrupt(timer, &TimerStepGenerator::onTimer, true);
+    }
+}
+
+bool TimerStepGenerator::start(const StepSchedule &schedule, int8_t direction) {
+    stop();
+    if (schedule.size == 0) {
+        return false;
+    }
+
+    // ISR is not running at this point, it's safe to swap the schedule
+    this->schedule = schedule;
+    this->direction = direction;
+    segmentIndex = 0;
+    segmentSteps = schedule.segments[0].steps;
+    pulseHigh = false;
+    running = true;
+
+    timerWrite(timer, 0);
+    timerAlarmWrite(timer, schedule.segments[0].interval, true);
+    timerAlarmEnable(timer);
+    return true;
+}
+
+void TimerStepGenerator::stop() {
+    if (timer != nullptr) {
+        timerAlarmDisable(timer);
+    }
+    if (pulseHigh) {
+        digitalWrite(stepPin, LOW);
+        pulseHigh = false;
+    }
+    running = false;
+}
+
+bool TimerStepGenerator::isRunning() {
+    return running;
+}
+
+long TimerStepGenerator::getPosition() {
+    return position;
+}
+
+void TimerStepGenerator::setPosition(long position) {
+    if (!running) {
+        this->position = position;
+    }
+}
+
+uint32_t TimerStepGenerator::getInterval() {
+    uint8_t index = segmentIndex;
+    if (!running || index >= schedule.size) {
+        return 0;
+    }
+    return schedule.segments[index].interval;
+}
+
+uint32_t TimerStepGenerator::getDeadlineMisses() {
+    return deadlineMisses;
+}
+
+void IRAM_ATTR TimerStepGenerator::onTimer() {
+    instance->pulse();
+}
+
+void IRAM_ATTR TimerStepGenerator::pulse() {
+    if (!pulseHigh) {
+        // timer auto-reloads on alarm, the counter is the latency of this ISR
+        if (timerRead(timer) > STEP_DEADLINE_TOLERANCE) {
+            deadlineMisses++;
+        }
+        // rising edge is the step, keep the pin high for the minimum pulse width
+        digitalWrite(stepPin, HIGH);
+        pulseHigh = true;
+        position += direction;
+        segmentSteps--;
+        timerAlarmWrite(timer, STEP_MIN_PULSE_WIDTH, true);
+        return;
+    }
+
+    digitalWrite(stepPin, LOW);
+    pulseHigh = false;
+
+    if (segmentSteps == 0) {
+        segmentIndex++;
+        if (segmentIndex >= schedule.size) {
+            timerAlarmDisable(timer);
+            running = false;
+            return;
+        }
+        segmentSteps = schedule.segments[segmentIndex].steps;
+    }
+    timerAlarmWrite(timer, schedule.segments[segmentIndex].interval - STEP_MIN_PULSE_WIDTH, true);
+}
+
+#endif
@@ -4,7 +4,20 @@
 #include <esp_wifi.h>
 #include <esp_task_wdt.h>
 #include "Config.h"
+#ifdef LOOP_PROFILER
+#include "LoopProfiler.h"
+#else
+#define PROFILER_BEGIN(profiler)
+#define PROFILER_LAP(profiler, stage)
+#define PROFILER_END(profiler)
+#endif
+#include "IdleScheduler.h"
+#include "EnergyLedger.h"
 #include "connect/RemoteControl.h"
+#include "connect/BluetoothConnect.h"
+#include "connect/CommandProtocol.h"
+#include "connect/WifiConnect.h"
+#include "connect/StatePublisher.h"
 #include "behavior/BloomingBehavior.h"
 #include "behavior/MindfulnessBehavior.h"
 #include "behavior/Calibration.h"
@@ -31,6 +44,8 @@ void setFeatureFlags(Config &config) {
 //#define SERIAL_NUMBER 402
 
 #define WDT_TIMEOUT 10 // 10s for watch dog, reset with ever periodic operation
+#define BLUETOOTH_STATE_INTERVAL_MS 100 // min time between state notifications to the app
+#define WIFI_STATE_INTERVAL_MS 500 // min time between state updates to Floud
 
 Config config(FIRMWARE_VERSION);
 Floower floower(&config);
@@ -40,6 +55,17 @@ CommandProtocol cmdProtocol(&config, &floower);
 BluetoothConnect bluetoothConnect(&floower, &config, &cmdProtocol);
 WifiConnect wifiConnect(&config, &cmdProtocol);
 RemoteControl remoteControl(&bluetoothConnect, &wifiConnect, &cmdProtocol);
+#ifdef LOOP_PROFILER
+LoopProfiler loopProfiler;
+#endif
+IdleScheduler idleScheduler;
+EnergyLedger energyLedger;
+StatePublisher bluetoothStatePublisher(BLUETOOTH_STATE_INTERVAL_MS, [](int8_t petalsOpenLevel, HsbColor hsbColor) {
+    return bluetoothConnect.updateFloowerState(petalsOpenLevel, hsbColor);
+});
+StatePublisher wifiStatePublisher(WIFI_STATE_INTERVAL_MS, [](int8_t petalsOpenLevel, HsbColor hsbColor) {
+    return wifiConnect.updateFloowerState(petalsOpenLevel, hsbColor);
+});
 
 void configure();
 void planDeepSleep(long timeoutMs);
@@ -55,9 +81,15 @@ void onConfigChanged(bool wifiChanged) {
 }
 
 void onFloowerChanged(int8_t petalsOpenLevel, HsbColor hsbColor) {
-    ESP_LOGI(LOG_TAG, "Floower state changed");
-    wifiConnect.updateFloowerState(petalsOpenLevel, hsbColor);
-    bluetoothConnect.updateFloowerState(petalsOpenLevel, hsbColor);
+    ESP_LOGD(LOG_TAG, "Floower state changed");
+    wifiStatePublisher.publish(petalsOpenLevel, hsbColor);
+    bluetoothStatePublisher.publish(petalsOpenLevel, hsbColor);
+}
+
+void republishState(StatePublisher &publisher) {
+    // new listener knows nothing, send the current state even if unchanged
+    publisher.invalidate();
+    publisher.publish(floower.getPetalsOpenLevel(), floower.getColor());
 }
 
 void setup() {
@@ -90,9 +122,20 @@ void setup() {
     esp_wifi_stop();
     btStop();
     floower.init();
+    floower.startMotionTask(); // petals and LEDs are driven from their own core from now on
     floower.enableTouch([=](FloowerTouchEvent event){}, !wokeUp); // enable NOP touch to enable deep sleep wake up function
     floower.readPowerState(); // calibrate the ADC
     floower.onChange(onFloowerChanged);
+    bluetoothConnect.onConnected([]() { republishState(bluetoothStatePublisher); });
+    wifiConnect.onConnected([]() { republishState(wifiStatePublisher); });
+    floower.setEnergyLedger(&energyLedger);
+    idleScheduler.setEnergyLedger(&energyLedger);
+    cmdProtocol.setEnergyLedger(&energyLedger);
+    cmdProtocol.setStatePublishers(&bluetoothStatePublisher, &wifiStatePublisher);
+#ifdef LOOP_PROFILER
+    loopProfiler.onDeadlineMisses([]() { return floower.getPetalsDeadlineMisses(); });
+    cmdProtocol.setLoopProfiler(&loopProfiler);
+#endif
     delay(50); // wait to warm-up
 
     // init state machine, this is core logic
@@ -108,13 +151,32 @@ void setup() {
 }
 
 void loop() {
+    PROFILER_BEGIN(loopProfiler);
     floower.update();
+    PROFILER_LAP(loopProfiler, PROFILER_STAGE_FLOOWER);
     behavior->loop();
+    PROFILER_LAP(loopProfiler, PROFILER_STAGE_BEHAVIOR);
+    bluetoothConnect.loop();
     wifiConnect.loop();
-
-    // save some power when there is nothing happening
-    if (behavior->isIdle()) {
-        delay(10);
+    wifiStatePublisher.update();
+    bluetoothStatePublisher.update();
+    PROFILER_LAP(loopProfiler, PROFILER_STAGE_WIFI);
+    PROFILER_END(loopProfiler);
+
+    remoteControl.accountEnergy(energyLedger);
+    energyLedger.update(); // totals read by the commands are at most one pass old
+    config.update(floower.arePetalsMoving());
+
+    // sleep until the nearest deadline, light sleep when nothing is moving and the radio is off
+    idleScheduler.begin(millis());
+    floower.planIdle(idleScheduler);
+    config.planIdle(idleScheduler);
+    behavior->planIdle(idleScheduler);
+    remoteControl.planIdle(idleScheduler);
+    wifiStatePublisher.planIdle(idleScheduler);
+    bluetoothStatePublisher.planIdle(idleScheduler);
+    if (idleScheduler.idle()) {
+        floower.registerOutsideTouch(); // the touch ISR does not run in light sleep
     }
 }
 
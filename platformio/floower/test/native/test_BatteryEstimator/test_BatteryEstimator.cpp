@@ -0,0 +1,212 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <EEPROM.h>
+#include "SimHardware.h"
+#include "hardware/BatteryEstimator.h"
+#include "hardware/Floower.h"
+
+#define BATTERY_PIN 36
+
+#define IDLE_LOAD 45 // mA, CPU and dark LEDs
+#define STEPPER_LOAD 250 // mA, idle load with the petals moving
+#define CELL_RESISTANCE 350 // mOhm, an aged cell sags more than the estimator assumes
+
+// Voltage traces are shaped after logged ADC bursts: uniform noise of a few ADC steps plus a couple of readings per
+// burst caught in the stepper or LEDs PWM current peak. Noise is pseudo random with a fixed seed to keep the runs
+// reproducible.
+static uint32_t noiseSeed;
+
+static int16_t noise(int16_t amplitude) {
+    noiseSeed = noiseSeed * 1664525 + 1013904223;
+    return (int16_t) ((noiseSeed >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+static uint16_t toReading(int32_t millivolts) {
+    return millivolts * 100 / 181;
+}
+
+// burst of readings of a cell with the given open circuit voltage under the given load
+static void traceBurst(uint16_t *readings, uint16_t openCircuitVoltage, uint16_t loadCurrent, uint8_t spikes) {
+    int32_t voltage = openCircuitVoltage - (int32_t) loadCurrent * CELL_RESISTANCE / 1000;
+    for (uint8_t i = 0; i < BATTERY_OVERSAMPLING; i++) {
+        readings[i] = toReading(voltage) + noise(8);
+    }
+    for (uint8_t i = 0; i < spikes; i++) {
+        readings[(i * 7) % BATTERY_OVERSAMPLING] = toReading(voltage - 250); // PWM current peak
+    }
+}
+
+// low battery as detected by a single reading before the estimator
+static bool naiveLow(uint16_t *readings) {
+    return readings[0] * 0.00181 < BATTERY_LOW_VOLTAGE / 1000.0;
+}
+
+void setUp(void) {
+    SimHardware::reset();
+    EEPROM.erase();
+    noiseSeed = 1;
+}
+
+void tearDown(void) {
+}
+
+void test_discharge_curve_lookup(void) {
+    TEST_ASSERT_EQUAL(0, BatteryEstimator::levelFromVoltage(3000));
+    TEST_ASSERT_EQUAL(0, BatteryEstimator::levelFromVoltage(3300));
+    TEST_ASSERT_EQUAL(50, BatteryEstimator::levelFromVoltage(3850));
+    TEST_ASSERT_EQUAL(55, BatteryEstimator::levelFromVoltage(3870));
+    TEST_ASSERT_EQUAL(100, BatteryEstimator::levelFromVoltage(4200));
+    TEST_ASSERT_EQUAL(100, BatteryEstimator::levelFromVoltage(4300));
+
+    uint8_t lastLevel = 0;
+    for (uint16_t voltage = 3300; voltage <= 4200; voltage++) {
+        uint8_t level = BatteryEstimator::levelFromVoltage(voltage);
+        TEST_ASSERT_TRUE(level >= lastLevel);
+        lastLevel = level;
+    }
+}
+
+void test_median_drops_pwm_spikes(void) {
+    BatteryEstimator estimator;
+    uint16_t readings[BATTERY_OVERSAMPLING];
+    traceBurst(readings, 3900, 0, 6);
+    estimator.addSample(readings, BATTERY_OVERSAMPLING, 0, false);
+
+    TEST_ASSERT_UINT32_WITHIN(15, 3900, estimator.getEstimate().voltage);
+}
+
+void test_discharge_trace(void) {
+    BatteryEstimator estimator;
+    uint16_t readings[BATTERY_OVERSAMPLING];
+    uint16_t naiveFalseLows = 0;
+    uint16_t lowConfirmedAt = 0;
+
+    // one sample a second from full to empty, the petals move every 20s
+    for (uint16_t voltage = 4150, sample = 0; voltage >= 3300; voltage--, sample++) {
+        bool moving = sample % 20 < 3;
+        uint16_t load = moving ? STEPPER_LOAD : IDLE_LOAD;
+        traceBurst(readings, voltage, load, moving ? 3 : 1);
+        if (voltage > BATTERY_LOW_VOLTAGE + 20 && naiveLow(readings)) {
+            naiveFalseLows++;
+        }
+        estimator.addSample(readings, BATTERY_OVERSAMPLING, load, false);
+        BatteryEstimate estimate = estimator.getEstimate();
+
+        if (sample >= BATTERY_SETTLE_SAMPLES) {
+            TEST_ASSERT_UINT32_WITHIN(40, voltage, estimate.voltage);
+            TEST_ASSERT_UINT32_WITHIN(5, BatteryEstimator::levelFromVoltage(voltage), estimate.level);
+        }
+        if (voltage > BATTERY_LOW_VOLTAGE + 20) {
+            TEST_ASSERT_FALSE(estimate.low);
+        }
+        else if (estimate.low && lowConfirmedAt == 0) {
+            lowConfirmedAt = voltage;
+        }
+    }
+    printf("discharge: naive reading false lows %u, low confirmed at %u mV\n", naiveFalseLows, lowConfirmedAt);
+
+    TEST_ASSERT_TRUE(naiveFalseLows > 0);
+    TEST_ASSERT_TRUE(lowConfirmedAt >= BATTERY_LOW_VOLTAGE - 20);
+}
+
+void test_stepper_sag_no_false_low(void) {
+    BatteryEstimator estimator;
+    uint16_t readings[BATTERY_OVERSAMPLING];
+    uint16_t naiveLows = 0;
+
+    // almost empty battery blooming and closing, each movement takes 4s
+    for (uint16_t sample = 0; sample < 120; sample++) {
+        bool moving = sample % 6 < 4;
+        uint16_t load = moving ? STEPPER_LOAD : IDLE_LOAD;
+        traceBurst(readings, BATTERY_LOW_VOLTAGE + 60, moving ? STEPPER_LOAD * 2 : IDLE_LOAD, moving ? 4 : 1); // stall current peaks
+        if (naiveLow(readings)) {
+            naiveLows++;
+        }
+        estimator.addSample(readings, BATTERY_OVERSAMPLING, load, false);
+        TEST_ASSERT_FALSE(estimator.getEstimate().low);
+    }
+    printf("stepper sag: naive reading lows %u of 120\n", naiveLows);
+    TEST_ASSERT_TRUE(naiveLows > 0);
+
+    // the same battery really depleted is confirmed in a few idle samples
+    for (uint8_t sample = 0; sample < BATTERY_LOW_SAMPLES + 4; sample++) {
+        traceBurst(readings, BATTERY_LOW_VOLTAGE - 50, IDLE_LOAD, 1);
+        estimator.addSample(readings, BATTERY_OVERSAMPLING, IDLE_LOAD, false);
+    }
+    TEST_ASSERT_TRUE(estimator.getEstimate().low);
+}
+
+void test_runtime_and_confidence(void) {
+    BatteryEstimator estimator;
+    uint16_t readings[BATTERY_OVERSAMPLING];
+
+    traceBurst(readings, 3850, 100, 0);
+    estimator.addSample(readings, BATTERY_OVERSAMPLING, 100, false);
+    uint8_t initialConfidence = estimator.getEstimate().confidence;
+    for (uint8_t sample = 0; sample < 30; sample++) {
+        traceBurst(readings, 3850, 100, 0);
+        estimator.addSample(readings, BATTERY_OVERSAMPLING, 100, false);
+    }
+    BatteryEstimate estimate = estimator.getEstimate();
+    TEST_ASSERT_UINT32_WITHIN(5, 50, estimate.level); // aged cell sags below the compensation
+    TEST_ASSERT_UINT32_WITHIN(10, estimate.level * 16 * 60 / 100, estimate.runtime); // 16mAh per % at 100mA
+    TEST_ASSERT_TRUE(initialConfidence < 20);
+    TEST_ASSERT_TRUE(estimate.confidence > 40);
+
+    // less load, less doubt about the sag
+    for (uint8_t sample = 0; sample < 60; sample++) {
+        traceBurst(readings, 3850, 20, 0);
+        estimator.addSample(readings, BATTERY_OVERSAMPLING, 20, false);
+    }
+    TEST_ASSERT_TRUE(estimator.getEstimate().confidence > estimate.confidence);
+    TEST_ASSERT_TRUE(estimator.getEstimate().runtime > 2 * estimate.runtime);
+
+    // charger lifts the voltage, level is a guess and there is no runtime
+    for (uint8_t sample = 0; sample < 30; sample++) {
+        traceBurst(readings, 4000, 0, 0);
+        estimator.addSample(readings, BATTERY_OVERSAMPLING, 20, true);
+    }
+    estimate = estimator.getEstimate();
+    TEST_ASSERT_EQUAL(0, estimate.runtime);
+    TEST_ASSERT_TRUE(estimate.confidence < 20);
+    TEST_ASSERT_FALSE(estimate.low);
+}
+
+void test_floower_compensates_leds_load(void) {
+    Config config(11);
+    config.begin();
+    config.hardwareCalibration(1000, 1000, 9, 1);
+    config.factorySettings();
+    config.load();
+    Floower floower(&config);
+    floower.init();
+    SimHardware::setAnalog(BATTERY_PIN, toReading(3800));
+    SimHardware::setDigital(35, HIGH); // not charging
+
+    PowerState dark = floower.readPowerState();
+    TEST_ASSERT_FLOAT_WITHIN(0.02, 3.8, dark.batteryVoltage);
+
+    // same reading with white LEDs means higher open circuit voltage
+    floower.transitionColor(0, 0, 1.0, 0);
+    floower.update();
+    PowerState lit;
+    for (uint8_t i = 0; i < 60; i++) {
+        lit = floower.readPowerState();
+    }
+    TEST_ASSERT_TRUE(lit.batteryVoltage > dark.batteryVoltage + 0.04);
+    TEST_ASSERT_TRUE(lit.batteryRuntime < dark.batteryRuntime / 4);
+    TEST_ASSERT_FALSE(lit.batteryLow);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_discharge_curve_lookup);
+    RUN_TEST(test_median_drops_pwm_spikes);
+    RUN_TEST(test_discharge_trace);
+    RUN_TEST(test_stepper_sag_no_false_low);
+    RUN_TEST(test_runtime_and_confidence);
+    RUN_TEST(test_floower_compensates_leds_load);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include <unity.h>
+#include <string.h>
+#include "connect/BinaryCodec.h"
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_negotiate(void) {
+    TEST_ASSERT_EQUAL(COMMAND_CODEC_MSGPACK, BinaryCodec::negotiate(0));
+    TEST_ASSERT_EQUAL(1, BinaryCodec::negotiate(1));
+    TEST_ASSERT_EQUAL(BINARY_CODEC_VERSION, BinaryCodec::negotiate(200)); // newer client falls back to ours
+}
+
+void test_not_mistaken_for_msgpack(void) {
+    const char msgPackMap[] = {(char) 0x82, (char) 0xA1, 'l', 50};
+    TEST_ASSERT_FALSE(BinaryCodec::isBinary(msgPackMap, sizeof(msgPackMap)));
+    TEST_ASSERT_FALSE(BinaryCodec::isBinary(msgPackMap, 0));
+
+    BinaryState state;
+    TEST_ASSERT_FALSE(BinaryCodec::decodePetals(msgPackMap, sizeof(msgPackMap), state));
+}
+
+void test_decode_petals(void) {
+    const char payload[] = {1, 75, 0x03, (char) 0xE8};
+    BinaryState state;
+    TEST_ASSERT_TRUE(BinaryCodec::decodePetals(payload, sizeof(payload), state));
+    TEST_ASSERT_TRUE(state.hasLevel);
+    TEST_ASSERT_EQUAL(75, state.level);
+    TEST_ASSERT_FALSE(state.hasColor);
+    TEST_ASSERT_TRUE(state.hasTime);
+    TEST_ASSERT_EQUAL(1000, state.time);
+
+    TEST_ASSERT_FALSE(BinaryCodec::decodePetals(payload, sizeof(payload) - 1, state)); // truncated
+}
+
+void test_decode_rgb_color(void) {
+    const char payload[] = {1, (char) 255, (char) 128, 0, (char) 0xFF, (char) 0xFF};
+    BinaryState state;
+    TEST_ASSERT_TRUE(BinaryCodec::decodeRgbColor(payload, sizeof(payload), state));
+    TEST_ASSERT_FALSE(state.hasLevel);
+    TEST_ASSERT_TRUE(state.hasColor);
+    TEST_ASSERT_TRUE(state.color == RgbColor(255, 128, 0));
+    TEST_ASSERT_FALSE(state.hasTime); // 0xFFFF is the configured speed
+
+    const char unknownVersion[] = {BINARY_CODEC_VERSION + 1, 1, 2, 3, 0, 0};
+    TEST_ASSERT_FALSE(BinaryCodec::decodeRgbColor(unknownVersion, sizeof(unknownVersion), state));
+}
+
+void test_write_state_round_trip(void) {
+    BinaryState state = {true, 100, true, RgbColor(10, 20, 30), true, 5000};
+    char payload[BINARY_WRITE_STATE_LENGTH + 1];
+    TEST_ASSERT_EQUAL(BINARY_WRITE_STATE_LENGTH, BinaryCodec::encodeWriteState(state, payload));
+
+    BinaryState decoded;
+    TEST_ASSERT_TRUE(BinaryCodec::decodeWriteState(payload, BINARY_WRITE_STATE_LENGTH, decoded));
+    TEST_ASSERT_TRUE(decoded.hasLevel);
+    TEST_ASSERT_EQUAL(100, decoded.level);
+    TEST_ASSERT_TRUE(decoded.hasColor);
+    TEST_ASSERT_TRUE(decoded.color == RgbColor(10, 20, 30));
+    TEST_ASSERT_EQUAL(5000, decoded.time);
+
+    state.hasLevel = false;
+    state.hasTime = false;
+    BinaryCodec::encodeWriteState(state, payload);
+    TEST_ASSERT_TRUE(BinaryCodec::decodeWriteState(payload, BINARY_WRITE_STATE_LENGTH, decoded));
+    TEST_ASSERT_FALSE(decoded.hasLevel);
+    TEST_ASSERT_TRUE(decoded.hasColor);
+    TEST_ASSERT_FALSE(decoded.hasTime);
+}
+
+void test_encode_read_state(void) {
+    char payload[BINARY_READ_STATE_LENGTH];
+    TEST_ASSERT_EQUAL(BINARY_READ_STATE_LENGTH, BinaryCodec::encodeReadState(RgbColor(1, 2, 3), 42, payload));
+    const char expected[] = {BINARY_CODEC_VERSION, 1, 2, 3, 42};
+    TEST_ASSERT_EQUAL_MEMORY(expected, payload, BINARY_READ_STATE_LENGTH);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_negotiate);
+    RUN_TEST(test_not_mistaken_for_msgpack);
+    RUN_TEST(test_decode_petals);
+    RUN_TEST(test_decode_rgb_color);
+    RUN_TEST(test_write_state_round_trip);
+    RUN_TEST(test_encode_read_state);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,231 @@
+#include <unity.h>
+#include <chrono>
+#include <stdlib.h>
+#include "hardware/ColorAnimation.h"
+
+#define BENCHMARK_FRAMES 200000
+#define PIXELS 7
+
+// Benchmarks only print the time per frame. The host has a double precision FPU, unlike ESP32 where the reference
+// double math is emulated, so host numbers understate the gain and are not asserted.
+
+// per frame color math of the animations before the tables, kept as reference
+
+static RgbColor referenceTransition(HsbColor origin, HsbColor target, float progress) {
+    double diff = origin.H - target.H;
+    HsbColor color;
+    if (diff < 0.2 && diff > -0.2) {
+        color = HsbColor::LinearBlend<NeoHueBlendShortestDistance>(origin, target, progress);
+    }
+    else {
+        color = RgbColor::LinearBlend(origin, target, progress);
+    }
+    return color;
+}
+
+static void referenceRainbowLoop(float progress, double brightness, RgbColor *pixels) {
+    double hue = progress;
+    double step = 1.0 / 6.0;
+    pixels[0] = HsbColor(progress, 1, brightness);
+    for (uint8_t i = 1; i < 7; i++, hue += step) {
+        if (hue >= 1.0) {
+            hue = hue - 1;
+        }
+        pixels[i] = HsbColor(hue, 1, brightness);
+    }
+}
+
+static void referenceCandle(const HsbColor *origin, const HsbColor *target, float progress, RgbColor *pixels) {
+    pixels[0] = HsbColor(0.042, 1.0, 1.0);
+    for (uint8_t i = 0; i < 6; i++) {
+        pixels[i + 1] = HsbColor::LinearBlend<NeoHueBlendShortestDistance>(origin[i], target[i], progress);
+    }
+}
+
+static uint8_t maxError(const RgbColor &expected, const RgbColor &actual) {
+    uint8_t error = abs(expected.R - actual.R);
+    error = max(error, (uint8_t) abs(expected.G - actual.G));
+    return max(error, (uint8_t) abs(expected.B - actual.B));
+}
+
+static uint32_t checksum = 0; // keeps the benchmarked code from being optimized away
+
+static void sink(const RgbColor &color) {
+    checksum += color.R + color.G + color.B;
+}
+
+static void sink(const RgbColor *pixels) {
+    for (uint8_t i = 0; i < PIXELS; i++) {
+        sink(pixels[i]);
+    }
+}
+
+static double nanosPerFrame(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BENCHMARK_FRAMES;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_fixed_point_helpers(void) {
+    TEST_ASSERT_EQUAL(0, toFixedProgress(-0.5));
+    TEST_ASSERT_EQUAL(65535, toFixedProgress(1.5));
+    TEST_ASSERT_TRUE(blendRgb(RgbColor(0, 100, 255), RgbColor(255, 100, 0), 0) == RgbColor(0, 100, 255));
+    TEST_ASSERT_TRUE(blendRgb(RgbColor(0, 100, 255), RgbColor(255, 100, 0), 65535) == RgbColor(255, 100, 0));
+    TEST_ASSERT_TRUE(blendRgb(RgbColor(0, 100, 255), RgbColor(255, 100, 0), 32768) == RgbColor(128, 100, 128));
+    TEST_ASSERT_TRUE(scaleRgb(RgbColor(255, 128, 1), 255) == RgbColor(255, 128, 1));
+    TEST_ASSERT_TRUE(scaleRgb(RgbColor(255, 128, 1), 0) == RgbColor(0, 0, 0));
+    TEST_ASSERT_EQUAL(0, easeCubicInOut(0));
+    TEST_ASSERT_EQUAL(65535, easeCubicInOut(65535));
+}
+
+void test_hue_wheel_matches_hsb(void) {
+    uint8_t worst = 0;
+    for (uint32_t hue = 0; hue < 65536; hue += 97) {
+        for (uint16_t brightness = 0; brightness <= 255; brightness += 51) {
+            RgbColor expected = HsbColor(hue / 65536.0f, 1, brightness / 255.0f);
+            worst = max(worst, maxError(expected, hueToRgb(hue, brightness)));
+        }
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(2, worst);
+}
+
+void test_ease_matches_float(void) {
+    uint32_t worst = 0;
+    for (uint32_t progress = 0; progress < 65536; progress += 13) {
+        uint16_t expected = NeoEase::CubicInOut(progress / 65535.0f) * 65535;
+        worst = max(worst, (uint32_t) abs(expected - easeCubicInOut(progress)));
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(40, worst); // under 1/1000
+}
+
+void test_transition_matches_reference(void) {
+    const HsbColor colors[] = {
+        HsbColor(0.0, 1.0, 1.0), HsbColor(0.1, 1.0, 0.5), HsbColor(0.6, 0.8, 1.0),
+        HsbColor(0.95, 1.0, 0.2), HsbColor(0.3, 0.0, 1.0), HsbColor(0.0, 1.0, 0.0)
+    };
+    ColorTransition transition;
+    uint8_t worst = 0;
+    for (const HsbColor &origin : colors) {
+        for (const HsbColor &target : colors) {
+            transition.compile(origin, target);
+            for (uint32_t progress = 0; progress <= 65535; progress += 257) {
+                RgbColor expected = referenceTransition(origin, target, progress / 65535.0f);
+                worst = max(worst, maxError(expected, transition.rgbAt(progress)));
+            }
+            TEST_ASSERT_TRUE(transition.rgbAt(65535) == RgbColor(target)); // ends exactly on the target
+        }
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(4, worst);
+}
+
+void test_benchmark_transition(void) {
+    HsbColor origin(0.1, 1.0, 0.3);
+    HsbColor target(0.2, 0.7, 1.0);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+        sink(referenceTransition(origin, target, (float) frame / BENCHMARK_FRAMES));
+    }
+    double reference = nanosPerFrame(start);
+
+    start = std::chrono::steady_clock::now();
+    ColorTransition transition;
+    transition.compile(origin, target);
+    for (uint32_t frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+        sink(transition.rgbAt(toFixedProgress((float) frame / BENCHMARK_FRAMES)));
+    }
+    double tables = nanosPerFrame(start);
+
+    printf("transition: HSB %.1f ns/frame, tables %.1f ns/frame\n", reference, tables);
+}
+
+void test_benchmark_rainbow_loop(void) {
+    RgbColor pixels[PIXELS];
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+        referenceRainbowLoop((float) frame / BENCHMARK_FRAMES, 0.8, pixels);
+        sink(pixels);
+    }
+    double reference = nanosPerFrame(start);
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+        uint16_t hue = toFixedProgress((float) frame / BENCHMARK_FRAMES);
+        pixels[0] = hueToRgb(hue, 204);
+        for (uint8_t i = 1; i < PIXELS; i++, hue += 65536 / 6) {
+            pixels[i] = hueToRgb(hue, 204);
+        }
+        sink(pixels);
+    }
+    double tables = nanosPerFrame(start);
+
+    printf("rainbow loop: HSB %.1f ns/frame, tables %.1f ns/frame\n", reference, tables);
+}
+
+void test_benchmark_candle(void) {
+    const HsbColor candle(0.042, 1.0, 1.0);
+    const RgbColor candleRgb(candle);
+    HsbColor origin[6];
+    HsbColor target[6];
+    uint8_t originBrightness[6];
+    uint8_t targetBrightness[6];
+    for (uint8_t i = 0; i < 6; i++) {
+        originBrightness[i] = 50 + i * 30;
+        targetBrightness[i] = 230 - i * 25;
+        origin[i] = HsbColor(candle.H, candle.S, originBrightness[i] / 255.0f);
+        target[i] = HsbColor(candle.H, candle.S, targetBrightness[i] / 255.0f);
+    }
+    RgbColor pixels[PIXELS];
+    RgbColor expected[PIXELS];
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+        referenceCandle(origin, target, (float) frame / BENCHMARK_FRAMES, pixels);
+        sink(pixels);
+    }
+    double reference = nanosPerFrame(start);
+
+    start = std::chrono::steady_clock::now();
+    uint8_t worst = 0;
+    for (uint32_t frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+        uint16_t progress = toFixedProgress((float) frame / BENCHMARK_FRAMES);
+        pixels[0] = candleRgb;
+        for (uint8_t i = 0; i < 6; i++) {
+            uint8_t brightness = originBrightness[i] + (((targetBrightness[i] - originBrightness[i]) * (int32_t) progress + 32768) >> 16);
+            pixels[i + 1] = scaleRgb(candleRgb, brightness);
+        }
+        sink(pixels);
+    }
+    double tables = nanosPerFrame(start);
+
+    for (uint32_t frame = 0; frame < BENCHMARK_FRAMES; frame += 1000) {
+        referenceCandle(origin, target, (float) frame / BENCHMARK_FRAMES, expected);
+        uint16_t progress = toFixedProgress((float) frame / BENCHMARK_FRAMES);
+        for (uint8_t i = 0; i < 6; i++) {
+            uint8_t brightness = originBrightness[i] + (((targetBrightness[i] - originBrightness[i]) * (int32_t) progress + 32768) >> 16);
+            worst = max(worst, maxError(expected[i + 1], scaleRgb(candleRgb, brightness)));
+        }
+    }
+
+    printf("candle: HSB %.1f ns/frame, tables %.1f ns/frame, checksum %u\n", reference, tables, checksum);
+    TEST_ASSERT_LESS_OR_EQUAL(2, worst);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fixed_point_helpers);
+    RUN_TEST(test_hue_wheel_matches_hsb);
+    RUN_TEST(test_ease_matches_float);
+    RUN_TEST(test_transition_matches_reference);
+    RUN_TEST(test_benchmark_transition);
+    RUN_TEST(test_benchmark_rainbow_loop);
+    RUN_TEST(test_benchmark_candle);
+    UNITY_END();
+
+    return 0;
+}
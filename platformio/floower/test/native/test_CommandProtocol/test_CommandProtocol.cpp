@@ -0,0 +1,193 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include <EEPROM.h>
+#include "SimHardware.h"
+#include "connect/CommandProtocol.h"
+
+// binary codec negotiation and commands, benchmark of the binary and MsgPack decoding
+
+#define BENCHMARK_ITERATIONS 100000
+
+Config *config;
+Floower *floower;
+CommandProtocol *cmdProtocol;
+char response[MAX_MESSAGE_PAYLOAD_BYTES + 1];
+uint16_t responseLength;
+
+void setUp(void) {
+    SimHardware::reset();
+    EEPROM.erase();
+    config = new Config(11);
+    config->begin();
+    config->hardwareCalibration(1000, 1000, 9, 1);
+    config->factorySettings();
+    config->setCalibrated();
+    config->load();
+    floower = new Floower(config);
+    floower->init();
+    floower->initPetals(true, false);
+    floower->update();
+    cmdProtocol = new CommandProtocol(config, floower);
+}
+
+void tearDown(void) {
+    delete cmdProtocol;
+    delete floower;
+    delete config;
+}
+
+uint8_t negotiate(uint8_t clientVersion) {
+    uint8_t codec = COMMAND_CODEC_MSGPACK;
+    const char payload[] = {(char) clientVersion};
+    TEST_ASSERT_EQUAL(STATUS_OK, cmdProtocol->run(PROTOCOL_CODEC, payload, 1, response, &responseLength, &codec));
+    TEST_ASSERT_EQUAL(1, responseLength);
+    TEST_ASSERT_EQUAL(codec, response[0]);
+    return codec;
+}
+
+uint16_t msgPackWriteState(char *payload) {
+    StaticJsonDocument<MAX_MESSAGE_PAYLOAD_BYTES> document;
+    document["r"] = 255;
+    document["g"] = 128;
+    document["b"] = 0;
+    document["l"] = 60;
+    document["t"] = 1500;
+    return serializeMsgPack(document, payload, MAX_MESSAGE_PAYLOAD_BYTES);
+}
+
+void test_negotiation(void) {
+    TEST_ASSERT_EQUAL(BINARY_CODEC_VERSION, negotiate(BINARY_CODEC_VERSION + 5));
+    TEST_ASSERT_EQUAL(COMMAND_CODEC_MSGPACK, negotiate(0));
+
+    // only per connection state can be negotiated
+    const char payload[] = {1};
+    TEST_ASSERT_EQUAL(STATUS_UNSUPPORTED, cmdProtocol->run(PROTOCOL_CODEC, payload, 1, response, &responseLength));
+}
+
+void test_binary_write_state(void) {
+    uint8_t codec = negotiate(BINARY_CODEC_VERSION);
+    BinaryState state = {true, 60, true, RgbColor(255, 0, 0), true, 1500};
+    char payload[BINARY_WRITE_STATE_LENGTH];
+    uint16_t length = BinaryCodec::encodeWriteState(state, payload);
+
+    TEST_ASSERT_EQUAL(STATUS_OK, cmdProtocol->run(CMD_WRITE_STATE, payload, length, response, &responseLength, &codec));
+    TEST_ASSERT_EQUAL(60, floower->getPetalsOpenLevel());
+    TEST_ASSERT_TRUE(RgbColor(floower->getColor()) == RgbColor(255, 0, 0));
+
+    // truncated payload is refused
+    TEST_ASSERT_EQUAL(STATUS_ERROR, cmdProtocol->run(CMD_WRITE_STATE, payload, length - 1, response, &responseLength, &codec));
+
+    // and the state reads back in binary
+    TEST_ASSERT_EQUAL(STATUS_OK, cmdProtocol->run(CMD_READ_STATE, nullptr, 0, response, &responseLength, &codec));
+    TEST_ASSERT_EQUAL(BINARY_READ_STATE_LENGTH, responseLength);
+    TEST_ASSERT_EQUAL(255, (uint8_t) response[1]);
+    TEST_ASSERT_EQUAL(60, response[4]);
+}
+
+void test_msgpack_fallback(void) {
+    // binary connection still takes MsgPack
+    uint8_t codec = negotiate(BINARY_CODEC_VERSION);
+    char payload[MAX_MESSAGE_PAYLOAD_BYTES];
+    uint16_t length = msgPackWriteState(payload);
+
+    TEST_ASSERT_EQUAL(STATUS_OK, cmdProtocol->run(CMD_WRITE_STATE, payload, length, response, &responseLength, &codec));
+    TEST_ASSERT_EQUAL(60, floower->getPetalsOpenLevel());
+
+    // binary payload is not understood on MsgPack connection
+    codec = COMMAND_CODEC_MSGPACK;
+    char binaryPayload[BINARY_PETALS_LENGTH] = {BINARY_CODEC_VERSION, 20, 0, 0};
+    cmdProtocol->run(CMD_WRITE_PETALS, binaryPayload, sizeof(binaryPayload), response, &responseLength, &codec);
+    TEST_ASSERT_EQUAL(60, floower->getPetalsOpenLevel());
+}
+
+void test_ota_update_manifest(void) {
+    OtaManifest received;
+    bool called = false;
+    cmdProtocol->onRunOTAUpdate([&](const OtaManifest &manifest) {
+        received = manifest;
+        called = true;
+    });
+
+    StaticJsonDocument<MAX_MESSAGE_PAYLOAD_BYTES> document;
+    document["u"] = "ota.floower.io/floower-12.bin";
+    document["s"] = 1048576;
+    document["h"] = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+    char payload[MAX_MESSAGE_PAYLOAD_BYTES];
+    uint16_t length = serializeMsgPack(document, payload, MAX_MESSAGE_PAYLOAD_BYTES);
+    TEST_ASSERT_EQUAL(STATUS_OK, cmdProtocol->run(CMD_RUN_OTA_UPDATE, payload, length));
+    TEST_ASSERT_TRUE(called);
+    TEST_ASSERT_EQUAL_STRING("ota.floower.io/floower-12.bin", received.url.c_str());
+    TEST_ASSERT_EQUAL(1048576, received.size);
+    TEST_ASSERT_TRUE(received.hasDigest);
+    TEST_ASSERT_EQUAL_HEX8(0xba, received.sha256[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xad, received.sha256[SHA256_DIGEST_SIZE - 1]);
+    TEST_ASSERT_TRUE(received.deltaUrl.isEmpty());
+
+    // delta with the full image as the fallback
+    document["d"] = "ota.floower.io/floower-11-12.fhs";
+    length = serializeMsgPack(document, payload, MAX_MESSAGE_PAYLOAD_BYTES);
+    TEST_ASSERT_EQUAL(STATUS_OK, cmdProtocol->run(CMD_RUN_OTA_UPDATE, payload, length));
+    TEST_ASSERT_EQUAL_STRING("ota.floower.io/floower-11-12.fhs", received.deltaUrl.c_str());
+    TEST_ASSERT_EQUAL_STRING("ota.floower.io/floower-12.bin", received.url.c_str());
+
+    // malformed digest is refused
+    called = false;
+    document["h"] = "ba7816bf";
+    length = serializeMsgPack(document, payload, MAX_MESSAGE_PAYLOAD_BYTES);
+    TEST_ASSERT_EQUAL(STATUS_ERROR, cmdProtocol->run(CMD_RUN_OTA_UPDATE, payload, length));
+    TEST_ASSERT_FALSE(called);
+}
+
+void test_benchmark(void) {
+    char msgPackPayload[MAX_MESSAGE_PAYLOAD_BYTES];
+    uint16_t msgPackLength = msgPackWriteState(msgPackPayload);
+    char binaryPayload[BINARY_WRITE_STATE_LENGTH];
+    BinaryState state = {true, 60, true, RgbColor(255, 128, 0), true, 1500};
+    uint16_t binaryLength = BinaryCodec::encodeWriteState(state, binaryPayload);
+
+    // MsgPack path as CommandProtocol::run does it
+    StaticJsonDocument<MAX_MESSAGE_PAYLOAD_BYTES> document;
+    MsgPack::Unpacker unpacker;
+    uint32_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        unpacker.feed((const uint8_t *) msgPackPayload, msgPackLength);
+        unpacker.deserialize(document);
+        uint8_t level = document["l"];
+        uint16_t time = document["t"];
+        RgbColor color(document["r"], document["g"], document["b"]);
+        checksum += level + time + color.R;
+    }
+    double msgPackNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / (double) BENCHMARK_ITERATIONS;
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        BinaryState decoded;
+        BinaryCodec::decodeWriteState(binaryPayload, binaryLength, decoded);
+        checksum -= decoded.level + decoded.time + decoded.color.R;
+    }
+    double binaryNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / (double) BENCHMARK_ITERATIONS;
+
+    char message[128];
+    snprintf(message, sizeof(message), "CMD_WRITE_STATE MsgPack: %u B, %.0f ns/op", msgPackLength, msgPackNs);
+    TEST_MESSAGE(message);
+    snprintf(message, sizeof(message), "CMD_WRITE_STATE binary: %u B, %.0f ns/op", binaryLength, binaryNs);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_EQUAL(0, checksum); // both decoded the same values
+    TEST_ASSERT_LESS_THAN(msgPackLength, binaryLength);
+    TEST_ASSERT_LESS_THAN(msgPackNs, binaryNs);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_negotiation);
+    RUN_TEST(test_binary_write_state);
+    RUN_TEST(test_msgpack_fallback);
+    RUN_TEST(test_ota_update_manifest);
+    RUN_TEST(test_benchmark);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,226 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <EEPROM.h>
+#include "SimHardware.h"
+#include "SimConfigFlash.h"
+#include "Config.h"
+
+// deferred commits of the configuration changes, compared to the commits on the command path
+
+#define SESSIONS 10
+#define SESSION_COMMANDS 100 // slider dragged in the app
+#define COMMAND_INTERVAL 50 // ms
+#define BLOOM_TIME 6000 // ms, petals move during the session
+
+Config *config;
+
+struct CommitReport {
+    uint32_t commits;
+    uint32_t longestTime; // us, of the loop blocked
+    uint32_t whileMoving; // commits while the petals move
+};
+
+void setUp(void) {
+    SimHardware::reset();
+    EEPROM.erase();
+    configFlash.eraseAll();
+    config = new Config(11);
+    config->begin();
+    config->hardwareCalibration(1000, 1400, 9, 123);
+    config->factorySettings();
+    config->setCalibrated();
+    config->commit();
+    config->load();
+}
+
+void tearDown(void) {
+    delete config;
+}
+
+// what CMD_WRITE_CUSTOMIZATION does
+void customize(uint8_t value, bool deferred) {
+    config->setSpeed(5 + value % 50);
+    config->setColorBrightness(value % 100);
+    config->setMaxOpenLevel(50 + value % 50);
+    if (deferred) {
+        config->commitLater();
+    }
+    else {
+        config->commit();
+    }
+}
+
+CommitReport runSessions(bool deferred) {
+    CommitReport report = {0, 0, 0};
+    uint32_t value = 0;
+    for (uint8_t session = 0; session < SESSIONS; session++) {
+        unsigned long bloomEnd = millis() + BLOOM_TIME;
+        for (uint16_t i = 0; i < SESSION_COMMANDS + 200; i++) {
+            bool petalsMoving = (long) (millis() - bloomEnd) < 0;
+            uint32_t commits = config->getCommits();
+            uint64_t startTime = SimHardware::micros();
+            if (i < SESSION_COMMANDS) {
+                customize(value++, deferred);
+            }
+            config->update(petalsMoving);
+            uint32_t blockedTime = SimHardware::micros() - startTime;
+            if (config->getCommits() > commits) {
+                report.commits++;
+                report.longestTime = _max(report.longestTime, blockedTime);
+                report.whileMoving += petalsMoving ? 1 : 0;
+            }
+            delay(COMMAND_INTERVAL);
+        }
+    }
+    return report;
+}
+
+void test_commands_coalesced(void) {
+    CommitReport before = runSessions(false);
+    Config *synchronous = config;
+    setUp();
+    CommitReport after = runSessions(true);
+    printf("%d commands: committed right away %u commits, %u while moving, longest %.2f ms\n",
+        SESSIONS * SESSION_COMMANDS, before.commits, before.whileMoving, before.longestTime / 1000.0);
+    printf("%d commands: deferred %u commits, %u while moving, longest %.2f ms\n",
+        SESSIONS * SESSION_COMMANDS, after.commits, after.whileMoving, after.longestTime / 1000.0);
+    delete synchronous;
+
+    TEST_ASSERT_EQUAL(SESSIONS * SESSION_COMMANDS, before.commits);
+    TEST_ASSERT_TRUE(before.longestTime > SIM_FLASH_ERASE_TIME); // a compaction on the command path
+    TEST_ASSERT_EQUAL(SESSIONS, after.commits); // one per session
+    TEST_ASSERT_EQUAL(0, after.whileMoving);
+    TEST_ASSERT_TRUE(after.longestTime < before.longestTime);
+    TEST_ASSERT_FALSE(config->isCommitPending());
+
+    // the latest values are stored
+    Config rebooted(11);
+    rebooted.begin();
+    rebooted.load();
+    TEST_ASSERT_EQUAL(config->speed, rebooted.speed);
+    TEST_ASSERT_EQUAL(config->colorBrightness, rebooted.colorBrightness);
+    TEST_ASSERT_EQUAL(config->maxOpenLevel, rebooted.maxOpenLevel);
+}
+
+void test_changes_take_effect_right_away(void) {
+    bool changed = false;
+    bool wifiChanged = false;
+    config->onConfigChanged([&](bool wifi) {
+        changed = true;
+        wifiChanged = wifi;
+    });
+    uint32_t written = configFlash.getBytesWritten();
+    config->setWifi("home", "secret");
+    config->commitLater();
+    TEST_ASSERT_TRUE(changed);
+    TEST_ASSERT_TRUE(wifiChanged);
+    TEST_ASSERT_TRUE(config->isCommitPending());
+    TEST_ASSERT_EQUAL(written, configFlash.getBytesWritten());
+}
+
+void test_written_after_quiet_time(void) {
+    uint32_t commits = config->getCommits();
+    config->setSpeed(20);
+    config->commitLater();
+    delay(CONFIG_COMMIT_QUIET_TIME - 1000);
+    config->setSpeed(30); // quiet time starts again
+    config->commitLater();
+    delay(CONFIG_COMMIT_QUIET_TIME - 1);
+    config->update(false);
+    TEST_ASSERT_TRUE(config->isCommitPending());
+    delay(1);
+    config->update(false);
+    TEST_ASSERT_FALSE(config->isCommitPending());
+    TEST_ASSERT_EQUAL(commits + 1, config->getCommits());
+
+    Config rebooted(11);
+    rebooted.begin();
+    rebooted.load();
+    TEST_ASSERT_EQUAL(30, rebooted.speed);
+}
+
+void test_not_written_while_petals_move(void) {
+    config->setColorBrightness(40);
+    config->commitLater();
+    delay(CONFIG_COMMIT_QUIET_TIME * 2);
+    uint32_t written = configFlash.getBytesWritten();
+    config->update(true);
+    TEST_ASSERT_TRUE(config->isCommitPending());
+    TEST_ASSERT_EQUAL(written, configFlash.getBytesWritten());
+    config->update(false);
+    TEST_ASSERT_FALSE(config->isCommitPending());
+    TEST_ASSERT_TRUE(configFlash.getBytesWritten() > written);
+}
+
+void test_loop_woken_up_for_commit(void) {
+    IdleScheduler scheduler;
+    config->setName("Kitchen");
+    config->commitLater();
+    delay(CONFIG_COMMIT_QUIET_TIME - 300);
+    scheduler.begin(millis());
+    config->planIdle(scheduler);
+    TEST_ASSERT_EQUAL(300, scheduler.getPlan().duration);
+}
+
+void test_flushed_before_deep_sleep(void) {
+    config->setBluetoothAlwaysOn(true);
+    config->commitLater();
+    config->flush();
+    TEST_ASSERT_FALSE(config->isCommitPending());
+
+    Config rebooted(11);
+    rebooted.begin();
+    rebooted.load();
+    TEST_ASSERT_TRUE(rebooted.bluetoothAlwaysOn);
+}
+
+void test_unchanged_values_dropped(void) {
+    uint32_t written = configFlash.getBytesWritten();
+    config->setSpeed(config->speed);
+    config->setColorBrightness(config->colorBrightness);
+    config->commitLater();
+    config->flush();
+    TEST_ASSERT_EQUAL(written, configFlash.getBytesWritten());
+
+    config->commitLater(); // nothing changed, nothing to write
+    TEST_ASSERT_FALSE(config->isCommitPending());
+}
+
+void test_failed_write_retried(void) {
+    uint32_t commits = config->getCommits();
+    config->setSpeed(25);
+    config->commitLater();
+    delay(CONFIG_COMMIT_QUIET_TIME);
+    configFlash.cutPowerAfter(0);
+    config->update(false);
+    TEST_ASSERT_EQUAL(commits + 1, config->getCommits());
+    TEST_ASSERT_TRUE(config->isCommitPending()); // the failed key is written again later
+
+    configFlash.powerOn();
+    config->update(false);
+    TEST_ASSERT_EQUAL(commits + 1, config->getCommits()); // after the quiet time
+    delay(CONFIG_COMMIT_QUIET_TIME);
+    config->update(false);
+    TEST_ASSERT_FALSE(config->isCommitPending());
+    TEST_ASSERT_EQUAL(commits + 2, config->getCommits());
+
+    Config rebooted(11);
+    rebooted.begin();
+    rebooted.load();
+    TEST_ASSERT_EQUAL(25, rebooted.speed);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_commands_coalesced);
+    RUN_TEST(test_changes_take_effect_right_away);
+    RUN_TEST(test_written_after_quiet_time);
+    RUN_TEST(test_not_written_while_petals_move);
+    RUN_TEST(test_loop_woken_up_for_commit);
+    RUN_TEST(test_flushed_before_deep_sleep);
+    RUN_TEST(test_unchanged_values_dropped);
+    RUN_TEST(test_failed_write_retried);
+    UNITY_END();
+
+    return 0;
+}
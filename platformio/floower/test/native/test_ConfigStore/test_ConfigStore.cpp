@@ -0,0 +1,339 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <EEPROM.h>
+#include "SimHardware.h"
+#include "SimConfigFlash.h"
+#include "Config.h"
+#include "ConfigStore.h"
+
+#define CHANGES 10000
+
+void setUp(void) {
+    SimHardware::reset();
+    EEPROM.erase();
+    configFlash.eraseAll();
+}
+
+void tearDown(void) {
+}
+
+uint32_t totalErases() {
+    uint32_t erases = 0;
+    for (uint8_t sector = 0; sector < CONFIG_STORE_SECTORS; sector++) {
+        erases += configFlash.getErases(sector);
+    }
+    return erases;
+}
+
+void configure(Config &config) {
+    config.begin();
+    config.hardwareCalibration(1000, 1400, 9, 123);
+    config.factorySettings();
+    config.setCalibrated();
+    config.commit();
+    config.load();
+}
+
+void writeEepromInt(uint16_t address, uint16_t value) {
+    EEPROM.write(address, value & 0xFF);
+    EEPROM.write(address + 1, value >> 8);
+}
+
+void writeEepromString(uint16_t address, uint16_t sizeAddress, const char *value) {
+    EEPROM.write(sizeAddress, strlen(value));
+    for (uint8_t i = 0; i < strlen(value); i++) {
+        EEPROM.write(address + i, value[i]);
+    }
+}
+
+void test_erases_per_10k_changes(void) {
+    Config config(11);
+    configure(config);
+    uint32_t erases = totalErases();
+
+    HsbColor colors[3] = {colorRed, colorGreen, colorBlue};
+    for (uint32_t i = 0; i < CHANGES; i++) {
+        switch (i % 4) {
+            case 0: config.setColorBrightness(i % 100); break;
+            case 1: config.setSpeed(5 + i % 100); break;
+            case 2: config.setName("Floower " + String(i % 1000)); break;
+            case 3: colors[0] = HsbColor((i % 360) / 360.0, 1.0, 1.0); config.setColorScheme(colors, 3); break;
+        }
+        config.commit();
+    }
+    erases = totalErases() - erases;
+
+    // the EEPROM emulation rewrote its whole sector on every commit
+    EEPROM.begin(512);
+    for (uint32_t i = 0; i < CHANGES; i++) {
+        EEPROM.write(26, i % 100);
+        EEPROM.commit();
+    }
+    uint32_t legacyErases = EEPROM.getCommits();
+    printf("%d config changes: EEPROM %u sector erases, store %u sector erases\n", CHANGES, legacyErases, erases);
+    TEST_ASSERT_EQUAL(CHANGES, legacyErases);
+    TEST_ASSERT_TRUE(erases * 100 < legacyErases);
+
+    // erases rotate over the sectors
+    for (uint8_t sector = 0; sector < CONFIG_STORE_SECTORS; sector++) {
+        printf("sector %d: %u erases\n", sector, configFlash.getErases(sector));
+        TEST_ASSERT_UINT32_WITHIN(1, totalErases() / CONFIG_STORE_SECTORS, configFlash.getErases(sector));
+    }
+
+    // the latest values are back after a reboot
+    Config rebooted(11);
+    rebooted.begin();
+    rebooted.load();
+    TEST_ASSERT_EQUAL(5 + (CHANGES - 3) % 100, rebooted.speed);
+    TEST_ASSERT_EQUAL((CHANGES - 4) % 100, rebooted.colorBrightness);
+    TEST_ASSERT_EQUAL_STRING(config.name.c_str(), rebooted.name.c_str());
+    TEST_ASSERT_EQUAL(3, rebooted.colorSchemeSize);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, colors[0].H, rebooted.colorScheme[0].H);
+    TEST_ASSERT_EQUAL(1400, rebooted.servoOpen);
+    TEST_ASSERT_EQUAL(123, rebooted.serialNumber);
+    TEST_ASSERT_TRUE(rebooted.calibrated);
+}
+
+void test_values_survive_reboot(void) {
+    Config config(11);
+    configure(config);
+    config.setWifi("home", "secret");
+    config.setFloud("device", "token");
+    config.setBluetoothAlwaysOn(true);
+    config.setMaxOpenLevel(80);
+    config.commit();
+
+    Config rebooted(11);
+    rebooted.begin();
+    rebooted.load();
+    TEST_ASSERT_EQUAL(1000, rebooted.servoClosed);
+    TEST_ASSERT_EQUAL(1400, rebooted.servoOpen);
+    TEST_ASSERT_EQUAL(9, rebooted.hardwareRevision);
+    TEST_ASSERT_EQUAL(123, rebooted.serialNumber);
+    TEST_ASSERT_TRUE(rebooted.calibrated);
+    TEST_ASSERT_TRUE(rebooted.bluetoothAlwaysOn);
+    TEST_ASSERT_FALSE(rebooted.touchCalibrated);
+    TEST_ASSERT_EQUAL(DEFAULT_TOUCH_THRESHOLD, rebooted.touchThreshold);
+    TEST_ASSERT_EQUAL_STRING("Floower", rebooted.name.c_str());
+    TEST_ASSERT_EQUAL(DEFAULT_SPEED, rebooted.speed);
+    TEST_ASSERT_EQUAL(80, rebooted.maxOpenLevel);
+    TEST_ASSERT_EQUAL(DEFAULT_COLOR_BRIGHTNESS, rebooted.colorBrightness);
+    TEST_ASSERT_EQUAL(DEFAULT_COLOR_SCHEME_SIZE, rebooted.colorSchemeSize);
+    TEST_ASSERT_EQUAL_STRING("home", rebooted.wifiSsid.c_str());
+    TEST_ASSERT_EQUAL_STRING("secret", rebooted.wifiPassword.c_str());
+    TEST_ASSERT_EQUAL_STRING("device", rebooted.floudDeviceId.c_str());
+    TEST_ASSERT_EQUAL_STRING("token", rebooted.floudToken.c_str());
+}
+
+void test_not_configured(void) {
+    Config config(11);
+    config.begin();
+    config.load();
+    TEST_ASSERT_FALSE(config.calibrated);
+    TEST_ASSERT_EQUAL(0, totalErases());
+    TEST_ASSERT_EQUAL(0, configFlash.getBytesWritten());
+}
+
+void test_unchanged_values_not_written(void) {
+    Config config(11);
+    configure(config);
+    uint32_t written = configFlash.getBytesWritten();
+
+    config.factorySettings(); // same values again
+    config.commit();
+    TEST_ASSERT_EQUAL(written, configFlash.getBytesWritten());
+
+    config.setSpeed(30);
+    config.commit();
+    TEST_ASSERT_EQUAL(written + CONFIG_STORE_RECORD_OVERHEAD + 1, configFlash.getBytesWritten());
+}
+
+void test_torn_record_ignored(void) {
+    Config config(11);
+    configure(config);
+    config.setSpeed(30);
+    config.commit();
+
+    // power lost in the middle of the record
+    configFlash.cutPowerAfter(2);
+    config.setSpeed(80);
+    config.commit();
+    configFlash.powerOn();
+
+    Config rebooted(11);
+    rebooted.begin();
+    rebooted.load();
+    TEST_ASSERT_EQUAL(30, rebooted.speed);
+    TEST_ASSERT_TRUE(rebooted.calibrated);
+
+    // nothing is appended after the torn record, the next change moves to a fresh sector
+    uint32_t erases = totalErases();
+    rebooted.setSpeed(90);
+    rebooted.commit();
+    TEST_ASSERT_EQUAL(erases + 1, totalErases());
+
+    Config again(11);
+    again.begin();
+    again.load();
+    TEST_ASSERT_EQUAL(90, again.speed);
+    TEST_ASSERT_EQUAL(1400, again.servoOpen);
+    TEST_ASSERT_EQUAL_STRING("Floower", again.name.c_str());
+}
+
+void test_corrupted_record_falls_back(void) {
+    ConfigStore store;
+    store.begin();
+    store.writeByte(CONFIG_KEY_SPEED, 10); // formats the first sector
+    store.writeByte(CONFIG_KEY_SPEED, 20); // appended after the first record
+    TEST_ASSERT_EQUAL(20, store.readByte(CONFIG_KEY_SPEED, 0));
+
+    uint8_t zero = 0;
+    configFlash.write(CONFIG_STORE_HEADER_SIZE + 4 + 2, &zero, 1); // value of the second record
+    ConfigStore rebooted;
+    rebooted.begin();
+    TEST_ASSERT_EQUAL(10, rebooted.readByte(CONFIG_KEY_SPEED, 0));
+}
+
+void test_interrupted_compaction(void) {
+    ConfigStore store;
+    store.begin();
+    store.writeString(CONFIG_KEY_NAME, "Floower", NAME_MAX_LENGTH);
+
+    // power is enough for a record appended, not for the compaction once the sector is full
+    uint8_t value = 0;
+    while (true) {
+        configFlash.cutPowerAfter(CONFIG_STORE_RECORD_OVERHEAD + 1);
+        if (!store.writeByte(CONFIG_KEY_SPEED, value + 1)) {
+            break;
+        }
+        value++;
+    }
+    configFlash.powerOn();
+    TEST_ASSERT_EQUAL(1, configFlash.getErases(1));
+
+    ConfigStore rebooted;
+    rebooted.begin();
+    TEST_ASSERT_EQUAL_STRING("Floower", rebooted.readString(CONFIG_KEY_NAME, NAME_MAX_LENGTH).c_str());
+    TEST_ASSERT_EQUAL(value, rebooted.readByte(CONFIG_KEY_SPEED, 0));
+    TEST_ASSERT_TRUE(rebooted.writeByte(CONFIG_KEY_SPEED, 1));
+    TEST_ASSERT_EQUAL(2, configFlash.getErases(1)); // compacted again
+
+    ConfigStore again;
+    again.begin();
+    TEST_ASSERT_EQUAL(1, again.readByte(CONFIG_KEY_SPEED, 0));
+    TEST_ASSERT_EQUAL_STRING("Floower", again.readString(CONFIG_KEY_NAME, NAME_MAX_LENGTH).c_str());
+}
+
+void test_migrates_eeprom_version_5(void) {
+    EEPROM.begin(512);
+    EEPROM.write(0, 5);
+    writeEepromInt(2, 1100);
+    writeEepromInt(4, 1500);
+    EEPROM.write(6, 7);
+    writeEepromInt(7, 456);
+    EEPROM.write(9, 0x7); // calibrated, bluetooth, touch calibrated
+    EEPROM.write(20, 50);
+    EEPROM.write(22, 2);
+    EEPROM.write(24, 30);
+    EEPROM.write(25, 90);
+    EEPROM.write(26, 60);
+    writeEepromInt(30, Config::encodeHSColor(colorRed.H, colorRed.S));
+    writeEepromInt(32, Config::encodeHSColor(colorBlue.H, colorBlue.S));
+    writeEepromString(60, 23, "Kitchen");
+    writeEepromString(101, 100, "home");
+    writeEepromString(134, 133, "secret");
+    writeEepromString(199, 198, "token");
+    writeEepromString(240, 239, "device");
+
+    Config config(11);
+    config.begin();
+    config.load();
+    TEST_ASSERT_EQUAL(1100, config.servoClosed);
+    TEST_ASSERT_EQUAL(1500, config.servoOpen);
+    TEST_ASSERT_EQUAL(7, config.hardwareRevision);
+    TEST_ASSERT_EQUAL(456, config.serialNumber);
+    TEST_ASSERT_TRUE(config.calibrated);
+    TEST_ASSERT_TRUE(config.bluetoothAlwaysOn);
+    TEST_ASSERT_TRUE(config.touchCalibrated);
+    TEST_ASSERT_EQUAL(50, config.touchThreshold);
+    TEST_ASSERT_EQUAL(30, config.speed);
+    TEST_ASSERT_EQUAL(90, config.maxOpenLevel);
+    TEST_ASSERT_EQUAL(60, config.colorBrightness);
+    TEST_ASSERT_EQUAL(2, config.colorSchemeSize);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, colorBlue.H, config.colorScheme[1].H);
+    TEST_ASSERT_EQUAL_STRING("Kitchen", config.name.c_str());
+    TEST_ASSERT_EQUAL_STRING("home", config.wifiSsid.c_str());
+    TEST_ASSERT_EQUAL_STRING("secret", config.wifiPassword.c_str());
+    TEST_ASSERT_EQUAL_STRING("token", config.floudToken.c_str());
+    TEST_ASSERT_EQUAL_STRING("device", config.floudDeviceId.c_str());
+
+    // moved once, the EEPROM is not needed anymore
+    EEPROM.erase();
+    Config rebooted(11);
+    rebooted.begin();
+    rebooted.load();
+    TEST_ASSERT_EQUAL(1500, rebooted.servoOpen);
+    TEST_ASSERT_EQUAL_STRING("Kitchen", rebooted.name.c_str());
+}
+
+void test_migrates_eeprom_version_3(void) {
+    EEPROM.begin(512);
+    EEPROM.write(0, 3);
+    writeEepromInt(2, 1100);
+    writeEepromInt(4, 1500);
+    EEPROM.write(6, 7);
+    writeEepromInt(7, 456);
+    EEPROM.write(9, 0x2); // bluetooth
+    EEPROM.write(20, 50);
+    writeEepromString(60, 23, "Kitchen");
+
+    Config config(11);
+    config.begin();
+    config.load();
+    TEST_ASSERT_EQUAL(1500, config.servoOpen);
+    TEST_ASSERT_EQUAL(456, config.serialNumber);
+    TEST_ASSERT_TRUE(config.bluetoothAlwaysOn);
+    TEST_ASSERT_FALSE(config.calibrated);
+    TEST_ASSERT_EQUAL(DEFAULT_TOUCH_THRESHOLD, config.touchThreshold); // reset by version 4
+    TEST_ASSERT_EQUAL(DEFAULT_SPEED, config.speed);
+    TEST_ASSERT_EQUAL(DEFAULT_MAX_OPEN_LEVEL, config.maxOpenLevel);
+    TEST_ASSERT_EQUAL(DEFAULT_COLOR_BRIGHTNESS, config.colorBrightness);
+    TEST_ASSERT_EQUAL(DEFAULT_COLOR_SCHEME_SIZE, config.colorSchemeSize);
+    TEST_ASSERT_EQUAL_STRING("Kitchen", config.name.c_str());
+    TEST_ASSERT_EQUAL_STRING("", config.wifiSsid.c_str());
+}
+
+void test_migrates_eeprom_version_1(void) {
+    EEPROM.begin(512);
+    EEPROM.write(0, 1);
+    writeEepromInt(2, 1100);
+    writeEepromInt(4, 1500);
+
+    Config config(11);
+    config.begin();
+    config.load();
+    TEST_ASSERT_EQUAL(1100, config.servoClosed);
+    TEST_ASSERT_EQUAL(1500, config.servoOpen);
+    TEST_ASSERT_EQUAL(0, config.serialNumber);
+    TEST_ASSERT_TRUE(config.calibrated); // set by version 3
+    TEST_ASSERT_FALSE(config.bluetoothAlwaysOn);
+    TEST_ASSERT_EQUAL_STRING("Floower", config.name.c_str());
+    TEST_ASSERT_EQUAL(DEFAULT_SPEED, config.speed);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_erases_per_10k_changes);
+    RUN_TEST(test_values_survive_reboot);
+    RUN_TEST(test_not_configured);
+    RUN_TEST(test_unchanged_values_not_written);
+    RUN_TEST(test_torn_record_ignored);
+    RUN_TEST(test_corrupted_record_falls_back);
+    RUN_TEST(test_interrupted_compaction);
+    RUN_TEST(test_migrates_eeprom_version_5);
+    RUN_TEST(test_migrates_eeprom_version_3);
+    RUN_TEST(test_migrates_eeprom_version_1);
+    UNITY_END();
+
+    return 0;
+}
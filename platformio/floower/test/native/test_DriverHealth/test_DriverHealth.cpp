@@ -0,0 +1,208 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <EEPROM.h>
+#include "SimHardware.h"
+#include "SimTmcUart.h"
+#include "hardware/DriverHealth.h"
+#include "hardware/Petals.h"
+
+#define DRV_STATUS_OTPW 0x1
+#define DRV_STATUS_OT 0x2
+#define DRV_STATUS_S2GA 0x4
+#define DRV_STATUS_STST 0x80000000
+#define GSTAT_RESET 0x1
+#define GSTAT_DRV_ERR 0x2
+
+DriverHealth *health;
+
+TMC2300Status status(uint32_t drvStatus, uint32_t gstat) {
+    TMC2300Status status;
+    status.drvStatus.sr = drvStatus;
+    status.sgValue = 100;
+    status.gstat.sr = gstat;
+    return status;
+}
+
+void setUp(void) {
+    SimHardware::reset();
+    EEPROM.erase();
+    health = new DriverHealth();
+    health->begin(31);
+}
+
+void tearDown(void) {
+    delete health;
+}
+
+void test_faults_counted_when_they_appear(void) {
+    unsigned long now = 1000;
+    health->addSample(true, status(DRV_STATUS_STST, 0), now);
+    health->addSample(true, status(DRV_STATUS_S2GA, GSTAT_DRV_ERR), now += 500);
+    health->addSample(true, status(DRV_STATUS_S2GA, GSTAT_DRV_ERR), now += 500); // still there
+    health->addSample(false, status(0, 0), now += 500);
+    health->addSample(true, status(DRV_STATUS_S2GA, 0), now += 500); // again after the UART fault
+
+    TEST_ASSERT_EQUAL(5, health->getSamples());
+    TEST_ASSERT_EQUAL(2, health->getFaultCount(FAULT_SHORT));
+    TEST_ASSERT_EQUAL(1, health->getFaultCount(FAULT_DRIVER_ERROR));
+    TEST_ASSERT_EQUAL(1, health->getFaultCount(FAULT_UART));
+    TEST_ASSERT_EQUAL(0, health->getFaultCount(FAULT_OVERTEMP));
+
+    DriverFaultEvent events[HEALTH_EVENTS];
+    TEST_ASSERT_EQUAL(4, health->getEvents(events, HEALTH_EVENTS));
+    TEST_ASSERT_EQUAL(FAULT_SHORT, events[0].fault); // latest first
+    TEST_ASSERT_EQUAL(3, events[0].time);
+    TEST_ASSERT_EQUAL(FAULT_UART, events[1].fault);
+    TEST_ASSERT_EQUAL(FAULT_SHORT, events[2].fault); // same sample, in DriverFault order
+    TEST_ASSERT_EQUAL(FAULT_DRIVER_ERROR, events[3].fault);
+    TEST_ASSERT_EQUAL(31, events[3].irun);
+}
+
+void test_events_ring_keeps_latest(void) {
+    unsigned long now = 0;
+    for (uint8_t i = 0; i < HEALTH_EVENTS + 5; i++) {
+        health->addSample(true, status(0, GSTAT_RESET), now += 1000);
+        health->addSample(true, status(0, 0), now += 1000);
+    }
+    TEST_ASSERT_EQUAL(HEALTH_EVENTS + 5, health->getFaultCount(FAULT_RESET));
+
+    DriverFaultEvent events[HEALTH_EVENTS + 2];
+    TEST_ASSERT_EQUAL(HEALTH_EVENTS, health->getEvents(events, HEALTH_EVENTS + 2));
+    TEST_ASSERT_EQUAL(now / 1000 - 1, events[0].time);
+    TEST_ASSERT_EQUAL(now / 1000 - 1 - 2 * (HEALTH_EVENTS - 1), events[HEALTH_EVENTS - 1].time);
+    TEST_ASSERT_EQUAL(2, health->getEvents(events, 2));
+}
+
+void test_overtemperature_derates_and_restores(void) {
+    unsigned long now = 0;
+    health->addSample(true, status(DRV_STATUS_OTPW, 0), now += 500);
+    TEST_ASSERT_EQUAL(31 - HEALTH_IRUN_STEP, health->getIrun()); // right away
+
+    // still hot, one step a period down to the minimum
+    for (uint8_t i = 0; i < 20; i++) {
+        health->addSample(true, status(DRV_STATUS_OTPW, 0), now += 500);
+    }
+    TEST_ASSERT_EQUAL(31 - 3 * HEALTH_IRUN_STEP, health->getIrun());
+    for (uint8_t i = 0; i < 100; i++) {
+        health->addSample(true, status(DRV_STATUS_OTPW, 0), now += 500);
+    }
+    TEST_ASSERT_EQUAL(HEALTH_IRUN_MIN, health->getIrun());
+    TEST_ASSERT_EQUAL(1, health->getFaultCount(FAULT_OVERTEMP_WARNING));
+
+    // cooled down, back to full current slowly
+    health->addSample(true, status(0, 0), now += HEALTH_RESTORE_PERIOD - 1000);
+    TEST_ASSERT_EQUAL(HEALTH_IRUN_MIN, health->getIrun());
+    while (health->getIrun() < 31 && now < 3600000) {
+        health->addSample(true, status(0, 0), now += 500);
+    }
+    TEST_ASSERT_EQUAL(31, health->getIrun());
+
+    // shutdown takes it to the minimum at once
+    health->addSample(true, status(DRV_STATUS_OT, GSTAT_DRV_ERR), now += 500);
+    TEST_ASSERT_EQUAL(HEALTH_IRUN_MIN, health->getIrun());
+}
+
+void test_uart_fault_keeps_run_current(void) {
+    health->addSample(true, status(DRV_STATUS_OTPW, 0), 500);
+    uint8_t irun = health->getIrun();
+    health->addSample(false, status(0, 0), 1000);
+    TEST_ASSERT_EQUAL(irun, health->getIrun());
+}
+
+void test_rate_limited(void) {
+    TEST_ASSERT_TRUE(health->isSampleDue(HEALTH_SAMPLING_PERIOD));
+    health->addSample(true, status(0, 0), 1000);
+    TEST_ASSERT_FALSE(health->isSampleDue(1000 + HEALTH_SAMPLING_PERIOD - 1));
+    TEST_ASSERT_TRUE(health->isSampleDue(1000 + HEALTH_SAMPLING_PERIOD));
+}
+
+void test_petals_derate_hot_driver(void) {
+    Config config(11);
+    config.begin();
+    config.hardwareCalibration(1000, 1000, 9, 1);
+    config.factorySettings();
+    config.load();
+    StepperPetals petals(&config, health);
+    SimTmcUart *driver = SimHardware::getTmcUart();
+    petals.init(false, false);
+    REG_IHOLD_IRUN iholdIrun;
+    iholdIrun.sr = driver->getRegister(REG_IHOLD_IRUN::address);
+    TEST_ASSERT_EQUAL(31, iholdIrun.irun);
+
+    // driver gets hot during the bloom
+    driver->setRegister(REG_DRV_STATUS::address, DRV_STATUS_OTPW);
+    petals.setPetalsOpenLevel(100, config.speedMillis);
+    while (petals.arePetalsMoving() || petals.isEnabled()) {
+        petals.update();
+        delay(1);
+    }
+    iholdIrun.sr = driver->getRegister(REG_IHOLD_IRUN::address);
+    TEST_ASSERT_EQUAL(health->getIrun(), iholdIrun.irun);
+    TEST_ASSERT_TRUE(iholdIrun.irun < 31);
+    TEST_ASSERT_EQUAL(1, health->getFaultCount(FAULT_OVERTEMP_WARNING));
+    TEST_ASSERT_TRUE(health->getSamples() > 10); // StallGuard samples count too
+}
+
+void test_petals_power_on_not_a_fault(void) {
+    Config config(11);
+    config.begin();
+    config.hardwareCalibration(1000, 1000, 9, 1);
+    config.factorySettings();
+    config.load();
+    StepperPetals petals(&config, health);
+    SimTmcUart *driver = SimHardware::getTmcUart();
+    TEST_ASSERT_EQUAL(GSTAT_RESET, driver->getRegister(REG_GSTAT::address)); // as the driver powers on
+    petals.init(false, false);
+    TEST_ASSERT_EQUAL(0, driver->getRegister(REG_GSTAT::address));
+    uint32_t writes = driver->getWriteCount();
+
+    petals.setPetalsOpenLevel(50, 1000);
+    while (petals.arePetalsMoving() || petals.isEnabled()) {
+        petals.update();
+        delay(1);
+    }
+    TEST_ASSERT_TRUE(health->getSamples() > 0);
+    TEST_ASSERT_EQUAL(0, health->getFaultCount(FAULT_RESET));
+    TEST_ASSERT_EQUAL(writes, driver->getWriteCount()); // not configured again
+}
+
+void test_petals_reconfigure_reset_driver(void) {
+    Config config(11);
+    config.begin();
+    config.hardwareCalibration(1000, 1000, 9, 1);
+    config.factorySettings();
+    config.load();
+    StepperPetals petals(&config, health);
+    SimTmcUart *driver = SimHardware::getTmcUart();
+    petals.init(false, false);
+    uint32_t chopconf = driver->getRegister(REG_CHOPCONF::address);
+
+    // brown-out resets the driver between movements
+    driver->setRegister(REG_CHOPCONF::address, TMC2300_CHOPCONF_DEFAULT);
+    driver->setRegister(REG_SGTHRS_ADDRESS, 0);
+    driver->setRegister(REG_GSTAT::address, GSTAT_RESET);
+    petals.setPetalsOpenLevel(50, 1000);
+    while (petals.arePetalsMoving() || petals.isEnabled()) {
+        petals.update();
+        delay(1);
+    }
+    TEST_ASSERT_EQUAL(1, health->getFaultCount(FAULT_RESET));
+    TEST_ASSERT_EQUAL(0, driver->getRegister(REG_GSTAT::address)); // cleared
+    TEST_ASSERT_EQUAL_HEX32(chopconf, driver->getRegister(REG_CHOPCONF::address));
+    TEST_ASSERT_TRUE(driver->getRegister(REG_SGTHRS_ADDRESS) > 0);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_faults_counted_when_they_appear);
+    RUN_TEST(test_events_ring_keeps_latest);
+    RUN_TEST(test_overtemperature_derates_and_restores);
+    RUN_TEST(test_uart_fault_keeps_run_current);
+    RUN_TEST(test_rate_limited);
+    RUN_TEST(test_petals_derate_hot_driver);
+    RUN_TEST(test_petals_power_on_not_a_fault);
+    RUN_TEST(test_petals_reconfigure_reset_driver);
+    UNITY_END();
+
+    return 0;
+}
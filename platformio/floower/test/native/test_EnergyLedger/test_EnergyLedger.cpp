@@ -0,0 +1,183 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <EEPROM.h>
+#include "SimHardware.h"
+#include "EnergyLedger.h"
+#include "IdleScheduler.h"
+#include "behavior/BloomingBehavior.h"
+
+#define BATTERY_PIN 36
+#define USB_PIN 39
+#define TOUCH_PIN 4
+
+#define ADC_BATTERY_FULL 2300 // ~4.16V
+
+#define HOUR 3600000000UL // us
+
+static const char *consumerNames[ENERGY_CONSUMERS] = {"CPU", "stepper", "LEDs", "WiFi", "BLE"};
+
+Config *config;
+Floower *floower;
+RemoteControl *remoteControl;
+BloomingBehavior *behavior;
+EnergyLedger *ledger;
+IdleScheduler scheduler;
+bool started;
+
+// main loop as in main.cpp
+void run(unsigned long durationMs) {
+    unsigned long endTime = millis() + durationMs;
+    while (millis() < endTime) {
+        floower->update();
+        behavior->loop();
+        remoteControl->accountEnergy(*ledger);
+        scheduler.begin(millis());
+        floower->planIdle(scheduler);
+        behavior->planIdle(scheduler);
+        remoteControl->planIdle(scheduler);
+        if (scheduler.getPlan().mode == IDLE_NONE) {
+            delay(1); // simulated time moves only by delays
+        }
+        if (scheduler.idle()) {
+            floower->registerOutsideTouch();
+        }
+    }
+}
+
+void startFloower() {
+    SimHardware::setAnalog(BATTERY_PIN, ADC_BATTERY_FULL);
+    SimHardware::setAnalog(USB_PIN, 0);
+    SimHardware::setDigital(35, HIGH); // not charging
+
+    config->begin();
+    config->hardwareCalibration(1000, 1000, 9, 1);
+    config->factorySettings();
+    config->setCalibrated();
+    config->setTouchCalibrated(true);
+    config->commit();
+    config->load();
+    config->deepSleepEnabled = true;
+
+    floower->init();
+    floower->setEnergyLedger(ledger);
+    scheduler.setEnergyLedger(ledger);
+    floower->readPowerState();
+    behavior->setup(false);
+    started = true;
+}
+
+void setUp(void) {
+    SimHardware::reset();
+    EEPROM.erase();
+    ledger = new EnergyLedger();
+    config = new Config(11);
+    floower = new Floower(config);
+    remoteControl = new RemoteControl(nullptr, nullptr, nullptr);
+    behavior = new BloomingBehavior(config, floower, remoteControl);
+    started = false;
+}
+
+void tearDown(void) {
+    if (started) {
+        run(1000); // let the touch cooldown expire, touch state is static
+    }
+    scheduler.setEnergyLedger(nullptr);
+    delete behavior;
+    delete remoteControl;
+    delete floower;
+    delete config;
+    delete ledger;
+}
+
+void test_time_in_state_weighted_by_model(void) {
+    ledger->setState(ENERGY_CPU, CPU_IDLE);
+    SimHardware::advance(HOUR);
+    ledger->setState(ENERGY_CPU, CPU_ACTIVE);
+    ledger->setState(ENERGY_WIFI, POWER_ON);
+    SimHardware::advance(HOUR / 2);
+    ledger->update();
+
+    TEST_ASSERT_EQUAL(3600000, ledger->getStateTime(ENERGY_CPU, CPU_IDLE));
+    TEST_ASSERT_EQUAL(1800000, ledger->getStateTime(ENERGY_CPU, CPU_ACTIVE));
+    TEST_ASSERT_EQUAL(ENERGY_CPU_IDLE + ENERGY_CPU_ACTIVE / 2, ledger->getCharge(ENERGY_CPU));
+    TEST_ASSERT_EQUAL(ENERGY_WIFI_ON / 2, ledger->getCharge(ENERGY_WIFI));
+    TEST_ASSERT_EQUAL(0, ledger->getCharge(ENERGY_STEPPER));
+    TEST_ASSERT_EQUAL(ENERGY_CPU_ACTIVE + ENERGY_WIFI_ON, ledger->getCurrent());
+
+    // the model applies to the time already spent, tuned figures reprice the past
+    ledger->setCurrent(ENERGY_WIFI, POWER_ON, 100000);
+    TEST_ASSERT_EQUAL(50000, ledger->getCharge(ENERGY_WIFI));
+    TEST_ASSERT_EQUAL(ENERGY_CPU_IDLE + ENERGY_CPU_ACTIVE / 2 + 50000, ledger->getTotalCharge());
+
+    ledger->reset();
+    TEST_ASSERT_EQUAL(0, ledger->getTotalCharge());
+    TEST_ASSERT_EQUAL(POWER_ON, ledger->getState(ENERGY_WIFI)); // states stay
+}
+
+void test_leds_light_accounted(void) {
+    ledger->setState(ENERGY_CPU, CPU_LIGHT_SLEEP); // leave the CPU out
+    ledger->setState(ENERGY_LEDS, POWER_ON);
+    ledger->setLedsLight(PIXELS_COUNT * 3 * GAMMA_MAX_LEVEL); // white
+    SimHardware::advance(HOUR);
+    ledger->setLedsLight(PIXELS_COUNT * GAMMA_MAX_LEVEL / 2); // dim red
+    SimHardware::advance(HOUR);
+    ledger->update();
+
+    uint32_t expected = 2 * ENERGY_LEDS_POWERED + PIXELS_COUNT * 3 * ENERGY_LED_CHANNEL + PIXELS_COUNT * ENERGY_LED_CHANNEL / 2;
+    TEST_ASSERT_UINT32_WITHIN(PIXELS_COUNT * 3 * ENERGY_LED_CHANNEL / 256, expected, ledger->getCharge(ENERGY_LEDS));
+}
+
+void test_micros_overflow(void) {
+    SimHardware::advance(0xFFFFFFFF - HOUR / 2); // micros() of ESP32 overflows every 71 minutes
+    ledger->reset();
+    ledger->setState(ENERGY_STEPPER, POWER_ON);
+    for (uint8_t i = 0; i < 4; i++) {
+        SimHardware::advance(HOUR / 4);
+        ledger->update();
+    }
+    TEST_ASSERT_EQUAL(3600000, ledger->getStateTime(ENERGY_STEPPER, POWER_ON));
+    TEST_ASSERT_EQUAL(ENERGY_STEPPER_ENABLED, ledger->getCharge(ENERGY_STEPPER));
+}
+
+void test_bloom_on_battery_breakdown(void) {
+    startFloower();
+    run(3000);
+    ledger->reset();
+
+    // bloom, stay lit for a while, close and idle until the deep sleep
+    SimHardware::setTouch(TOUCH_PIN, 10);
+    run(200);
+    SimHardware::setTouch(TOUCH_PIN, 100);
+    run(config->speedMillis + 10000);
+    SimHardware::setTouch(TOUCH_PIN, 10);
+    run(200);
+    SimHardware::setTouch(TOUCH_PIN, 100);
+    run(config->speedMillis + 30000);
+    ledger->update();
+
+    printf("bloom cycle on battery, %lu s:\n", (ledger->getStateTime(ENERGY_CPU, CPU_ACTIVE) + ledger->getStateTime(ENERGY_CPU, CPU_IDLE)
+        + ledger->getStateTime(ENERGY_CPU, CPU_LIGHT_SLEEP)) / 1000UL);
+    for (uint8_t i = 0; i < ENERGY_CONSUMERS; i++) {
+        printf("  %-8s %6u uAh\n", consumerNames[i], ledger->getCharge((EnergyConsumer) i));
+    }
+
+    // stepper runs for both movements only, LEDs are lit in between and the CPU sleeps most of the time
+    uint32_t stepperTime = ledger->getStateTime(ENERGY_STEPPER, POWER_ON);
+    TEST_ASSERT_UINT32_WITHIN(config->speedMillis / 2, 2 * config->speedMillis, stepperTime);
+    TEST_ASSERT_TRUE(ledger->getStateTime(ENERGY_LEDS, POWER_ON) > 10000);
+    TEST_ASSERT_TRUE(ledger->getStateTime(ENERGY_CPU, CPU_LIGHT_SLEEP) > 20000);
+    TEST_ASSERT_TRUE(ledger->getCharge(ENERGY_LEDS) > 0);
+    TEST_ASSERT_EQUAL(0, ledger->getCharge(ENERGY_WIFI));
+    TEST_ASSERT_FALSE(SimHardware::isDeepSleeping());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_time_in_state_weighted_by_model);
+    RUN_TEST(test_leds_light_accounted);
+    RUN_TEST(test_micros_overflow);
+    RUN_TEST(test_bloom_on_battery_breakdown);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "SimHardware.h"
+#include "SimLedStrip.h"
+#include "hardware/FrameGovernor.h"
+#include "hardware/MotionTask.h"
+
+#define PIXELS_PIN 27
+#define STATUS_PIXELS_PIN 32
+
+void setUp(void) {
+    SimHardware::reset();
+}
+
+void tearDown(void) {
+}
+
+void test_rate_limited_to_target(void) {
+    FrameGovernor governor(50); // 20ms per frame
+    uint8_t frame[3] = {0, 0, 0};
+    uint32_t shown = 0;
+
+    // new content every 1ms for 2s
+    for (unsigned long now = 0; now < 2000000; now += 1000) {
+        frame[0]++;
+        if (governor.isFrameDue(now) && governor.submitFrame(frame, sizeof(frame), now)) {
+            shown++;
+        }
+    }
+    TEST_ASSERT_UINT32_WITHIN(1, 100, shown);
+    FrameStats stats = governor.getStats();
+    TEST_ASSERT_EQUAL(50, stats.targetFps);
+    TEST_ASSERT_UINT32_WITHIN(1, 50, stats.fps);
+    TEST_ASSERT_EQUAL(shown, stats.shown);
+}
+
+void test_identical_frames_skipped(void) {
+    FrameGovernor governor(100);
+    uint8_t frame[6] = {1, 2, 3, 4, 5, 6};
+
+    TEST_ASSERT_TRUE(governor.submitFrame(frame, sizeof(frame), 0));
+    TEST_ASSERT_FALSE(governor.submitFrame(frame, sizeof(frame), 20000));
+    TEST_ASSERT_FALSE(governor.submitFrame(frame, sizeof(frame), 40000));
+    frame[5] = 7;
+    TEST_ASSERT_TRUE(governor.submitFrame(frame, sizeof(frame), 60000));
+
+    FrameStats stats = governor.getStats();
+    TEST_ASSERT_EQUAL(2, stats.shown);
+    TEST_ASSERT_EQUAL(2, stats.skipped);
+}
+
+void test_fps_drops_to_zero_when_idle(void) {
+    FrameGovernor governor(30);
+    uint8_t frame[3] = {1, 2, 3};
+    governor.isFrameDue(0);
+    governor.submitFrame(frame, sizeof(frame), 0);
+
+    for (unsigned long now = 0; now <= 2 * FRAME_RATE_WINDOW; now += 1000) {
+        governor.isFrameDue(now);
+    }
+    TEST_ASSERT_EQUAL(0, governor.getStats().fps);
+}
+
+void test_target_clamped(void) {
+    FrameGovernor governor(0);
+    TEST_ASSERT_EQUAL(1, governor.getTargetFps());
+    governor.setTargetFps(255);
+    TEST_ASSERT_EQUAL(FRAME_RATE_MAX, governor.getTargetFps());
+}
+
+void test_motion_task_skips_redundant_shows(void) {
+    MotionTask motionTask(PIXELS_PIN, STATUS_PIXELS_PIN);
+    motionTask.init(nullptr);
+    motionTask.setPixelsFrameRate(20); // 50ms per frame
+    SimLedStrip *pixels = SimHardware::getLedStrip(PIXELS_PIN);
+    uint32_t initialShows = pixels->getShowCount();
+
+    // a new frame every 1ms for 1s, the loop runs the iterations
+    LedsFrame frame;
+    for (uint16_t i = 0; i < 1000; i++) {
+        frame.pixels[0] = RgbColor(i / 4, 0, 0);
+        motionTask.showLeds(frame);
+        motionTask.run();
+        SimHardware::advance(1000);
+    }
+    uint32_t shows = pixels->getShowCount() - initialShows;
+    TEST_ASSERT_UINT32_WITHIN(1, 20, shows);
+
+    // frame that went back to the shown one before being due is not sent again
+    SimHardware::advance(100000);
+    frame.pixels[0] = RgbColor(1, 2, 3);
+    motionTask.showLeds(frame);
+    motionTask.run();
+    frame.pixels[0] = RgbColor(3, 2, 1);
+    motionTask.showLeds(frame);
+    motionTask.run();
+    frame.pixels[0] = RgbColor(1, 2, 3);
+    motionTask.showLeds(frame);
+    motionTask.run();
+    SimHardware::advance(100000);
+    motionTask.run();
+
+    FrameStats stats = motionTask.getPixelsFrameStats();
+    TEST_ASSERT_EQUAL(shows + 1, stats.shown);
+    TEST_ASSERT_EQUAL(1, stats.skipped);
+    TEST_ASSERT_TRUE(pixels->getShownColor(0) == RgbColor(1, 2, 3));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_rate_limited_to_target);
+    RUN_TEST(test_identical_frames_skipped);
+    RUN_TEST(test_fps_drops_to_zero_when_idle);
+    RUN_TEST(test_target_clamped);
+    RUN_TEST(test_motion_task_skips_redundant_shows);
+    UNITY_END();
+
+    return 0;
+}
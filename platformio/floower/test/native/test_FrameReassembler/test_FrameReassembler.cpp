@@ -0,0 +1,272 @@
+#include <unity.h>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string.h>
+#include "connect/FrameReassembler.h"
+
+#define FUZZ_ROUNDS 200
+#define FUZZ_FRAMES 50
+#define THROUGHPUT_FRAMES 200000
+
+struct Frame {
+    uint16_t type;
+    uint16_t id;
+    std::vector<char> payload;
+};
+
+static uint32_t randomState = 1;
+
+static uint32_t nextRandom() {
+    // xorshift, deterministic across runs
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+static Frame randomFrame(uint16_t id) {
+    Frame frame;
+    frame.type = nextRandom() % 100;
+    frame.id = id;
+    frame.payload.resize(nextRandom() % 4 == 0 ? 0 : nextRandom() % (MAX_MESSAGE_PAYLOAD_BYTES + 1));
+    for (char &c : frame.payload) {
+        c = nextRandom();
+    }
+    return frame;
+}
+
+static void appendFrame(std::vector<char> &stream, const Frame &frame) {
+    uint16_t length = frame.payload.size();
+    const char header[] = {
+        (char) (frame.type >> 8), (char) frame.type,
+        (char) (frame.id >> 8), (char) frame.id,
+        (char) (length >> 8), (char) length
+    };
+    stream.insert(stream.end(), header, header + sizeof(header));
+    stream.insert(stream.end(), frame.payload.begin(), frame.payload.end());
+}
+
+static void assertFrame(const Frame &expected, const CommandMessageHeader &header, const char *payload) {
+    TEST_ASSERT_EQUAL(expected.type, header.type);
+    TEST_ASSERT_EQUAL(expected.id, header.id);
+    TEST_ASSERT_EQUAL(expected.payload.size(), header.length);
+    if (header.length > 0) {
+        TEST_ASSERT_EQUAL(0, memcmp(expected.payload.data(), payload, header.length));
+    }
+}
+
+void setUp(void) {
+    randomState = 1;
+}
+
+void tearDown(void) {
+}
+
+void test_frame_split_byte_by_byte(void) {
+    static FrameReassembler frames;
+    CommandMessageHeader header;
+    char payload[MAX_MESSAGE_PAYLOAD_BYTES];
+    Frame frame = randomFrame(1);
+    frame.payload.resize(10);
+    std::vector<char> stream;
+    appendFrame(stream, frame);
+
+    for (size_t i = 0; i < stream.size() - 1; i++) {
+        TEST_ASSERT_EQUAL(FRAME_OK, frames.feed(&stream[i], 1));
+        TEST_ASSERT_FALSE(frames.next(header, payload));
+    }
+    TEST_ASSERT_EQUAL(FRAME_OK, frames.feed(&stream.back(), 1));
+    TEST_ASSERT_EQUAL(1, frames.getQueuedFrames());
+    TEST_ASSERT_TRUE(frames.next(header, payload));
+    assertFrame(frame, header, payload);
+    TEST_ASSERT_FALSE(frames.next(header, payload));
+}
+
+void test_coalesced_frames_in_one_packet(void) {
+    static FrameReassembler frames;
+    CommandMessageHeader header;
+    char payload[MAX_MESSAGE_PAYLOAD_BYTES];
+    std::vector<Frame> sent;
+    std::vector<char> stream;
+    for (uint16_t i = 0; i < 5; i++) {
+        sent.push_back(randomFrame(i));
+        appendFrame(stream, sent.back());
+    }
+
+    TEST_ASSERT_EQUAL(FRAME_OK, frames.feed(stream.data(), stream.size()));
+    TEST_ASSERT_EQUAL(5, frames.getQueuedFrames());
+    for (const Frame &frame : sent) {
+        TEST_ASSERT_TRUE(frames.next(header, payload));
+        assertFrame(frame, header, payload);
+    }
+    TEST_ASSERT_FALSE(frames.next(header, payload));
+    TEST_ASSERT_EQUAL(5, frames.getReceivedFrames());
+}
+
+void test_random_segmentation(void) {
+    static FrameReassembler frames;
+    CommandMessageHeader header;
+    char payload[MAX_MESSAGE_PAYLOAD_BYTES];
+
+    for (uint16_t round = 0; round < FUZZ_ROUNDS; round++) {
+        std::vector<Frame> sent;
+        std::vector<char> stream;
+        for (uint16_t i = 0; i < FUZZ_FRAMES; i++) {
+            sent.push_back(randomFrame(i));
+            appendFrame(stream, sent.back());
+        }
+
+        // replay the stream cut into random segments, drain sometimes to let frames pile up
+        size_t received = 0;
+        size_t position = 0;
+        while (position < stream.size()) {
+            size_t segment = 1 + nextRandom() % 600;
+            if (segment > stream.size() - position) {
+                segment = stream.size() - position;
+            }
+            while (frames.feed(&stream[position], segment) == FRAME_OVERFLOW) {
+                // rejected segment is not consumed, make room and retry
+                TEST_ASSERT_TRUE(frames.next(header, payload));
+                assertFrame(sent[received++], header, payload);
+            }
+            position += segment;
+
+            while (nextRandom() % 3 != 0 && frames.next(header, payload)) {
+                assertFrame(sent[received++], header, payload);
+            }
+        }
+        while (frames.next(header, payload)) {
+            assertFrame(sent[received++], header, payload);
+        }
+        TEST_ASSERT_EQUAL(FUZZ_FRAMES, received);
+    }
+    TEST_ASSERT_EQUAL(FUZZ_ROUNDS * FUZZ_FRAMES, frames.getReceivedFrames());
+}
+
+void test_invalid_length(void) {
+    static FrameReassembler frames;
+    const char invalid[] = { 0, 1, 0, 2, (char) 0xFF, (char) 0xFF };
+    TEST_ASSERT_EQUAL(FRAME_INVALID, frames.feed(invalid, sizeof(invalid)));
+
+    // stream resumes with the next connection
+    CommandMessageHeader header;
+    char payload[MAX_MESSAGE_PAYLOAD_BYTES];
+    const char valid[] = { 0, 1, 0, 2, 0, 0 };
+    frames.discardPartial();
+    TEST_ASSERT_EQUAL(FRAME_OK, frames.feed(valid, sizeof(valid)));
+    TEST_ASSERT_TRUE(frames.next(header, payload));
+    TEST_ASSERT_EQUAL(2, header.id);
+}
+
+void test_frames_before_invalid_published(void) {
+    static FrameReassembler frames;
+    const char chunk[] = {
+        0, 1, 0, 3, 0, 1, 'a', // complete frame
+        0, 1, 0, 4, 0, 0, // complete frame without payload
+        0, 1, 0, 5, (char) 0xFF, (char) 0xFF // invalid
+    };
+    TEST_ASSERT_EQUAL(FRAME_INVALID, frames.feed(chunk, sizeof(chunk)));
+    TEST_ASSERT_EQUAL(2, frames.getQueuedFrames());
+    TEST_ASSERT_EQUAL(2, frames.getReceivedFrames());
+
+    CommandMessageHeader header;
+    char payload[MAX_MESSAGE_PAYLOAD_BYTES];
+    TEST_ASSERT_TRUE(frames.next(header, payload));
+    TEST_ASSERT_EQUAL(3, header.id);
+    TEST_ASSERT_EQUAL('a', payload[0]);
+    TEST_ASSERT_TRUE(frames.next(header, payload));
+    TEST_ASSERT_EQUAL(4, header.id);
+    TEST_ASSERT_FALSE(frames.next(header, payload));
+}
+
+void test_overflow_when_not_drained(void) {
+    static FrameReassembler frames;
+    CommandMessageHeader header;
+    char payload[MAX_MESSAGE_PAYLOAD_BYTES];
+    Frame frame = randomFrame(1);
+    frame.payload.resize(100);
+    std::vector<char> stream;
+    appendFrame(stream, frame);
+
+    uint16_t accepted = 0;
+    while (frames.feed(stream.data(), stream.size()) == FRAME_OK) {
+        accepted++;
+    }
+    TEST_ASSERT_EQUAL(FRAME_BUFFER_SIZE / stream.size(), accepted);
+    TEST_ASSERT_EQUAL(1, frames.getOverflows());
+
+    // queued frames stay intact
+    TEST_ASSERT_TRUE(frames.next(header, payload));
+    assertFrame(frame, header, payload);
+    frames.clear();
+    TEST_ASSERT_EQUAL(0, frames.getQueuedFrames());
+    TEST_ASSERT_FALSE(frames.next(header, payload));
+}
+
+void test_producer_consumer_throughput(void) {
+    static FrameReassembler frames;
+    std::vector<Frame> sent;
+    std::vector<char> stream;
+    for (uint16_t i = 0; i < 1000; i++) {
+        sent.push_back(randomFrame(i));
+        appendFrame(stream, sent.back());
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread producer([&]() {
+        uint32_t segmentState = 7;
+        for (uint32_t sentFrames = 0; sentFrames < THROUGHPUT_FRAMES; sentFrames += sent.size()) {
+            size_t position = 0;
+            while (position < stream.size()) {
+                segmentState = segmentState * 1103515245 + 12345;
+                size_t segment = 1 + (segmentState >> 16) % 1460; // up to TCP MSS
+                if (segment > stream.size() - position) {
+                    segment = stream.size() - position;
+                }
+                while (frames.feed(&stream[position], segment) == FRAME_OVERFLOW) {
+                    std::this_thread::yield(); // the real socket would reconnect, here just wait for the loop
+                }
+                position += segment;
+            }
+        }
+    });
+
+    CommandMessageHeader header;
+    char payload[MAX_MESSAGE_PAYLOAD_BYTES];
+    uint32_t received = 0;
+    uint32_t mismatches = 0;
+    uint64_t bytes = 0;
+    while (received < THROUGHPUT_FRAMES) {
+        if (frames.next(header, payload)) {
+            const Frame &frame = sent[received % sent.size()];
+            if (header.id != frame.id || header.length != frame.payload.size() || (header.length > 0 && memcmp(frame.payload.data(), payload, header.length) != 0)) {
+                mismatches++;
+            }
+            bytes += FRAME_HEADER_SIZE + header.length;
+            received++;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    TEST_ASSERT_EQUAL(0, mismatches);
+    printf("%u frames, %.1f MB/s, %.0f frames/s\n", received, bytes / seconds / 1000000, received / seconds);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_frame_split_byte_by_byte);
+    RUN_TEST(test_coalesced_frames_in_one_packet);
+    RUN_TEST(test_random_segmentation);
+    RUN_TEST(test_invalid_length);
+    RUN_TEST(test_frames_before_invalid_published);
+    RUN_TEST(test_overflow_when_not_drained);
+    RUN_TEST(test_producer_consumer_throughput);
+    UNITY_END();
+
+    return 0;
+}
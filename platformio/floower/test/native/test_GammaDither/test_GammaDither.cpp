@@ -0,0 +1,229 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include <math.h>
+#include "SimHardware.h"
+#include "SimLedStrip.h"
+#include "hardware/GammaDither.h"
+#include "hardware/MotionTask.h"
+
+#define PIXELS_PIN 27
+#define STATUS_PIXELS_PIN 32
+#define FADE_FRAMES 500 // 5s at the dithering frame rate
+#define EYE_FRAMES 4 // frames perceived as one, 40ms
+#define BENCHMARK_FRAMES 100000
+
+static const float curveGammas[GAMMA_CURVES] = {1.0, 1.8, 2.2, 2.5};
+
+static uint32_t checksum = 0; // keeps the benchmarked code from being optimized away
+
+struct FadeQuality {
+    float maxError; // of the perceived light from the ideal one, in output levels
+    uint16_t distinctLevels; // of the perceived light
+};
+
+// fades one pixel from 0 to 0.2 of brightness as the mindfulness breathing does
+static FadeQuality measureFade(bool dithering) {
+    GammaDither output(1, GAMMA_2_2);
+    output.setDithering(dithering);
+    float shown[FADE_FRAMES];
+    float ideal[FADE_FRAMES];
+
+    for (uint16_t frame = 0; frame < FADE_FRAMES; frame++) {
+        uint8_t value = frame * 51 / (FADE_FRAMES - 1);
+        output.setPixel(0, RgbColor(value));
+        RgbColor pixel;
+        output.render(&pixel);
+        shown[frame] = pixel.R;
+        ideal[frame] = GammaDither::toLightLevel(value, GAMMA_2_2) / 256.0f;
+    }
+
+    FadeQuality quality = {0, 0};
+    float lastPerceived = -1;
+    for (uint16_t frame = EYE_FRAMES; frame <= FADE_FRAMES; frame++) {
+        float perceived = 0;
+        float expected = 0;
+        for (uint16_t i = frame - EYE_FRAMES; i < frame; i++) {
+            perceived += shown[i] / EYE_FRAMES;
+            expected += ideal[i] / EYE_FRAMES;
+        }
+        quality.maxError = _max(quality.maxError, fabsf(perceived - expected));
+        if (perceived != lastPerceived) {
+            quality.distinctLevels++;
+            lastPerceived = perceived;
+        }
+    }
+    return quality;
+}
+
+void setUp(void) {
+    SimHardware::reset();
+}
+
+void tearDown(void) {
+}
+
+void test_tables_follow_curves(void) {
+    for (uint8_t curve = 0; curve < GAMMA_CURVES; curve++) {
+        for (uint16_t value = 0; value < GAMMA_LEVELS; value++) {
+            float expected = powf(value / 255.0f, curveGammas[curve]) * GAMMA_MAX_LEVEL;
+            TEST_ASSERT_FLOAT_WITHIN(1.0, expected, GammaDither::toLightLevel(value, (GammaCurve) curve));
+        }
+    }
+}
+
+void test_linear_curve_keeps_colors(void) {
+    GammaDither output(3);
+    output.setPixel(0, RgbColor(0, 1, 2));
+    output.setPixel(1, RgbColor(127, 128, 255));
+    TEST_ASSERT_TRUE(output.isPending());
+
+    RgbColor frame[3];
+    output.render(frame);
+    TEST_ASSERT_TRUE(frame[0] == RgbColor(0, 1, 2));
+    TEST_ASSERT_TRUE(frame[1] == RgbColor(127, 128, 255));
+    TEST_ASSERT_TRUE(frame[2] == RgbColor(0));
+    TEST_ASSERT_FALSE(output.isPending());
+
+    output.setPixel(1, RgbColor(127, 128, 255));
+    TEST_ASSERT_FALSE(output.isPending());
+    output.setCurve(GAMMA_2_2);
+    TEST_ASSERT_TRUE(output.isPending());
+}
+
+void test_dithered_frames_average_to_light_level(void) {
+    GammaDither output(1, GAMMA_2_2);
+    for (uint16_t value = 0; value < GAMMA_LEVELS; value++) {
+        output.setPixel(0, RgbColor(value, 0, 0));
+        uint16_t level = GammaDither::toLightLevel(value, GAMMA_2_2);
+        bool dim = level < DITHER_LOW_LEVEL;
+        uint16_t frames = dim ? 256 : DITHER_FADE_FRAMES;
+        uint32_t sum = 0;
+        RgbColor pixel;
+        for (uint16_t frame = 0; frame < frames; frame++) {
+            output.render(&pixel);
+            sum += pixel.R;
+        }
+        // the dithered frames sum up to the level in 8.8 fixed point
+        TEST_ASSERT_FLOAT_WITHIN(1.0, frames * level / 256.0, sum);
+        if (!dim) {
+            // settled color is rounded in the next frame and is not dithered anymore
+            TEST_ASSERT_EQUAL((level & 0xFF) != 0, output.isDithering());
+            output.render(&pixel);
+            TEST_ASSERT_EQUAL((level + 0x80) >> 8, pixel.R);
+        }
+        TEST_ASSERT_EQUAL(dim && (level & 0xFF) != 0, output.isDithering());
+    }
+}
+
+void test_dithering_improves_dim_fade(void) {
+    FadeQuality rounded = measureFade(false);
+    FadeQuality dithered = measureFade(true);
+    printf("fade to 0.2: rounded error %.2f, %u levels; dithered error %.2f, %u levels\n",
+        rounded.maxError, rounded.distinctLevels, dithered.maxError, dithered.distinctLevels);
+
+    TEST_ASSERT_TRUE(rounded.maxError > 0.4);
+    TEST_ASSERT_TRUE(dithered.maxError < 0.3);
+    TEST_ASSERT_TRUE(dithered.distinctLevels > 2 * rounded.distinctLevels);
+}
+
+void test_benchmark_frame(void) {
+    GammaDither output(PIXELS_COUNT, GAMMA_2_2);
+    RgbColor frame[PIXELS_COUNT];
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCHMARK_FRAMES; i++) {
+        for (uint8_t p = 0; p < PIXELS_COUNT; p++) {
+            output.setPixel(p, RgbColor(i + p, i >> 1, i >> 2));
+        }
+        output.render(frame);
+        checksum += frame[0].R + frame[PIXELS_COUNT - 1].B;
+    }
+    double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BENCHMARK_FRAMES;
+    printf("gamma and dithering of %d pixels: %.1f ns/frame (%u)\n", PIXELS_COUNT, nanos, checksum);
+}
+
+static uint32_t countShows(MotionTask &motionTask, SimLedStrip *pixels, uint16_t millis) {
+    uint32_t initialShows = pixels->getShowCount();
+    for (uint16_t i = 0; i < millis; i++) {
+        motionTask.run();
+        SimHardware::advance(1000);
+    }
+    return pixels->getShowCount() - initialShows;
+}
+
+void test_motion_task_static_color_drops_frame_rate(void) {
+    MotionTask motionTask(PIXELS_PIN, STATUS_PIXELS_PIN);
+    motionTask.init(nullptr);
+    motionTask.setGamma(GAMMA_2_2);
+    SimLedStrip *pixels = SimHardware::getLedStrip(PIXELS_PIN);
+    SimLedStrip *statusPixels = SimHardware::getLedStrip(STATUS_PIXELS_PIN);
+    countShows(motionTask, pixels, 1000); // initial frames
+
+    LedsFrame frame;
+    for (uint8_t p = 0; p < PIXELS_COUNT; p++) {
+        frame.pixels[p] = RgbColor(40);
+    }
+    frame.status = RgbColor(30); // idle status light
+    motionTask.showLeds(frame);
+    uint32_t statusShows = statusPixels->getShowCount();
+
+    // the new color is dithered at the dithering rate for a while, then rounded once
+    TEST_ASSERT_UINT32_WITHIN(2, DITHER_FADE_FRAMES + 1, countShows(motionTask, pixels, 1000));
+    TEST_ASSERT_TRUE(pixels->getShownColor(0) == RgbColor((GammaDither::toLightLevel(40, GAMMA_2_2) + 0x80) >> 8));
+    TEST_ASSERT_UINT32_WITHIN(2, DITHER_FADE_FRAMES + 1, statusPixels->getShowCount() - statusShows);
+
+    // static color falls back to the static frame rate, nothing is shown anymore
+    statusShows = statusPixels->getShowCount();
+    TEST_ASSERT_EQUAL(0, countShows(motionTask, pixels, 1000));
+    TEST_ASSERT_EQUAL(0, statusPixels->getShowCount() - statusShows);
+    TEST_ASSERT_TRUE(motionTask.isSettled());
+}
+
+void test_motion_task_dithers_dim_color(void) {
+    MotionTask motionTask(PIXELS_PIN, STATUS_PIXELS_PIN);
+    motionTask.init(nullptr);
+    motionTask.setGamma(GAMMA_2_2);
+    SimLedStrip *pixels = SimHardware::getLedStrip(PIXELS_PIN);
+
+    LedsFrame frame;
+    for (uint8_t p = 0; p < PIXELS_COUNT; p++) {
+        frame.pixels[p] = RgbColor(20);
+    }
+    motionTask.showLeds(frame);
+    countShows(motionTask, pixels, 1000); // fade frames
+    uint32_t initialShows = pixels->getShowCount();
+    uint32_t sum = 0;
+    for (uint16_t i = 0; i < 1000; i++) {
+        motionTask.run();
+        SimHardware::advance(1000);
+        sum += pixels->getShownColor(0).R;
+    }
+    // dim color keeps being dithered and the light averages to its level
+    TEST_ASSERT_UINT32_WITHIN(2, DITHER_FRAME_RATE, pixels->getShowCount() - initialShows);
+    TEST_ASSERT_FLOAT_WITHIN(0.05, GammaDither::toLightLevel(20, GAMMA_2_2) / 256.0, sum / 1000.0);
+    TEST_ASSERT_FALSE(motionTask.isSettled()); // keeps the loop out of light sleep
+
+    // colors without fractional levels stop the dithered frames
+    for (uint8_t p = 0; p < PIXELS_COUNT; p++) {
+        frame.pixels[p] = RgbColor(255, 0, 0);
+    }
+    motionTask.showLeds(frame);
+    TEST_ASSERT_EQUAL(1, countShows(motionTask, pixels, 1000));
+    TEST_ASSERT_TRUE(pixels->getShownColor(0) == RgbColor(255, 0, 0));
+    TEST_ASSERT_TRUE(motionTask.isSettled());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_tables_follow_curves);
+    RUN_TEST(test_linear_curve_keeps_colors);
+    RUN_TEST(test_dithered_frames_average_to_light_level);
+    RUN_TEST(test_dithering_improves_dim_fade);
+    RUN_TEST(test_benchmark_frame);
+    RUN_TEST(test_motion_task_static_color_drops_frame_rate);
+    RUN_TEST(test_motion_task_dithers_dim_color);
+    UNITY_END();
+
+    return 0;
+}
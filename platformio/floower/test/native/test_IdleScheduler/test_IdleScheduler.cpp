@@ -0,0 +1,281 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <EEPROM.h>
+#include "SimHardware.h"
+#include "IdleScheduler.h"
+#include "behavior/BloomingBehavior.h"
+
+#define BATTERY_PIN 36
+#define USB_PIN 39
+#define TOUCH_PIN 4
+
+#define ADC_BATTERY_FULL 2300 // ~4.16V
+#define ADC_USB_CONNECTED 2900
+
+// rough ESP32 power model to compare the loops, LEDs and radio excluded
+#define PASS_TIME_MS 0.3 // one pass of the main loop
+#define ACTIVE_MA 45.0 // CPU running the loop
+#define WAIT_MA 25.0 // CPU idle in FreeRTOS, clocks running
+#define LIGHT_SLEEP_MA 1.5
+#define BATTERY_MAH 1600.0
+
+Config *config;
+Floower *floower;
+RemoteControl *remoteControl;
+BloomingBehavior *behavior;
+IdleScheduler scheduler;
+bool started;
+unsigned long colorChangeTime; // first pass with the color changing
+
+struct LoopRun {
+    uint32_t passes;
+    uint32_t waitTime; // ms
+    uint32_t lightSleepTime; // ms
+};
+
+void checkColorChange() {
+    if (colorChangeTime == 0 && floower->isChangingColor()) {
+        colorChangeTime = millis();
+    }
+}
+
+// main loop as before the scheduler
+LoopRun runPolling(unsigned long durationMs) {
+    LoopRun run = {0, 0, 0};
+    unsigned long endTime = millis() + durationMs;
+    while (millis() < endTime) {
+        floower->update();
+        behavior->loop();
+        checkColorChange();
+        run.passes++;
+        if (behavior->isIdle()) {
+            delay(10);
+            run.waitTime += 10;
+        }
+        else {
+            delay(1);
+        }
+    }
+    return run;
+}
+
+// main loop idled by the scheduler
+LoopRun runScheduled(unsigned long durationMs) {
+    scheduler.resetStats();
+    unsigned long endTime = millis() + durationMs;
+    while (millis() < endTime) {
+        floower->update();
+        behavior->loop();
+        checkColorChange();
+        scheduler.begin(millis());
+        floower->planIdle(scheduler);
+        behavior->planIdle(scheduler);
+        remoteControl->planIdle(scheduler);
+        if (scheduler.getPlan().mode == IDLE_NONE) {
+            delay(1); // simulated time moves only by delays
+        }
+        if (scheduler.idle()) {
+            floower->registerOutsideTouch();
+        }
+    }
+    IdleStats stats = scheduler.getStats();
+    return {stats.passes, stats.waitTime, stats.lightSleepTime};
+}
+
+double averageCurrent(const LoopRun &run, unsigned long durationMs) {
+    double activeTime = run.passes * PASS_TIME_MS;
+    double charge = activeTime * ACTIVE_MA + run.waitTime * WAIT_MA + run.lightSleepTime * LIGHT_SLEEP_MA
+        + _max(0.0, durationMs - activeTime - run.waitTime - run.lightSleepTime) * WAIT_MA;
+    return charge / durationMs;
+}
+
+// ms from the touch until the behavior reacts to it
+uint32_t touchLatency(bool scheduled) {
+    colorChangeTime = 0;
+    SimHardware::setTouch(TOUCH_PIN, 10);
+    unsigned long touchTime = millis();
+    while (colorChangeTime == 0 && millis() - touchTime < 1000) {
+        if (scheduled) {
+            runScheduled(1);
+        }
+        else {
+            runPolling(1);
+        }
+    }
+    SimHardware::setTouch(TOUCH_PIN, 100);
+    return colorChangeTime - touchTime;
+}
+
+void startFloower(bool usbConnected) {
+    SimHardware::setAnalog(BATTERY_PIN, ADC_BATTERY_FULL);
+    SimHardware::setAnalog(USB_PIN, usbConnected ? ADC_USB_CONNECTED : 0);
+    SimHardware::setDigital(35, HIGH); // not charging
+
+    config->begin();
+    config->hardwareCalibration(1000, 1000, 9, 1);
+    config->factorySettings();
+    config->setCalibrated();
+    config->setTouchCalibrated(true);
+    config->commit();
+    config->load();
+    config->deepSleepEnabled = true;
+
+    floower->init();
+    floower->readPowerState();
+    behavior->setup(false);
+    started = true;
+}
+
+void setUp(void) {
+    SimHardware::reset();
+    EEPROM.erase();
+    config = new Config(11);
+    floower = new Floower(config);
+    remoteControl = new RemoteControl(nullptr, nullptr, nullptr);
+    behavior = new BloomingBehavior(config, floower, remoteControl);
+    started = false;
+}
+
+void tearDown(void) {
+    if (started) {
+        runScheduled(1000); // let the touch cooldown expire, touch state is static
+    }
+    delete behavior;
+    delete remoteControl;
+    delete floower;
+    delete config;
+}
+
+void test_nearest_deadline_wins(void) {
+    scheduler.begin(1000);
+    TEST_ASSERT_EQUAL(IDLE_LIGHT_SLEEP, scheduler.getPlan().mode);
+    TEST_ASSERT_EQUAL(IDLE_MAX_TIME, scheduler.getPlan().duration);
+
+    scheduler.wakeAt(1500);
+    scheduler.wakeIn(300);
+    scheduler.wakeAt(1800);
+    TEST_ASSERT_EQUAL(300, scheduler.getPlan().duration);
+
+    scheduler.wakeAt(900); // already passed
+    TEST_ASSERT_EQUAL(IDLE_NONE, scheduler.getPlan().mode);
+    TEST_ASSERT_EQUAL(0, scheduler.getPlan().duration);
+}
+
+void test_deadline_over_millis_overflow(void) {
+    scheduler.begin(0xFFFFFF00);
+    scheduler.wakeAt(0x00000100); // after the overflow
+    TEST_ASSERT_EQUAL(0x200, scheduler.getPlan().duration);
+
+    scheduler.begin(0x00000010);
+    scheduler.wakeAt(0xFFFFFFF0); // before the overflow, passed
+    TEST_ASSERT_EQUAL(IDLE_NONE, scheduler.getPlan().mode);
+}
+
+void test_light_sleep_only_when_allowed_and_long(void) {
+    scheduler.begin(0);
+    scheduler.wakeIn(LIGHT_SLEEP_MIN_TIME - 1);
+    TEST_ASSERT_EQUAL(IDLE_WAIT, scheduler.getPlan().mode);
+
+    scheduler.begin(0);
+    scheduler.wakeIn(500);
+    scheduler.preventLightSleep();
+    TEST_ASSERT_EQUAL(IDLE_WAIT, scheduler.getPlan().mode);
+    TEST_ASSERT_EQUAL(500, scheduler.getPlan().duration);
+
+    scheduler.begin(0); // every pass plans from scratch
+    scheduler.wakeIn(500);
+    TEST_ASSERT_EQUAL(IDLE_LIGHT_SLEEP, scheduler.getPlan().mode);
+}
+
+void test_touch_wakes_up_idle_wait(void) {
+    startFloower(true);
+    runScheduled(2000);
+
+    scheduler.begin(millis());
+    scheduler.wakeIn(IDLE_MAX_TIME);
+    scheduler.preventLightSleep();
+    unsigned long start = millis();
+    SimHardware::setTouch(TOUCH_PIN, 10);
+    scheduler.idle();
+    SimHardware::setTouch(TOUCH_PIN, 100);
+    TEST_ASSERT_UINT32_WITHIN(SIM_TOUCH_ISR_INTERVAL / 1000, SIM_TOUCH_ISR_INTERVAL / 1000, millis() - start);
+}
+
+void test_standby_on_battery_sleeps(void) {
+    startFloower(false);
+    runScheduled(3000); // start up and touch cooldown
+
+    LoopRun scheduled = runScheduled(25000);
+    LoopRun polling = runPolling(25000); // deep sleep comes after 60s
+    double scheduledCurrent = averageCurrent(scheduled, 25000);
+    double pollingCurrent = averageCurrent(polling, 25000);
+    printf("standby on battery: polling %u passes %.1f mA (%.0f h), scheduled %u passes %u ms light sleep %.1f mA (%.0f h)\n",
+        polling.passes, pollingCurrent, BATTERY_MAH / pollingCurrent,
+        scheduled.passes, scheduled.lightSleepTime, scheduledCurrent, BATTERY_MAH / scheduledCurrent);
+
+    TEST_ASSERT_FALSE(SimHardware::isDeepSleeping());
+    TEST_ASSERT_TRUE(scheduled.passes < 100); // about the power watchdog only
+    TEST_ASSERT_TRUE(scheduled.lightSleepTime > 24000);
+    TEST_ASSERT_TRUE(scheduledCurrent * 5 < pollingCurrent);
+}
+
+void test_usb_powered_never_light_sleeps(void) {
+    startFloower(true);
+    runScheduled(3000);
+
+    LoopRun scheduled = runScheduled(10000);
+    TEST_ASSERT_EQUAL(0, scheduled.lightSleepTime);
+    TEST_ASSERT_TRUE(scheduled.waitTime > 9000);
+}
+
+void test_touch_latency_not_increased(void) {
+    startFloower(false);
+    runScheduled(3000);
+    runScheduled(567); // touch lands in the middle of a light sleep
+    uint32_t scheduledLatency = touchLatency(true);
+    runScheduled(config->speedMillis + 3000);
+
+    // same touch on the polling loop
+    tearDown();
+    setUp();
+    startFloower(false);
+    runPolling(3567);
+    uint32_t pollingLatency = touchLatency(false);
+
+    printf("touch latency: polling %u ms, scheduled %u ms\n", pollingLatency, scheduledLatency);
+    TEST_ASSERT_TRUE(scheduledLatency <= pollingLatency);
+    TEST_ASSERT_TRUE(scheduledLatency <= SIM_TOUCH_ISR_INTERVAL / 1000 + 1);
+}
+
+void test_bloom_completes_on_deadlines(void) {
+    startFloower(false);
+    runScheduled(3000);
+
+    SimHardware::setTouch(TOUCH_PIN, 10);
+    runScheduled(200);
+    SimHardware::setTouch(TOUCH_PIN, 100);
+    runScheduled(config->speedMillis + 2000);
+
+    TEST_ASSERT_TRUE(behavior->isIdle());
+    TEST_ASSERT_EQUAL(config->maxOpenLevel, floower->getCurrentPetalsOpenLevel());
+    TEST_ASSERT_TRUE(floower->isLit());
+
+    // back to sleeping once the bloom is done
+    LoopRun scheduled = runScheduled(5000);
+    TEST_ASSERT_TRUE(scheduled.lightSleepTime > 4500);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_nearest_deadline_wins);
+    RUN_TEST(test_deadline_over_millis_overflow);
+    RUN_TEST(test_light_sleep_only_when_allowed_and_long);
+    RUN_TEST(test_touch_wakes_up_idle_wait);
+    RUN_TEST(test_standby_on_battery_sleeps);
+    RUN_TEST(test_usb_powered_never_light_sleeps);
+    RUN_TEST(test_touch_latency_not_increased);
+    RUN_TEST(test_bloom_completes_on_deadlines);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include <unity.h>
+#include "connect/InflightTable.h"
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_window_limits_requests(void) {
+    InflightTable inflight(3);
+    TEST_ASSERT_TRUE(inflight.add(1, 16, 0, 2000));
+    TEST_ASSERT_TRUE(inflight.add(2, 17, 0, 2000));
+    TEST_ASSERT_TRUE(inflight.add(3, 17, 0, 2000));
+    TEST_ASSERT_TRUE(inflight.isFull());
+    TEST_ASSERT_FALSE(inflight.add(4, 17, 0, 2000));
+    TEST_ASSERT_EQUAL(3, inflight.getCount());
+
+    TEST_ASSERT_TRUE(inflight.complete(2));
+    TEST_ASSERT_FALSE(inflight.isFull());
+    TEST_ASSERT_TRUE(inflight.add(4, 17, 0, 2000));
+
+    inflight.setWindow(100);
+    TEST_ASSERT_EQUAL(INFLIGHT_MAX_WINDOW, inflight.getWindow());
+    inflight.setWindow(0);
+    TEST_ASSERT_EQUAL(1, inflight.getWindow());
+}
+
+void test_responses_matched_out_of_order(void) {
+    InflightTable inflight;
+    InflightRequest request;
+    inflight.add(10, 16, 0, 2000);
+    inflight.add(11, 17, 0, 2000);
+    inflight.add(12, 19, 0, 2000);
+
+    TEST_ASSERT_TRUE(inflight.complete(12, &request));
+    TEST_ASSERT_EQUAL(19, request.type);
+    TEST_ASSERT_TRUE(inflight.complete(10, &request));
+    TEST_ASSERT_EQUAL(16, request.type);
+    TEST_ASSERT_FALSE(inflight.complete(10)); // duplicate response
+    TEST_ASSERT_FALSE(inflight.complete(99)); // never sent
+    TEST_ASSERT_EQUAL(1, inflight.getCount());
+}
+
+void test_each_request_has_own_timeout(void) {
+    InflightTable inflight;
+    InflightRequest expired;
+    inflight.add(1, 16, 1000, 5000); // due at 6000
+    inflight.add(2, 17, 2000, 2000); // due at 4000
+    inflight.add(3, 19, 3000, 2000); // due at 5000
+
+    TEST_ASSERT_EQUAL(0, inflight.expire(3999));
+    TEST_ASSERT_EQUAL(1, inflight.expire(4000, &expired));
+    TEST_ASSERT_EQUAL(2, expired.id);
+    TEST_ASSERT_TRUE(inflight.complete(3)); // answered in time
+    TEST_ASSERT_EQUAL(0, inflight.expire(5500));
+    TEST_ASSERT_EQUAL(1, inflight.expire(6000, &expired));
+    TEST_ASSERT_EQUAL(1, expired.id);
+    TEST_ASSERT_EQUAL(0, inflight.getCount());
+}
+
+void test_timeout_across_millis_overflow(void) {
+    InflightTable inflight;
+    unsigned long now = (unsigned long) -1000;
+    inflight.add(1, 17, now, 2000);
+
+    TEST_ASSERT_EQUAL(0, inflight.expire(now + 500));
+    TEST_ASSERT_EQUAL(0, inflight.expire(now + 1999));
+    TEST_ASSERT_EQUAL(1, inflight.expire(now + 2000));
+}
+
+void test_clear(void) {
+    InflightTable inflight;
+    inflight.add(1, 16, 0, 2000);
+    inflight.add(2, 17, 0, 2000);
+    inflight.clear();
+    TEST_ASSERT_EQUAL(0, inflight.getCount());
+    TEST_ASSERT_EQUAL(0, inflight.expire(10000));
+    TEST_ASSERT_FALSE(inflight.complete(1));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_window_limits_requests);
+    RUN_TEST(test_responses_matched_out_of_order);
+    RUN_TEST(test_each_request_has_own_timeout);
+    RUN_TEST(test_timeout_across_millis_overflow);
+    RUN_TEST(test_clear);
+    UNITY_END();
+
+    return 0;
+}
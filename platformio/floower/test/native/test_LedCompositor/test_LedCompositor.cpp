@@ -0,0 +1,250 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <EEPROM.h>
+#include "SimHardware.h"
+#include "SimLedStrip.h"
+#include "hardware/LedCompositor.h"
+#include "hardware/Floower.h"
+
+#define NEOPIXEL_PIN 27
+#define BATTERY_PIN 36
+#define USB_PIN 39
+#define CHARGE_PIN 35
+#define BATTERY_READING_FULL 2320 // 4.2V
+#define BATTERY_READING_WEAK 1960 // 3.55V
+
+void setUp(void) {
+    SimHardware::reset();
+}
+
+void tearDown(void) {
+}
+
+void test_layers_stack_in_order(void) {
+    LedCompositor compositor(4);
+    compositor.fill(LAYER_BASE, RgbColor(0, 0, 200));
+    compositor.setPixel(LAYER_EFFECT, 1, RgbColor(255, 0, 0));
+    compositor.setPixel(LAYER_STATUS, 3, RgbColor(0, 50, 0));
+
+    TEST_ASSERT_TRUE(compositor.compose());
+    TEST_ASSERT_EQUAL(0x0F, compositor.getChangedPixels());
+    TEST_ASSERT_TRUE(compositor.getPixel(0) == RgbColor(0, 0, 200));
+    TEST_ASSERT_TRUE(compositor.getPixel(1) == RgbColor(255, 0, 0));
+    TEST_ASSERT_TRUE(compositor.getPixel(3) == RgbColor(0, 50, 0));
+
+    // effect pixel cleared uncovers the base color
+    compositor.clearPixel(LAYER_EFFECT, 1);
+    TEST_ASSERT_TRUE(compositor.compose());
+    TEST_ASSERT_EQUAL(0x02, compositor.getChangedPixels());
+    TEST_ASSERT_TRUE(compositor.getPixel(1) == RgbColor(0, 0, 200));
+}
+
+void test_blend_modes(void) {
+    LedCompositor compositor(1);
+    compositor.setPixel(LAYER_BASE, 0, RgbColor(200, 100, 0));
+
+    compositor.setPixel(LAYER_EFFECT, 0, RgbColor(100, 100, 100));
+    compositor.setBlendMode(LAYER_EFFECT, BLEND_ADD);
+    compositor.compose();
+    TEST_ASSERT_TRUE(compositor.getPixel(0) == RgbColor(255, 200, 100));
+
+    compositor.setBlendMode(LAYER_EFFECT, BLEND_MULTIPLY);
+    compositor.setPixel(LAYER_EFFECT, 0, RgbColor(255, 127, 0));
+    compositor.compose();
+    TEST_ASSERT_TRUE(compositor.getPixel(0) == RgbColor(200, 50, 0));
+
+    compositor.setBlendMode(LAYER_EFFECT, BLEND_LIGHTEN);
+    compositor.setPixel(LAYER_EFFECT, 0, RgbColor(10, 150, 20));
+    compositor.compose();
+    TEST_ASSERT_TRUE(compositor.getPixel(0) == RgbColor(200, 150, 20));
+
+    compositor.setBlendMode(LAYER_EFFECT, BLEND_ALPHA, 64);
+    compositor.setPixel(LAYER_EFFECT, 0, RgbColor(0, 200, 255));
+    compositor.compose();
+    TEST_ASSERT_TRUE(compositor.getPixel(0) == RgbColor(150, 125, 64));
+
+    compositor.setBlendMode(LAYER_EFFECT, BLEND_NORMAL);
+    compositor.compose();
+    TEST_ASSERT_TRUE(compositor.getPixel(0) == RgbColor(0, 200, 255));
+}
+
+void test_unchanged_output_not_reported(void) {
+    LedCompositor compositor(7);
+    compositor.fill(LAYER_BASE, RgbColor(10, 20, 30));
+    TEST_ASSERT_TRUE(compositor.compose());
+
+    // nothing touched
+    TEST_ASSERT_FALSE(compositor.compose());
+
+    // same colors written again
+    compositor.fill(LAYER_BASE, RgbColor(10, 20, 30));
+    TEST_ASSERT_FALSE(compositor.compose());
+
+    // effect layer covering with the same color as below
+    compositor.setPixel(LAYER_EFFECT, 2, RgbColor(10, 20, 30));
+    TEST_ASSERT_FALSE(compositor.compose());
+    TEST_ASSERT_EQUAL(0, compositor.getChangedPixels());
+}
+
+void test_brightness_limit_keeps_hue(void) {
+    LedCompositor compositor(2);
+    compositor.setPixel(LAYER_BASE, 0, RgbColor(255, 128, 0));
+    compositor.setPixel(LAYER_BASE, 1, RgbColor(50, 20, 10));
+    compositor.setBrightnessLimit(128);
+    compositor.compose();
+
+    TEST_ASSERT_TRUE(compositor.getPixel(0) == RgbColor(127, 64, 0));
+    TEST_ASSERT_TRUE(compositor.getPixel(1) == RgbColor(50, 20, 10)); // under the limit
+
+    compositor.setBrightnessLimit(255);
+    TEST_ASSERT_TRUE(compositor.compose());
+    TEST_ASSERT_TRUE(compositor.getPixel(0) == RgbColor(255, 128, 0));
+}
+
+uint8_t countPixelsOtherThan(SimLedStrip *strip, RgbColor color) {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < PIXELS_COUNT; i++) {
+        if (strip->getShownColor(i) != color) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void test_floower_shows_strip_only_on_change(void) {
+    Config config(1);
+    config.begin();
+    config.hardwareCalibration(1000, 1000, 9, 1);
+    config.factorySettings();
+    config.load();
+    Floower floower(&config);
+    floower.init();
+    floower.setGamma(GAMMA_LINEAR); // compare the composed colors as they are
+    SimLedStrip *strip = SimHardware::getLedStrip(NEOPIXEL_PIN);
+
+    floower.transitionColor(0.5, 1.0, 1.0, 0);
+    floower.update();
+    uint32_t shows = strip->getShowCount();
+    TEST_ASSERT_TRUE(strip->getShownColor(0) == RgbColor(HsbColor(0.5, 1.0, 1.0)));
+
+    // idle updates and the same color again do not touch the strip
+    for (uint8_t i = 0; i < 10; i++) {
+        floower.transitionColor(0.5, 1.0, 1.0, 0);
+        floower.update();
+        delay(10);
+    }
+    TEST_ASSERT_EQUAL(shows, strip->getShowCount());
+
+    // status LED lives on its own strip
+    floower.showStatus(HsbColor(0.3, 1.0, 0.5), STILL, 0);
+    floower.update();
+    TEST_ASSERT_EQUAL(shows, strip->getShowCount());
+
+    // circle effect over the base color, in its own animation slot
+    RgbColor base(HsbColor(0.5, 1.0, 1.0));
+    floower.circleColor(0.0, 1.0, 600);
+    for (uint8_t i = 0; i < 10; i++) {
+        floower.update();
+        delay(10);
+    }
+    TEST_ASSERT_TRUE(strip->getShownColor(0) == base);
+    TEST_ASSERT_EQUAL(3, countPixelsOtherThan(strip, base));
+
+    // base color transition runs under the circle without restarting it
+    RgbColor target(HsbColor(0.7, 1.0, 1.0));
+    floower.transitionColor(0.7, 1.0, 1.0, 100);
+    for (uint8_t i = 0; i < 20; i++) {
+        floower.update();
+        delay(10);
+    }
+    TEST_ASSERT_TRUE(floower.isChangingColor()); // circle still running
+    TEST_ASSERT_TRUE(strip->getShownColor(0) == target);
+    TEST_ASSERT_EQUAL(3, countPixelsOtherThan(strip, target));
+
+    floower.stopAnimation(true);
+    floower.update();
+    delay(100);
+    floower.update();
+    TEST_ASSERT_EQUAL(0, countPixelsOtherThan(strip, target));
+}
+
+void test_floower_new_color_ends_color_mode(void) {
+    Config config(1);
+    config.begin();
+    config.hardwareCalibration(1000, 1000, 9, 1);
+    config.factorySettings();
+    config.load();
+    Floower floower(&config);
+    floower.init();
+    floower.setGamma(GAMMA_LINEAR);
+    SimLedStrip *strip = SimHardware::getLedStrip(NEOPIXEL_PIN);
+
+    floower.startAnimation(CANDLE);
+    for (uint8_t i = 0; i < 50; i++) {
+        floower.update();
+        delay(10);
+    }
+    TEST_ASSERT_TRUE(floower.isAnimating());
+
+    // candle covers the base, a new color replaces it and fades from the candle color
+    floower.transitionColor(0.3, 1.0, 1.0, 100);
+    for (uint8_t i = 0; i < 20; i++) {
+        floower.update();
+        delay(10);
+    }
+    TEST_ASSERT_FALSE(floower.isAnimating());
+    TEST_ASSERT_EQUAL(0, countPixelsOtherThan(strip, RgbColor(HsbColor(0.3, 1.0, 1.0))));
+}
+
+void test_floower_dims_on_weak_battery(void) {
+    Config config(11);
+    config.begin();
+    config.hardwareCalibration(1000, 1000, 9, 1);
+    config.factorySettings();
+    config.load();
+    Floower floower(&config);
+    floower.init();
+    floower.setGamma(GAMMA_LINEAR);
+    SimLedStrip *strip = SimHardware::getLedStrip(NEOPIXEL_PIN);
+    SimHardware::setDigital(CHARGE_PIN, HIGH); // not charging, no USB
+    SimHardware::setAnalog(BATTERY_PIN, BATTERY_READING_FULL);
+    floower.readPowerState();
+
+    floower.transitionColor(0, 0, 1.0, 0);
+    floower.update();
+    delay(100);
+    TEST_ASSERT_TRUE(strip->getShownColor(0) == RgbColor(255));
+
+    // battery runs down, the light is limited and keeps its hue
+    SimHardware::setAnalog(BATTERY_PIN, BATTERY_READING_WEAK);
+    for (uint8_t i = 0; i < 60; i++) {
+        floower.readPowerState();
+    }
+    TEST_ASSERT_TRUE(floower.getPowerState().batteryLevel < 20);
+    floower.update();
+    delay(100);
+    RgbColor dimmed = strip->getShownColor(0);
+    TEST_ASSERT_TRUE(dimmed.R < 200);
+    TEST_ASSERT_TRUE(dimmed.R == dimmed.G && dimmed.G == dimmed.B);
+
+    // plugged in
+    SimHardware::setAnalog(USB_PIN, 2900);
+    floower.readPowerState();
+    floower.update();
+    delay(100);
+    TEST_ASSERT_TRUE(strip->getShownColor(0) == RgbColor(255));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_layers_stack_in_order);
+    RUN_TEST(test_blend_modes);
+    RUN_TEST(test_unchanged_output_not_reported);
+    RUN_TEST(test_brightness_limit_keeps_hue);
+    RUN_TEST(test_floower_shows_strip_only_on_change);
+    RUN_TEST(test_floower_new_color_ends_color_mode);
+    RUN_TEST(test_floower_dims_on_weak_battery);
+    UNITY_END();
+
+    return 0;
+}
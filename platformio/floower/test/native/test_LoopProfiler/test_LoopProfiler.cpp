@@ -0,0 +1,94 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <algorithm>
+#include <vector>
+#include "SimHardware.h"
+#include "LoopProfiler.h"
+
+void setUp(void) {
+    SimHardware::reset();
+}
+
+void tearDown(void) {
+}
+
+void test_bucket_bounds(void) {
+    // every value falls in its bucket and buckets are contiguous
+    for (uint32_t value = 0; value < 100000; value++) {
+        uint8_t index = LatencyHistogram::bucketIndex(value);
+        TEST_ASSERT_TRUE(value >= LatencyHistogram::bucketLowerBound(index));
+        TEST_ASSERT_TRUE(value < LatencyHistogram::bucketLowerBound(index) + LatencyHistogram::bucketWidth(index));
+    }
+    for (uint8_t index = 1; index < HISTOGRAM_BUCKETS - 1; index++) {
+        TEST_ASSERT_EQUAL_UINT32(LatencyHistogram::bucketLowerBound(index - 1) + LatencyHistogram::bucketWidth(index - 1), LatencyHistogram::bucketLowerBound(index));
+    }
+    TEST_ASSERT_EQUAL(HISTOGRAM_BUCKETS - 1, LatencyHistogram::bucketIndex(0xFFFFFFFF));
+}
+
+void test_percentiles(void) {
+    // skewed distribution, compare with exact percentiles
+    LatencyHistogram histogram;
+    std::vector<uint32_t> values;
+    for (uint32_t i = 0; i < 10000; i++) {
+        uint32_t value = 1000 + (SimHardware::random() % 5000);
+        if (i % 50 == 0) {
+            value = 200000 + (SimHardware::random() % 100000); // spikes
+        }
+        values.push_back(value);
+        histogram.record(value);
+    }
+    std::sort(values.begin(), values.end());
+    uint32_t exactP50 = values[values.size() / 2 - 1];
+    uint32_t exactP99 = values[values.size() * 99 / 100 - 1];
+
+    TEST_ASSERT_EQUAL_UINT32(10000, histogram.getCount());
+    TEST_ASSERT_EQUAL_UINT32(values.back(), histogram.getMax());
+    TEST_ASSERT_UINT32_WITHIN(exactP50 / 8, exactP50, histogram.getPercentile(50));
+    TEST_ASSERT_UINT32_WITHIN(exactP99 / 8, exactP99, histogram.getPercentile(99));
+    TEST_ASSERT_EQUAL_UINT32(histogram.getMax(), histogram.getPercentile(100));
+
+    histogram.clear();
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.getCount());
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.getPercentile(50));
+}
+
+void test_loop_stages(void) {
+    LoopProfiler profiler;
+    profiler.onDeadlineMisses([]() { return (uint32_t) 3; });
+
+    for (uint8_t i = 0; i < 100; i++) {
+        uint32_t loopStart = LoopProfiler::now();
+        SimHardware::advance(500);
+        uint32_t lapStart = profiler.lap(PROFILER_STAGE_FLOOWER, loopStart);
+        SimHardware::advance(i < 99 ? 100 : 5000); // single slow behavior loop
+        lapStart = profiler.lap(PROFILER_STAGE_BEHAVIOR, lapStart);
+        profiler.lap(PROFILER_STAGE_LOOP, loopStart);
+    }
+
+    LatencyStats floowerStats = profiler.getStats(PROFILER_STAGE_FLOOWER);
+    TEST_ASSERT_EQUAL_UINT32(100, floowerStats.count);
+    TEST_ASSERT_UINT32_WITHIN(500 / 8, 500, floowerStats.p50);
+    TEST_ASSERT_EQUAL_UINT32(500, floowerStats.max);
+
+    LatencyStats behaviorStats = profiler.getStats(PROFILER_STAGE_BEHAVIOR);
+    TEST_ASSERT_UINT32_WITHIN(100 / 8, 100, behaviorStats.p50);
+    TEST_ASSERT_UINT32_WITHIN(100 / 8, 100, behaviorStats.p99);
+    TEST_ASSERT_EQUAL_UINT32(5000, behaviorStats.max);
+
+    TEST_ASSERT_EQUAL_UINT32(0, profiler.getStats(PROFILER_STAGE_WIFI).count);
+    TEST_ASSERT_EQUAL_UINT32(5500, profiler.getStats(PROFILER_STAGE_LOOP).max);
+    TEST_ASSERT_EQUAL_UINT32(3, profiler.getDeadlineMisses());
+
+    profiler.reset();
+    TEST_ASSERT_EQUAL_UINT32(0, profiler.getStats(PROFILER_STAGE_LOOP).count);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_bucket_bounds);
+    RUN_TEST(test_percentiles);
+    RUN_TEST(test_loop_stages);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <unity.h>
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include "hardware/MotionPlanner.h"
+
+// verifies the planned schedules against the ideal profile and benchmarks the planning
+
+#define OPEN_STEPS 30000
+#define ACCELERATION 20000
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// max difference between the step rate of each segment and the ideal average speed over the same steps, relative to peak speed
+float peakRateError(MotionPlanner &planner, const StepSchedule &schedule) {
+    float error = 0;
+    uint32_t position = 0;
+    float peak = planner.getPeakSpeed();
+    for (uint8_t i = 0; i < schedule.size; i++) {
+        uint32_t next = position + schedule.segments[i].steps;
+        float rate = 1000000.0 / schedule.segments[i].interval;
+        float ideal = schedule.segments[i].steps / (planner.timeAt(next) - planner.timeAt(position));
+        float diff = fabs(rate - ideal) / peak;
+        if (diff > error) {
+            error = diff;
+        }
+        position = next;
+    }
+    return error;
+}
+
+void verifyMove(MotionProfile profile, uint32_t steps, uint32_t duration, float startSpeed) {
+    MotionPlanner planner(ACCELERATION, profile);
+    StepSchedule schedule;
+    TEST_ASSERT_TRUE(planner.plan(steps, duration, startSpeed, schedule));
+
+    TEST_ASSERT_EQUAL(steps, schedule.getTotalSteps());
+    TEST_ASSERT_UINT32_WITHIN(duration * 10, duration * 1000, schedule.getDuration()); // within 1%
+    TEST_ASSERT_FLOAT_WITHIN(0.5, steps, planner.positionAt(planner.getDuration()));
+    TEST_ASSERT_LESS_THAN_FLOAT(0.1f, peakRateError(planner, schedule));
+    if (startSpeed > 0) {
+        // no velocity discontinuity when retargeting
+        float firstRate = 1000000.0 / schedule.segments[0].interval;
+        TEST_ASSERT_LESS_THAN_FLOAT(0.1f, fabs(firstRate - startSpeed) / startSpeed);
+    }
+}
+
+void test_constant_profile(void) {
+    verifyMove(PROFILE_CONSTANT, OPEN_STEPS, 5000, 0);
+}
+
+void test_trapezoidal_profile(void) {
+    verifyMove(PROFILE_TRAPEZOIDAL, OPEN_STEPS, 5000, 0);
+    verifyMove(PROFILE_TRAPEZOIDAL, 15000, 2500, 0);
+    verifyMove(PROFILE_TRAPEZOIDAL, OPEN_STEPS / 5, 500, 0); // needs more acceleration than configured
+}
+
+void test_s_curve_profile(void) {
+    verifyMove(PROFILE_S_CURVE, OPEN_STEPS, 5000, 0);
+    verifyMove(PROFILE_S_CURVE, 9000, 4800, 0);
+}
+
+void test_retarget_while_moving(void) {
+    verifyMove(PROFILE_TRAPEZOIDAL, 20000, 4000, 6000);
+    verifyMove(PROFILE_S_CURVE, 20000, 4000, 6000);
+    verifyMove(PROFILE_S_CURVE, 5000, 3000, 6000); // slow down to the new cruise speed
+}
+
+void test_stop(void) {
+    MotionPlanner planner(ACCELERATION, PROFILE_S_CURVE);
+    StepSchedule schedule;
+    uint32_t steps = planner.planStop(6000, schedule);
+    TEST_ASSERT_EQUAL(900, steps); // v^2 / 2a
+    TEST_ASSERT_EQUAL(steps, schedule.getTotalSteps());
+    TEST_ASSERT_LESS_THAN_FLOAT(0.1f, peakRateError(planner, schedule));
+}
+
+void test_benchmark(void) {
+    MotionProfile profiles[] = {PROFILE_CONSTANT, PROFILE_TRAPEZOIDAL, PROFILE_S_CURVE};
+    const char *names[] = {"constant", "trapezoidal", "s-curve"};
+    const int iterations = 10000;
+
+    for (uint8_t p = 0; p < 3; p++) {
+        MotionPlanner planner(ACCELERATION, profiles[p]);
+        StepSchedule schedule;
+        float error = 0;
+        double elapsed = 0;
+        for (int i = 0; i < iterations; i++) {
+            auto start = std::chrono::steady_clock::now();
+            planner.plan(1000 + (i * 7919) % (OPEN_STEPS - 1000), 1000 + i % 4000, (i % 3) * 2000, schedule);
+            elapsed += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+            float e = peakRateError(planner, schedule);
+            if (e > error) {
+                error = e;
+            }
+        }
+        double ns = elapsed / iterations;
+
+        char message[128];
+        snprintf(message, sizeof(message), "%s: %.0f ns/move, peak step-rate error %.2f%%", names[p], ns, error * 100);
+        TEST_MESSAGE(message);
+        TEST_ASSERT_LESS_THAN_FLOAT(0.1f, error);
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_constant_profile);
+    RUN_TEST(test_trapezoidal_profile);
+    RUN_TEST(test_s_curve_profile);
+    RUN_TEST(test_retarget_while_moving);
+    RUN_TEST(test_stop);
+    RUN_TEST(test_benchmark);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <thread>
+#include <vector>
+#include "SimHardware.h"
+#include "SimLedStrip.h"
+#include "hardware/MotionTask.h"
+
+#define PIXELS_PIN 27
+#define STATUS_PIXELS_PIN 32
+
+// petals which only record what they were told, touched by the motion task only
+class RecordingPetals : public Petals {
+    public:
+        void init(bool initial, bool wokeUp) { initialized = true; }
+        void update() { updates++; }
+        void setPetalsOpenLevel(int8_t level, int transitionTime) {
+            levels.push_back(level);
+            petalsOpenLevel = level;
+        }
+        int8_t getPetalsOpenLevel() { return petalsOpenLevel; }
+        int8_t getCurrentPetalsOpenLevel() { return petalsOpenLevel; }
+        bool arePetalsMoving() { return false; }
+        bool setEnabled(bool enabled) { this->enabled = enabled; return true; }
+        bool isEnabled() { return enabled; }
+        uint32_t getDeadlineMisses() { return 0; }
+
+        std::vector<int8_t> levels;
+        std::atomic<uint32_t> updates {0};
+        bool initialized = false;
+        bool enabled = true;
+        int8_t petalsOpenLevel = 0;
+};
+
+RecordingPetals *petals;
+MotionTask *motionTask;
+
+void waitForTask(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void setUp(void) {
+    SimHardware::reset();
+    petals = new RecordingPetals();
+    motionTask = new MotionTask(PIXELS_PIN, STATUS_PIXELS_PIN);
+    motionTask->init(petals);
+}
+
+void tearDown(void) {
+    motionTask->end();
+    delete motionTask;
+    delete petals;
+}
+
+void test_queued_movement_reports_moving(void) {
+    // no task, the loop runs the iterations
+    TEST_ASSERT_TRUE(motionTask->setPetalsOpenLevel(80, 1000));
+    TEST_ASSERT_TRUE(motionTask->arePetalsMoving());
+    TEST_ASSERT_EQUAL(80, motionTask->getPetalsOpenLevel());
+    TEST_ASSERT_EQUAL(0, petals->levels.size());
+
+    motionTask->run();
+    TEST_ASSERT_FALSE(motionTask->arePetalsMoving());
+    TEST_ASSERT_EQUAL(1, petals->levels.size());
+    TEST_ASSERT_EQUAL(80, motionTask->getPetalsOpenLevel());
+}
+
+void test_full_queue_rejects_commands(void) {
+    for (uint8_t i = 0; i < MOTION_QUEUE_SIZE; i++) {
+        TEST_ASSERT_TRUE(motionTask->setPetalsOpenLevel(i, 0));
+    }
+    TEST_ASSERT_FALSE(motionTask->setPetalsOpenLevel(100, 0));
+    TEST_ASSERT_EQUAL(MOTION_QUEUE_SIZE - 1, motionTask->getPetalsOpenLevel()); // rejected level is not reported
+
+    motionTask->run();
+    TEST_ASSERT_FALSE(motionTask->arePetalsMoving());
+    TEST_ASSERT_EQUAL(MOTION_QUEUE_SIZE, petals->levels.size());
+}
+
+void test_task_applies_commands_in_order(void) {
+    motionTask->begin();
+    TEST_ASSERT_TRUE(motionTask->isRunning());
+    motionTask->initPetals(true, false);
+
+    // more commands than the queue holds, the producer backs off while it's full
+    for (uint16_t i = 0; i < 500; i++) {
+        while (!motionTask->setPetalsOpenLevel(i % 101, 0)) {
+            std::this_thread::yield();
+        }
+    }
+    uint32_t waited = 0;
+    while (motionTask->arePetalsMoving() && waited < 2000) {
+        waitForTask(1);
+        waited++;
+    }
+    motionTask->end();
+
+    TEST_ASSERT_FALSE(motionTask->isRunning());
+    TEST_ASSERT_TRUE(petals->initialized);
+    TEST_ASSERT_EQUAL(500, petals->levels.size());
+    for (uint16_t i = 0; i < 500; i++) {
+        TEST_ASSERT_EQUAL(i % 101, petals->levels[i]);
+    }
+    TEST_ASSERT_TRUE(petals->updates > 0);
+}
+
+void test_task_shows_latest_frame(void) {
+    motionTask->begin();
+
+    LedsFrame frame;
+    for (uint8_t i = 0; i < 10; i++) {
+        for (uint8_t p = 0; p < PIXELS_COUNT; p++) {
+            frame.pixels[p] = RgbColor(i, p, 0);
+        }
+        frame.status = RgbColor(0, 0, i);
+        while (!motionTask->showLeds(frame)) {
+            std::this_thread::yield();
+        }
+    }
+    waitForTask(50);
+    motionTask->end();
+
+    SimLedStrip *pixels = SimHardware::getLedStrip(PIXELS_PIN);
+    SimLedStrip *statusPixel = SimHardware::getLedStrip(STATUS_PIXELS_PIN);
+    for (uint8_t p = 0; p < PIXELS_COUNT; p++) {
+        TEST_ASSERT_TRUE(pixels->getShownColor(p) == RgbColor(9, p, 0));
+    }
+    TEST_ASSERT_TRUE(statusPixel->getShownColor(0) == RgbColor(0, 0, 9));
+}
+
+void test_shutdown_stops_task(void) {
+    motionTask->begin();
+    LedsFrame frame;
+    frame.pixels[0] = RgbColor(255, 0, 0);
+    motionTask->showLeds(frame);
+    waitForTask(20);
+
+    motionTask->shutdown();
+    TEST_ASSERT_FALSE(motionTask->isRunning());
+    TEST_ASSERT_FALSE(petals->enabled);
+    TEST_ASSERT_TRUE(SimHardware::getLedStrip(PIXELS_PIN)->getShownColor(0) == RgbColor(0));
+
+    // nothing runs the queue anymore
+    uint32_t updates = petals->updates;
+    motionTask->setPetalsOpenLevel(50, 0);
+    waitForTask(20);
+    TEST_ASSERT_EQUAL(updates, petals->updates);
+    TEST_ASSERT_TRUE(motionTask->arePetalsMoving());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_queued_movement_reports_moving);
+    RUN_TEST(test_full_queue_rejects_commands);
+    RUN_TEST(test_task_applies_commands_in_order);
+    RUN_TEST(test_task_shows_latest_frame);
+    RUN_TEST(test_shutdown_stops_task);
+    UNITY_END();
+
+    return 0;
+}
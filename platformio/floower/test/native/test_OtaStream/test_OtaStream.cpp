@@ -0,0 +1,790 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <vector>
+#include <string>
+#include <string.h>
+#include <unordered_map>
+#include "SimHardware.h"
+#include "SimFirmware.h"
+#include "SimTcpSocket.h"
+#include "connect/OtaStream.h"
+
+#define IMAGE_SIZE 200000
+#define TCP_WINDOW 5744 // lwIP receive window of the ESP32
+#define MAX_SEGMENT 1436
+#define DOWNLOAD_TIMEOUT 120000 // ms
+#define SLOW_LINK 40 // bytes per ms
+#define DELTA_PATH "/firmware/floower-11-12.fhs"
+#define DELTA_SEED 12
+
+static uint32_t randomState = 1;
+
+static uint32_t nextRandom() {
+    // xorshift, deterministic across runs
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+// HTTP server of the firmware image, answers in randomly sized segments without overrunning the TCP window
+class HttpStandIn {
+    public:
+        std::vector<uint8_t> image;
+        std::vector<uint8_t> delta; // served at DELTA_PATH, not found when empty
+        bool honorRange = true;
+        uint16_t statusCode = 200;
+        std::vector<uint32_t> dropAt; // image offsets where the connection is lost, ascending
+        uint32_t stallAt = UINT32_MAX; // image offset where the server stops sending once
+        uint32_t bandwidth = 0; // bytes per ms, unlimited when 0
+        std::vector<std::string> requests;
+        uint32_t sentBytes = 0;
+        size_t maxUnacked = 0;
+
+        HttpStandIn(SimTcpSocket *socket) : socket(socket) {}
+
+        void step() {
+            if (socket->connecting()) {
+                socket->serverAccept();
+                response.clear();
+                position = 0;
+                budget = 0;
+                budgetTime = millis();
+                return;
+            }
+            if (!socket->connected()) {
+                return;
+            }
+            std::string &received = socket->getSent();
+            size_t end = received.find("\r\n\r\n");
+            if (end != std::string::npos) {
+                respond(received.substr(0, end + 4));
+                received.erase(0, end + 4);
+            }
+            if (position >= response.size() || position >= stallPosition) {
+                return;
+            }
+
+            size_t window = TCP_WINDOW - socket->getUnacked();
+            size_t length = 1 + nextRandom() % MAX_SEGMENT;
+            length = _min(length, _min(window, response.size() - position));
+            length = _min(length, stallPosition - position);
+            if (bandwidth > 0) {
+                budget = _min(budget + (millis() - budgetTime) * bandwidth, (size_t) TCP_WINDOW);
+                budgetTime = millis();
+                length = _min(length, budget);
+                budget -= length;
+            }
+            bool drop = position + length >= dropPosition;
+            if (drop) {
+                length = dropPosition - position;
+                dropAt.erase(dropAt.begin());
+            }
+            if (length > 0) {
+                socket->serverSend(response.data() + position, length);
+                position += length;
+                sentBytes += length;
+                maxUnacked = _max(maxUnacked, socket->getUnacked());
+            }
+            if (position == stallPosition) {
+                stallAt = UINT32_MAX;
+            }
+            if (drop || position == response.size()) {
+                socket->serverDisconnect(); // Connection: close
+            }
+        }
+
+    private:
+        void respond(const std::string &request) {
+            requests.push_back(request);
+            uint32_t offset = 0;
+            size_t range = request.find("Range: bytes=");
+            if (honorRange && range != std::string::npos) {
+                offset = atol(request.c_str() + range + 13);
+            }
+
+            const std::vector<uint8_t> &file = request.find("GET " DELTA_PATH " ") == 0 ? delta : image;
+            char head[256];
+            if (file.empty()) {
+                snprintf(head, sizeof(head), "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+            }
+            else if (statusCode != 200) {
+                snprintf(head, sizeof(head), "HTTP/1.1 %d Service Unavailable\r\nContent-Length: 0\r\n\r\n", statusCode);
+            }
+            else if (offset > 0) {
+                snprintf(head, sizeof(head), "HTTP/1.1 206 Partial Content\r\nServer: stand-in\r\ncontent-type: application/octet-stream\r\n"
+                    "Content-Range: bytes %u-%u/%u\r\nContent-Length: %u\r\n\r\n",
+                    offset, (uint32_t) file.size() - 1, (uint32_t) file.size(), (uint32_t) file.size() - offset);
+            }
+            else {
+                snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nServer: stand-in\r\nContent-Type: application/octet-stream\r\n"
+                    "Content-Length: %u\r\nConnection: close\r\n\r\n", (uint32_t) file.size());
+            }
+            response = head;
+            if (statusCode == 200 && !file.empty()) {
+                response.append(file.begin() + offset, file.end());
+            }
+            position = 0;
+
+            size_t headLength = strlen(head);
+            dropPosition = !dropAt.empty() && dropAt.front() >= offset ? headLength + dropAt.front() - offset : SIZE_MAX;
+            stallPosition = stallAt != UINT32_MAX && stallAt >= offset ? headLength + stallAt - offset : SIZE_MAX;
+        }
+
+        SimTcpSocket *socket;
+        std::string response;
+        size_t position = 0;
+        size_t dropPosition = SIZE_MAX;
+        size_t stallPosition = SIZE_MAX;
+        size_t budget = 0; // bytes the link could have sent
+        unsigned long budgetTime = 0;
+};
+
+SimTcpSocket *socket;
+HttpStandIn *server;
+OtaStream *ota;
+OtaManifest manifest;
+std::vector<uint8_t> rawImage; // as flashed
+
+static void digestOf(const std::vector<uint8_t> &data, uint8_t *digest) {
+    Sha256 sha256;
+    sha256.update(data.data(), data.size());
+    sha256.finish(digest);
+}
+
+// image that compresses about as well as a firmware, literals of a skewed alphabet and repeats of recent bytes
+static std::vector<uint8_t> firmwareLike(size_t size) {
+    std::vector<uint8_t> image;
+    while (image.size() < size) {
+        uint32_t kind = nextRandom() % 100;
+        if (kind < 10 && image.size() > 2048) {
+            size_t offset = 1 + nextRandom() % 2048;
+            size_t length = 3 + nextRandom() % 14;
+            for (size_t i = 0; i < length && image.size() < size; i++) {
+                image.push_back(image[image.size() - offset]);
+            }
+        }
+        else if (kind < 40) {
+            uint32_t value = nextRandom();
+            image.push_back((value % 8) * (value % 5) * 4);
+        }
+        else {
+            image.push_back(nextRandom());
+        }
+    }
+    return image;
+}
+
+// same format as tools/ota-packer, greedy matching over hash chains
+static std::vector<uint8_t> pack(const std::vector<uint8_t> &image, uint8_t windowBits = 11, uint8_t lookaheadBits = 4) {
+    std::vector<uint8_t> packed = {'F', 'L', 'H', 'S', OTA_PACKED_VERSION, windowBits, lookaheadBits, 0};
+    for (uint8_t i = 0; i < 4; i++) {
+        packed.push_back(image.size() >> (i * 8));
+    }
+    uint32_t bits = 0;
+    uint8_t bitCount = 0;
+    auto put = [&](uint32_t value, uint8_t count) {
+        for (int8_t i = count - 1; i >= 0; i--) {
+            bits = (bits << 1) | ((value >> i) & 1);
+            if (++bitCount == 8) {
+                packed.push_back(bits);
+                bits = 0;
+                bitCount = 0;
+            }
+        }
+    };
+
+    size_t size = image.size();
+    size_t window = 1 << windowBits;
+    size_t maxLength = 1 << lookaheadBits;
+    std::vector<int32_t> head(1 << 16, -1);
+    std::vector<int32_t> previous(size, -1);
+    auto hashAt = [&](size_t position) { return ((image[position] << 8) ^ (image[position + 1] << 4) ^ image[position + 2]) & 0xFFFF; };
+    auto insert = [&](size_t position) {
+        if (position + 2 < size) {
+            uint32_t hash = hashAt(position);
+            previous[position] = head[hash];
+            head[hash] = position;
+        }
+    };
+
+    for (size_t position = 0; position < size;) {
+        size_t bestLength = 0;
+        size_t bestOffset = 0;
+        int32_t candidate = position + 2 < size ? head[hashAt(position)] : -1;
+        for (uint8_t chain = 0; candidate >= 0 && position - candidate <= window && chain < 64; chain++) {
+            size_t length = 0;
+            while (length < maxLength && position + length < size && image[candidate + length] == image[position + length]) {
+                length++;
+            }
+            if (length > bestLength) {
+                bestLength = length;
+                bestOffset = position - candidate;
+            }
+            candidate = previous[candidate];
+        }
+        if (bestLength >= 3) {
+            put(0, 1);
+            put(bestOffset - 1, windowBits);
+            put(bestLength - 1, lookaheadBits);
+        }
+        else {
+            put(1, 1);
+            put(image[position], 8);
+            bestLength = 1;
+        }
+        for (size_t i = 0; i < bestLength; i++) {
+            insert(position++);
+        }
+    }
+    if (bitCount > 0) {
+        packed.push_back(bits << (8 - bitCount));
+    }
+    return packed;
+}
+
+// diff length from the start on in the step direction, where the matching bytes outweigh the others
+static size_t extendDiff(const std::vector<uint8_t> &source, const std::vector<uint8_t> &target, size_t sourceStart, size_t targetStart, int8_t step, size_t limit) {
+    int32_t equal = 0;
+    int32_t score = 0;
+    size_t best = 0;
+    for (size_t i = 1; i <= limit; i++) {
+        if (step > 0) {
+            equal += source[sourceStart + i - 1] == target[targetStart + i - 1];
+        }
+        else {
+            equal += source[sourceStart - i] == target[targetStart - i];
+        }
+        if (equal * 2 - (int32_t) i > score) {
+            score = equal * 2 - i;
+            best = i;
+        }
+        else if (i - best > 64) {
+            break;
+        }
+    }
+    return best;
+}
+
+// same format as tools/ota-packer, exactly matching seeds extended to diffs
+static std::vector<uint8_t> makeDelta(const std::vector<uint8_t> &source, const std::vector<uint8_t> &target) {
+    std::unordered_map<std::string, size_t> index;
+    for (size_t position = 0; position + DELTA_SEED <= source.size(); position += 4) {
+        index.emplace(std::string(source.begin() + position, source.begin() + position + DELTA_SEED), position);
+    }
+    std::vector<uint8_t> patch = {'F', 'L', 'D', 'P', DELTA_VERSION, 0, 0, 0};
+    auto putUint32 = [&](uint32_t value) {
+        for (uint8_t i = 0; i < 4; i++) {
+            patch.push_back(value >> (i * 8));
+        }
+    };
+    putUint32(source.size());
+    putUint32(target.size());
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    digestOf(source, digest);
+    patch.insert(patch.end(), digest, digest + SHA256_DIGEST_SIZE);
+
+    size_t sourcePosition = 0;
+    size_t extraStart = 0;
+    size_t position = 0;
+    while (position < target.size()) {
+        auto seed = index.end();
+        if (position + DELTA_SEED <= target.size()) {
+            seed = index.find(std::string(target.begin() + position, target.begin() + position + DELTA_SEED));
+        }
+        if (seed == index.end()) {
+            position++;
+            continue;
+        }
+        size_t sourceStart = seed->second;
+        size_t length = extendDiff(source, target, sourceStart, position, 1, _min(source.size() - sourceStart, target.size() - position));
+        size_t back = extendDiff(source, target, sourceStart, position, -1, _min(sourceStart, position - extraStart));
+        sourceStart -= back;
+        size_t targetStart = position - back;
+        length += back;
+
+        putUint32(targetStart - extraStart);
+        putUint32(length);
+        putUint32(sourceStart - sourcePosition);
+        patch.insert(patch.end(), target.begin() + extraStart, target.begin() + targetStart);
+        for (size_t i = 0; i < length; i++) {
+            patch.push_back(target[targetStart + i] - source[sourceStart + i]);
+        }
+        sourcePosition = sourceStart + length;
+        position = targetStart + length;
+        extraStart = position;
+    }
+    putUint32(target.size() - extraStart);
+    putUint32(0);
+    putUint32(0);
+    patch.insert(patch.end(), target.begin() + extraStart, target.end());
+    return patch;
+}
+
+// next version of a firmware, code inserted at a few places and the pointers past it moved
+static std::vector<uint8_t> nextVersion(const std::vector<uint8_t> &base) {
+    std::vector<uint8_t> next(base.begin(), base.begin() + 50000);
+    for (uint16_t i = 0; i < 600; i++) {
+        next.push_back(nextRandom());
+    }
+    next.insert(next.end(), base.begin() + 50000, base.begin() + 150000);
+    for (uint16_t i = 0; i < 100; i++) {
+        next.push_back(nextRandom());
+    }
+    next.insert(next.end(), base.begin() + 150000, base.end());
+    for (size_t i = 60000; i < next.size(); i += 256) {
+        next[i] += 6;
+    }
+    return next;
+}
+
+static void usePackedImage() {
+    std::vector<uint8_t> image = firmwareLike(IMAGE_SIZE);
+    digestOf(image, manifest.sha256);
+    server->image = pack(image);
+    rawImage = image;
+}
+
+// full image and the delta to it from the running firmware
+static void useDelta() {
+    std::vector<uint8_t> base = firmwareLike(IMAGE_SIZE - 700);
+    SimHardware::setRunningFirmware(base);
+    rawImage = nextVersion(base);
+    digestOf(rawImage, manifest.sha256);
+    server->image = pack(rawImage);
+    server->delta = pack(makeDelta(base, rawImage), 11, 10);
+    manifest.deltaUrl = "ota.floower.io" DELTA_PATH;
+}
+
+static OtaState download() {
+    TEST_ASSERT_TRUE(ota->begin(manifest, socket));
+    while (millis() < DOWNLOAD_TIMEOUT) {
+        for (uint32_t i = nextRandom() % 4; i > 0; i--) {
+            server->step();
+        }
+        OtaState state = ota->loop();
+        if (state == OTA_FINISHED || state == OTA_FAILED) {
+            return state;
+        }
+        delay(1);
+    }
+    return ota->getState();
+}
+
+static void assertImageWritten() {
+    SimFirmware *firmware = SimHardware::getFirmware();
+    TEST_ASSERT_NOT_NULL(firmware);
+    TEST_ASSERT_TRUE(firmware->isBootable());
+    TEST_ASSERT_EQUAL(IMAGE_SIZE, firmware->getImage().size());
+    TEST_ASSERT_TRUE(firmware->getImage() == rawImage);
+    TEST_ASSERT_EQUAL(IMAGE_SIZE, ota->getWrittenBytes());
+}
+
+void setUp(void) {
+    SimHardware::reset();
+    randomState = 1;
+    socket = new SimTcpSocket();
+    server = new HttpStandIn(socket);
+    ota = new OtaStream();
+    socket->onConnect([](void *arg, SimTcpSocket *client) { ota->onConnected(); });
+    socket->onData([](void *arg, SimTcpSocket *client, void *data, size_t len) { ota->onData((char *) data, len); });
+    socket->onDisconnect([](void *arg, SimTcpSocket *client) { ota->onDisconnected(); });
+
+    server->image.resize(IMAGE_SIZE);
+    for (uint8_t &byte : server->image) {
+        byte = nextRandom();
+    }
+    manifest = OtaManifest();
+    manifest.url = "ota.floower.io/firmware/floower-12.bin";
+    manifest.size = IMAGE_SIZE;
+    manifest.hasDigest = true;
+    digestOf(server->image, manifest.sha256);
+    rawImage = server->image;
+}
+
+void tearDown(void) {
+    delete ota;
+    delete server;
+    delete socket;
+}
+
+void test_sha256_vectors(void) {
+    const char *abc = "abc";
+    const char *long56 = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    uint8_t expected[SHA256_DIGEST_SIZE];
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    Sha256 sha256;
+
+    sha256.finish(digest);
+    TEST_ASSERT_TRUE(Sha256::parseHex("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", expected));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, digest, SHA256_DIGEST_SIZE);
+
+    sha256.begin();
+    sha256.update((const uint8_t *) abc, 3);
+    sha256.finish(digest);
+    TEST_ASSERT_TRUE(Sha256::parseHex("BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD", expected));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, digest, SHA256_DIGEST_SIZE);
+
+    sha256.begin();
+    sha256.update((const uint8_t *) long56, strlen(long56));
+    sha256.finish(digest);
+    TEST_ASSERT_TRUE(Sha256::parseHex("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", expected));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, digest, SHA256_DIGEST_SIZE);
+
+    // any chunking gives the same digest
+    digestOf(server->image, expected);
+    sha256.begin();
+    for (size_t position = 0; position < IMAGE_SIZE;) {
+        size_t length = nextRandom() % 200;
+        length = _min(length, IMAGE_SIZE - position);
+        sha256.update(server->image.data() + position, length);
+        position += length;
+    }
+    sha256.finish(digest);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, digest, SHA256_DIGEST_SIZE);
+
+    TEST_ASSERT_FALSE(Sha256::parseHex("e3b0c442", digest));
+    TEST_ASSERT_FALSE(Sha256::parseHex("x3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", digest));
+}
+
+void test_parser_head_split_anywhere(void) {
+    const char *response = "HTTP/1.1 206 Partial Content\r\nServer: nginx\r\nCONTENT-TYPE: application/octet-stream; x=y\r\n"
+        "Content-Range: bytes 4096-8191/200000\r\ncontent-length:  4096 \r\n\r\nBODY";
+    size_t length = strlen(response);
+    for (size_t split = 0; split <= length; split++) {
+        HttpResponseParser parser;
+        size_t consumed = parser.feed(response, split);
+        TEST_ASSERT_FALSE(parser.isInvalid());
+        if (!parser.isComplete()) {
+            consumed += parser.feed(response + split, length - split);
+        }
+        TEST_ASSERT_TRUE(parser.isComplete());
+        TEST_ASSERT_EQUAL_STRING("BODY", response + consumed);
+        TEST_ASSERT_EQUAL(206, parser.getStatusCode());
+        TEST_ASSERT_EQUAL(4096, parser.getContentLength());
+        TEST_ASSERT_EQUAL_STRING("application/octet-stream", parser.getContentType());
+        TEST_ASSERT_TRUE(parser.hasContentRange());
+        TEST_ASSERT_EQUAL(4096, parser.getRangeStart());
+        TEST_ASSERT_EQUAL(200000, parser.getRangeTotal());
+    }
+
+    // byte by byte
+    HttpResponseParser parser;
+    size_t consumed = 0;
+    while (!parser.isComplete()) {
+        consumed += parser.feed(response + consumed, 1);
+    }
+    TEST_ASSERT_EQUAL(length - 4, consumed);
+    TEST_ASSERT_EQUAL(0, parser.feed("BODY", 4)); // body is left to the caller
+}
+
+void test_parser_rejects_invalid(void) {
+    HttpResponseParser parser;
+    parser.feed("SSH-2.0-OpenSSH_8.9\r\n", 21);
+    TEST_ASSERT_TRUE(parser.isInvalid());
+
+    parser.reset();
+    const char *badLength = "HTTP/1.1 200 OK\r\nContent-Length: 12ab\r\n";
+    parser.feed(badLength, strlen(badLength));
+    TEST_ASSERT_TRUE(parser.isInvalid());
+
+    parser.reset();
+    const char *chunked = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nContent-Range: bytes 0-9/*\r\n\r\n";
+    parser.feed(chunked, strlen(chunked));
+    TEST_ASSERT_TRUE(parser.isComplete());
+    TEST_ASSERT_TRUE(parser.isChunked());
+    TEST_ASSERT_EQUAL(-1, parser.getContentLength());
+    TEST_ASSERT_EQUAL(-1, parser.getRangeTotal());
+
+    // endless head
+    parser.reset();
+    parser.feed("HTTP/1.1 200 OK\r\n", 17);
+    std::string header = "X-Padding: " + std::string(HTTP_LINE_MAX * 2, 'x') + "\r\n";
+    for (uint8_t i = 0; i < 20 && !parser.isInvalid(); i++) {
+        parser.feed(header.c_str(), header.length());
+    }
+    TEST_ASSERT_TRUE(parser.isInvalid());
+}
+
+void test_download_with_random_chunking(void) {
+    TEST_ASSERT_EQUAL(OTA_FINISHED, download());
+    assertImageWritten();
+    TEST_ASSERT_EQUAL(1, ota->getConnections()); // buffers never overflowed
+    TEST_ASSERT_TRUE(server->requests[0].find("GET /firmware/floower-12.bin HTTP/1.1\r\n") == 0);
+    TEST_ASSERT_TRUE(server->requests[0].find("Host: ota.floower.io\r\n") != std::string::npos);
+    TEST_ASSERT_TRUE(server->requests[0].find("Range:") == std::string::npos);
+    TEST_ASSERT_TRUE(server->maxUnacked <= TCP_WINDOW);
+    printf("download: %u bytes in %lu ms, flash bound %lu ms\n", IMAGE_SIZE, millis(),
+        (unsigned long) IMAGE_SIZE * SIM_FLASH_SECTOR_TIME / SIM_FLASH_SECTOR_SIZE / 1000);
+}
+
+void test_resume_after_disconnects(void) {
+    server->dropAt = {30000, 30001, 120000, IMAGE_SIZE - 1};
+    TEST_ASSERT_EQUAL(OTA_FINISHED, download());
+    assertImageWritten();
+    TEST_ASSERT_EQUAL(5, ota->getConnections());
+    TEST_ASSERT_EQUAL(5, server->requests.size());
+    TEST_ASSERT_TRUE(server->requests[1].find("Range: bytes=30000-\r\n") != std::string::npos);
+    TEST_ASSERT_TRUE(server->requests[2].find("Range: bytes=30001-\r\n") != std::string::npos);
+    TEST_ASSERT_TRUE(server->requests[4].find("Range: bytes=199999-\r\n") != std::string::npos);
+    TEST_ASSERT_TRUE(server->sentBytes < IMAGE_SIZE + 5 * 256); // image once, plus the heads
+}
+
+void test_resume_when_range_ignored(void) {
+    server->honorRange = false;
+    server->dropAt = {50000};
+    TEST_ASSERT_EQUAL(OTA_FINISHED, download());
+    assertImageWritten();
+    TEST_ASSERT_EQUAL(2, ota->getConnections());
+    TEST_ASSERT_TRUE(server->sentBytes > IMAGE_SIZE + 50000); // beginning skipped the second time
+}
+
+void test_resume_stalled_server(void) {
+    server->stallAt = 100000;
+    TEST_ASSERT_EQUAL(OTA_FINISHED, download());
+    assertImageWritten();
+    TEST_ASSERT_EQUAL(2, ota->getConnections());
+    TEST_ASSERT_TRUE(millis() > OTA_RESPONSE_TIMEOUT);
+}
+
+void test_digest_mismatch_not_bootable(void) {
+    manifest.sha256[7] ^= 0x01;
+    TEST_ASSERT_EQUAL(OTA_FAILED, download());
+    SimFirmware *firmware = SimHardware::getFirmware();
+    TEST_ASSERT_EQUAL(IMAGE_SIZE, firmware->getImage().size()); // downloaded whole
+    TEST_ASSERT_FALSE(firmware->isBootable());
+    TEST_ASSERT_FALSE(firmware->isRunning()); // aborted
+}
+
+void test_size_mismatch_rejected(void) {
+    manifest.size = IMAGE_SIZE + 1;
+    TEST_ASSERT_EQUAL(OTA_FAILED, download());
+    TEST_ASSERT_NULL(SimHardware::getFirmware()); // flash untouched
+    TEST_ASSERT_FALSE(socket->connected());
+}
+
+void test_gives_up_without_progress(void) {
+    server->statusCode = 503;
+    TEST_ASSERT_EQUAL(OTA_FAILED, download());
+    TEST_ASSERT_EQUAL(OTA_RESUME_ATTEMPTS, ota->getConnections());
+    TEST_ASSERT_TRUE(millis() >= (OTA_RESUME_ATTEMPTS - 1) * OTA_RESUME_DELAY);
+    TEST_ASSERT_NULL(SimHardware::getFirmware());
+}
+
+void test_invalid_url(void) {
+    manifest.url = "ota.floower.io";
+    TEST_ASSERT_FALSE(ota->begin(manifest, socket));
+    manifest.url = "http://192.168.0.10:8080/floower.bin";
+    TEST_ASSERT_TRUE(ota->begin(manifest, socket));
+    TEST_ASSERT_EQUAL_STRING("192.168.0.10", ota->getHost());
+    TEST_ASSERT_EQUAL(8080, ota->getPort());
+}
+
+void test_decoder_any_chunking(void) {
+    std::vector<uint8_t> image = firmwareLike(50000);
+    for (uint8_t lookaheadBits = 3; lookaheadBits <= 6; lookaheadBits++) {
+        std::vector<uint8_t> packed = pack(image, 8 + lookaheadBits % 4, lookaheadBits);
+        HeatshrinkDecoder decoder;
+        TEST_ASSERT_TRUE(decoder.begin(packed[5], packed[6]));
+
+        std::vector<uint8_t> decoded;
+        uint8_t output[100];
+        size_t position = OTA_PACKED_HEADER_SIZE;
+        while (decoded.size() < image.size()) {
+            size_t length = _min((size_t) nextRandom() % 50, packed.size() - position);
+            const uint8_t *input = packed.data() + position;
+            size_t remaining = length;
+            while (true) {
+                size_t size = _min((size_t) (1 + nextRandom() % sizeof(output)), image.size() - decoded.size());
+                size_t decodedLength = decoder.decode(input, remaining, output, size);
+                decoded.insert(decoded.end(), output, output + decodedLength);
+                if (decodedLength < size || decoded.size() == image.size()) {
+                    break; // input used up
+                }
+            }
+            position += length - remaining;
+            TEST_ASSERT_TRUE(position < packed.size() || decoded.size() == image.size());
+        }
+        TEST_ASSERT_TRUE(decoded == image);
+    }
+
+    HeatshrinkDecoder decoder;
+    TEST_ASSERT_FALSE(decoder.begin(HEATSHRINK_WINDOW_BITS_MAX + 1, 4));
+    TEST_ASSERT_FALSE(decoder.begin(8, 8));
+    TEST_ASSERT_FALSE(decoder.begin(8, HEATSHRINK_LOOKAHEAD_BITS_MIN - 1));
+}
+
+void test_packed_download(void) {
+    usePackedImage();
+    server->dropAt = {7, 12, 60000}; // within the header and in the middle of the stream
+    TEST_ASSERT_EQUAL(OTA_FINISHED, download());
+    assertImageWritten();
+    TEST_ASSERT_EQUAL(4, ota->getConnections());
+    TEST_ASSERT_EQUAL(IMAGE_SIZE, ota->getImageSize());
+    TEST_ASSERT_EQUAL(server->image.size(), ota->getTotalBytes());
+    TEST_ASSERT_EQUAL(IMAGE_SIZE / SIM_FLASH_SECTOR_SIZE + 1, SimHardware::getFirmware()->getWrites()); // whole sectors
+}
+
+void test_packed_faster_on_slow_link(void) {
+    server->bandwidth = SLOW_LINK;
+    TEST_ASSERT_EQUAL(OTA_FINISHED, download());
+    assertImageWritten();
+    unsigned long rawTime = millis();
+
+    tearDown();
+    setUp();
+    usePackedImage();
+    server->bandwidth = SLOW_LINK;
+    TEST_ASSERT_EQUAL(OTA_FINISHED, download());
+    assertImageWritten();
+    unsigned long packedTime = millis();
+
+    printf("%u KB/s link: raw %u bytes in %lu ms, packed %u bytes (%.1f %%) in %lu ms\n", SLOW_LINK, IMAGE_SIZE, rawTime,
+        (uint32_t) server->image.size(), 100.0 * server->image.size() / IMAGE_SIZE, packedTime);
+    TEST_ASSERT_TRUE(server->image.size() < IMAGE_SIZE * 3 / 4);
+    TEST_ASSERT_TRUE(packedTime < rawTime * 3 / 4);
+}
+
+void test_packed_unsupported_rejected(void) {
+    usePackedImage();
+    server->image[5] = HEATSHRINK_WINDOW_BITS_MAX + 1;
+    TEST_ASSERT_EQUAL(OTA_FAILED, download());
+    TEST_ASSERT_NULL(SimHardware::getFirmware()); // flash untouched
+
+    usePackedImage();
+    manifest.size = IMAGE_SIZE - 1; // size told by the header
+    TEST_ASSERT_EQUAL(OTA_FAILED, download());
+    TEST_ASSERT_NULL(SimHardware::getFirmware());
+}
+
+void test_packed_truncated_not_bootable(void) {
+    usePackedImage();
+    server->image.resize(server->image.size() - 100);
+    TEST_ASSERT_EQUAL(OTA_FAILED, download());
+    TEST_ASSERT_FALSE(SimHardware::getFirmware()->isBootable());
+    TEST_ASSERT_FALSE(SimHardware::getFirmware()->isRunning()); // aborted
+}
+
+void test_delta_update(void) {
+    useDelta();
+    server->bandwidth = SLOW_LINK;
+    TEST_ASSERT_EQUAL(OTA_FINISHED, download());
+    assertImageWritten();
+    TEST_ASSERT_TRUE(ota->isDelta());
+    TEST_ASSERT_EQUAL(1, ota->getConnections());
+    TEST_ASSERT_TRUE(server->requests[0].find("GET " DELTA_PATH " ") == 0);
+    unsigned long deltaTime = millis();
+
+    // patch bytes are from the running firmware and the download, all state in the stream
+    printf("delta: %u bytes (%.1f %% of %u packed) applied in %lu ms, %lu KB/s flashed, RAM %u bytes (patcher %u)\n",
+        (uint32_t) server->delta.size(), 100.0 * server->delta.size() / server->image.size(), (uint32_t) server->image.size(),
+        deltaTime, IMAGE_SIZE / deltaTime, (uint32_t) (sizeof(OtaStream) + 2 * OTA_CHUNK_SIZE), (uint32_t) sizeof(DeltaPatcher));
+    TEST_ASSERT_TRUE(server->delta.size() < server->image.size() / 10);
+    TEST_ASSERT_TRUE(sizeof(DeltaPatcher) < 512);
+    TEST_ASSERT_TRUE(deltaTime < ((unsigned long) IMAGE_SIZE * SIM_FLASH_SECTOR_TIME / SIM_FLASH_SECTOR_SIZE / 1000) * 12 / 10 + 100); // flash bound
+}
+
+void test_delta_resumed(void) {
+    useDelta();
+    server->dropAt = {700}; // in the middle of the patch
+    TEST_ASSERT_EQUAL(OTA_FINISHED, download());
+    assertImageWritten();
+    TEST_ASSERT_TRUE(ota->isDelta());
+    TEST_ASSERT_EQUAL(2, ota->getConnections());
+    TEST_ASSERT_TRUE(server->requests[1].find("Range: bytes=700-\r\n") != std::string::npos);
+}
+
+void test_delta_falls_back_when_missing(void) {
+    useDelta();
+    server->delta.clear();
+    TEST_ASSERT_EQUAL(OTA_FINISHED, download());
+    assertImageWritten();
+    TEST_ASSERT_FALSE(ota->isDelta());
+    TEST_ASSERT_EQUAL(2, server->requests.size());
+    TEST_ASSERT_TRUE(server->requests[1].find("GET /firmware/floower-12.bin ") == 0);
+}
+
+void test_delta_falls_back_on_other_base(void) {
+    useDelta();
+    std::vector<uint8_t> running = SimHardware::getRunningFirmware();
+    running[1000] ^= 0xFF;
+    SimHardware::setRunningFirmware(running);
+    TEST_ASSERT_EQUAL(OTA_FINISHED, download());
+    assertImageWritten();
+    TEST_ASSERT_FALSE(ota->isDelta());
+    TEST_ASSERT_EQUAL(2, ota->getConnections());
+    TEST_ASSERT_TRUE(server->sentBytes < server->delta.size() + server->image.size() + 512); // delta once
+}
+
+void test_delta_source_checked_in_blocks(void) {
+    useDelta();
+    std::vector<uint8_t> patch = makeDelta(SimHardware::getRunningFirmware(), rawImage);
+    DeltaPatcher patcher;
+    TEST_ASSERT_TRUE(patcher.begin(patch.data()));
+    DeltaSourceCheck check;
+    uint16_t calls = 1;
+    while ((check = patcher.checkSource()) == SOURCE_CHECKING) {
+        calls++;
+    }
+    TEST_ASSERT_EQUAL(SOURCE_MATCHES, check);
+    TEST_ASSERT_EQUAL((IMAGE_SIZE - 700 + DELTA_CHECK_BLOCK - 1) / DELTA_CHECK_BLOCK, calls);
+
+    std::vector<uint8_t> running = SimHardware::getRunningFirmware();
+    running.back() ^= 0xFF;
+    SimHardware::setRunningFirmware(running);
+    TEST_ASSERT_TRUE(patcher.begin(patch.data()));
+    do {
+        check = patcher.checkSource();
+    } while (check == SOURCE_CHECKING);
+    TEST_ASSERT_EQUAL(SOURCE_DIFFERS, check);
+}
+
+void test_delta_falls_back_on_digest_mismatch(void) {
+    useDelta();
+    std::vector<uint8_t> wrong = rawImage;
+    wrong[100000] ^= 0x01;
+    server->delta = pack(makeDelta(SimHardware::getRunningFirmware(), wrong), 11, 10);
+    TEST_ASSERT_EQUAL(OTA_FINISHED, download());
+    assertImageWritten();
+    TEST_ASSERT_FALSE(ota->isDelta());
+    TEST_ASSERT_EQUAL(2, ota->getConnections());
+}
+
+void test_invalid_delta_url(void) {
+    manifest.deltaUrl = "floower-11-12.fhs";
+    TEST_ASSERT_FALSE(ota->begin(manifest, socket));
+    manifest.deltaUrl = "ota.floower.io:8080" DELTA_PATH;
+    TEST_ASSERT_TRUE(ota->begin(manifest, socket));
+    TEST_ASSERT_EQUAL(8080, ota->getPort());
+    TEST_ASSERT_TRUE(ota->isDelta());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_sha256_vectors);
+    RUN_TEST(test_parser_head_split_anywhere);
+    RUN_TEST(test_parser_rejects_invalid);
+    RUN_TEST(test_download_with_random_chunking);
+    RUN_TEST(test_resume_after_disconnects);
+    RUN_TEST(test_resume_when_range_ignored);
+    RUN_TEST(test_resume_stalled_server);
+    RUN_TEST(test_digest_mismatch_not_bootable);
+    RUN_TEST(test_size_mismatch_rejected);
+    RUN_TEST(test_gives_up_without_progress);
+    RUN_TEST(test_invalid_url);
+    RUN_TEST(test_decoder_any_chunking);
+    RUN_TEST(test_packed_download);
+    RUN_TEST(test_packed_faster_on_slow_link);
+    RUN_TEST(test_packed_unsupported_rejected);
+    RUN_TEST(test_packed_truncated_not_bootable);
+    RUN_TEST(test_delta_update);
+    RUN_TEST(test_delta_resumed);
+    RUN_TEST(test_delta_falls_back_when_missing);
+    RUN_TEST(test_delta_falls_back_on_other_base);
+    RUN_TEST(test_delta_source_checked_in_blocks);
+    RUN_TEST(test_delta_falls_back_on_digest_mismatch);
+    RUN_TEST(test_invalid_delta_url);
+    UNITY_END();
+
+    return 0;
+}
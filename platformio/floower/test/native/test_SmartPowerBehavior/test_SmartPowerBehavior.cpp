@@ -0,0 +1,136 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <EEPROM.h>
+#include "SimHardware.h"
+#include "SimLedStrip.h"
+#include "behavior/BloomingBehavior.h"
+
+#define BATTERY_PIN 36
+#define USB_PIN 39
+#define TOUCH_PIN 4
+#define NEOPIXEL_PIN 27
+
+#define ADC_BATTERY_FULL 2300 // ~4.16V
+#define ADC_BATTERY_DEAD 1800 // ~3.26V
+#define ADC_USB_CONNECTED 2900
+
+Config *config;
+Floower *floower;
+RemoteControl *remoteControl;
+BloomingBehavior *behavior;
+
+void run(unsigned long durationMs) {
+    unsigned long endTime = millis() + durationMs;
+    while (millis() < endTime) {
+        floower->update();
+        behavior->loop();
+        delay(10);
+    }
+}
+
+void touch(unsigned long durationMs) {
+    SimHardware::setTouch(TOUCH_PIN, 10);
+    run(durationMs);
+    SimHardware::setTouch(TOUCH_PIN, 100);
+}
+
+void startFloower(uint16_t batteryReading, bool usbConnected) {
+    SimHardware::setAnalog(BATTERY_PIN, batteryReading);
+    SimHardware::setAnalog(USB_PIN, usbConnected ? ADC_USB_CONNECTED : 0);
+    SimHardware::setDigital(35, HIGH); // not charging
+
+    config->begin();
+    config->hardwareCalibration(1000, 1000, 9, 1);
+    config->factorySettings();
+    config->setCalibrated();
+    config->setTouchCalibrated(true);
+    config->commit();
+    config->load();
+    config->deepSleepEnabled = true;
+
+    floower->init();
+    floower->readPowerState();
+    behavior->setup(false);
+}
+
+bool isShowingLight() {
+    SimLedStrip *strip = SimHardware::getLedStrip(NEOPIXEL_PIN);
+    for (uint16_t i = 0; i < strip->PixelCount(); i++) {
+        if (strip->getShownColor(i) != RgbColor(0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void setUp(void) {
+    SimHardware::reset();
+    EEPROM.erase();
+    config = new Config(11);
+    floower = new Floower(config);
+    remoteControl = new RemoteControl(nullptr, nullptr, nullptr);
+    behavior = new BloomingBehavior(config, floower, remoteControl);
+}
+
+void tearDown(void) {
+    run(1000); // let the touch cooldown expire, touch state is static
+    delete behavior;
+    delete remoteControl;
+    delete floower;
+    delete config;
+}
+
+void test_setup_standby(void) {
+    startFloower(ADC_BATTERY_FULL, true);
+    run(3000);
+
+    TEST_ASSERT_TRUE(behavior->isIdle());
+    TEST_ASSERT_EQUAL(0, floower->getCurrentPetalsOpenLevel());
+    TEST_ASSERT_FALSE(isShowingLight());
+    TEST_ASSERT_FALSE(SimHardware::isDeepSleeping());
+}
+
+void test_touch_blooms(void) {
+    startFloower(ADC_BATTERY_FULL, true);
+    run(1000);
+
+    touch(200);
+    run(config->speedMillis + 2000);
+
+    TEST_ASSERT_TRUE(behavior->isIdle());
+    TEST_ASSERT_EQUAL(config->maxOpenLevel, floower->getCurrentPetalsOpenLevel());
+    TEST_ASSERT_TRUE(isShowingLight());
+
+    touch(200);
+    run(config->speedMillis + 2000);
+
+    TEST_ASSERT_EQUAL(0, floower->getCurrentPetalsOpenLevel());
+}
+
+void test_low_battery_deep_sleep(void) {
+    startFloower(ADC_BATTERY_DEAD, false);
+    run(10000);
+
+    TEST_ASSERT_TRUE(SimHardware::isDeepSleeping());
+    TEST_ASSERT_EQUAL(0, floower->getCurrentPetalsOpenLevel());
+}
+
+void test_inactivity_deep_sleep(void) {
+    startFloower(ADC_BATTERY_FULL, false);
+    run(30000);
+    TEST_ASSERT_FALSE(SimHardware::isDeepSleeping());
+
+    run(35000);
+    TEST_ASSERT_TRUE(SimHardware::isDeepSleeping());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_setup_standby);
+    RUN_TEST(test_touch_blooms);
+    RUN_TEST(test_low_battery_deep_sleep);
+    RUN_TEST(test_inactivity_deep_sleep);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include <unity.h>
+#include <thread>
+#include "SpscQueue.h"
+
+#define THREADED_ITEMS 1000000
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_fill_and_drain(void) {
+    SpscQueue<uint32_t, 8> queue;
+    uint32_t item;
+
+    TEST_ASSERT_TRUE(queue.isEmpty());
+    TEST_ASSERT_NULL(queue.front());
+    TEST_ASSERT_FALSE(queue.pop(item));
+
+    // several rounds to wrap the indices around
+    for (uint32_t round = 0; round < 5; round++) {
+        for (uint32_t i = 0; i < 8; i++) {
+            TEST_ASSERT_TRUE(queue.push(round * 10 + i));
+        }
+        TEST_ASSERT_FALSE(queue.push(99));
+        TEST_ASSERT_EQUAL(8, queue.size());
+
+        TEST_ASSERT_EQUAL(round * 10, *queue.front());
+        for (uint32_t i = 0; i < 8; i++) {
+            TEST_ASSERT_TRUE(queue.pop(item));
+            TEST_ASSERT_EQUAL(round * 10 + i, item);
+        }
+        TEST_ASSERT_TRUE(queue.isEmpty());
+    }
+}
+
+void test_front_keeps_item_until_pop(void) {
+    SpscQueue<uint32_t, 4> queue;
+    queue.push(1);
+    queue.push(2);
+
+    uint32_t *front = queue.front();
+    TEST_ASSERT_NOT_NULL(front);
+    TEST_ASSERT_EQUAL(1, *front);
+    TEST_ASSERT_EQUAL(2, queue.size()); // still occupies its slot while being processed
+    queue.pop();
+    TEST_ASSERT_EQUAL(2, *queue.front());
+}
+
+void test_producer_consumer_threads(void) {
+    static SpscQueue<uint32_t, 64> queue;
+    uint32_t fullCount = 0;
+
+    std::thread producer([&]() {
+        for (uint32_t i = 0; i < THREADED_ITEMS; i++) {
+            while (!queue.push(i)) {
+                fullCount++;
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint32_t expected = 0;
+    uint32_t outOfOrder = 0;
+    while (expected < THREADED_ITEMS) {
+        uint32_t item;
+        if (queue.pop(item)) {
+            if (item != expected) {
+                outOfOrder++;
+            }
+            expected++;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    TEST_ASSERT_EQUAL(0, outOfOrder);
+    TEST_ASSERT_TRUE(queue.isEmpty());
+    printf("%d items, producer found the queue full %u times\n", THREADED_ITEMS, fullCount);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fill_and_drain);
+    RUN_TEST(test_front_keeps_item_until_pop);
+    RUN_TEST(test_producer_consumer_threads);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,174 @@
+#include <unity.h>
+#include <vector>
+#include "SimHardware.h"
+#include "connect/StatePublisher.h"
+
+struct PublishedState {
+    int8_t petalsOpenLevel;
+    RgbColor color;
+};
+
+std::vector<PublishedState> published;
+bool transportReady; // e.g. no BLE client or Floud not authorized yet when false
+
+bool onPublish(int8_t petalsOpenLevel, HsbColor hsbColor) {
+    if (!transportReady) {
+        return false;
+    }
+    published.push_back({petalsOpenLevel, RgbColor(hsbColor)});
+    return true;
+}
+
+void setUp(void) {
+    SimHardware::reset();
+    published.clear();
+    transportReady = true;
+}
+
+void tearDown(void) {
+}
+
+void test_first_state_sent_immediately(void) {
+    StatePublisher publisher(100, onPublish);
+    publisher.publish(50, HsbColor(RgbColor(255, 0, 0)));
+
+    TEST_ASSERT_EQUAL(1, published.size());
+    TEST_ASSERT_EQUAL(50, published[0].petalsOpenLevel);
+    TEST_ASSERT_TRUE(published[0].color == RgbColor(255, 0, 0));
+    TEST_ASSERT_FALSE(publisher.isPending());
+}
+
+void test_burst_coalesced_latest_wins(void) {
+    StatePublisher publisher(100, onPublish);
+    publisher.publish(0, HsbColor(RgbColor(0, 0, 0)));
+
+    for (int8_t level = 1; level <= 20; level++) {
+        SimHardware::advance(1000);
+        publisher.publish(level, HsbColor(RgbColor(level, 0, 0)));
+        publisher.update();
+    }
+    TEST_ASSERT_EQUAL(1, published.size());
+    TEST_ASSERT_TRUE(publisher.isPending());
+
+    SimHardware::advance(100000);
+    publisher.update();
+    TEST_ASSERT_EQUAL(2, published.size());
+    TEST_ASSERT_EQUAL(20, published[1].petalsOpenLevel);
+    TEST_ASSERT_TRUE(published[1].color == RgbColor(20, 0, 0));
+}
+
+void test_unchanged_state_not_sent(void) {
+    StatePublisher publisher(100, onPublish);
+    publisher.publish(30, HsbColor(RgbColor(0, 0, 255)));
+
+    // different HSB that renders into the same RGB, no delta for the listeners
+    SimHardware::advance(200000);
+    HsbColor same(RgbColor(0, 0, 255));
+    same.H += 0.0001;
+    publisher.publish(30, same);
+    TEST_ASSERT_EQUAL(1, published.size());
+
+    // change that went back before being sent
+    publisher.publish(40, HsbColor(RgbColor(0, 0, 255))); // sent, interval passed
+    SimHardware::advance(10000);
+    publisher.publish(30, HsbColor(RgbColor(0, 0, 255)));
+    publisher.publish(40, HsbColor(RgbColor(0, 0, 255)));
+    SimHardware::advance(200000);
+    publisher.update();
+    TEST_ASSERT_EQUAL(2, published.size());
+}
+
+void test_invalidate_resends(void) {
+    StatePublisher publisher(100, onPublish);
+    publisher.publish(30, HsbColor(RgbColor(0, 255, 0)));
+    publisher.invalidate();
+    publisher.publish(30, HsbColor(RgbColor(0, 255, 0)));
+    TEST_ASSERT_EQUAL(2, published.size());
+}
+
+void test_rejected_state_not_marked_sent(void) {
+    StatePublisher publisher(100, onPublish);
+    transportReady = false;
+    publisher.publish(30, HsbColor(RgbColor(0, 255, 0)));
+    TEST_ASSERT_EQUAL(0, published.size());
+    TEST_ASSERT_TRUE(publisher.isPending());
+
+    // same state again once the transport is ready, it never reached the listeners so it's not a duplicate
+    transportReady = true;
+    publisher.invalidate(); // connected
+    publisher.publish(30, HsbColor(RgbColor(0, 255, 0)));
+    TEST_ASSERT_EQUAL(1, published.size());
+    TEST_ASSERT_EQUAL(30, published[0].petalsOpenLevel);
+}
+
+void test_rejected_state_retried(void) {
+    StatePublisher publisher(100, onPublish);
+    publisher.publish(0, HsbColor(RgbColor(0, 0, 0)));
+
+    // last state of a burst is rejected, no publish follows
+    transportReady = false;
+    SimHardware::advance(200000);
+    publisher.publish(60, HsbColor(RgbColor(255, 0, 0)));
+    TEST_ASSERT_EQUAL(1, published.size());
+    TEST_ASSERT_TRUE(publisher.isPending());
+
+    // retried once per interval, not on every update
+    SimHardware::advance(50000);
+    publisher.update();
+    TEST_ASSERT_EQUAL(1, publisher.getRejectedCount());
+    SimHardware::advance(50000);
+    publisher.update();
+    TEST_ASSERT_EQUAL(2, publisher.getRejectedCount());
+
+    transportReady = true;
+    SimHardware::advance(100000);
+    publisher.update();
+    TEST_ASSERT_EQUAL(2, published.size());
+    TEST_ASSERT_EQUAL(60, published[1].petalsOpenLevel);
+    TEST_ASSERT_FALSE(publisher.isPending());
+}
+
+void test_counters(void) {
+    StatePublisher publisher(100, onPublish);
+    publisher.publish(0, HsbColor(RgbColor(0, 0, 0))); // sent
+    for (int8_t level = 1; level <= 5; level++) {
+        publisher.publish(level, HsbColor(RgbColor(0, 0, 0))); // 4 replaced, the last one sent later
+    }
+    SimHardware::advance(200000);
+    publisher.update();
+    SimHardware::advance(200000);
+    publisher.publish(5, HsbColor(RgbColor(0, 0, 0))); // unchanged
+    transportReady = false;
+    publisher.publish(6, HsbColor(RgbColor(0, 0, 0))); // rejected
+
+    TEST_ASSERT_EQUAL(2, publisher.getSentCount());
+    TEST_ASSERT_EQUAL(5, publisher.getSuppressedCount());
+    TEST_ASSERT_EQUAL(1, publisher.getRejectedCount());
+}
+
+void test_interval_change(void) {
+    StatePublisher publisher(1000, onPublish);
+    publisher.publish(10, HsbColor(RgbColor(0, 0, 0)));
+    SimHardware::advance(200000);
+    publisher.publish(20, HsbColor(RgbColor(0, 0, 0)));
+    TEST_ASSERT_EQUAL(1, published.size());
+
+    publisher.setMinInterval(100);
+    publisher.update();
+    TEST_ASSERT_EQUAL(2, published.size());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_state_sent_immediately);
+    RUN_TEST(test_burst_coalesced_latest_wins);
+    RUN_TEST(test_unchanged_state_not_sent);
+    RUN_TEST(test_invalidate_resends);
+    RUN_TEST(test_rejected_state_not_marked_sent);
+    RUN_TEST(test_rejected_state_retried);
+    RUN_TEST(test_counters);
+    RUN_TEST(test_interval_change);
+    UNITY_END();
+
+    return 0;
+}
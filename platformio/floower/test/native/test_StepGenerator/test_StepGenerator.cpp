@@ -0,0 +1,108 @@
+#include <unity.h>
+#include <vector>
+#include "hardware/StepGenerator.h"
+
+// measures the step timing of the generator against the ideal schedule
+
+struct StepRecord {
+    uint32_t time;
+    long position;
+};
+
+std::vector<StepRecord> steps;
+FakeStepGenerator *generator = nullptr;
+
+void setUp(void) {
+    steps.clear();
+    generator = new FakeStepGenerator();
+    generator->begin();
+    generator->onStep([](uint32_t time, long position) { steps.push_back({time, position}); });
+}
+
+void tearDown(void) {
+    delete generator;
+    generator = nullptr;
+}
+
+uint32_t maxJitter(uint32_t startTime, const StepSchedule &schedule) {
+    uint32_t expected = startTime;
+    uint32_t jitter = 0;
+    size_t index = 0;
+    for (uint8_t s = 0; s < schedule.size; s++) {
+        for (uint32_t i = 0; i < schedule.segments[s].steps && index < steps.size(); i++, index++) {
+            expected += schedule.segments[s].interval;
+            uint32_t diff = steps[index].time > expected ? steps[index].time - expected : expected - steps[index].time;
+            if (diff > jitter) {
+                jitter = diff;
+            }
+        }
+    }
+    return jitter;
+}
+
+void test_schedule_merges_segments(void) {
+    StepSchedule schedule;
+    schedule.add(100, 200);
+    schedule.add(50, 200);
+    schedule.add(0, 100);
+    schedule.add(10, 5); // clamped to minimum interval
+    TEST_ASSERT_EQUAL(2, schedule.size);
+    TEST_ASSERT_EQUAL(160, schedule.getTotalSteps());
+    TEST_ASSERT_EQUAL(150 * 200 + 10 * STEP_MIN_INTERVAL, schedule.getDuration());
+}
+
+void test_full_stroke_is_exact(void) {
+    StepSchedule schedule;
+    schedule.add(30000, 166); // open in ~5s
+    generator->start(schedule, STEP_DIRECTION_CW);
+
+    // main loop stalls in random chunks, the generator must not care
+    uint32_t chunks[] = {10, 5000, 1, 30000, 733, 12000};
+    uint8_t i = 0;
+    while (generator->isRunning()) {
+        generator->advance(chunks[i++ % 6]);
+    }
+
+    TEST_ASSERT_EQUAL(30000, steps.size());
+    TEST_ASSERT_EQUAL(30000, generator->getPosition());
+    TEST_ASSERT_EQUAL(0, maxJitter(0, schedule));
+}
+
+void test_multiple_segments_and_direction(void) {
+    generator->setPosition(1000);
+    StepSchedule schedule;
+    schedule.add(10, 500);
+    schedule.add(10, 100);
+    generator->start(schedule, STEP_DIRECTION_CCW);
+    generator->advance(100000);
+
+    TEST_ASSERT_FALSE(generator->isRunning());
+    TEST_ASSERT_EQUAL(980, generator->getPosition());
+    TEST_ASSERT_EQUAL(20, steps.size());
+    TEST_ASSERT_EQUAL(500, steps[0].time);
+    TEST_ASSERT_EQUAL(5000 + 100, steps[10].time);
+    TEST_ASSERT_EQUAL(0, maxJitter(0, schedule));
+}
+
+void test_retarget_keeps_position(void) {
+    StepSchedule schedule;
+    schedule.add(1000, 100);
+    generator->start(schedule, STEP_DIRECTION_CW);
+    generator->advance(25050);
+    TEST_ASSERT_EQUAL(250, generator->getPosition());
+
+    generator->start(schedule, STEP_DIRECTION_CCW);
+    generator->advance(10000);
+    TEST_ASSERT_EQUAL(150, generator->getPosition());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_schedule_merges_segments);
+    RUN_TEST(test_full_stroke_is_exact);
+    RUN_TEST(test_multiple_segments_and_direction);
+    RUN_TEST(test_retarget_keeps_position);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <EEPROM.h>
+#include "SimHardware.h"
+#include "SimTmcUart.h"
+#include "hardware/Petals.h"
+
+#define OPEN_STEPS 30000 // TMC_OPEN_STEPS
+
+// petals driven by the simulated driver, the motor turns them until they hit the closed end-stop
+
+Config *config;
+StepperPetals *petals;
+SimTmcUart *driver;
+
+void run(unsigned long durationMs) {
+    unsigned long endTime = millis() + durationMs;
+    while (millis() < endTime) {
+        petals->update();
+        delay(1);
+    }
+}
+
+void runUntilStopped(unsigned long timeoutMs) {
+    unsigned long endTime = millis() + timeoutMs;
+    while (petals->arePetalsMoving() && millis() < endTime) {
+        petals->update();
+        delay(1);
+    }
+    petals->update();
+}
+
+void setUp(void) {
+    SimHardware::reset();
+    EEPROM.erase();
+    config = new Config(11);
+    config->begin();
+    config->hardwareCalibration(1000, 1000, 9, 1);
+    config->factorySettings();
+    config->load();
+    petals = new StepperPetals(config);
+    driver = SimHardware::getTmcUart();
+}
+
+void tearDown(void) {
+    delete petals;
+    delete config;
+}
+
+void test_power_on_homing(void) {
+    driver->setMotorPosition(5000); // turned off half way through a movement
+    petals->init(true, false);
+    TEST_ASSERT_TRUE(petals->arePetalsMoving());
+    TEST_ASSERT_EQUAL(0, petals->getCurrentPetalsOpenLevel());
+
+    runUntilStopped(5000);
+    TEST_ASSERT_FALSE(petals->arePetalsMoving());
+    TEST_ASSERT_EQUAL(0, driver->getMotorPosition());
+    TEST_ASSERT_TRUE(driver->getStalledSteps() < 200); // stopped shortly after hitting the end-stop
+}
+
+void test_homing_when_closed(void) {
+    petals->init(true, false);
+    runUntilStopped(5000);
+    TEST_ASSERT_FALSE(petals->arePetalsMoving());
+    TEST_ASSERT_TRUE(millis() < 200);
+    TEST_ASSERT_TRUE(driver->getStalledSteps() < 200);
+}
+
+void test_wake_up_keeps_position(void) {
+    petals->init(true, true); // petals were closed before the deep sleep
+    TEST_ASSERT_FALSE(petals->arePetalsMoving());
+    TEST_ASSERT_EQUAL(0, driver->getStalledSteps());
+}
+
+void test_level_requested_while_homing(void) {
+    driver->setMotorPosition(2000);
+    petals->init(true, false);
+    petals->setPetalsOpenLevel(50, 1000);
+    TEST_ASSERT_EQUAL(50, petals->getPetalsOpenLevel());
+
+    runUntilStopped(5000);
+    TEST_ASSERT_EQUAL(OPEN_STEPS / 2, driver->getMotorPosition());
+    TEST_ASSERT_EQUAL(50, petals->getCurrentPetalsOpenLevel());
+}
+
+void test_close_stops_at_end_stop(void) {
+    petals->init(true, false);
+    runUntilStopped(5000);
+    uint32_t homingStalls = driver->getStalledSteps();
+
+    petals->setPetalsOpenLevel(100, config->speedMillis);
+    runUntilStopped(config->speedMillis + 1000);
+    TEST_ASSERT_EQUAL(OPEN_STEPS, driver->getMotorPosition());
+
+    petals->setPetalsOpenLevel(0, config->speedMillis);
+    runUntilStopped(config->speedMillis + 1000);
+    TEST_ASSERT_FALSE(petals->arePetalsMoving());
+    TEST_ASSERT_EQUAL(0, driver->getMotorPosition());
+    TEST_ASSERT_EQUAL(0, petals->getCurrentPetalsOpenLevel());
+    printf("close: %u steps against the end-stop\n", driver->getStalledSteps() - homingStalls);
+    TEST_ASSERT_TRUE(driver->getStalledSteps() - homingStalls < 200);
+}
+
+void test_lost_steps_rezeroed(void) {
+    petals->init(true, false);
+    runUntilStopped(5000);
+    petals->setPetalsOpenLevel(60, config->speedMillis);
+    runUntilStopped(config->speedMillis + 1000);
+
+    // petals were pushed closed by hand, the counted position is off
+    driver->setMotorPosition(OPEN_STEPS / 10);
+    petals->setPetalsOpenLevel(20, config->speedMillis);
+    runUntilStopped(config->speedMillis + 3000);
+
+    TEST_ASSERT_FALSE(petals->arePetalsMoving());
+    TEST_ASSERT_EQUAL(OPEN_STEPS / 5, driver->getMotorPosition()); // homed on the way and continued to the level
+    TEST_ASSERT_EQUAL(20, petals->getCurrentPetalsOpenLevel());
+}
+
+void test_obstruction_while_opening(void) {
+    petals->init(true, false);
+    runUntilStopped(5000);
+    petals->setPetalsOpenLevel(100, config->speedMillis);
+    run(config->speedMillis / 2);
+
+    // something blocks the petals, the motor stalls
+    long blockedAt = driver->getMotorPosition() + 100;
+    uint32_t stalledSteps = driver->getStalledSteps();
+    driver->setObstacle(blockedAt);
+    run(100);
+    TEST_ASSERT_FALSE(petals->arePetalsMoving());
+    TEST_ASSERT_EQUAL(blockedAt, driver->getMotorPosition());
+    printf("obstruction: %u steps against it\n", driver->getStalledSteps() - stalledSteps);
+    TEST_ASSERT_TRUE(driver->getStalledSteps() - stalledSteps < 200);
+    TEST_ASSERT_EQUAL(driver->getMotorPosition() * 100 / OPEN_STEPS, petals->getPetalsOpenLevel());
+}
+
+void test_high_stallguard_result_not_stalled(void) {
+    driver->setFreeSgValue(300); // lightly loaded motor, beyond 8 bits
+    petals->init(true, false);
+    runUntilStopped(5000);
+    uint32_t homingStalls = driver->getStalledSteps();
+
+    petals->setPetalsOpenLevel(100, config->speedMillis);
+    runUntilStopped(config->speedMillis + 1000);
+    TEST_ASSERT_EQUAL(OPEN_STEPS, driver->getMotorPosition());
+    TEST_ASSERT_EQUAL(100, petals->getCurrentPetalsOpenLevel());
+    TEST_ASSERT_EQUAL(homingStalls, driver->getStalledSteps());
+}
+
+void test_no_driver_no_homing(void) {
+    driver->setConnected(false);
+    petals->init(true, false);
+    TEST_ASSERT_FALSE(petals->arePetalsMoving());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_power_on_homing);
+    RUN_TEST(test_homing_when_closed);
+    RUN_TEST(test_wake_up_keeps_position);
+    RUN_TEST(test_level_requested_while_homing);
+    RUN_TEST(test_close_stops_at_end_stop);
+    RUN_TEST(test_lost_steps_rezeroed);
+    RUN_TEST(test_obstruction_while_opening);
+    RUN_TEST(test_high_stallguard_result_not_stalled);
+    RUN_TEST(test_no_driver_no_homing);
+    UNITY_END();
+
+    return 0;
+}
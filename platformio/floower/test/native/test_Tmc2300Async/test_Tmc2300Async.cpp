@@ -0,0 +1,150 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <vector>
+#include "SimHardware.h"
+#include "SimTmcUart.h"
+#include <tmc2300.h>
+
+// asynchronous register access over the simulated single wire UART, time moves only when the test lets it
+
+#define DRIVER_ADDRESS 0
+
+SimTmcUart *uart;
+TMC2300 *driver;
+
+void pollUntilIdle(unsigned long timeoutMs) {
+    unsigned long endTime = millis() + timeoutMs;
+    while (driver->isBusy() && millis() < endTime) {
+        driver->poll();
+        delay(1);
+    }
+}
+
+void setUp(void) {
+    SimHardware::reset();
+    uart = new SimTmcUart();
+    driver = new TMC2300(uart, 0.1, DRIVER_ADDRESS);
+}
+
+void tearDown(void) {
+    delete driver;
+    delete uart;
+}
+
+void test_batched_read_without_waiting(void) {
+    uart->setRegister(REG_DRV_STATUS::address, 0x80000002);
+    uart->setRegister(REG_SG_VALUE_ADDRESS, 42);
+    uart->setRegister(REG_GSTAT::address, 0x2);
+
+    bool done = false;
+    TMC2300Status result;
+    TEST_ASSERT_TRUE(driver->readStatusAsync([&](bool ok, TMC2300Status status) {
+        TEST_ASSERT_TRUE(ok);
+        result = status;
+        done = true;
+    }));
+    TEST_ASSERT_TRUE(driver->isBusy());
+    TEST_ASSERT_EQUAL(0, uart->getReadCount()); // nothing happens until polled
+
+    unsigned long startTime = micros();
+    driver->poll();
+    TEST_ASSERT_TRUE(micros() - startTime < 1000); // blocking read waits 2ms for every register
+
+    TEST_ASSERT_TRUE(done);
+    TEST_ASSERT_FALSE(driver->isBusy());
+    TEST_ASSERT_EQUAL(3, uart->getReadCount());
+    TEST_ASSERT_EQUAL_HEX32(0x80000002, result.drvStatus.sr);
+    TEST_ASSERT_TRUE(result.drvStatus.ot);
+    TEST_ASSERT_EQUAL(42, result.sgValue);
+    TEST_ASSERT_TRUE(result.gstat.drv_err);
+}
+
+void test_requests_complete_in_order(void) {
+    std::vector<int> completed;
+    TEST_ASSERT_TRUE(driver->writeAsync(REG_TCOOLTHRS_ADDRESS, 1234, [&](bool ok) {
+        TEST_ASSERT_TRUE(ok);
+        completed.push_back(1);
+    }));
+    const uint8_t addresses[] = {REG_TCOOLTHRS_ADDRESS};
+    TEST_ASSERT_TRUE(driver->readAsync(addresses, 1, [&](bool ok, const uint32_t *values, uint8_t count) {
+        TEST_ASSERT_TRUE(ok);
+        TEST_ASSERT_EQUAL(1, count);
+        TEST_ASSERT_EQUAL(1234, values[0]); // written before
+        completed.push_back(2);
+    }));
+    TEST_ASSERT_TRUE(driver->writeAsync(REG_SGTHRS_ADDRESS, 30));
+
+    // write lets the datagram out before the next one, the loop goes on meanwhile
+    driver->poll();
+    TEST_ASSERT_EQUAL(1, uart->getWriteCount());
+    TEST_ASSERT_EQUAL(0, completed.size());
+
+    pollUntilIdle(100);
+    TEST_ASSERT_EQUAL(2, completed.size());
+    TEST_ASSERT_EQUAL(1, completed[0]);
+    TEST_ASSERT_EQUAL(2, completed[1]);
+    TEST_ASSERT_EQUAL(30, uart->getRegister(REG_SGTHRS_ADDRESS));
+}
+
+void test_callback_queues_next_request(void) {
+    uint8_t samples = 0;
+    std::function<void(bool, TMC2300Status)> sample = [&](bool ok, TMC2300Status status) {
+        TEST_ASSERT_TRUE(ok);
+        if (++samples < 5) {
+            driver->readStatusAsync(sample);
+        }
+    };
+    driver->readStatusAsync(sample);
+    pollUntilIdle(100);
+    TEST_ASSERT_EQUAL(5, samples);
+    TEST_ASSERT_EQUAL(15, uart->getReadCount());
+}
+
+void test_driver_not_responding(void) {
+    uart->setConnected(false);
+    bool failed = false;
+    driver->readStatusAsync([&](bool ok, TMC2300Status status) {
+        TEST_ASSERT_FALSE(ok);
+        TEST_ASSERT_EQUAL(0, status.sgValue);
+        failed = true;
+    });
+
+    driver->poll();
+    TEST_ASSERT_FALSE(failed); // waits for the reply without blocking
+    pollUntilIdle(100);
+    TEST_ASSERT_TRUE(failed);
+    TEST_ASSERT_TRUE(millis() < 50); // first register timed out twice, the rest of the batch is dropped
+}
+
+void test_queue_full(void) {
+    for (uint8_t i = 0; i < TMC2300_QUEUE_SIZE; i++) {
+        TEST_ASSERT_TRUE(driver->writeAsync(REG_SGTHRS_ADDRESS, i));
+    }
+    TEST_ASSERT_FALSE(driver->writeAsync(REG_SGTHRS_ADDRESS, 100));
+    const uint8_t addresses[TMC2300_BATCH_SIZE + 1] = {0};
+    TEST_ASSERT_FALSE(driver->readAsync(addresses, TMC2300_BATCH_SIZE + 1, nullptr));
+
+    pollUntilIdle(100);
+    TEST_ASSERT_EQUAL(TMC2300_QUEUE_SIZE - 1, uart->getRegister(REG_SGTHRS_ADDRESS));
+}
+
+void test_blocking_read_finishes_queue(void) {
+    uart->setRegister(REG_DRV_STATUS::address, 0x80000000);
+    driver->writeAsync(REG_SGTHRS_ADDRESS, 30);
+    TEST_ASSERT_EQUAL(0, driver->testConnection());
+    TEST_ASSERT_FALSE(driver->isBusy());
+    TEST_ASSERT_EQUAL(30, uart->getRegister(REG_SGTHRS_ADDRESS));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_batched_read_without_waiting);
+    RUN_TEST(test_requests_complete_in_order);
+    RUN_TEST(test_callback_queues_next_request);
+    RUN_TEST(test_driver_not_responding);
+    RUN_TEST(test_queue_full);
+    RUN_TEST(test_blocking_read_finishes_queue);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <EEPROM.h>
+#include <chrono>
+#include "SimHardware.h"
+#include "SimTmcUart.h"
+#include "hardware/Petals.h"
+#include <tmc2300.h>
+
+#define DRIVER_ADDRESS 0
+#define CRC_ROUNDS 200000
+
+// CRC as computed bit by bit before the table
+static uint8_t bitwiseCRC(const uint8_t datagram[], uint8_t len) {
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t currentByte = datagram[i];
+        for (uint8_t j = 0; j < 8; j++) {
+            if ((crc >> 7) ^ (currentByte & 0x01)) {
+                crc = (crc << 1) ^ 0x07;
+            }
+            else {
+                crc = (crc << 1);
+            }
+            currentByte = currentByte >> 1;
+        }
+    }
+    return crc;
+}
+
+static double benchmark(uint8_t (*crc)(const uint8_t[], uint8_t)) {
+    uint8_t datagram[7] = {0x05, 0x00, 0x6C, 0x13, 0x00, 0x80, 0x01};
+    volatile uint8_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < CRC_ROUNDS; i++) {
+        datagram[6] = i;
+        sink = sink + crc(datagram, 7);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / CRC_ROUNDS;
+}
+
+SimTmcUart *uart;
+TMC2300 *driver;
+
+uint32_t transactions() {
+    SimTmcUart *sim = SimHardware::getTmcUart();
+    return sim->getReadCount() + sim->getWriteCount();
+}
+
+void setUp(void) {
+    SimHardware::reset();
+    EEPROM.erase();
+    uart = new SimTmcUart();
+    driver = new TMC2300(uart, 0.1, DRIVER_ADDRESS);
+}
+
+void tearDown(void) {
+    delete driver;
+    delete uart;
+}
+
+void test_crc_table_matches_bitwise(void) {
+    uint8_t datagram[8];
+    uint32_t seed = 1;
+    for (uint16_t i = 0; i < 1000; i++) {
+        for (uint8_t j = 0; j < 8; j++) {
+            seed = seed * 1664525 + 1013904223;
+            datagram[j] = seed >> 24;
+        }
+        uint8_t len = 1 + i % 8;
+        TEST_ASSERT_EQUAL(bitwiseCRC(datagram, len), TMC2300::calcCRC(datagram, len));
+    }
+}
+
+void test_crc_benchmark(void) {
+    double bitwise = benchmark(bitwiseCRC);
+    double table = benchmark(TMC2300::calcCRC);
+    printf("CRC of 7 byte datagram: bitwise %.1f ns, table %.1f ns\n", bitwise, table);
+    TEST_ASSERT_TRUE(table < bitwise);
+}
+
+void test_reads_served_from_shadow(void) {
+    REG_CHOPCONF chopconf = driver->readChopconf(); // power-on value is known
+    TEST_ASSERT_EQUAL_HEX32(TMC2300_CHOPCONF_DEFAULT, chopconf.sr);
+    TEST_ASSERT_EQUAL(0, uart->getReadCount());
+
+    driver->readGConfReg();
+    driver->readGConfReg();
+    TEST_ASSERT_EQUAL(1, uart->getReadCount()); // read once, known since
+
+    driver->readDrvStatusReg();
+    driver->readDrvStatusReg();
+    TEST_ASSERT_EQUAL(3, uart->getReadCount()); // status always comes from the driver
+}
+
+void test_flush_writes_changed_only(void) {
+    driver->setRegister(REG_SGTHRS_ADDRESS, 30);
+    driver->setRegister(REG_TCOOLTHRS_ADDRESS, 100);
+    driver->setRegister(REG_CHOPCONF::address, TMC2300_CHOPCONF_DEFAULT); // no change
+    TEST_ASSERT_EQUAL(0, uart->getWriteCount());
+
+    TEST_ASSERT_EQUAL(2, driver->flush());
+    TEST_ASSERT_EQUAL(2, uart->getWriteCount());
+    TEST_ASSERT_EQUAL(30, uart->getRegister(REG_SGTHRS_ADDRESS));
+    TEST_ASSERT_EQUAL(100, uart->getRegister(REG_TCOOLTHRS_ADDRESS));
+
+    driver->setRegister(REG_SGTHRS_ADDRESS, 30);
+    driver->writeSGThrs(30);
+    TEST_ASSERT_EQUAL(0, driver->flush());
+    TEST_ASSERT_EQUAL(2, uart->getWriteCount());
+
+    // driver was reset, everything is written again
+    driver->resetShadow();
+    driver->writeSGThrs(30);
+    TEST_ASSERT_EQUAL(3, uart->getWriteCount());
+}
+
+void test_transactions_per_init_and_move(void) {
+    Config config(11);
+    config.begin();
+    config.hardwareCalibration(1000, 1000, 9, 1);
+    config.factorySettings();
+    config.load();
+    StepperPetals petals(&config);
+
+    // before the shadow: connection test, IOIN, GSTAT and CHOPCONF reads, GSTAT clear and 4 writes
+    petals.init(false, false);
+    uint32_t init = transactions();
+    printf("init: %u UART transactions, %u saved\n", init, 9 - init);
+    TEST_ASSERT_EQUAL(7, init);
+
+    petals.init(false, true); // wake up, configuration is done
+    TEST_ASSERT_EQUAL(init + 1, transactions());
+
+    // only StallGuard is read during the movement, the configuration is left alone
+    uint32_t writes = SimHardware::getTmcUart()->getWriteCount();
+    uint32_t reads = SimHardware::getTmcUart()->getReadCount();
+    petals.setPetalsOpenLevel(100, config.speedMillis);
+    while (petals.arePetalsMoving()) {
+        petals.update();
+        delay(1);
+    }
+    petals.update();
+    reads = SimHardware::getTmcUart()->getReadCount() - reads;
+    printf("move: %u status reads, %u writes\n", reads, SimHardware::getTmcUart()->getWriteCount() - writes);
+    TEST_ASSERT_EQUAL(writes, SimHardware::getTmcUart()->getWriteCount());
+    TEST_ASSERT_EQUAL(0, reads % 3); // batched DRV_STATUS, SG_VALUE and GSTAT
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_crc_table_matches_bitwise);
+    RUN_TEST(test_crc_benchmark);
+    RUN_TEST(test_reads_served_from_shadow);
+    RUN_TEST(test_flush_writes_changed_only);
+    RUN_TEST(test_transactions_per_init_and_move);
+    UNITY_END();
+
+    return 0;
+}
@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+"""Packs a firmware image for the OTA update of Floower.
+
+The image is compressed to the heatshrink bitstream (LZSS with a small fixed window) that the Floower decompresses
+while downloading, so it needs no more RAM than the window. Prints the manifest of the update command, its size and
+digest are of the image as flashed.
+
+With --base, a delta patch from the base image (the firmware running on the Floower) is packed instead. The patch is
+a sequence of records (extra length, diff length, source seek) followed by the extra bytes taken as they are and the
+diff bytes added to the source, mostly zeros where the code only moved. The Floower checks the digest of the base in
+the patch header and downloads the full image when the patch can't be applied.
+
+usage: ota-pack.py firmware.bin [-o firmware.fhs] [-w 11] [-l 4] [-b previous.bin]
+"""
+
+import argparse
+import hashlib
+import json
+import struct
+import sys
+
+MAGIC = b'FLHS'
+VERSION = 1
+HEADER = '<4sBBBxI'  # magic, version, window bits, lookahead bits, unpacked size
+MAX_CHAIN = 64  # match candidates tried at every position
+WINDOW_BITS_MAX = 11  # window the Floower keeps in RAM
+
+DELTA_MAGIC = b'FLDP'
+DELTA_VERSION = 1
+DELTA_HEADER = '<4sB3xII32s'  # magic, version, source size, target size, source digest
+DELTA_RECORD = '<IIi'  # extra length, diff length, source seek
+SEED = 12  # bytes matching exactly where a diff may start
+INDEX_STEP = 4  # source positions indexed, seeds are found at any alignment of the target
+GIVE_UP = 64  # bytes without improving a diff before it ends
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.current = 0
+        self.bits = 0
+
+    def write(self, value, count):
+        for i in range(count - 1, -1, -1):
+            self.current = (self.current << 1) | ((value >> i) & 1)
+            self.bits += 1
+            if self.bits == 8:
+                self.out.append(self.current)
+                self.current = 0
+                self.bits = 0
+
+    def finish(self):
+        if self.bits > 0:
+            self.out.append(self.current << (8 - self.bits))  # zero padded
+        return bytes(self.out)
+
+
+def compress(data, window_bits, lookahead_bits):
+    """Greedy LZSS: literal is 1 + 8 bits, back reference 0 + index + count bits."""
+    window = 1 << window_bits
+    max_match = 1 << lookahead_bits
+    backref_bits = 1 + window_bits + lookahead_bits
+    min_match = backref_bits // 9 + 1  # shorter matches cost more than literals
+    writer = BitWriter()
+    chains = {}  # 3 byte prefix -> recent positions
+    length = len(data)
+    position = 0
+    while position < length:
+        best_length = 0
+        best_offset = 0
+        if position + 3 <= length:
+            key = data[position:position + 3]
+            candidates = chains.get(key)
+            if candidates:
+                limit = min(max_match, length - position)
+                for candidate in reversed(candidates):
+                    offset = position - candidate
+                    if offset > window:
+                        break
+                    match = 3
+                    while match < limit and data[candidate + match] == data[position + match]:
+                        match += 1
+                    if match > best_length:
+                        best_length = match
+                        best_offset = offset
+                        if match == limit:
+                            break
+        if best_length >= max(min_match, 3):
+            writer.write(0, 1)
+            writer.write(best_offset - 1, window_bits)
+            writer.write(best_length - 1, lookahead_bits)
+            step = best_length
+        else:
+            writer.write(1, 1)
+            writer.write(data[position], 8)
+            step = 1
+        for i in range(position, min(position + step, length - 2)):
+            key = data[i:i + 3]
+            candidates = chains.setdefault(key, [])
+            candidates.append(i)
+            if len(candidates) > MAX_CHAIN:
+                del candidates[0]
+        position += step
+    return writer.finish()
+
+
+def extend(source, target, source_start, target_start, step, limit):
+    """Length of the diff from the start on in the step direction, where the matching bytes outweigh the others."""
+    equal = 0
+    score = 0
+    best = 0
+    for i in range(1, limit + 1):
+        if step > 0:
+            equal += source[source_start + i - 1] == target[target_start + i - 1]
+        else:
+            equal += source[source_start - i] == target[target_start - i]
+        if equal * 2 - i > score:
+            score = equal * 2 - i
+            best = i
+        elif i - best > GIVE_UP:
+            break
+    return best
+
+
+def delta(source, target):
+    index = {}
+    for position in range(0, len(source) - SEED + 1, INDEX_STEP):
+        index.setdefault(source[position:position + SEED], position)
+
+    patch = bytearray(struct.pack(DELTA_HEADER, DELTA_MAGIC, DELTA_VERSION, len(source), len(target),
+                                  hashlib.sha256(source).digest()))
+    source_position = 0
+    extra_start = 0
+    position = 0
+    while position < len(target):
+        seed = index.get(target[position:position + SEED])
+        if seed is None:
+            position += 1
+            continue
+        length = extend(source, target, seed, position, 1, min(len(source) - seed, len(target) - position))
+        back = extend(source, target, seed, position, -1, min(seed, position - extra_start))
+        source_start = seed - back
+        target_start = position - back
+        length += back
+
+        patch += struct.pack(DELTA_RECORD, target_start - extra_start, length, source_start - source_position)
+        patch += target[extra_start:target_start]
+        patch += bytes((target[target_start + i] - source[source_start + i]) & 0xFF for i in range(length))
+        source_position = source_start + length
+        position = target_start + length
+        extra_start = position
+    patch += struct.pack(DELTA_RECORD, len(target) - extra_start, 0, 0)
+    patch += target[extra_start:]
+    return bytes(patch)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Packs a firmware image for the OTA update of Floower')
+    parser.add_argument('image', help='firmware image built by PlatformIO (.pio/build/floower-esp32/firmware.bin)')
+    parser.add_argument('-o', '--output', help='packed image, <image>.fhs by default')
+    parser.add_argument('-w', '--window', type=int, default=11, help='window size bits, 8 to %d' % WINDOW_BITS_MAX)
+    parser.add_argument('-l', '--lookahead', type=int,
+                        help='lookahead size bits, 3 to window - 1, 4 for an image and window - 1 for a patch by default')
+    parser.add_argument('-u', '--url', default='<host>/<path>', help='url the packed image is served from')
+    parser.add_argument('-b', '--base', help='image of the previous version to make a delta patch from')
+    parser.add_argument('-f', '--full-url', default='<host>/<full image path>', help='url of the full image, fallback of the delta')
+    args = parser.parse_args()
+    if args.lookahead is None:
+        args.lookahead = args.window - 1 if args.base else 4  # long runs of zeros in a patch
+    if not 8 <= args.window <= WINDOW_BITS_MAX or not 3 <= args.lookahead < args.window:
+        sys.exit('unsupported window or lookahead size')
+
+    with open(args.image, 'rb') as file:
+        image = file.read()
+    payload = image
+    if args.base:
+        with open(args.base, 'rb') as file:
+            payload = delta(file.read(), image)
+    packed = struct.pack(HEADER, MAGIC, VERSION, args.window, args.lookahead, len(payload))
+    packed += compress(payload, args.window, args.lookahead)
+    output = args.output or args.image + '.fhs'
+    with open(output, 'wb') as file:
+        file.write(packed)
+
+    print('%s: %d -> %d bytes, %.1f %%' % (output, len(image), len(packed), 100.0 * len(packed) / len(image)))
+    manifest = {'u': args.url, 's': len(image), 'h': hashlib.sha256(image).hexdigest()}
+    if args.base:
+        manifest['u'] = args.full_url
+        manifest['d'] = args.url
+    print(json.dumps(manifest))
+
+
+if __name__ == '__main__':
+    main()